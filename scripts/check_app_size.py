@@ -0,0 +1,56 @@
+"""Fails the build when the firmware doesn't fit the smallest app partition of the partition table.
+
+The web asset image is linked into the firmware, so growing web/ grows the app. An image over the OTA slot can't be
+updated over the air any more. Runs as a PlatformIO post script after the firmware binary is built, or standalone:
+
+	python scripts/check_app_size.py <partition table csv> <firmware bin>
+"""
+import csv
+import os
+import sys
+
+
+def parse_size(value):
+	value = value.strip().upper()
+	if value.endswith("K"):
+		return int(value[:-1], 0) * 1024
+	if value.endswith("M"):
+		return int(value[:-1], 0) * 1024 * 1024
+	return int(value, 0)
+
+
+def app_slot_size(table):
+	sizes = []
+	with open(table, newline="") as file:
+		for row in csv.reader(file):
+			if not row or row[0].strip().startswith("#") or len(row) < 5:
+				continue
+			if row[1].strip() == "app":
+				sizes.append(parse_size(row[4]))
+	if not sizes:
+		raise ValueError("no app partition in %s" % table)
+	return min(sizes)
+
+
+def check(table, firmware):
+	slot = app_slot_size(table)
+	size = os.path.getsize(firmware)
+	print("Firmware %d bytes, app slot %d bytes, %d bytes (%.1f%%) free" % (size, slot, slot - size, 100.0 * (slot - size) / slot))
+	return size <= slot
+
+
+try:
+	Import("env") # noqa: F821 - provided by SCons
+except NameError:
+	env = None
+
+if env is not None:
+	def after_build(source, target, env):
+		table = os.path.join(env.subst("$PROJECT_DIR"), env.GetProjectOption("board_build.partitions"))
+		if not check(table, target[0].get_abspath()):
+			sys.stderr.write("Error: firmware doesn't fit the app partition, OTA updates would fail\n")
+			env.Exit(1)
+
+	env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", after_build)
+elif __name__ == "__main__":
+	sys.exit(0 if check(sys.argv[1], sys.argv[2]) else 1)
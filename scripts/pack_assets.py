@@ -0,0 +1,95 @@
+"""Packs web/ into the read-only asset image linked into the firmware, layout described in src/AssetImage.h.
+
+Text assets not compressed yet are gzipped, references to deps/ in HTML get ?v=<first 8 hash digits> of the current
+dependency so browsers may cache it as immutable. Runs as a PlatformIO pre script before every build, or standalone:
+
+	python scripts/pack_assets.py <source dir> <image>
+"""
+import gzip
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"HAI1"
+FLAG_GZIP = 0x1
+COMPRESSED = (".html", ".css", ".js", ".json", ".svg")
+DEPS_REFERENCE = re.compile(r"""(["'])(deps/[^"'?]+)(?:\?v=[0-9a-f]*)?\1""")
+
+
+def fnv1a64(data):
+	value = 0xcbf29ce484222325
+	for byte in data:
+		value = ((value ^ byte) * 0x100000001b3) & 0xffffffffffffffff
+	return value
+
+
+def collect(root):
+	files = {}
+	for directory, _, names in os.walk(root):
+		for name in names:
+			full = os.path.join(directory, name)
+			with open(full, "rb") as file:
+				files["/" + os.path.relpath(full, root).replace(os.sep, "/")] = file.read()
+	return files
+
+
+def stored(path, content):
+	if path.endswith(COMPRESSED):
+		return gzip.compress(content, compresslevel=9, mtime=0), FLAG_GZIP # fixed mtime keeps ETags stable
+	return content, 0
+
+
+def pack(root, target):
+	files = collect(root)
+	entries = {}
+	for path, content in files.items():
+		if not path.endswith(".html"):
+			entries[path] = stored(path, content)
+
+	def versioned(match):
+		path = "/" + match.group(2)
+		if path not in entries:
+			return match.group(0)
+		return "%s%s?v=%08x%s" % (match.group(1), match.group(2), fnv1a64(entries[path][0]) >> 32, match.group(1))
+
+	for path, content in files.items():
+		if path.endswith(".html"):
+			entries[path] = stored(path, DEPS_REFERENCE.sub(versioned, content.decode("utf-8")).encode("utf-8"))
+
+	paths = sorted(entries, key=lambda path: path.encode("utf-8"))
+	table = bytearray()
+	blob = bytearray(16 + 24 * len(paths))
+	for path in paths:
+		data, flags = entries[path]
+		name = path.encode("utf-8")
+		name_offset = len(blob)
+		blob += name
+		blob += bytes(-len(blob) % 4)
+		table += struct.pack("<QIHHII", fnv1a64(data), name_offset, len(name), flags, len(blob), len(data))
+		blob += data
+	blob[0:16] = struct.pack("<4sIII", MAGIC, len(paths), len(blob), 0)
+	blob[16:16 + len(table)] = table
+
+	os.makedirs(os.path.dirname(target), exist_ok=True)
+	if os.path.exists(target):
+		with open(target, "rb") as file:
+			if file.read() == blob:
+				return len(paths), len(blob) # unchanged, don't relink
+	with open(target, "wb") as file:
+		file.write(blob)
+	return len(paths), len(blob)
+
+
+try:
+	Import("env") # noqa: F821 - provided by SCons
+except NameError:
+	env = None
+
+if env is not None:
+	project = env.subst("$PROJECT_DIR")
+	count, size = pack(os.path.join(project, "web"), os.path.join(project, ".pio", "assets.bin"))
+	print("Packed %d web assets, %d bytes" % (count, size))
+elif __name__ == "__main__":
+	count, size = pack(sys.argv[1], sys.argv[2])
+	print("Packed %d web assets, %d bytes" % (count, size))
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "BeaconBleAddress.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace heating {
+
+// Drops repeated BLE advertisements before they are parsed. Sensors repeat the same payload many times per measurement,
+// so only a changed payload (compared by hash) is let through. An unchanged one is let through again after refresh
+// time to keep the sensor alive in the room samples. Direct-mapped cache - address collision only costs an extra parse.
+template <size_t Capacity>
+class AdvertisementFilter {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+
+public:
+	using clock_t = std::chrono::steady_clock;
+
+	explicit AdvertisementFilter(std::chrono::seconds refresh) : refresh_(refresh) {}
+
+	// true if advertisement should be parsed
+	bool isNew(BleAddress_t const &address, uint8_t const *payload, size_t payloadSize, clock_t::time_point now) {
+		received_.fetch_add(1, std::memory_order_relaxed);
+
+		auto hash = payloadHash(payload, payloadSize);
+		auto &entry = entries_[BleAddressHash{}(address) & (Capacity - 1)];
+
+		if (entry.used && entry.address == address && entry.payloadHash == hash && now - entry.forwarded < refresh_) {
+			duplicates_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		entry = Entry{address, hash, now, true};
+		return true;
+	}
+
+	// counters are written by the BLE host task and read by the status of the controller task
+	uint32_t getReceived() const { return received_.load(std::memory_order_relaxed); }
+	uint32_t getDuplicates() const { return duplicates_.load(std::memory_order_relaxed); }
+
+	static uint32_t payloadHash(uint8_t const *payload, size_t payloadSize) { // FNV-1a
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < payloadSize; ++i) {
+			hash = (hash ^ payload[i]) * 16777619u;
+		}
+		return hash;
+	}
+
+private:
+	struct Entry {
+		BleAddress_t address;
+		uint32_t payloadHash;
+		clock_t::time_point forwarded;
+		bool used = false;
+	};
+
+	std::chrono::seconds refresh_;
+	std::array<Entry, Capacity> entries_{};
+	std::atomic<uint32_t> received_{0};
+	std::atomic<uint32_t> duplicates_{0};
+};
+
+} // namespace heating
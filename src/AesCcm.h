@@ -0,0 +1,203 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace heating::crypto {
+
+// AES-128 block encryption (FIPS-197). The key schedule is expanded once in constructor, so one instance per key is kept
+// and every block costs only the rounds. Only the forward cipher is needed - CCM decrypts with the counter mode keystream.
+class Aes128 {
+public:
+	using Key_t = std::array<uint8_t, 16>;
+	using Block_t = std::array<uint8_t, 16>;
+
+	explicit Aes128(Key_t const &key) {
+		static constexpr uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36};
+
+		for (size_t i = 0; i < 16; ++i) {
+			roundKeys_[i] = key[i];
+		}
+		for (size_t i = 16; i < roundKeys_.size(); i += 4) {
+			uint8_t word[4] = {roundKeys_[i - 4], roundKeys_[i - 3], roundKeys_[i - 2], roundKeys_[i - 1]};
+			if (i % 16 == 0) {
+				uint8_t first = word[0];
+				word[0] = static_cast<uint8_t>(sbox[word[1]] ^ rcon[i / 16 - 1]);
+				word[1] = sbox[word[2]];
+				word[2] = sbox[word[3]];
+				word[3] = sbox[first];
+			}
+			for (size_t j = 0; j < 4; ++j) {
+				roundKeys_[i + j] = roundKeys_[i + j - 16] ^ word[j];
+			}
+		}
+	}
+
+	void encrypt(Block_t &block) const {
+		addRoundKey(block, 0);
+		for (size_t round = 1; round < 10; ++round) {
+			subBytesShiftRows(block);
+			mixColumns(block);
+			addRoundKey(block, round);
+		}
+		subBytesShiftRows(block);
+		addRoundKey(block, 10);
+	}
+
+private:
+	// clang-format off
+	static constexpr uint8_t sbox[256] = {
+		0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+		0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+		0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+		0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+		0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+		0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+		0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+		0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+		0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+		0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+		0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+		0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+		0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+		0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+		0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+		0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16};
+	// clang-format on
+
+	static uint8_t xtime(uint8_t value) { return static_cast<uint8_t>((value << 1) ^ ((value & 0x80) ? 0x1B : 0x00)); }
+
+	void addRoundKey(Block_t &block, size_t round) const {
+		auto const *key = roundKeys_.data() + round * 16;
+		for (size_t i = 0; i < 16; ++i) {
+			block[i] ^= key[i];
+		}
+	}
+
+	// state is column major - byte (row, column) at column * 4 + row
+	static void subBytesShiftRows(Block_t &block) {
+		Block_t state = block;
+		for (size_t column = 0; column < 4; ++column) {
+			for (size_t row = 0; row < 4; ++row) {
+				block[column * 4 + row] = sbox[state[((column + row) % 4) * 4 + row]];
+			}
+		}
+	}
+
+	static void mixColumns(Block_t &block) {
+		for (size_t column = 0; column < 4; ++column) {
+			uint8_t *c = block.data() + column * 4;
+			uint8_t all = c[0] ^ c[1] ^ c[2] ^ c[3];
+			uint8_t first = c[0];
+			c[0] ^= all ^ xtime(c[0] ^ c[1]);
+			c[1] ^= all ^ xtime(c[1] ^ c[2]);
+			c[2] ^= all ^ xtime(c[2] ^ c[3]);
+			c[3] ^= all ^ xtime(c[3] ^ first);
+		}
+	}
+
+	std::array<uint8_t, 176> roundKeys_;
+};
+
+// AES-CCM (RFC 3610) with nonce of 7..13 bytes, tag of 4..16 bytes and associated data shorter than 0xFF00 bytes.
+namespace ccm {
+namespace detail {
+inline Aes128::Block_t counterBlock(uint8_t const *nonce, size_t nonceLength, uint32_t counter) {
+	Aes128::Block_t block{};
+	block[0] = static_cast<uint8_t>(14 - nonceLength); // L - 1
+	for (size_t i = 0; i < nonceLength; ++i) {
+		block[1 + i] = nonce[i];
+	}
+	for (size_t i = 15; i > nonceLength && counter; --i, counter >>= 8) {
+		block[i] = static_cast<uint8_t>(counter);
+	}
+	return block;
+}
+
+// CBC-MAC over B0, length prefixed associated data and plaintext - both zero padded to blocks
+inline Aes128::Block_t mac(Aes128 const &aes, uint8_t const *nonce, size_t nonceLength, uint8_t const *aad, size_t aadLength, uint8_t const *plain, size_t length, size_t tagLength) {
+	Aes128::Block_t x = counterBlock(nonce, nonceLength, static_cast<uint32_t>(length));
+	x[0] = static_cast<uint8_t>((aadLength ? 0x40 : 0x00) | (((tagLength - 2) / 2) << 3) | (14 - nonceLength));
+	aes.encrypt(x);
+
+	if (aadLength) {
+		size_t pos = 2;
+		x[0] ^= static_cast<uint8_t>(aadLength >> 8);
+		x[1] ^= static_cast<uint8_t>(aadLength);
+		for (size_t i = 0; i < aadLength; ++i) {
+			x[pos++] ^= aad[i];
+			if (pos == 16) {
+				aes.encrypt(x);
+				pos = 0;
+			}
+		}
+		if (pos) {
+			aes.encrypt(x);
+		}
+	}
+
+	for (size_t i = 0; i < length; i += 16) {
+		for (size_t j = 0; j < 16 && i + j < length; ++j) {
+			x[j] ^= plain[i + j];
+		}
+		aes.encrypt(x);
+	}
+	return x;
+}
+
+// XOR with keystream blocks A1, A2... - same operation encrypts and decrypts
+inline void ctr(Aes128 const &aes, uint8_t const *nonce, size_t nonceLength, uint8_t const *in, size_t length, uint8_t *out) {
+	for (size_t i = 0; i < length; i += 16) {
+		auto keystream = counterBlock(nonce, nonceLength, static_cast<uint32_t>(i / 16 + 1));
+		aes.encrypt(keystream);
+		for (size_t j = 0; j < 16 && i + j < length; ++j) {
+			out[i + j] = in[i + j] ^ keystream[j];
+		}
+	}
+}
+
+inline bool validParameters(size_t nonceLength, size_t aadLength, size_t tagLength) {
+	return nonceLength >= 7 && nonceLength <= 13 && tagLength >= 4 && tagLength <= 16 && tagLength % 2 == 0 && aadLength < 0xFF00;
+}
+} // namespace detail
+
+inline bool encrypt(Aes128 const &aes, uint8_t const *nonce, size_t nonceLength, uint8_t const *aad, size_t aadLength, uint8_t const *plain, size_t length, uint8_t *cipher, uint8_t *tag, size_t tagLength) {
+	if (!detail::validParameters(nonceLength, aadLength, tagLength)) {
+		return false;
+	}
+	auto x = detail::mac(aes, nonce, nonceLength, aad, aadLength, plain, length, tagLength);
+	auto s0 = detail::counterBlock(nonce, nonceLength, 0);
+	aes.encrypt(s0);
+	for (size_t i = 0; i < tagLength; ++i) {
+		tag[i] = x[i] ^ s0[i];
+	}
+	detail::ctr(aes, nonce, nonceLength, plain, length, cipher);
+	return true;
+}
+
+// false if tag doesn't match - plain is then zeroed, nothing unauthenticated leaks to the caller
+inline bool decrypt(Aes128 const &aes, uint8_t const *nonce, size_t nonceLength, uint8_t const *aad, size_t aadLength, uint8_t const *cipher, size_t length, uint8_t const *tag, size_t tagLength, uint8_t *plain) {
+	if (!detail::validParameters(nonceLength, aadLength, tagLength)) {
+		return false;
+	}
+	detail::ctr(aes, nonce, nonceLength, cipher, length, plain);
+	auto x = detail::mac(aes, nonce, nonceLength, aad, aadLength, plain, length, tagLength);
+	auto s0 = detail::counterBlock(nonce, nonceLength, 0);
+	aes.encrypt(s0);
+
+	uint8_t difference = 0; // constant time compare
+	for (size_t i = 0; i < tagLength; ++i) {
+		difference |= x[i] ^ s0[i] ^ tag[i];
+	}
+	if (difference) {
+		for (size_t i = 0; i < length; ++i) {
+			plain[i] = 0;
+		}
+		return false;
+	}
+	return true;
+}
+} // namespace ccm
+
+} // namespace heating::crypto
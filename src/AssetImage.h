@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace heating {
+
+// FNV-1a 64 of asset content, fed while the file is read
+class AssetHash {
+public:
+	void update(uint8_t const *data, size_t length) {
+		for (size_t i = 0; i < length; ++i) {
+			hash_ = (hash_ ^ data[i]) * 0x100000001b3ull;
+		}
+	}
+
+	uint64_t get() const { return hash_; }
+
+private:
+	uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+// Read-only web asset image packed at build time by scripts/pack_assets.py and linked into the firmware, so assets are
+// served straight from memory mapped flash: no filesystem, no open/read copies, hashes computed once on the build host.
+//
+// Little endian layout:
+//   header   magic "HAI1", u32 entry count, u32 image length, u32 reserved
+//   entries  u64 hash, u32 path offset, u16 path length, u16 flags, u32 data offset, u32 data length - sorted by path
+//   paths and data, offsets from the image start
+class AssetImage {
+public:
+	static constexpr uint32_t magic = 0x31494148; // "HAI1"
+	static constexpr uint16_t flagGzip = 0x1;
+	static constexpr size_t headerSize = 16;
+	static constexpr size_t entrySize = 24;
+
+	struct Entry {
+		std::string_view path;
+		uint8_t const *data = nullptr;
+		uint32_t size = 0;
+		uint64_t hash = 0;
+		bool gzip = false;
+	};
+
+	AssetImage() = default;
+
+	// checks the whole image once, an image failing any bound check is treated as empty
+	AssetImage(uint8_t const *image, size_t length) : image_(image) {
+		if (!image || length < headerSize || read32(0) != magic || read32(8) > length) {
+			return;
+		}
+		auto count = read32(4);
+		length = read32(8);
+		if (count > (length - headerSize) / entrySize) {
+			return;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			auto at = headerSize + i * entrySize;
+			uint64_t pathEnd = uint64_t(read32(at + 8)) + read16(at + 12);
+			uint64_t dataEnd = uint64_t(read32(at + 16)) + read32(at + 20);
+			if (pathEnd > length || dataEnd > length) {
+				return;
+			}
+			if (i > 0 && !(pathAt(i - 1) < pathAt(i))) {
+				return;
+			}
+		}
+		count_ = count;
+	}
+
+	bool isValid() const { return count_ > 0; }
+	size_t size() const { return count_; }
+
+	Entry at(size_t index) const {
+		auto at = headerSize + index * entrySize;
+		Entry entry;
+		entry.hash = uint64_t(read32(at + 4)) << 32 | read32(at);
+		entry.path = pathAt(index);
+		entry.gzip = read16(at + 14) & flagGzip;
+		entry.data = image_ + read32(at + 16);
+		entry.size = read32(at + 20);
+		return entry;
+	}
+
+	std::optional<Entry> find(std::string_view path) const {
+		size_t low = 0;
+		size_t high = count_;
+		while (low < high) {
+			auto middle = (low + high) / 2;
+			auto candidate = pathAt(middle);
+			if (candidate == path) {
+				return at(middle);
+			} else if (candidate < path) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		return std::nullopt;
+	}
+
+private:
+	uint32_t read32(size_t at) const {
+		uint32_t value;
+		std::memcpy(&value, image_ + at, sizeof(value)); // entries aren't guaranteed aligned in the linked blob
+		return value;
+	}
+
+	uint16_t read16(size_t at) const {
+		uint16_t value;
+		std::memcpy(&value, image_ + at, sizeof(value));
+		return value;
+	}
+
+	std::string_view pathAt(size_t index) const {
+		auto at = headerSize + index * entrySize;
+		return std::string_view(reinterpret_cast<char const *>(image_ + read32(at + 8)), read16(at + 12));
+	}
+
+	uint8_t const *image_ = nullptr;
+	uint32_t count_ = 0;
+};
+
+// same layout as scripts/pack_assets.py writes, for native tests and benchmarks
+class AssetImageWriter {
+public:
+	void add(std::string path, std::string content, bool gzip = false) {
+		files_.push_back({std::move(path), std::move(content), gzip});
+	}
+
+	std::vector<uint8_t> build() {
+		std::sort(files_.begin(), files_.end(), [](File const &a, File const &b) { return a.path < b.path; });
+		std::vector<uint8_t> image(AssetImage::headerSize + files_.size() * AssetImage::entrySize);
+		std::vector<std::pair<uint32_t, uint32_t>> offsets; // path, data
+		for (auto const &file : files_) {
+			auto pathOffset = append(image, file.path);
+			align(image);
+			offsets.emplace_back(pathOffset, append(image, file.content));
+		}
+
+		write32(image, 0, AssetImage::magic);
+		write32(image, 4, files_.size());
+		write32(image, 8, image.size());
+		for (size_t i = 0; i < files_.size(); ++i) {
+			auto at = AssetImage::headerSize + i * AssetImage::entrySize;
+			AssetHash hash;
+			hash.update(reinterpret_cast<uint8_t const *>(files_[i].content.data()), files_[i].content.size());
+			write32(image, at, static_cast<uint32_t>(hash.get()));
+			write32(image, at + 4, static_cast<uint32_t>(hash.get() >> 32));
+			write32(image, at + 8, offsets[i].first);
+			write16(image, at + 12, files_[i].path.size());
+			write16(image, at + 14, files_[i].gzip ? AssetImage::flagGzip : 0);
+			write32(image, at + 16, offsets[i].second);
+			write32(image, at + 20, files_[i].content.size());
+		}
+		return image;
+	}
+
+private:
+	struct File {
+		std::string path;
+		std::string content;
+		bool gzip;
+	};
+
+	static uint32_t append(std::vector<uint8_t> &image, std::string const &bytes) {
+		auto offset = image.size();
+		image.insert(image.end(), bytes.begin(), bytes.end());
+		return offset;
+	}
+
+	static void align(std::vector<uint8_t> &image) { image.resize((image.size() + 3) & ~size_t(3)); }
+
+	static void write32(std::vector<uint8_t> &image, size_t at, uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			image[at + i] = value >> (8 * i);
+		}
+	}
+
+	static void write16(std::vector<uint8_t> &image, size_t at, uint16_t value) {
+		image[at] = value;
+		image[at + 1] = value >> 8;
+	}
+
+	std::vector<File> files_;
+};
+
+} // namespace heating
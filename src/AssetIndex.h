@@ -0,0 +1,166 @@
+#pragma once
+
+#include "AssetImage.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace heating {
+
+// Web assets indexed once at boot: request path -> content, length, content type, encoding and strong ETag, so a
+// request is answered without looking anything up in flash. HTML revalidates with If-None-Match every load; other assets referenced with
+// ?v=<first 8 ETag digits> are cached as immutable - the reference changes with the content, a stale one revalidates.
+class AssetIndex {
+public:
+	struct Asset {
+		std::string path; // request path, "/deps/chart.umd.js.gz"
+		uint8_t const *data = nullptr;
+		uint32_t size = 0;
+		char const *contentType = "text/plain";
+		bool gzip = false;
+		char etag[19] = {}; // "<16 hex digits>" with quotes
+		mutable uint32_t served = 0;
+		mutable uint32_t notModified = 0;
+
+		std::string_view version() const { return std::string_view(etag + 1, 8); }
+	};
+
+	enum class result_t : uint8_t { notFound, notModified, ok };
+
+	struct Response {
+		result_t result = result_t::notFound;
+		Asset const *asset = nullptr;
+		char const *cacheControl = nullptr;
+	};
+
+	static constexpr char const *cacheImmutable = "public, max-age=31536000, immutable";
+	static constexpr char const *cacheRevalidate = "no-cache";
+	static constexpr char const *cacheShort = "max-age=3600";
+
+	// @param path  request path the asset is served at
+	// @param gzip  content is compressed - either the path ends with .gz or the packer compressed it
+	void add(std::string path, uint8_t const *data, uint32_t size, uint64_t hash, bool gzip) {
+		Asset asset;
+		asset.contentType = getContentType(path);
+		asset.gzip = gzip || endsWith(path, ".gz");
+		asset.path = std::move(path);
+		asset.data = data;
+		asset.size = size;
+		std::snprintf(asset.etag, sizeof(asset.etag), "\"%08x%08x\"", static_cast<unsigned>(hash >> 32), static_cast<unsigned>(hash));
+		auto at = std::lower_bound(assets_.begin(), assets_.end(), asset.path, [](Asset const &a, std::string const &p) { return a.path < p; });
+		assets_.insert(at, std::move(asset));
+	}
+
+	// exact path, or its compressed variant
+	Asset const *find(std::string_view path) const {
+		if (auto asset = lookup(path)) {
+			return asset;
+		}
+		std::string gz(path);
+		gz += ".gz";
+		return lookup(gz);
+	}
+
+	// @param version       value of the "v" query argument, empty when none
+	// @param ifNoneMatch   If-None-Match request header, empty when none
+	Response resolve(std::string_view path, std::string_view version, std::string_view ifNoneMatch) const {
+		Response response;
+		auto asset = find(path);
+		if (!asset) {
+			return response;
+		}
+		response.asset = asset;
+		if (!version.empty() && version == asset->version()) {
+			response.cacheControl = cacheImmutable;
+		} else if (std::string_view(asset->contentType) == "text/html") {
+			response.cacheControl = cacheRevalidate;
+		} else {
+			response.cacheControl = cacheShort;
+		}
+
+		if (matches(ifNoneMatch, asset->etag)) {
+			asset->notModified++;
+			response.result = result_t::notModified;
+		} else {
+			asset->served++;
+			response.result = result_t::ok;
+		}
+		return response;
+	}
+
+	void add(AssetImage const &image) {
+		assets_.reserve(assets_.size() + image.size());
+		for (size_t i = 0; i < image.size(); ++i) {
+			auto entry = image.at(i);
+			add(std::string(entry.path), entry.data, entry.size, entry.hash, entry.gzip);
+		}
+	}
+
+	size_t size() const { return assets_.size(); }
+
+	void getStatus(std::ostream &ss) const {
+		ss << "[";
+		for (size_t i = 0; i < assets_.size(); ++i) {
+			auto const &asset = assets_[i];
+			ss << (i ? ", " : "") << "{\"path\": \"" << asset.path << "\", \"size\": " << asset.size << ", \"etag\": \"" << std::string_view(asset.etag + 1, 16) << "\", \"served\": " << asset.served << ", \"notModified\": " << asset.notModified << "}";
+		}
+		ss << "]";
+	}
+
+	static char const *getContentType(std::string_view path) {
+		if (endsWith(path, ".gz")) {
+			path.remove_suffix(3);
+		}
+		if (endsWith(path, ".css")) {
+			return "text/css";
+		} else if (endsWith(path, ".js")) {
+			return "text/javascript";
+		} else if (endsWith(path, ".html")) {
+			return "text/html";
+		} else if (endsWith(path, ".png")) {
+			return "image/png";
+		} else if (endsWith(path, ".jpg")) {
+			return "image/jpeg";
+		} else if (endsWith(path, ".svg")) {
+			return "image/svg+xml";
+		} else if (endsWith(path, ".json")) {
+			return "application/json";
+		}
+		return "text/plain";
+	}
+
+private:
+	static bool endsWith(std::string_view text, std::string_view suffix) { return text.size() >= suffix.size() && text.substr(text.size() - suffix.size()) == suffix; }
+
+	// list of entity tags or "*", weak comparison as RFC 9110 requires for If-None-Match
+	static bool matches(std::string_view ifNoneMatch, std::string_view etag) {
+		while (!ifNoneMatch.empty()) {
+			auto comma = ifNoneMatch.find(',');
+			auto tag = ifNoneMatch.substr(0, comma);
+			ifNoneMatch = comma == std::string_view::npos ? std::string_view() : ifNoneMatch.substr(comma + 1);
+			auto first = tag.find_first_not_of(' ');
+			if (first == std::string_view::npos) {
+				continue;
+			}
+			tag = tag.substr(first, tag.find_last_not_of(' ') - first + 1);
+			if (tag == "*" || tag == etag || (tag.substr(0, 2) == "W/" && tag.substr(2) == etag)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Asset const *lookup(std::string_view path) const {
+		auto at = std::lower_bound(assets_.begin(), assets_.end(), path, [](Asset const &a, std::string_view p) { return a.path < p; });
+		return at != assets_.end() && at->path == path ? &*at : nullptr;
+	}
+
+	std::vector<Asset> assets_; // sorted by path
+};
+
+} // namespace heating
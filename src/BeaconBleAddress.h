@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <esp_bt_defs.h>
@@ -12,6 +13,16 @@ using BleAddress_t = std::array<uint8_t, ESP_BD_ADDR_LEN>;
 #define PRiBleAddress "%02x:%02x:%02x:%02x:%02x:%02x"
 #define PRaBleAddress(_addr) _addr[0], _addr[1], _addr[2], _addr[3], _addr[4], _addr[5]
 
+struct BleAddressHash {
+	size_t operator()(BleAddress_t const &address) const { // FNV-1a
+		uint32_t hash = 2166136261u;
+		for (auto byte : address) {
+			hash = (hash ^ byte) * 16777619u;
+		}
+		return hash;
+	}
+};
+
 std::string BLEAddressToString(BleAddress_t const &bda);
 BleAddress_t BLEAddresFromString(std::string_view address);
 
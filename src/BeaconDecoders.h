@@ -0,0 +1,355 @@
+#pragma once
+
+#include "AesCcm.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace heating::beacon {
+
+// values in repo units: temperature and humidity in 1/100 (2150 = 21.50 °C, 6005 = 60.05 %)
+struct Reading {
+	std::optional<int16_t> temperature;
+	std::optional<int16_t> humidity;
+	std::optional<int8_t> battery;
+	std::optional<uint8_t> counter; // frame / packet counter if format has one
+	std::optional<uint32_t> replayCounter; // counter authenticated with encrypted frame - caller rejects replayed ones
+
+	bool empty() const { return !temperature && !humidity && !battery; }
+};
+
+namespace adtype {
+static constexpr uint8_t nameShort = 0x08;
+static constexpr uint8_t nameComplete = 0x09;
+static constexpr uint8_t serviceData16 = 0x16;
+static constexpr uint8_t manufacturerData = 0xFF;
+} // namespace adtype
+
+struct AdStructure {
+	uint8_t type;
+	uint8_t const *data; // points into advertisement payload, valid as long as the payload
+	uint8_t length;      // without type byte
+};
+
+// Iterates over AD structures (length, type, data) of an advertisement payload in place, without copying.
+// Stops at first zero length or malformed structure crossing the payload end.
+class AdStructures {
+public:
+	AdStructures(uint8_t const *payload, size_t size) : payload_(payload), size_(size) {}
+
+	class iterator {
+	public:
+		iterator(uint8_t const *pos, uint8_t const *end) : pos_(pos), end_(end) { validate(); }
+
+		AdStructure operator*() const { return AdStructure{pos_[1], pos_ + 2, static_cast<uint8_t>(pos_[0] - 1)}; }
+
+		iterator &operator++() {
+			pos_ += pos_[0] + 1;
+			validate();
+			return *this;
+		}
+
+		bool operator!=(iterator const &other) const { return pos_ != other.pos_; }
+		bool operator==(iterator const &other) const { return pos_ == other.pos_; }
+
+	private:
+		void validate() {
+			if (pos_ >= end_ || end_ - pos_ < 2 || pos_[0] == 0 || pos_[0] + 1 > end_ - pos_) {
+				pos_ = end_;
+			}
+		}
+
+		uint8_t const *pos_;
+		uint8_t const *end_;
+	};
+
+	iterator begin() const { return iterator(payload_, payload_ + size_); }
+	iterator end() const { return iterator(payload_ + size_, payload_ + size_); }
+
+private:
+	uint8_t const *payload_;
+	size_t size_;
+};
+
+// what encrypted formats need to decrypt a frame - sensor address and its bind key, empty for sensors without key
+struct DecryptionContext {
+	uint8_t const *address = nullptr; // 6 bytes in display order (a4:c1:38:...)
+	crypto::Aes128 const *key = nullptr;
+};
+
+namespace detail {
+static constexpr size_t maxPlainSize = 31; // legacy advertisement payload limit, encrypted frames are never longer
+
+inline uint16_t le16(uint8_t const *data) { return static_cast<uint16_t>(data[0] | (data[1] << 8)); }
+inline uint16_t be16(uint8_t const *data) { return static_cast<uint16_t>((data[0] << 8) | data[1]); }
+inline uint32_t le24(uint8_t const *data) { return static_cast<uint32_t>(data[0] | (data[1] << 8) | (data[2] << 16)); }
+inline uint32_t le32(uint8_t const *data) { return le24(data) | (static_cast<uint32_t>(data[3]) << 24); }
+inline int16_t clampTemperature(int32_t value) { return static_cast<int16_t>(value < -32768 ? -32768 : (value > 32767 ? 32767 : value)); }
+} // namespace detail
+
+// --- decoders, data points behind the 16 bit UUID / company id -------------------------------------------------------
+
+// ATC1441 (13 bytes, big endian) and pvvx custom (15 bytes, little endian) formats, UUID 0x181A
+inline bool decodeAtc(uint8_t const *data, size_t length, Reading &reading, DecryptionContext const &) {
+	if (length == 13) {
+		reading.temperature = static_cast<int16_t>(static_cast<int16_t>(detail::be16(data + 6)) * 10);
+		reading.humidity = static_cast<int16_t>(data[8] * 100);
+		reading.battery = static_cast<int8_t>(data[9]);
+		reading.counter = data[12];
+		return true;
+	}
+	if (length == 15) {
+		reading.temperature = static_cast<int16_t>(detail::le16(data + 6));
+		reading.humidity = static_cast<int16_t>(detail::le16(data + 8));
+		reading.battery = static_cast<int8_t>(data[12]);
+		reading.counter = data[13];
+		return true;
+	}
+	return false;
+}
+
+namespace detail {
+// BTHome v2 objects following the device info byte
+inline bool parseBtHomeObjects(uint8_t const *data, size_t length, Reading &reading) {
+	// object id -> data size, 0 - unknown (parsing cannot continue)
+	static constexpr auto objectSizes = [] {
+		std::array<uint8_t, 0x54> sizes{};
+		uint8_t const known[][2] = {{0x00, 1}, {0x01, 1}, {0x02, 2}, {0x03, 2}, {0x04, 3}, {0x05, 3}, {0x06, 2}, {0x07, 2}, {0x08, 2}, {0x09, 1}, {0x0A, 3}, {0x0B, 3}, {0x0C, 2}, {0x0D, 2}, {0x0E, 2}, {0x12, 2}, {0x13, 2}, {0x14, 2}, {0x2E, 1}, {0x2F, 1}, {0x3A, 1}, {0x3C, 2}, {0x3D, 2}, {0x3E, 4}, {0x3F, 2}, {0x40, 2}, {0x41, 2}, {0x42, 3}, {0x43, 2}, {0x44, 2}, {0x45, 2}, {0x46, 1}, {0x47, 2}, {0x48, 2}, {0x49, 2}, {0x4A, 2}, {0x4B, 3}, {0x4C, 4}, {0x4D, 4}, {0x4E, 4}, {0x4F, 4}, {0x50, 4}, {0x51, 2}, {0x52, 2}};
+		for (auto const &entry : known) {
+			sizes[entry[0]] = entry[1];
+		}
+		for (uint8_t id = 0x0F; id <= 0x11; ++id) {
+			sizes[id] = 1; // binary sensors
+		}
+		for (uint8_t id = 0x15; id <= 0x2D; ++id) {
+			sizes[id] = 1;
+		}
+		return sizes;
+	}();
+
+	bool decoded = false;
+	size_t pos = 0;
+	while (pos < length) {
+		uint8_t id = data[pos++];
+		uint8_t size = id < objectSizes.size() ? objectSizes[id] : 0;
+		if (size == 0 || pos + size > length) {
+			break;
+		}
+		auto const *value = data + pos;
+		switch (id) {
+			case 0x00: reading.counter = value[0]; break;
+			case 0x01: reading.battery = static_cast<int8_t>(value[0]); decoded = true; break;
+			case 0x02: reading.temperature = static_cast<int16_t>(detail::le16(value)); decoded = true; break;
+			case 0x03: reading.humidity = static_cast<int16_t>(detail::le16(value)); decoded = true; break;
+			case 0x2E: reading.humidity = static_cast<int16_t>(value[0] * 100); decoded = true; break;
+			case 0x45: reading.temperature = detail::clampTemperature(static_cast<int16_t>(detail::le16(value)) * 10); decoded = true; break;
+		}
+		pos += size;
+	}
+	return decoded;
+}
+} // namespace detail
+
+// BTHome v2, UUID 0xFCD2. Encrypted frames: objects, counter (4), MIC (4) - nonce is address, UUID, device info and counter.
+inline bool decodeBtHome(uint8_t const *data, size_t length, Reading &reading, DecryptionContext const &context) {
+	if (length < 1) {
+		return false;
+	}
+	uint8_t deviceInfo = data[0];
+	if ((deviceInfo >> 5) != 2) {
+		return false;
+	}
+	if (!(deviceInfo & 0x01)) {
+		return detail::parseBtHomeObjects(data + 1, length - 1, reading);
+	}
+
+	static constexpr size_t trailer = 8;
+	if (!context.key || !context.address || length < 1 + trailer + 1 || length - 1 - trailer > detail::maxPlainSize) {
+		return false;
+	}
+	size_t cipherLength = length - 1 - trailer;
+	auto const *counter = data + 1 + cipherLength;
+
+	uint8_t nonce[13];
+	for (size_t i = 0; i < 6; ++i) {
+		nonce[i] = context.address[i];
+	}
+	nonce[6] = 0xD2;
+	nonce[7] = 0xFC;
+	nonce[8] = deviceInfo;
+	for (size_t i = 0; i < 4; ++i) {
+		nonce[9 + i] = counter[i];
+	}
+
+	uint8_t plain[detail::maxPlainSize];
+	if (!crypto::ccm::decrypt(*context.key, nonce, sizeof(nonce), nullptr, 0, data + 1, cipherLength, counter + 4, 4, plain)) {
+		return false;
+	}
+	reading.replayCounter = detail::le32(counter);
+	return detail::parseBtHomeObjects(plain, cipherLength, reading);
+}
+
+namespace detail {
+// MiBeacon object: type (2), length (1), value
+inline bool parseMiBeaconObject(uint8_t const *data, size_t length, Reading &reading) {
+	if (length < 3) {
+		return false;
+	}
+	uint16_t objectType = le16(data);
+	uint8_t objectLength = data[2];
+	auto const *value = data + 3;
+	if (3u + objectLength > length) {
+		return false;
+	}
+
+	switch (objectType) {
+		case 0x1004:
+			if (objectLength < 2) return false;
+			reading.temperature = clampTemperature(static_cast<int16_t>(le16(value)) * 10);
+			return true;
+		case 0x1006:
+			if (objectLength < 2) return false;
+			reading.humidity = static_cast<int16_t>(le16(value) * 10);
+			return true;
+		case 0x100A:
+			if (objectLength < 1) return false;
+			reading.battery = static_cast<int8_t>(value[0]);
+			return true;
+		case 0x100D:
+			if (objectLength < 4) return false;
+			reading.temperature = clampTemperature(static_cast<int16_t>(le16(value)) * 10);
+			reading.humidity = static_cast<int16_t>(le16(value + 2) * 10);
+			return true;
+	}
+	return false;
+}
+} // namespace detail
+
+// Xiaomi MiBeacon (MJ_HT_V1, LYWSDCGQ, LYWSD03MMC and similar), UUID 0xFE95. Encrypted frames of version 4 and 5:
+// object, extended counter (3), MIC (4) - nonce is address, product id, frame counter and extended counter.
+inline bool decodeMiBeacon(uint8_t const *data, size_t length, Reading &reading, DecryptionContext const &context) {
+	if (length < 5) {
+		return false;
+	}
+	uint16_t frameControl = detail::le16(data);
+
+	size_t pos = 5; // frame control, product id, frame counter
+	reading.counter = data[4];
+	if (frameControl & 0x0010) { // MAC included
+		pos += 6;
+	}
+	if (frameControl & 0x0020) { // capability included
+		if (pos >= length) {
+			return false;
+		}
+		bool ioCapability = data[pos] & 0x20;
+		pos += ioCapability ? 3 : 1;
+	}
+	if (!(frameControl & 0x0040) || pos >= length) { // no object
+		return false;
+	}
+
+	if (!(frameControl & 0x0008)) {
+		return detail::parseMiBeaconObject(data + pos, length - pos, reading);
+	}
+
+	static constexpr size_t trailer = 7;
+	if ((frameControl >> 12) < 4 || !context.key || !context.address || length < pos + trailer + 1 || length - pos - trailer > detail::maxPlainSize) { // legacy encryption not supported
+		return false;
+	}
+	size_t cipherLength = length - pos - trailer;
+	auto const *extendedCounter = data + pos + cipherLength;
+
+	uint8_t nonce[12];
+	for (size_t i = 0; i < 6; ++i) {
+		nonce[i] = context.address[5 - i]; // MAC as in frame - reversed
+	}
+	nonce[6] = data[2]; // product id
+	nonce[7] = data[3];
+	nonce[8] = data[4]; // frame counter
+	for (size_t i = 0; i < 3; ++i) {
+		nonce[9 + i] = extendedCounter[i];
+	}
+	static constexpr uint8_t aad[] = {0x11};
+
+	uint8_t plain[detail::maxPlainSize];
+	if (!crypto::ccm::decrypt(*context.key, nonce, sizeof(nonce), aad, sizeof(aad), data + pos, cipherLength, extendedCounter + 3, 4, plain)) {
+		return false;
+	}
+	reading.replayCounter = (detail::le24(extendedCounter) << 8) | data[4];
+	return detail::parseMiBeaconObject(plain, cipherLength, reading);
+}
+
+// Govee H5072/H5075 (6 bytes, packed temperature and humidity) and H5074 (7 bytes, little endian), company id 0xEC88
+inline bool decodeGovee(uint8_t const *data, size_t length, Reading &reading, DecryptionContext const &) {
+	if (length == 6) {
+		uint32_t packed = (data[1] << 16) | (data[2] << 8) | data[3];
+		bool negative = packed & 0x800000;
+		packed &= 0x7FFFFF;
+		int32_t temperature = static_cast<int32_t>(packed / 1000) * 10; // 0.1 -> 0.01 °C
+		reading.temperature = detail::clampTemperature(negative ? -temperature : temperature);
+		reading.humidity = static_cast<int16_t>((packed % 1000) * 10);
+		reading.battery = static_cast<int8_t>(data[4] & 0x7F);
+		return true;
+	}
+	if (length == 7) {
+		reading.temperature = static_cast<int16_t>(detail::le16(data + 1));
+		reading.humidity = static_cast<int16_t>(detail::le16(data + 3));
+		reading.battery = static_cast<int8_t>(data[5]);
+		return true;
+	}
+	return false;
+}
+
+// --- registry --------------------------------------------------------------------------------------------------------
+
+using decoder_t = bool (*)(uint8_t const *data, size_t length, Reading &reading, DecryptionContext const &context);
+
+struct DecoderEntry {
+	uint8_t adType;   // service data or manufacturer data
+	uint16_t id;      // 16 bit service UUID or company id
+	decoder_t decode;
+	char const *name;
+};
+
+inline constexpr std::array<DecoderEntry, 4> decoders{{
+	{adtype::serviceData16, 0x181A, decodeAtc, "ATC"},
+	{adtype::serviceData16, 0xFCD2, decodeBtHome, "BTHome"},
+	{adtype::serviceData16, 0xFE95, decodeMiBeacon, "MiBeacon"},
+	{adtype::manufacturerData, 0xEC88, decodeGovee, "Govee"},
+}};
+
+inline DecoderEntry const *findDecoder(uint8_t adType, uint16_t id) {
+	for (auto const &entry : decoders) {
+		if (entry.id == id && entry.adType == adType) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+// Decodes the first AD structure with a known UUID / company id. Anything else is rejected after reading 3 bytes per structure.
+// Encrypted frames are decoded only with a key in context and only when their MIC verifies.
+inline std::optional<Reading> decode(uint8_t const *payload, size_t size, char const **format = nullptr, DecryptionContext const &context = {}) {
+	for (auto const &ad : AdStructures(payload, size)) {
+		if ((ad.type != adtype::serviceData16 && ad.type != adtype::manufacturerData) || ad.length < 2) {
+			continue;
+		}
+		auto const *entry = findDecoder(ad.type, detail::le16(ad.data));
+		if (!entry) {
+			continue;
+		}
+		Reading reading;
+		if (entry->decode(ad.data + 2, ad.length - 2, reading, context) && !reading.empty()) {
+			if (format) {
+				*format = entry->name;
+			}
+			return reading;
+		}
+	}
+	return std::nullopt;
+}
+
+} // namespace heating::beacon
@@ -3,32 +3,29 @@
 #include "config.h"
 #include "Logger.h"
 #include "BeaconBleAddress.h"
+#include "AdvertisementFilter.h"
+#include "BeaconDecoders.h"
+#include "BindKeys.h"
 
 #include <NimBLEDevice.h>
 #include <NimBLEAdvertisedDevice.h>
 #include <esp_gap_ble_api.h>
 
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <memory>
 #include <optional>
-#include <set>
-#include <string_view>
-#include <vector>
+#include <ostream>
 
 
 namespace heating {
 
 class BeaconTemperatureReader : public NimBLEScanCallbacks {
-private:
-	struct ServiceDataView {
-		uint8_t *data = nullptr;
-		uint8_t length = 0;
-	};
-
 public:
-	using BleDevices_t = std::set<BleAddress_t>;
-
-	using ReportTemperature_t = std::function<void(BleAddress_t, std::optional<int16_t> temperature, std::optional<int16_t> humidity, std::optional<int8_t> battery)>;
+	// counter - sensor frame counter if format has one, used for loss statistics
+	// called on BLE host task for every decoded advertisement - must not block
+	using ReportTemperature_t = std::function<void(BleAddress_t, int8_t rssi, std::optional<uint8_t> counter, std::optional<int16_t> temperature, std::optional<int16_t> humidity, std::optional<int8_t> battery)>;
 
 	BeaconTemperatureReader(ReportTemperature_t pushTemperature) : pushTemperature_(pushTemperature) {
 		stReader_ = this;
@@ -40,19 +37,36 @@ public:
 		}
 		NimBLEScan *pBLEScan = NimBLEDevice::getScan();
 
-		pBLEScan->setScanCallbacks(this, true);
-		pBLEScan->setActiveScan(true);
-		pBLEScan->setInterval(100); // 100ms
-		pBLEScan->setWindow(80);    // 80ms
+		pBLEScan->setScanCallbacks(this, true); // report every advertisement - duplicates are filtered by payload
+		pBLEScan->setActiveScan(config_.active);
+		pBLEScan->setInterval(config_.periodMs);
+		pBLEScan->setWindow(config_.windowMs); // radio duty cycle window/period
+		pBLEScan->setDuplicateFilter(0);       // controller filters by address only which would hide new measurements
+		if (config_.continuous) {
+			pBLEScan->setMaxResults(0); // callbacks only, nothing accumulates during endless scan
+		}
 
-		DBGLOGTR("BLE initialized successfully.\n");
+		DBGLOGTR("BLE initialized successfully. %s %s scan, window %dms / %dms\n", config_.continuous ? "continuous" : "periodic", config_.active ? "active" : "passive", config_.windowMs, config_.periodMs);
 	}
 
+	// swapped when rooms are reloaded, callback keeps using the previous set until it finishes
+	void setBindKeys(std::shared_ptr<BindKeys> bindKeys) { std::atomic_store(&bindKeys_, std::move(bindKeys)); }
+	std::shared_ptr<BindKeys> getBindKeys() const { return std::atomic_load(&bindKeys_); }
+
 	void shutDownBLE() { NimBLEDevice::deinit(true); }
 
 	bool isScanPending() { return bluetoothScanPending_; }
 
 	void triggerScan() {
+		if (config_.continuous) {
+			if (!bluetoothScanPending_) { // not started yet or stopped by the stack - (re)start endless scan
+				bluetoothScanPending_ = true;
+				auto res = NimBLEDevice::getScan()->start(0, false, true);
+				DBGLOGTR("Continuous scan start result: %d\n", res);
+			}
+			return;
+		}
+
 		if (bluetoothScanPending_) {
 			DBGLOGTR("Scan pending\n");
 			return;
@@ -73,6 +87,23 @@ public:
 		DBGLOGTR("Scan start  result: %d\n", res);
 	}
 
+	void stopScan() {
+		if (bluetoothScanPending_) {
+			NimBLEDevice::getScan()->stop();
+			bluetoothScanPending_ = false;
+		}
+	}
+
+	void getStatus(std::ostream &ss) const {
+		ss << "{\"continuous\": " << (config_.continuous ? "true" : "false");
+		ss << ", \"scanning\": " << (bluetoothScanPending_ ? "true" : "false");
+		ss << ", \"received\": " << duplicateFilter_.getReceived();
+		ss << ", \"duplicates\": " << duplicateFilter_.getDuplicates();
+		auto bindKeys = getBindKeys();
+		ss << ", \"bindKeys\": " << (bindKeys ? bindKeys->size() : 0);
+		ss << ", \"replays\": " << (bindKeys ? bindKeys->getReplays() : 0) << "}";
+	}
+
 	void scanFinished() {
 		bluetoothScanPending_ = false;
 		lastScanFinishedMillis_ = millis();
@@ -81,12 +112,17 @@ public:
 	}
 
 	void onResult(NimBLEAdvertisedDevice const *advertisedDevice) final {
-		auto payload = advertisedDevice->getPayload();
+		auto const &payload = advertisedDevice->getPayload();
 		auto addr = advertisedDevice->getAddress();
+		auto const *bda = addr.getBase()->val;
 
 		// DBGLOGTR("ON RESULT SERVICE DATA COUNT %zu / %s, payload size: %zu address: %s\n", advertisedDevice->getServiceDataCount(), advertisedDevice->getName().c_str(), payload.size(), advertisedDevice->getAddress().toString().c_str());
 
-		parseAdvertisment(addr.getBase()->val, advertisedDevice->getRSSI(), payload.data(), payload.size());
+		if (!duplicateFilter_.isNew(BleAddress_t{bda[5], bda[4], bda[3], bda[2], bda[1], bda[0]}, payload.data(), payload.size(), std::chrono::steady_clock::now())) {
+			return;
+		}
+
+		parseAdvertisment(bda, advertisedDevice->getRSSI(), payload.data(), payload.size());
 	}
 
 	void onDiscovered(const NimBLEAdvertisedDevice *advertisedDevice) final {
@@ -97,127 +133,33 @@ public:
 		scanFinished();
 	}
 
-	void parseAdvertisment(uint8_t const *bda, int rssi, uint8_t *payload, size_t payloadSize) {
-		if (payloadSize < 2) {
-			return;
-		}
-
-		std::string_view deviceName;
-		std::vector<ServiceDataView> serviceData;
-		uint8_t *frame = payload;
+	void parseAdvertisment(uint8_t const *bda, int rssi, uint8_t const *payload, size_t payloadSize) {
+		BleAddress_t address{bda[5], bda[4], bda[3], bda[2], bda[1], bda[0]};
 
-		while (frame < payload + payloadSize) {
-			uint8_t frameLen = frame[0];
-			if (frameLen == 0) {
-				break;
-			}
-			uint8_t frameType = frame[1];
-			frameLen--; // remove type byte from length
-			frame += 2; // skip type and length bytes
-			// DBGLOGTR("Frame type: %d 0x%02X %d\n", frameType, frameType, frameLen);
-			switch (frameType) {
-				case ESP_BLE_AD_TYPE_NAME_SHORT:
-				case ESP_BLE_AD_TYPE_NAME_CMPL:
-					// DBGLOGTR("Device name: %s\n", std::string((char*)frame, frameLen).c_str());
-					deviceName = {reinterpret_cast<char *>(frame), frameLen};
-					if (deviceName != "MJ_HT_V1" && deviceName.substr(0, 4) != "ATC_") {
-						return; // don't parse service data
-					}
-					break;
-				case ESP_BLE_AD_TYPE_SERVICE_DATA:
-					if (frameLen < 2) {
-						return;
-					}
-					// uint16_t uuid = *(uint16_t*)frame;
-					serviceData.emplace_back(ServiceDataView{frame + 2, static_cast<uint8_t>(frameLen - 2)});
-				break;
-			}
-			frame += frameLen;
-		}
-
-		if (deviceName == "MJ_HT_V1") {
-			parseMJ_HT_V1(BleAddress_t{bda[5], bda[4], bda[3], bda[2], bda[1], bda[0]}, rssi, serviceData);
-		} else if (deviceName.substr(0, 4) == "ATC_") {
-			parseATC(BleAddress_t{bda[5], bda[4], bda[3], bda[2], bda[1], bda[0]}, rssi, serviceData);
-		}
-	}
+		auto bindKeys = getBindKeys();
+		beacon::DecryptionContext context{address.data(), bindKeys ? bindKeys->find(address) : nullptr};
 
-	void parseMJ_HT_V1(BleAddress_t bda, int rssi, std::vector<ServiceDataView> const &serviceData) {
-		if (serviceData.size() == 0) {
-			DBGLOGTR("No service data for " PRiBleAddress "\n", PRaBleAddress(bda));
+		char const *format = nullptr;
+		auto reading = beacon::decode(payload, payloadSize, &format, context);
+		if (!reading) {
 			return;
 		}
 
-		DBGLOGTR("%s: " PRiBleAddress ", serviceDataCount: %d RSSI: %d\n", "MJ_HT_V1", PRaBleAddress(bda), serviceData.size(),  rssi);
-
-		for (int service = 0; service < 1; ++service) { // first is always valid
-			if (serviceData[service].length < 15) {
-				// DBGLOGTR("Service data[%d] too short\n", service);
-				// for (int i = 0; i < serviceData[service].length; ++i) {
-				// 	logger.printf("%02X ", serviceData[service].data[i]);
-				// }
-				// logger.printf("\n");
-				continue;
-			}
-			switch (serviceData[service].data[11]) {
-				case 0x04: {
-					int16_t temperature = (serviceData[service].data[15] * 256 + serviceData[service].data[14]) * 10;
-					pushTemperature_(bda, temperature, {}, {});
-					DBGLOGTR("TEMPERATURE_EVENT ONLY: %d\n", temperature);
-					break;
-				}
-				case 0x06: {
-					int16_t humidity = (serviceData[service].data[15] * 256 + serviceData[service].data[14]) * 10;
-					DBGLOGTR("HUMIDITY_EVENT: %d \n", humidity);
-					pushTemperature_(bda, {}, humidity, {});
-					break;
-				}
-				case 0x0A: {
-					DBGLOGTR("BATTERY_EVENT: %d%%\n", serviceData[service].data[14]);
-					pushTemperature_(bda, {}, {}, serviceData[service].data[14]);
-					break;
-				}
-				case 0x0D: {
-					int16_t temperature = (serviceData[service].data[15] * 256 + serviceData[service].data[14]) * 10;
-					int16_t humidity = (serviceData[service].data[17] * 256 + serviceData[service].data[16]) * 10;
-					DBGLOGTR("TEMPERATURE_HUMIDITY EVENT: %d %d\n", temperature, humidity);
-					pushTemperature_(bda, temperature, humidity, {});
-				}
-				break;
-			}
-		}
-	}
-
-	void parseATC(BleAddress_t bda, int rssi, std::vector<ServiceDataView> const &serviceData) {
-		if (serviceData.size() == 0) {
-			DBGLOGTR("No service data for " PRiBleAddress "\n", PRaBleAddress(bda));
+		if (reading->replayCounter && bindKeys->accept(address, *reading->replayCounter, duplicateFilter_.payloadHash(payload, payloadSize), std::chrono::steady_clock::now()) == BindKeys::verdict_t::rejected) {
+			DBGLOGTR("%s: " PRiBleAddress " replayed frame, counter %u\n", format, PRaBleAddress(address), static_cast<unsigned>(*reading->replayCounter));
 			return;
 		}
 
-		DBGLOGTR("%s: " PRiBleAddress ", serviceDataCount: %d RSSI: %d\n", "ATC", PRaBleAddress(bda), serviceData.size(),  rssi);
-		for (int service = 0; service < 1 /*serviceDataCount*/; ++service) {
-			if (serviceData[service].length < 12) {
-				// DBGLOGTR("Service data[%d] too short\n", service);
-				// for (int i = 0; i < serviceData[service].length; ++i) {
-				// 	logger.printf("%02X ", serviceData[service].data[i]);
-				// }
-				// logger.printf("\n");
-				continue;
-			}
-			int16_t temperature = (serviceData[service].data[6] * 256 + serviceData[service].data[7]) * 10;
-			int16_t humidity = serviceData[service].data[8] * 100;
-			int8_t battery = serviceData[service].data[9];
-			DBGLOGTR("TEMPERATURE_HUMIDITY_BATTERY EVENT: %d %d %d\n", temperature, humidity, battery);
-			pushTemperature_(bda, temperature, humidity, battery);
-		}
+		pushTemperature_(address, rssi, reading->counter, reading->temperature, reading->humidity, reading->battery);
 	}
 
-
 private:
 	static BeaconTemperatureReader *stReader_;
 	ReportTemperature_t pushTemperature_;
 	std::atomic_bool bluetoothScanPending_ = false;
 	config::BluetoothConfig config_ = config::getBluetoothConfig();
+	AdvertisementFilter<64> duplicateFilter_{std::chrono::seconds(config_.duplicateRefresh)};
+	std::shared_ptr<BindKeys> bindKeys_; // swapped atomically
 	unsigned long lastScanFinishedMillis_ = 0;
 };
 }
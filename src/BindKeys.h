@@ -0,0 +1,104 @@
+#pragma once
+
+#include "AesCcm.h"
+#include "BeaconBleAddress.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace heating {
+
+// Bind keys of sensors sending encrypted advertisements. The AES key schedule is expanded when the set is built (room
+// configuration load), the BLE callback only looks it up. Keeps the last authenticated counter of every sensor and
+// rejects replayed frames. The last accepted frame itself is let through again - sensors keep advertising it until the
+// next measurement and the advertisement filter forwards it every refresh to keep the sensor alive in its room.
+// Counters live in RAM only - after restart the first frame of every sensor is accepted.
+class BindKeys {
+public:
+	using clock_t = std::chrono::steady_clock;
+	using Key_t = crypto::Aes128::Key_t;
+
+	// sensor which didn't send authenticated frame for this long probably restarted with counter from zero
+	static constexpr std::chrono::hours resyncAfter{1};
+
+	// previous - set being replaced, its replay counters are carried over
+	explicit BindKeys(std::vector<std::pair<BleAddress_t, Key_t>> const &keys, BindKeys const *previous = nullptr) : count_(keys.size()), entries_(std::make_unique<Entry[]>(keys.size())) {
+		for (size_t i = 0; i < count_; ++i) {
+			auto &entry = entries_[i];
+			entry.address = keys[i].first;
+			entry.aes.emplace(keys[i].second);
+			if (auto const *old = previous ? previous->findEntry(entry.address) : nullptr) {
+				entry.counter.store(old->counter.load());
+				entry.payloadHash.store(old->payloadHash.load());
+				entry.accepted.store(old->accepted.load());
+			}
+		}
+	}
+
+	crypto::Aes128 const *find(BleAddress_t const &address) const {
+		auto const *entry = findEntry(address);
+		return entry ? &*entry->aes : nullptr;
+	}
+
+	enum class verdict_t : uint8_t {
+		fresh,    // counter newer than the last accepted one
+		repeated, // the last accepted frame again - same counter and payload
+		rejected  // replayed older frame, or sensor without key
+	};
+
+	// payloadHash - of the whole advertisement, tells the repeated last frame from a different one with its counter.
+	// Called from BLE task only.
+	verdict_t accept(BleAddress_t const &address, uint32_t counter, uint32_t payloadHash, clock_t::time_point now) {
+		auto *entry = findEntry(address);
+		if (!entry) {
+			return verdict_t::rejected;
+		}
+
+		auto accepted = entry->accepted.load();
+		bool first = accepted == clock_t::rep{0};
+		if (!first && counter <= entry->counter.load() && now.time_since_epoch().count() - accepted < std::chrono::duration_cast<clock_t::duration>(resyncAfter).count()) {
+			if (counter == entry->counter.load() && payloadHash == entry->payloadHash.load()) {
+				return verdict_t::repeated;
+			}
+			replays_++;
+			return verdict_t::rejected;
+		}
+		entry->counter.store(counter);
+		entry->payloadHash.store(payloadHash);
+		entry->accepted.store(now.time_since_epoch().count());
+		return verdict_t::fresh;
+	}
+
+	size_t size() const { return count_; }
+	uint32_t getReplays() const { return replays_; }
+
+private:
+	struct Entry {
+		BleAddress_t address{};
+		std::optional<crypto::Aes128> aes;
+		std::atomic<uint32_t> counter{0};
+		std::atomic<uint32_t> payloadHash{0}; // of the frame with the counter
+		std::atomic<clock_t::rep> accepted{0}; // time of last accepted frame, 0 - none yet
+	};
+
+	// few encrypted sensors per installation - linear search beats hashing
+	Entry *findEntry(BleAddress_t const &address) const {
+		for (size_t i = 0; i < count_; ++i) {
+			if (entries_[i].address == address) {
+				return &entries_[i];
+			}
+		}
+		return nullptr;
+	}
+
+	size_t count_;
+	std::unique_ptr<Entry[]> entries_; // atomics are not movable - fixed array
+	std::atomic<uint32_t> replays_{0};
+};
+
+} // namespace heating
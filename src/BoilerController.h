@@ -1,9 +1,11 @@
 #pragma once
 
 #include "config.h"
+#include "FlowTemperatureOptimizer.h"
 #include "GpioPort.h"
 #include "HeatingCurve.h"
 #include "Logger.h"
+#include "ValveScheduler.h"
 #include <sstream>
 #include <algorithm>
 #include <set>
@@ -24,15 +26,14 @@ public:
 	using emsSetHeatingTemperature_t = std::function<void(uint8_t)>;
 
 	BoilerController(config::BoilerConfig const &config, getOutdoorTemp_t getOutdoorTemp, emsChangeBoilerState_t emsChangeBoilerState, emsSetHeatingTemperature_t emsSetHeatingTemperature,
-		std::unique_ptr<gpio::GpioPort> boilerPort, std::vector<std::unique_ptr<gpio::GpioPort>> valvePorts, std::vector<std::string> valveLabels)
+		std::unique_ptr<gpio::GpioPort> boilerPort, std::vector<std::unique_ptr<gpio::GpioPort>> valvePorts, std::vector<std::string> valveLabels, std::vector<ThermalActuator::Config> const &valveActuators = {})
 		: config_(config), getOutdoorTemp_(getOutdoorTemp), emsChangeBoilerState_(emsChangeBoilerState), emsSetHeatingTemperature_(emsSetHeatingTemperature)
-		, boilerPort_(std::move(boilerPort)), valvePorts_(std::move(valvePorts))
+		, boilerPort_(std::move(boilerPort))
 		, valveLabels_(std::move(valveLabels))
-		, valvesStates_(valvePorts_.size(), true) {
+		, valves_(std::move(valvePorts), std::chrono::milliseconds(config_.boiler.valveSwitchStepMs), config_.boiler.valveSwitchBatchSize, [this](uint8_t nr, bool closed) {
+			DBGLOGBOILER("Handle valve %d '%s' state: %s coil %s \n", nr, valveLabel(nr), !closed ? "open " : "close", closed ? "on" : "off");
+		}, valveActuators) {
 		boilerPort_->initOutput();
-		for (auto &vp : valvePorts_) {
-			vp->initOutput();
-		}
 	}
 
 	void startBoilerOrContinue(bool shouldStartBoiler, bool shouldBoilerContinue, boilerHeatingTemperatureOverride_t boilerHeatingTemperatureOverride) {
@@ -42,6 +43,9 @@ public:
 		DBGLOGBOILER("Current boiler state: %d, should start: %d, should continue: %d, boiler heating temp override: %d\n", isBoilerStarted(), shouldStartBoiler, shouldBoilerContinue, boilerHeatingTemperatureOverride.value_or(0));
 
 		if (valvePreheating_ && (clock_t::now() - lastPreheatTime_ >= std::chrono::seconds(config_.boiler.valvePreheatingDelay))) {
+			if ((shouldStartBoiler || shouldBoilerContinue) && isWaitingForValves()) {
+				return;
+			}
 			DBGLOGBOILER("Finished valve preheating. Changing boiler state to: %s\n", (shouldStartBoiler || shouldBoilerContinue) ? "enabled" : "disabled");
 			valvePreheating_ = false;
 			changeBoilerState(shouldStartBoiler || shouldBoilerContinue, boilerHeatingTemperatureOverride);
@@ -60,6 +64,9 @@ public:
 				DBGLOGBOILER("Started valve preheating. Boiler start delayed by %ds\n", config_.boiler.valvePreheatingDelay);
 				return;
 			}
+			if (isWaitingForValves()) {
+				return;
+			}
 			changeBoilerState(true, boilerHeatingTemperatureOverride);
 			return;
 		}
@@ -89,18 +96,43 @@ public:
 			return;
 		}
 
-		for (size_t valve = 0; valve < valvePorts_.size(); ++valve) {
-			bool close = valvesToClose.find(valve) != std::end(valvesToClose);
-			handleValve(valve, close);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t valve = 0; valve < valves_.size(); ++valve) {
+				valves_.setClosed(valve, valvesToClose.find(valve) != std::end(valvesToClose));
+			}
 		}
+		applyValves();
+	}
+
+	// applies staggered valve changes which were postponed to limit inrush current, returns how many valves switched
+	size_t loop() {
+		return applyValves();
 	}
 
 	void getStatus(std::ostream &ss) const {
 		std::lock_guard<std::mutex> lock(mutex_);
 		ss << "{\"boiler\": " << (isBoilerStarted() ? "true" : "false") << ", \"valvesOpened\": [";
-		for (size_t valve = 0; valve < valvesStates_.size(); ++valve) {
-			ss << (valvesStates_[valve] ? "true" : "false");
-			if (valve + 1 < valvesStates_.size()) {
+		for (size_t valve = 0; valve < valves_.size(); ++valve) {
+			ss << (valves_.isClosed(valve) ? "false" : "true");
+			if (valve + 1 < valves_.size()) {
+				ss << ", ";
+			}
+		}
+		ss << "]";
+		ss << ", \"valvesPosition\": [";
+		auto now = clock_t::now();
+		for (size_t valve = 0; valve < valves_.size(); ++valve) {
+			ss << valves_.getPosition(valve, now) / 10; // %
+			if (valve + 1 < valves_.size()) {
+				ss << ", ";
+			}
+		}
+		ss << "]";
+		ss << ", \"valveActuations\": [";
+		for (size_t valve = 0; valve < valves_.size(); ++valve) {
+			ss << valves_.getActuations(valve);
+			if (valve + 1 < valves_.size()) {
 				ss << ", ";
 			}
 		}
@@ -119,6 +151,10 @@ public:
 		if (currentHeatingTemperature_) {
 			ss << ", \"heatingTemperature\": " << currentHeatingTemperature_.value();
 		}
+		ss << ", \"outdoorAdjustment\": " << outdoorAdjustment_;
+		ss << ", \"warmWaterCharging\": " << (warmWaterCharging_ ? "true" : "false");
+		ss << ", \"optimizer\": ";
+		optimizer_.getStatus(ss);
 		if (manualTestActive_) {
 			auto remaining = std::chrono::duration_cast<std::chrono::seconds>(manualTestEnd_ - clock_t::now()).count();
 			if (remaining < 0)
@@ -147,10 +183,13 @@ public:
 
 		boilerPort_->write(boilerState);
 
-		for (size_t i = 0; i < valvePorts_.size() && i < valveStates.size(); ++i) {
-			bool opened = valveStates[i];
-			handleValve(i, !opened); // handleValve takes "closed" flag
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t i = 0; i < valves_.size() && i < valveStates.size(); ++i) {
+				valves_.setClosed(i, !valveStates[i]);
+			}
 		}
+		applyValves();
 	}
 
 	void stopManualTest() {
@@ -168,6 +207,89 @@ public:
 		openAllValves();
 	}
 
+	// boiler heating curve at given outdoor temperature, without learnt correction, 1/100 °C
+	int16_t getCurveTemperature(int16_t outdoorTemperature) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return heatingCurve_(outdoorTemperature);
+	}
+
+	// forecast shift of outdoor temperature for the heating curve, 1/100 °C - negative pre-charges, positive coasts
+	void setOutdoorAdjustment(int16_t adjustment) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (adjustment != outdoorAdjustment_) {
+			DBGLOGBOILER("Outdoor adjustment: %d\n", adjustment);
+		}
+		outdoorAdjustment_ = adjustment;
+	}
+
+	// outdoor temperature the heating curves are evaluated at, 1/100 °C
+	int16_t getCurveOutdoorTemperature(int16_t outdoorTemperature) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return adjustOutdoorTemperature(outdoorTemperature);
+	}
+
+	// flow temperature chosen from zone curves replaces boiler heating curve, none - back to the curve
+	void setZoneTemperature(std::optional<int16_t> temperature) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		zoneTemperature_ = temperature;
+	}
+
+	// recompiles the curve after configured points changed
+	void setHeatingCurve(std::array<uint8_t, 9> const &heatingCurve) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		heatingCurve_ = compileHeatingCurve(heatingCurve);
+	}
+
+	void setOptimizerState(FlowOptimizerState const &state) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		optimizer_.setState(state);
+	}
+
+	// boiler heats warm water first - flow temperature and room gains don't follow the heating curve meanwhile
+	void setWarmWaterCharging(bool charging) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (charging != warmWaterCharging_) {
+			DBGLOGBOILER("Warm water charging: %d\n", charging);
+		}
+		warmWaterCharging_ = charging;
+	}
+
+	// feeds room demand and boiler temperatures to the flow temperature optimizer - returns learnt state when it's time to persist it
+	std::optional<FlowOptimizerState> updateOptimizer(FlowTemperatureOptimizer::Feedback const &feedback) {
+		if (!isBoilerStarted() || isManualTestActive() || isWarmWaterCharging()) {
+			return std::nullopt;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto now = clock_t::now();
+		auto curveTemperature = zoneTemperature_.value_or(heatingCurve_(adjustOutdoorTemperature(currentOutdoorTemperature_.value_or(getOutdoorTemp_()))));
+		if (optimizer_.update(feedback, curveTemperature, now)) {
+			DBGLOGBOILER("Optimizer rooms: %d demanding: %d gain: %d flow: %d return: %d -> offset: %d slope: %u\n", feedback.rooms, feedback.demanding, feedback.gainRate.value_or(0), feedback.flowTemperature.value_or(0), feedback.returnTemperature.value_or(0), optimizer_.getState().offset, optimizer_.getState().slope);
+			optimizerDirty_ = true;
+		}
+		if (optimizerDirty_ && (!lastOptimizerPersist_ || now - *lastOptimizerPersist_ >= optimizerPersistInterval)) {
+			optimizerDirty_ = false;
+			lastOptimizerPersist_ = now;
+			return optimizer_.getState();
+		}
+		return std::nullopt;
+	}
+
+	// flow temperature set for heating, none while the boiler is off, heats warm water, under manual test or not controlled by temperature
+	std::optional<int16_t> getCurrentHeatingTemperature() {
+		if (!isBoilerStarted() || isManualTestActive() || isWarmWaterCharging()) {
+			return std::nullopt;
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		return currentHeatingTemperature_;
+	}
+
+	// time needed by valve actuator to open - used to open valves ahead of schedule
+	std::chrono::seconds getValveOpenTime(uint8_t valve) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return valves_.getOpenTime(valve);
+	}
+
 	bool isManualTestActive() {
 		if (!manualTestActive_)
 			return false;
@@ -185,22 +307,32 @@ private:
 	}
 
 	void openAllValves() {
-		for (size_t valve = 0; valve < valvePorts_.size(); ++valve) {
-			handleValve(valve, false);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			valves_.setAllOpen();
 		}
+		applyValves();
 	}
 
-	void handleValve(uint8_t nr, bool closed) {
-		{
-			std::lock_guard<std::mutex> lock(mutex_);
-			valvesStates_[nr] = !closed;
+	// Thermal actuators need minutes to open. Boiler (and its pump) should not start against closed circuits,
+	// so start is postponed until configured part of the capacity of valves to be opened is estimated open.
+	bool isWaitingForValves() {
+		if (config_.boiler.valveOpenCapacityToStart == 0 || isBoilerStarted()) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto openCapacity = valves_.getOpenCapacity(clock_t::now());
+		if (openCapacity >= config_.boiler.valveOpenCapacityToStart * 10) {
+			return false;
 		}
-		valvePorts_[nr]->write(closed); // HIGH = coil on = closed
-		// small delay to avoid power surge when multiple valves change at once
-#ifdef ARDUINO
-		delay(10);
-#endif
-		DBGLOGBOILER("Handle valve %d '%s' state: %s coil %s \n", nr, valveLabel(nr), !closed ? "open " : "close", closed ? "on" : "off");
+		DBGLOGBOILER("Waiting for valves to open. Open capacity %d%%, required %d%%\n", openCapacity / 10, config_.boiler.valveOpenCapacityToStart);
+		return true;
+	}
+
+	size_t applyValves() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return valves_.process(clock_t::now());
 	}
 
 	void changeBoilerState(bool enabled, boilerHeatingTemperatureOverride_t boilerHeatingTemperatureOverride) {
@@ -245,9 +377,22 @@ private:
 
 	bool isBoilerStarted() const { return currentBoilerState_; }
 
+	bool isWarmWaterCharging() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return warmWaterCharging_;
+	}
+
+	int16_t adjustOutdoorTemperature(int16_t outdoorTemperature) const {
+		return static_cast<int16_t>(std::clamp<int32_t>(outdoorTemperature + outdoorAdjustment_, INT16_MIN, INT16_MAX));
+	}
+
 	int16_t getHeatingTemperature(int16_t outdoorTemperature) {
-		auto temp = calcHeatingTemperature(outdoorTemperature, config_.heatingCurve.heatingCurve);
-		DBGLOGBOILER("getHeatingTemperature outdoor: %d, calculated: %d\n", static_cast<int>(outdoorTemperature), static_cast<int>(temp));
+		auto curveTemp = zoneTemperature_.value_or(heatingCurve_(adjustOutdoorTemperature(outdoorTemperature)));
+		auto temp = optimizer_.apply(curveTemp);
+		if (config_.optimizer.enabled && config_.heatingCurve.minHeatingCurveTemp < config_.heatingCurve.maxHeatingCurveTemp) {
+			temp = std::clamp<int16_t>(temp, config_.heatingCurve.minHeatingCurveTemp * 100, config_.heatingCurve.maxHeatingCurveTemp * 100);
+		}
+		DBGLOGBOILER("getHeatingTemperature outdoor: %d, curve: %d, calculated: %d\n", static_cast<int>(outdoorTemperature), static_cast<int>(curveTemp), static_cast<int>(temp));
 		return temp;
 	}
 
@@ -262,9 +407,11 @@ private:
 	emsChangeBoilerState_t emsChangeBoilerState_;
 	emsSetHeatingTemperature_t emsSetHeatingTemperature_;
 	std::unique_ptr<gpio::GpioPort> boilerPort_;
-	std::vector<std::unique_ptr<gpio::GpioPort>> valvePorts_;
 	std::vector<std::string> valveLabels_;
-	std::vector<bool> valvesStates_;
+	ValveScheduler valves_;
+	CompiledHeatingCurve<9> heatingCurve_{compileHeatingCurve(config_.heatingCurve.heatingCurve)};
+	std::optional<int16_t> zoneTemperature_;
+	int16_t outdoorAdjustment_ = 0;
 
 	using clock_t = std::chrono::steady_clock;
 
@@ -276,8 +423,14 @@ private:
 	std::optional<int16_t> currentOutdoorTemperature_ = 0;
 
 	bool manualTestActive_ = false;
+	bool warmWaterCharging_ = false; // reported by EMS
 	clock_t::time_point manualTestEnd_;
 
+	static constexpr std::chrono::hours optimizerPersistInterval{1}; // limits flash writes
+	FlowTemperatureOptimizer optimizer_{config_.optimizer};
+	bool optimizerDirty_ = false;
+	std::optional<clock_t::time_point> lastOptimizerPersist_;
+
 	mutable std::mutex mutex_;
 };
 
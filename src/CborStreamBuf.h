@@ -0,0 +1,364 @@
+#pragma once
+
+#include <cerrno>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+namespace heating {
+
+// Stream buffer encoding the JSON written into it as CBOR (RFC 8949) on the fly, so every status writer taking a
+// std::ostream produces either representation and no JSON document is kept for the CBOR one - only the token being
+// written. Objects and arrays become indefinite length maps and arrays, integers the shortest CBOR integer, other
+// numbers a float when it holds the value exactly, otherwise a double.
+class CborStreamBuf : public std::streambuf {
+public:
+	CborStreamBuf() {
+		setp(pending_, pending_ + sizeof(pending_));
+	}
+
+	std::string_view view() {
+		drain();
+		return out_;
+	}
+
+	// true when one complete document was written
+	bool finish() {
+		drain();
+		endToken();
+		return !error_ && started_ && depth_ == 0 && state_ == state_t::between;
+	}
+
+	bool hasError() const { return error_; }
+
+	// value already encoded, e.g. by encode(), written where its JSON would go - or members of a map (items of an array)
+	// without the head and break, inside an open one. Empty is taken as a value that failed to encode.
+	void writeEncoded(std::string_view cbor) {
+		drain();
+		endToken();
+		if (cbor.empty() || state_ != state_t::between) {
+			error_ = true;
+			return;
+		}
+		out_.append(cbor);
+		started_ = true;
+	}
+
+	// empty when json isn't one complete document
+	static std::string encode(std::string_view json) {
+		CborStreamBuf buf;
+		buf.sputn(json.data(), static_cast<std::streamsize>(json.size()));
+		if (!buf.finish()) {
+			return {};
+		}
+		return std::move(buf.out_);
+	}
+
+	// bytes of JSON encoded so far
+	size_t getConsumed() {
+		drain();
+		return consumed_;
+	}
+
+protected:
+	// JSON is collected in a small put area and encoded a chunk at a time
+	int_type overflow(int_type c) override {
+		drain();
+		if (!traits_type::eq_int_type(c, traits_type::eof())) {
+			put(traits_type::to_char_type(c));
+		}
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(char const *s, std::streamsize count) override {
+		drain();
+		feed(s, count);
+		return count;
+	}
+
+	int sync() override {
+		drain();
+		return 0;
+	}
+
+private:
+	enum class state_t : uint8_t { between, string, escape, unicode, number, literal };
+
+	enum major_t : uint8_t { unsignedInt = 0, negativeInt = 1, textString = 3, array = 4, map = 5, simple = 7 };
+
+	static constexpr size_t maxNumber = 32;
+
+	void drain() {
+		feed(pbase(), pptr() - pbase());
+		setp(pending_, pending_ + sizeof(pending_));
+	}
+
+	void feed(char const *data, size_t length) {
+		for (size_t i = 0; i < length;) {
+			if (state_ == state_t::string && !error_) { // plain runs of a string are copied at once
+				auto run = i;
+				while (run < length && data[run] != '"' && data[run] != '\\') {
+					++run;
+				}
+				token_.append(data + i, run - i);
+				consumed_ += run - i;
+				i = run;
+				if (i == length) {
+					break;
+				}
+			}
+			put(data[i++]);
+		}
+	}
+
+	void put(char c) {
+		consumed_++;
+		if (error_) {
+			return;
+		}
+		switch (state_) {
+		case state_t::string:
+			if (c == '"') {
+				head(textString, token_.size());
+				out_ += token_;
+				state_ = state_t::between;
+			} else if (c == '\\') {
+				state_ = state_t::escape;
+			} else {
+				token_ += c;
+			}
+			return;
+		case state_t::escape:
+			escape(c);
+			return;
+		case state_t::unicode:
+			unicode(c);
+			return;
+		case state_t::number:
+			if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+				token_ += c;
+				error_ = token_.size() > maxNumber;
+				return;
+			}
+			endToken();
+			break;
+		case state_t::literal:
+			if (c >= 'a' && c <= 'z') {
+				token_ += c;
+				error_ = token_.size() > 5;
+				return;
+			}
+			endToken();
+			break;
+		case state_t::between:
+			break;
+		}
+		if (error_) {
+			return;
+		}
+
+		switch (c) {
+		case '{':
+		case '[':
+			out_ += static_cast<char>((c == '{' ? map : array) << 5 | 31);
+			depth_++;
+			started_ = true;
+			break;
+		case '}':
+		case ']':
+			if (depth_ == 0) {
+				error_ = true;
+				return;
+			}
+			out_ += static_cast<char>(0xff); // break
+			depth_--;
+			break;
+		case '"':
+			state_ = state_t::string;
+			token_.clear();
+			started_ = true;
+			break;
+		case ',':
+		case ':':
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			break;
+		default:
+			if (c == '-' || (c >= '0' && c <= '9')) {
+				state_ = state_t::number;
+			} else if (c >= 'a' && c <= 'z') {
+				state_ = state_t::literal;
+			} else {
+				error_ = true;
+				return;
+			}
+			token_.assign(1, c);
+			started_ = true;
+			break;
+		}
+	}
+
+	void escape(char c) {
+		state_ = state_t::string;
+		switch (c) {
+		case 'b': token_ += '\b'; break;
+		case 'f': token_ += '\f'; break;
+		case 'n': token_ += '\n'; break;
+		case 'r': token_ += '\r'; break;
+		case 't': token_ += '\t'; break;
+		case 'u':
+			state_ = state_t::unicode;
+			unicodeDigits_ = 0;
+			codePoint_ = 0;
+			break;
+		default: token_ += c; break; // \" \\ \/
+		}
+	}
+
+	void unicode(char c) {
+		uint32_t digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			error_ = true;
+			return;
+		}
+		codePoint_ = codePoint_ << 4 | digit;
+		if (++unicodeDigits_ < 4) {
+			return;
+		}
+		state_ = state_t::string;
+		if (codePoint_ >= 0xd800 && codePoint_ < 0xdc00) {
+			highSurrogate_ = codePoint_; // low half follows as the next escape
+			return;
+		}
+		if (codePoint_ >= 0xdc00 && codePoint_ < 0xe000 && highSurrogate_) {
+			codePoint_ = 0x10000 + ((highSurrogate_ - 0xd800) << 10) + (codePoint_ - 0xdc00);
+		}
+		highSurrogate_ = 0;
+		appendUtf8(codePoint_);
+	}
+
+	void appendUtf8(uint32_t codePoint) {
+		if (codePoint < 0x80) {
+			token_ += static_cast<char>(codePoint);
+		} else if (codePoint < 0x800) {
+			token_ += static_cast<char>(0xc0 | codePoint >> 6);
+			token_ += static_cast<char>(0x80 | (codePoint & 0x3f));
+		} else if (codePoint < 0x10000) {
+			token_ += static_cast<char>(0xe0 | codePoint >> 12);
+			token_ += static_cast<char>(0x80 | (codePoint >> 6 & 0x3f));
+			token_ += static_cast<char>(0x80 | (codePoint & 0x3f));
+		} else {
+			token_ += static_cast<char>(0xf0 | codePoint >> 18);
+			token_ += static_cast<char>(0x80 | (codePoint >> 12 & 0x3f));
+			token_ += static_cast<char>(0x80 | (codePoint >> 6 & 0x3f));
+			token_ += static_cast<char>(0x80 | (codePoint & 0x3f));
+		}
+	}
+
+	// number or literal being written ends with the character after it
+	void endToken() {
+		if (state_ == state_t::number) {
+			number();
+		} else if (state_ == state_t::literal) {
+			if (token_ == "false" || token_ == "true" || token_ == "null") {
+				out_ += static_cast<char>(simple << 5 | (token_[0] == 'f' ? 20 : token_[0] == 't' ? 21 : 22));
+			} else {
+				error_ = true;
+			}
+		} else {
+			return;
+		}
+		state_ = state_t::between;
+	}
+
+	void number() {
+		char const *text = token_.c_str();
+		char *end = nullptr;
+		errno = 0;
+		if (token_.find_first_of(".eE") == std::string::npos) {
+			if (token_[0] == '-') {
+				auto value = std::strtoll(text, &end, 10);
+				if (errno == 0 && *end == '\0') {
+					value < 0 ? head(negativeInt, static_cast<uint64_t>(-(value + 1))) : head(unsignedInt, 0); // "-0" is 0
+					return;
+				}
+			} else {
+				auto value = std::strtoull(text, &end, 10);
+				if (errno == 0 && *end == '\0') {
+					head(unsignedInt, value);
+					return;
+				}
+			}
+			errno = 0; // out of range integers are encoded as a double
+		}
+		double value = std::strtod(text, &end);
+		if (*end != '\0' || end == text) {
+			error_ = true;
+			return;
+		}
+		auto single = std::fabs(value) <= FLT_MAX ? static_cast<float>(value) : 0.0f;
+		if (static_cast<double>(single) == value) {
+			uint32_t bits;
+			std::memcpy(&bits, &single, sizeof(bits));
+			out_ += static_cast<char>(simple << 5 | 26);
+			bigEndian(bits, 4);
+		} else {
+			uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			out_ += static_cast<char>(simple << 5 | 27);
+			bigEndian(bits, 8);
+		}
+	}
+
+	void head(major_t major, uint64_t value) {
+		auto type = static_cast<uint8_t>(major << 5);
+		if (value < 24) {
+			out_ += static_cast<char>(type | value);
+		} else if (value <= 0xff) {
+			out_ += static_cast<char>(type | 24);
+			bigEndian(value, 1);
+		} else if (value <= 0xffff) {
+			out_ += static_cast<char>(type | 25);
+			bigEndian(value, 2);
+		} else if (value <= 0xffffffff) {
+			out_ += static_cast<char>(type | 26);
+			bigEndian(value, 4);
+		} else {
+			out_ += static_cast<char>(type | 27);
+			bigEndian(value, 8);
+		}
+	}
+
+	void bigEndian(uint64_t value, size_t bytes) {
+		while (bytes--) {
+			out_ += static_cast<char>(value >> (bytes * 8));
+		}
+	}
+
+	char pending_[64];
+	std::string out_;
+	std::string token_; // string, number or literal being written
+	state_t state_ = state_t::between;
+	size_t depth_ = 0;
+	size_t consumed_ = 0;
+	uint32_t codePoint_ = 0;
+	uint32_t highSurrogate_ = 0;
+	uint8_t unicodeDigits_ = 0;
+	bool started_ = false;
+	bool error_ = false;
+};
+
+} // namespace heating
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+
+namespace heating {
+
+// Connections accepted by the server task, handed to worker tasks which serve one connection each. A connection is
+// accepted only when a worker waits for it - the others stay in the listen backlog and hold no socket - so one slow
+// client or upload takes a single worker and the rest keep serving.
+template <typename Connection>
+class ConnectionQueue {
+public:
+	// server task - true when a connection accepted now is served right away
+	bool hasIdleWorker() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return waiting_ > queue_.size();
+	}
+
+	// server task
+	void push(Connection connection) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.push_back(std::move(connection));
+			stats_.accepted++;
+		}
+		available_.notify_one();
+	}
+
+	// worker task - waits for the next connection, done() when it was served
+	Connection pop() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		waiting_++;
+		available_.wait(lock, [this] { return !queue_.empty(); });
+		waiting_--;
+		auto connection = std::move(queue_.front());
+		queue_.pop_front();
+		busy_++;
+		stats_.maxBusy = std::max(stats_.maxBusy, busy_);
+		return connection;
+	}
+
+	void done() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		busy_--;
+		stats_.served++;
+	}
+
+	void getStatus(std::ostream &ss) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		ss << "{\"accepted\": " << stats_.accepted << ", \"served\": " << stats_.served << ", \"busy\": " << busy_ << ", \"maxBusy\": " << stats_.maxBusy << ", \"idle\": " << waiting_ << "}";
+	}
+
+private:
+	struct Stats {
+		uint32_t accepted = 0;
+		uint32_t served = 0;
+		uint32_t maxBusy = 0; // workers serving at once
+	};
+
+	mutable std::mutex mutex_;
+	std::condition_variable available_;
+	std::deque<Connection> queue_;
+	uint32_t waiting_ = 0; // workers in pop()
+	uint32_t busy_ = 0;
+	Stats stats_;
+};
+
+} // namespace heating
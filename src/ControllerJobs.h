@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+
+namespace heating {
+
+// Calls handed to the controller task by other tasks (REST worker tasks -> controller task). The controller state is
+// single threaded, so a caller queues the call and waits until the controller task ran it in its loop. A call still
+// queued at the timeout is withdrawn and never runs, one already running is waited for - so a call may capture the
+// caller's stack by reference.
+class ControllerJobs {
+public:
+	using job_t = std::function<void()>;
+	using clock_t = std::chrono::steady_clock;
+
+	explicit ControllerJobs(size_t capacity = 4) : capacity_(capacity) {}
+
+	// any task but the controller one - false when the queue is full or the call wasn't started in time
+	bool run(job_t job, std::chrono::milliseconds timeout) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (queue_.size() >= capacity_) {
+			stats_.rejected++;
+			return false;
+		}
+		auto id = ++lastQueued_;
+		queue_.push_back({id, std::move(job), clock_t::now()});
+
+		if (!done_.wait_for(lock, timeout, [this, id] { return finished_ >= id || running_ == id; })) {
+			for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+				if (it->id == id) {
+					queue_.erase(it);
+					break;
+				}
+			}
+			stats_.timeouts++;
+			return false;
+		}
+		done_.wait(lock, [this, id] { return finished_ >= id; });
+		return true;
+	}
+
+	// controller task - runs all queued calls, returns how many
+	size_t execute() {
+		size_t executed = 0;
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!queue_.empty()) {
+			auto job = std::move(queue_.front());
+			queue_.pop_front();
+			running_ = job.id;
+			auto started = clock_t::now();
+			lock.unlock();
+			done_.notify_all(); // caller's timeout no longer applies
+
+			job.job();
+
+			auto finished = clock_t::now();
+			lock.lock();
+			running_ = 0;
+			finished_ = job.id;
+			stats_.executed++;
+			stats_.maxWaitUs = std::max<uint32_t>(stats_.maxWaitUs, std::chrono::duration_cast<std::chrono::microseconds>(started - job.queued).count());
+			stats_.maxRunUs = std::max<uint32_t>(stats_.maxRunUs, std::chrono::duration_cast<std::chrono::microseconds>(finished - started).count());
+			done_.notify_all();
+			executed++;
+		}
+		return executed;
+	}
+
+	void getStatus(std::ostream &ss) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		ss << "{\"executed\": " << stats_.executed << ", \"timeouts\": " << stats_.timeouts << ", \"rejected\": " << stats_.rejected << ", \"queued\": " << queue_.size() << ", \"maxWaitUs\": " << stats_.maxWaitUs << ", \"maxRunUs\": " << stats_.maxRunUs << "}";
+	}
+
+private:
+	struct Job {
+		uint32_t id;
+		job_t job;
+		clock_t::time_point queued;
+	};
+
+	struct Stats {
+		uint32_t executed = 0;
+		uint32_t timeouts = 0;
+		uint32_t rejected = 0;
+		uint32_t maxWaitUs = 0; // queued until started
+		uint32_t maxRunUs = 0;
+	};
+
+	size_t capacity_;
+	mutable std::mutex mutex_;
+	std::condition_variable done_;
+	std::deque<Job> queue_;
+	uint32_t lastQueued_ = 0;
+	uint32_t running_ = 0; // 0 - none, ids start at 1
+	uint32_t finished_ = 0;
+	Stats stats_;
+};
+
+} // namespace heating
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "JsonScanner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace heating {
+
+// Current conditions - what control and the dashboard use from /data/2.5/weather
+struct Outdoor {
+	bool valid = false;
+	int16_t temp = 0;       // 1/100 °C
+	int16_t feelsLike = 0;  // 1/100 °C
+	uint8_t humidity = 0;   // %
+	uint16_t pressure = 0;  // hPa
+	uint16_t windSpeed = 0; // 1/100 m/s
+	uint16_t windDeg = 0;
+	uint64_t date = 0;
+	char name[32] = {};
+	char description[32] = {};
+	char icon[8] = {};
+
+	// compact status in the shape of the API response, the dashboard reads it as before
+	std::string getJSON() const {
+		if (!valid) {
+			return "{}";
+		}
+		std::string json;
+		json.reserve(256);
+		json += "{\"dt\":";
+		json += std::to_string(date);
+		json += ",\"name\":";
+		appendString(json, name);
+		json += ",\"weather\":[{\"description\":";
+		appendString(json, description);
+		json += ",\"icon\":";
+		appendString(json, icon);
+		json += "}],\"main\":{\"temp\":";
+		appendFixed(json, temp);
+		json += ",\"feels_like\":";
+		appendFixed(json, feelsLike);
+		json += ",\"humidity\":";
+		json += std::to_string(humidity);
+		json += ",\"pressure\":";
+		json += std::to_string(pressure);
+		json += "},\"wind\":{\"speed\":";
+		appendFixed(json, windSpeed);
+		json += ",\"deg\":";
+		json += std::to_string(windDeg);
+		json += "}}";
+		return json;
+	}
+
+private:
+	static void appendFixed(std::string &json, int32_t hundredths) {
+		char buffer[16];
+		std::snprintf(buffer, sizeof(buffer), "%s%d.%02d", hundredths < 0 ? "-" : "", std::abs(hundredths) / 100, std::abs(hundredths) % 100);
+		json += buffer;
+	}
+
+	static void appendString(std::string &json, char const *text) {
+		json += '"';
+		for (; *text; ++text) {
+			if (*text == '"' || *text == '\\') {
+				json += '\\';
+				json += *text;
+			} else if (static_cast<unsigned char>(*text) >= 0x20) {
+				json += *text;
+			}
+		}
+		json += '"';
+	}
+};
+
+// Parser of current conditions fed in network sized chunks, fills Outdoor directly
+class CurrentWeatherParser : public JsonScanner<CurrentWeatherParser> {
+public:
+	explicit CurrentWeatherParser(Outdoor &outdoor) : outdoor_(outdoor) { reset(); }
+
+	void reset() {
+		JsonScanner::reset();
+		outdoor_ = Outdoor{};
+		hasTemperature_ = false;
+		weatherIndex_ = 0;
+	}
+
+	// true when a complete document with temperature was parsed, outdoor is valid then
+	bool finish() {
+		outdoor_.valid = JsonScanner::finish() && hasTemperature_;
+		return outdoor_.valid;
+	}
+
+private:
+	friend class JsonScanner<CurrentWeatherParser>;
+
+	bool isFirstWeather() const { return depth() == 3 && keyIs(0, "weather") && isArray(1) && !isArray(2) && weatherIndex_ == 1; }
+
+	void onOpen() {
+		if (depth() == 3 && keyIs(0, "weather") && isArray(1)) {
+			weatherIndex_++;
+		}
+	}
+
+	void onClose() {}
+
+	void onValue(std::string_view text, bool string) {
+		if (string) {
+			if (depth() == 1 && keyIs(0, "name")) {
+				copy(outdoor_.name, text);
+			} else if (isFirstWeather() && keyIs(2, "description")) {
+				copy(outdoor_.description, text);
+			} else if (isFirstWeather() && keyIs(2, "icon")) {
+				copy(outdoor_.icon, text);
+			}
+			return;
+		}
+
+		char *end = nullptr;
+		double value = std::strtod(text.data(), &end);
+		if (end == text.data()) {
+			return;
+		}
+
+		if (depth() == 1 && keyIs(0, "dt")) {
+			outdoor_.date = static_cast<uint64_t>(std::max(value, 0.0));
+		} else if (depth() == 2 && keyIs(0, "main")) {
+			if (keyIs(1, "temp")) {
+				outdoor_.temp = hundredths(value);
+				hasTemperature_ = true;
+			} else if (keyIs(1, "feels_like")) {
+				outdoor_.feelsLike = hundredths(value);
+			} else if (keyIs(1, "humidity")) {
+				outdoor_.humidity = static_cast<uint8_t>(std::clamp(value, 0.0, 100.0));
+			} else if (keyIs(1, "pressure")) {
+				outdoor_.pressure = static_cast<uint16_t>(std::clamp(value, 0.0, 2000.0));
+			}
+		} else if (depth() == 2 && keyIs(0, "wind")) {
+			if (keyIs(1, "speed")) {
+				outdoor_.windSpeed = static_cast<uint16_t>(hundredths(std::clamp(value, 0.0, 300.0)));
+			} else if (keyIs(1, "deg")) {
+				outdoor_.windDeg = static_cast<uint16_t>(std::clamp(value, 0.0, 360.0));
+			}
+		}
+	}
+
+	static int16_t hundredths(double value) { return static_cast<int16_t>(std::clamp(value, -300.0, 300.0) * 100 + (value < 0 ? -0.5 : 0.5)); }
+
+	template <size_t Size>
+	static void copy(char (&target)[Size], std::string_view text) {
+		auto length = std::min(text.size(), Size - 1);
+		std::memcpy(target, text.data(), length);
+		target[length] = '\0';
+	}
+
+	Outdoor &outdoor_;
+	bool hasTemperature_ = false;
+	uint8_t weatherIndex_ = 0;
+};
+
+// Delay before the next fetch: the regular interval while fetches succeed; after failures retries start at retryBase
+// and double with each failure, up to maxDelay, so an outage or a revoked key isn't hammered every interval.
+struct FetchBackoff {
+	static constexpr uint32_t retryBaseMs = 15 * 1000;
+	static constexpr uint32_t maxDelayMs = 30 * 60 * 1000;
+
+	static uint32_t nextDelayMs(uint32_t intervalMs, uint8_t failures) {
+		if (failures == 0) {
+			return intervalMs;
+		}
+		uint32_t delay = retryBaseMs << std::min<uint8_t>(failures - 1, 16);
+		return std::min(delay, std::max(intervalMs, maxDelayMs));
+	}
+};
+
+} // namespace heating
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "BeaconBleAddress.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace heating {
+
+// Fixed-capacity table of BLE devices seen nearby. Open addressing with linear probing, no allocation after construction.
+// When the table reaches its load limit the least recently seen device is evicted, so foreign devices passing by
+// cannot grow memory use. Not thread safe - caller serializes access.
+template <size_t Capacity>
+class DeviceTable {
+	static_assert(Capacity >= 4 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+
+public:
+	using clock_t = std::chrono::steady_clock;
+	static constexpr size_t maxDevices = Capacity * 3 / 4; // keep probe sequences short
+
+	struct Device {
+		BleAddress_t address;
+		clock_t::time_point lastSeen;
+		int8_t rssi;
+		uint32_t advertisements;
+		uint32_t intervalMs;             // smoothed interval between advertisements - sample rate
+		uint32_t lost;                   // gaps in frame counter
+		std::optional<uint8_t> counter;  // last frame counter
+	};
+
+	// counter - frame counter of sensors which send one, used to count lost frames
+	void seen(BleAddress_t const &address, int8_t rssi, clock_t::time_point now, std::optional<uint8_t> counter = std::nullopt) {
+		auto pos = findSlot(address);
+		if (!slots_[pos].used) {
+			if (size_ >= maxDevices) {
+				evictLeastRecentlySeen();
+				pos = findSlot(address);
+			}
+			slots_[pos].used = true;
+			slots_[pos].device = Device{address, now, rssi, 0, 0, 0, std::nullopt};
+			size_++;
+		} else {
+			updateStatistics(slots_[pos].device, now, counter);
+		}
+
+		auto &device = slots_[pos].device;
+		device.lastSeen = now;
+		device.counter = counter;
+		device.rssi = rssi;
+		device.advertisements++;
+	}
+
+	Device const *find(BleAddress_t const &address) const {
+		auto pos = findSlot(address);
+		return slots_[pos].used ? &slots_[pos].device : nullptr;
+	}
+
+	template <typename Callback>
+	void forEach(Callback &&callback) const {
+		for (auto const &slot : slots_) {
+			if (slot.used) {
+				callback(slot.device);
+			}
+		}
+	}
+
+	size_t size() const { return size_; }
+	uint32_t getEvictions() const { return evictions_; }
+
+private:
+	static constexpr size_t mask = Capacity - 1;
+
+	struct Slot {
+		Device device;
+		bool used = false;
+	};
+
+	static constexpr uint8_t maxCounterGap = 64; // larger jump means sensor restart or long absence, not loss
+
+	static void updateStatistics(Device &device, clock_t::time_point now, std::optional<uint8_t> counter) {
+		auto interval = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - device.lastSeen).count());
+		if (device.intervalMs == 0) {
+			device.intervalMs = static_cast<uint32_t>(interval);
+		} else {
+			device.intervalMs = static_cast<uint32_t>(device.intervalMs + (interval - static_cast<int64_t>(device.intervalMs)) / 8);
+		}
+
+		if (counter && device.counter) {
+			uint8_t gap = static_cast<uint8_t>(*counter - *device.counter);
+			if (gap > 1 && gap <= maxCounterGap) {
+				device.lost += gap - 1;
+			}
+		}
+	}
+
+	static size_t home(BleAddress_t const &address) { return BleAddressHash{}(address) & mask; }
+
+	// slot holding address or the empty slot where it would be inserted
+	size_t findSlot(BleAddress_t const &address) const {
+		auto pos = home(address);
+		while (slots_[pos].used && slots_[pos].device.address != address) {
+			pos = (pos + 1) & mask;
+		}
+		return pos;
+	}
+
+	void evictLeastRecentlySeen() {
+		size_t oldest = Capacity;
+		for (size_t pos = 0; pos < Capacity; ++pos) {
+			if (slots_[pos].used && (oldest == Capacity || slots_[pos].device.lastSeen < slots_[oldest].device.lastSeen)) {
+				oldest = pos;
+			}
+		}
+		if (oldest != Capacity) {
+			erase(oldest);
+			evictions_++;
+		}
+	}
+
+	// backward shift deletion - no tombstones, so lookups never degrade
+	void erase(size_t hole) {
+		auto next = (hole + 1) & mask;
+		while (slots_[next].used) {
+			auto homePos = home(slots_[next].device.address);
+			if (((next - homePos) & mask) >= ((next - hole) & mask)) {
+				slots_[hole] = slots_[next];
+				hole = next;
+			}
+			next = (next + 1) & mask;
+		}
+		slots_[hole].used = false;
+		size_--;
+	}
+
+	std::array<Slot, Capacity> slots_{};
+	size_t size_ = 0;
+	uint32_t evictions_ = 0;
+};
+
+} // namespace heating
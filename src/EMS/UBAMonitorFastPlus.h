@@ -29,6 +29,9 @@ public:
 	auto getCurrentFlowTemperature() const {
 		return getValue<uint16_t>(7);
 	}
+	auto getReturnTemperature() const {
+		return getValue<uint16_t>(17);
+	}
 	auto getBurningGas() const {
 		return getValue<bool, 0>(11);
 	}
@@ -24,6 +24,14 @@ public:
 	auto getECOEnabled() const {
 		return getValue<uint8_t>(26);
 	}
+
+	static EmsTelegram setWarmWaterEnabled(uint8_t deviceId, uint8_t destination, bool enabled) {
+		return {EmsTelegram::operation_t::WRITE, deviceId, destination, 5, predefinedTypeId, {static_cast<uint8_t>(enabled ? 0x01 : 0x00)}};
+	}
+
+	static EmsTelegram setWarmWaterTemperature(uint8_t deviceId, uint8_t destination, uint8_t temp) {
+		return {EmsTelegram::operation_t::WRITE, deviceId, destination, 6, predefinedTypeId, {temp}};
+	}
 };
 
 
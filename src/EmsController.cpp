@@ -41,6 +41,9 @@ EmsController::EmsController() {
 		std::lock_guard<std::mutex> lock(s.mutex);
 		UPDATE_IF_SET(s.selectedFlowTemperature, getSelectedFlowTemperature)
 		UPDATE_IF_SET(s.currentFlowTemperature, getCurrentFlowTemperature)
+		if (auto returnTemperature = telegram->getReturnTemperature(); returnTemperature && *returnTemperature != 0x8000) { // 0x8000 - no sensor
+			s.returnTemperature = *returnTemperature;
+		}
 		UPDATE_IF_SET(s.burningGas, getBurningGas)
 		UPDATE_IF_SET(s.pumpEnabled, getPumpEnabled)
 		UPDATE_IF_SET(s.pressure, getPressure)
@@ -102,6 +105,7 @@ EmsController::EmsController() {
 		s.outdoorTemperature = telegram->getOutdoorTemperature();
 		if (s.outdoorTemperature.has_value()) {
 			s.outdoorTemperature.value() *= 10;
+			s.outdoorTemperatureReceived = std::chrono::steady_clock::now();
 		}
 	});
 
@@ -255,10 +259,11 @@ void EmsController::processTelegram(uint8_t *data, uint8_t length) { // runs on
 
 }
 
-void EmsController::processTelegrams() {
+size_t EmsController::processTelegrams() {
+	size_t processed = 0;
 	std::unique_lock<std::mutex> lock(telegramProcessingMutex_);
 	if (telegramsToProcess_.empty()) {
-		return;
+		return processed;
 	} else {
 		DBGLOGEMS("EmsController::processTelegrams size: %zu\n", telegramsToProcess_.size());
 
@@ -281,9 +286,11 @@ void EmsController::processTelegrams() {
 				}
 			}
 
+			processed++;
 			lock.lock();
 		} while (!telegramsToProcess_.empty());
 	}
+	return processed;
 }
 
 void EmsController::processReadRequest(EmsTelegram const &telegram) {
@@ -329,6 +336,41 @@ void EmsController::setHeatingTemperature(uint8_t temperature) {
 	enqueueTelegramToSend(UBAParametersPlus::setHeatingTemperature(deviceId_, boilerId_, temperature));
 }
 
+void EmsController::setWarmWater(bool enabled, uint8_t temperature) {
+	if (!emsConfig_.emsEnabled) {
+		return;
+	}
+
+	std::optional<bool> currentEnabled;
+	std::optional<uint8_t> currentTemperature;
+	{
+		std::lock_guard<std::mutex> lock(boilerState_.mutex);
+		currentEnabled = boilerState_.warmWaterEnabled;
+		currentTemperature = boilerState_.selectedWarmWaterTemperature;
+	}
+
+	bool writeEnabled = currentEnabled != enabled;
+	bool writeTemperature = enabled && currentTemperature != temperature;
+	if (!writeEnabled && !writeTemperature) {
+		return;
+	}
+
+	auto now = millis();
+	if (lastWarmWaterWriteMillis_ != 0 && !ib::millisDurationPassed(now, lastWarmWaterWriteMillis_, warmWaterWriteRetryMillis)) {
+		return;
+	}
+	lastWarmWaterWriteMillis_ = now;
+
+	DBGLOGEMS("setWarmWater enabled: %d temp: %d, current enabled: %d temp: %d\n", enabled, temperature, currentEnabled.value_or(false), currentTemperature.value_or(0));
+	if (writeTemperature) {
+		enqueueTelegramToSend(UBAParametersWWPlus::setWarmWaterTemperature(deviceId_, boilerId_, temperature));
+	}
+	if (writeEnabled) {
+		enqueueTelegramToSend(UBAParametersWWPlus::setWarmWaterEnabled(deviceId_, boilerId_, enabled));
+	}
+	enqueueTelegramToSend(UBAParametersWWPlus::getRequest(deviceId_, boilerId_));
+}
+
 } // namespace heating::ems
 
 //processTelegram (9): 98 08 FF 00 01 EA 00 FA 00
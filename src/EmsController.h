@@ -5,6 +5,7 @@
 #include "EMS/EmsTelegram.h"
 
 #include <atomic>
+#include <chrono>
 #include <deque>
 #include <functional>
 #include <list>
@@ -24,12 +25,14 @@ struct EmsBoilerState {
 	std::optional<bool> heatingEnabled;
 	//outdoor
 	std::optional<int16_t> outdoorTemperature; // for 5.7 EMS telegram returns 57 but we keep in multiplied by 10 = 570
+	std::chrono::steady_clock::time_point outdoorTemperatureReceived;
 	// wwparamsplus
 	std::optional<bool> warmWaterEnabled;
 	std::optional<uint8_t> selectedWarmWaterTemperature;
 	// monitorfast plus
 	std::optional<uint8_t> selectedFlowTemperature;
 	std::optional<uint16_t> currentFlowTemperature;
+	std::optional<uint16_t> returnTemperature; // 1/10 °C like flow temperature
 	std::optional<bool> burningGas;
 	std::optional<bool> pumpEnabled;
 	std::optional<uint8_t> pressure;
@@ -71,6 +74,7 @@ struct EmsBoilerState {
 		ADD_ITEM_TO_JSON(heatingEnabled, heatingEnabled.value())
 		ADD_ITEM_TO_JSON(selectedFlowTemperature, static_cast<int>(selectedFlowTemperature.value()))
 		ADD_ITEM_TO_JSON(currentFlowTemperature, static_cast<int>(currentFlowTemperature.value()))
+		ADD_ITEM_TO_JSON(returnTemperature, static_cast<int>(returnTemperature.value()))
 		ADD_ITEM_TO_JSON(burningGas, burningGas.value())
 		ADD_ITEM_TO_JSON(pumpEnabled, pumpEnabled.value())
 		ADD_ITEM_TO_JSON(pressure, static_cast<int>(pressure.value()))
@@ -125,6 +129,7 @@ public:
 	static constexpr unsigned long boilerParametersReadRequestIntervalSecs = 119;
 	static constexpr unsigned long boilerDetailsReadRequestIntervalSecs = 179;
 	static constexpr int maxTelegramQueueSize = 59;
+	static constexpr unsigned long warmWaterWriteRetryMillis = 60000; // boiler settings are read back before writing again
 
 	EmsController();
 
@@ -146,17 +151,20 @@ public:
 
 	void setHeatingTemperature(uint8_t temperature);
 
+	// writes only what differs from settings read back from the boiler
+	void setWarmWater(bool enabled, uint8_t temperature);
 
-	void loop() {
+	// returns how many telegrams were processed
+	size_t loop() {
 		if (!emsConfig_.emsEnabled) {
-			return;
+			return 0;
 		}
-		processTelegrams();
+		auto processed = processTelegrams();
 		requestPeriodicData();
 
 		//TODO log stats periodicly
 		// DBGLOGEMS("requestPeriodicData. TxNotConfirmed: %zu\n", txNotConfirmed_.load());
-
+		return processed;
 	}
 
 	void registerTelegramProcessor(uint16_t telegramId, std::function<void(EmsTelegram const &)> processor) {
@@ -217,7 +225,7 @@ private:
 		DBGLOGEMS("telegramsToSend_.size() = %zu\n", telegramsToSend_.size());
 	}
 
-	void processTelegrams();
+	size_t processTelegrams();
 
 	void processReadRequest(EmsTelegram const &telegram);
 
@@ -263,6 +271,7 @@ private:
 
 	unsigned long lastBoilerParametersReadRequestMillis_ = 0;
 	unsigned long lastBoilerDetailsReadRequestMillis_ = 0;
+	unsigned long lastWarmWaterWriteMillis_ = 0;
 
 };
 
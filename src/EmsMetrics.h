@@ -2,6 +2,7 @@
 #include "EMS/UBAMonitorFastPlus.h"
 #include "EMS/UBAMonitorWWPlus.h"
 #include "EMS/UBAFactory.h"
+#include "WarmWaterProgram.h"
 #include <TimeHelpers.h>
 
 #include <atomic>
@@ -44,6 +45,8 @@ public:
 			auto warmWater = telegram->getWarmWaterActive();
 			if (warmWater) {
 				warmWaterActive_ = *warmWater;
+				std::lock_guard<std::mutex> lock(mutex_);
+				warmWaterEvents_.update(*warmWater, ib::getTimeMillis());
 			}
 		});
 
@@ -111,11 +114,23 @@ public:
 		ADD_ITEM(heatingEnergyUsedKwh, heatingEnergyUsedKwh);
 		ADD_ITEM(warmWaterUsage, warmWaterUsage);
 		ADD_ITEM(warmWaterAvgFlow, warmWaterAvgFlow);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			ss << ",\"warmWaterEvents\": "; // completed since previous metrics
+			warmWaterEvents_.getJSON(ss, reportedWarmWaterEvents_);
+			reportedWarmWaterEvents_ = warmWaterEvents_.getTotal();
+		}
 		ss << "}";
 	}
 
 #undef ADD_ITEM
 
+	// last warm water events, doesn't reset metrics
+	void getWarmWaterEvents(std::ostream &ss) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		warmWaterEvents_.getJSON(ss);
+	}
+
 private:
 	void calculatePowerUsage(BurnerPowerState currentPowerState) {
 		auto timeDeltaMs = currentPowerState.time - previousPowerState_.time;
@@ -131,6 +146,7 @@ private:
 
 		if (warmWaterActive_) {
 			warmWaterEnergyUsedKwh_ += energyKwh;
+			warmWaterEvents_.addEnergy(energyKwh);
 		}
 
 		previousPowerState_ = currentPowerState;
@@ -144,12 +160,13 @@ private:
 
 		double flowLm = previousWarmWaterState_.flow / FLOW_SCALING_FACTOR;
 		totalWarmWaterUsage_ += (flowLm * timeDeltaMs) / MILLIS_IN_MIN;
+		warmWaterEvents_.addWater((flowLm * timeDeltaMs) / MILLIS_IN_MIN);
 
 		previousWarmWaterState_ = currentWaterState;
 	}
 
 private:
-	std::mutex mutex_;
+	mutable std::mutex mutex_;
 	BurnerPowerState previousPowerState_ = {0};
 	double totalEnergyUsedKwh_ = 0.0;
 	double warmWaterEnergyUsedKwh_ = 0.0;
@@ -161,5 +178,8 @@ private:
 	WarmWaterState previousWarmWaterState_ = {0};
 	double totalWarmWaterUsage_ = 0.0; // liters
 	uint64_t lastWarmWaterFlowGet_ = ib::getTimeMillis();
+
+	heating::WarmWaterEvents warmWaterEvents_;
+	uint32_t reportedWarmWaterEvents_ = 0;
 };
 } // namespace heating::ems
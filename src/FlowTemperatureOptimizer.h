@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+
+namespace heating {
+
+struct FlowOptimizerConfig {
+	bool enabled = false;
+	std::chrono::seconds updateInterval{600}; // heating system reacts in tens of minutes - don't chase noise
+	int16_t maxStep = 100;                    // max flow temperature change per update, 1/100 °C
+	int16_t maxOffset = 1000;                 // learnt offset limit (both directions), 1/100 °C
+	uint16_t minSlope = 700;                  // learnt slope limits, per mille of configured curve
+	uint16_t maxSlope = 1300;
+	int16_t targetGainRate = 50;      // temperature gain wanted in demanding rooms, 1/100 °C per hour
+	int16_t condensingReturn = 5500;  // return temperature above which boiler doesn't condense, 1/100 °C
+	int16_t minFlowReturnDelta = 500; // smaller flow - return difference means emitters don't take the heat
+};
+
+// Learnt adjustment of the heating curve: flow = reference + (curve - reference) * slope + offset
+struct FlowOptimizerState {
+	int16_t offset = 0;    // 1/100 °C
+	uint16_t slope = 1000; // per mille, 1000 - curve as configured
+
+	bool operator==(FlowOptimizerState const &other) const { return offset == other.offset && slope == other.slope; }
+	bool operator!=(FlowOptimizerState const &other) const { return !(*this == other); }
+};
+
+// Temperature change rate of a room - least squares over points recorded at most once per interval.
+// Result in 1/100 °C per hour.
+class GainRateEstimator {
+public:
+	using clock_t = std::chrono::steady_clock;
+	static constexpr size_t maxPoints = 8;
+
+	explicit GainRateEstimator(std::chrono::seconds interval = std::chrono::minutes(5)) : interval_(interval) {}
+
+	void add(int16_t temperature, clock_t::time_point now) {
+		if (count_ > 0 && now - points_[(first_ + count_ - 1) % maxPoints].time < interval_) {
+			return;
+		}
+		if (count_ == maxPoints) {
+			first_ = (first_ + 1) % maxPoints;
+			count_--;
+		}
+		points_[(first_ + count_) % maxPoints] = Point{now, temperature};
+		count_++;
+	}
+
+	std::optional<int16_t> get() const {
+		if (count_ < 2) {
+			return std::nullopt;
+		}
+
+		auto start = points_[first_].time;
+		int64_t sumT = 0, sumX = 0, sumTT = 0, sumTX = 0;
+		for (size_t i = 0; i < count_; ++i) {
+			auto const &point = points_[(first_ + i) % maxPoints];
+			int64_t t = std::chrono::duration_cast<std::chrono::seconds>(point.time - start).count();
+			sumT += t;
+			sumX += point.temperature;
+			sumTT += t * t;
+			sumTX += t * point.temperature;
+		}
+		int64_t n = static_cast<int64_t>(count_);
+		int64_t denominator = n * sumTT - sumT * sumT;
+		if (denominator == 0) {
+			return std::nullopt;
+		}
+		int64_t rate = (n * sumTX - sumT * sumX) * 3600 / denominator;
+		return static_cast<int16_t>(std::clamp<int64_t>(rate, INT16_MIN, INT16_MAX));
+	}
+
+	void reset() {
+		first_ = 0;
+		count_ = 0;
+	}
+
+private:
+	struct Point {
+		clock_t::time_point time;
+		int16_t temperature;
+	};
+
+	std::chrono::seconds interval_;
+	std::array<Point, maxPoints> points_{};
+	size_t first_ = 0;
+	size_t count_ = 0;
+};
+
+// Closed loop correction of the heating curve. Every update interval, while rooms demand heat, it compares how fast
+// the demanding rooms gain temperature with the target and nudges flow temperature up (too slow) or down (faster than
+// needed). Return temperature above the condensing limit or small flow-return difference pushes it down as well.
+// The correction is split between offset and slope by the position on the curve, so the learnt curve converges for
+// all outdoor temperatures, and every update is limited to maxStep.
+class FlowTemperatureOptimizer {
+public:
+	using clock_t = std::chrono::steady_clock;
+	static constexpr int16_t reference = 2000; // room temperature the curve pivots around, 1/100 °C
+
+	struct Feedback {
+		uint8_t rooms = 0;                      // enabled rooms with valid temperature
+		uint8_t demanding = 0;                  // rooms requesting heat
+		std::optional<int16_t> gainRate;        // mean gain of demanding rooms, 1/100 °C per hour
+		std::optional<int16_t> flowTemperature; // measured by boiler, 1/100 °C
+		std::optional<int16_t> returnTemperature;
+	};
+
+	explicit FlowTemperatureOptimizer(FlowOptimizerConfig const &config, FlowOptimizerState state = {}) : config_(config) { setState(state); }
+
+	int16_t apply(int16_t curveTemperature) const {
+		if (!config_.enabled) {
+			return curveTemperature;
+		}
+		int32_t flow = reference + (static_cast<int32_t>(curveTemperature) - reference) * state_.slope / 1000 + state_.offset;
+		return static_cast<int16_t>(std::clamp<int32_t>(flow, 0, INT16_MAX));
+	}
+
+	// true if learnt state changed
+	bool update(Feedback const &feedback, int16_t curveTemperature, clock_t::time_point now) {
+		if (!config_.enabled || feedback.rooms == 0 || feedback.demanding == 0) {
+			return false;
+		}
+		if (lastUpdate_ && now - *lastUpdate_ < config_.updateInterval) {
+			return false;
+		}
+		lastUpdate_ = now;
+
+		int32_t correction = 0;
+		bool satisfied = true;
+		if (feedback.gainRate) {
+			int32_t shortfall = config_.targetGainRate - *feedback.gainRate;
+			satisfied = shortfall <= 0;
+			// 0.5 °C/h too slow -> 1 °C hotter flow. A single cold room among many raises less, its valve and schedule come first.
+			int32_t demandShare = satisfied ? 100 : std::max<int32_t>(feedback.demanding * 100 / feedback.rooms, 25);
+			correction = shortfall * 2 * demandShare / 100;
+		}
+		if (satisfied && feedback.returnTemperature && *feedback.returnTemperature > config_.condensingReturn) {
+			correction -= config_.maxStep / 2;
+		}
+		if (satisfied && feedback.flowTemperature && feedback.returnTemperature && *feedback.flowTemperature - *feedback.returnTemperature < config_.minFlowReturnDelta) {
+			correction -= config_.maxStep / 2;
+		}
+		correction = std::clamp<int32_t>(correction, -config_.maxStep, config_.maxStep);
+		lastCorrection_ = static_cast<int16_t>(correction);
+
+		auto previous = state_;
+		int32_t span = static_cast<int32_t>(curveTemperature) - reference;
+		int32_t offset = state_.offset;
+		int32_t slope = state_.slope;
+		if (span >= 1000) { // cold outside - half of the error belongs to the slope
+			slope += (correction / 2) * 1000 / span;
+			offset += correction - correction / 2;
+		} else {
+			offset += correction;
+		}
+		setState(FlowOptimizerState{static_cast<int16_t>(offset), static_cast<uint16_t>(std::clamp<int32_t>(slope, 0, UINT16_MAX))});
+		return state_ != previous;
+	}
+
+	FlowOptimizerState getState() const { return state_; }
+
+	void setState(FlowOptimizerState state) {
+		state_.offset = std::clamp<int16_t>(state.offset, -config_.maxOffset, config_.maxOffset);
+		state_.slope = std::clamp<uint16_t>(state.slope, config_.minSlope, config_.maxSlope);
+	}
+
+	// configured curve points (°C) with learnt adjustment
+	template <size_t Points>
+	std::array<uint8_t, Points> getLearntCurve(std::array<uint8_t, Points> const &curve) const {
+		std::array<uint8_t, Points> learnt;
+		for (size_t i = 0; i < Points; ++i) {
+			learnt[i] = static_cast<uint8_t>(std::clamp<int32_t>((apply(static_cast<int16_t>(curve[i] * 100)) + 50) / 100, 0, UINT8_MAX));
+		}
+		return learnt;
+	}
+
+	void getStatus(std::ostream &ss) const {
+		ss << "{\"enabled\": " << (config_.enabled ? "true" : "false");
+		ss << ", \"offset\": " << state_.offset << ", \"slope\": " << state_.slope << ", \"lastCorrection\": " << lastCorrection_ << "}";
+	}
+
+private:
+	FlowOptimizerConfig config_;
+	FlowOptimizerState state_;
+	std::optional<clock_t::time_point> lastUpdate_;
+	int16_t lastCorrection_ = 0;
+};
+
+} // namespace heating
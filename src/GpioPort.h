@@ -12,6 +12,12 @@ public:
 
 	virtual void initOutput() = 0;
 	virtual void write(bool high) = 0;
+
+	// Batched write. stage() may defer the hardware update until commit() is called,
+	// so several pins on one I2C extender end up in a single bus transaction.
+	// Ports without a shared device simply write immediately.
+	virtual void stage(bool high) { write(high); }
+	virtual void commit() {}
 };
 
 // Null implementation for pins that are not used (e.g. boiler pin in EMS mode)
@@ -1,16 +1,28 @@
 #pragma once
 
 #include "BeaconBleAddress.h"
+#include "BindKeys.h"
 #include "BoilerController.h"
+#include "DeviceTable.h"
 #include "BuiltinGpioPort.h"
+#include "ControllerJobs.h"
 #include "PcfGpioPort.h"
 #include "BeaconTemperatureReader.h"
 #include "OpenWeather.h"
 #include "PeriodicCounter.h"
 #include "EmsController.h"
 #include "EmsMetrics.h"
+#include "HeatingCurveLearner.h"
+#include "LiveStatus.h"
+#include "StatusCache.h"
+#include "LoopStats.h"
 #include "MQTT.h"
+#include "OutdoorTemperature.h"
 #include "Room.h"
+#include "SampleQueue.h"
+#include "SensorIndex.h"
+#include "WarmWaterProgram.h"
+#include "ZoneAggregator.h"
 
 #include "Logger.h"
 #include <algorithm>
@@ -21,8 +33,10 @@
 #include <unordered_map>
 #include <iomanip>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace heating {
@@ -82,6 +96,16 @@ inline std::vector<std::string> createValveLabels() {
 	return labels;
 }
 
+inline std::vector<ThermalActuator::Config> createValveActuators() {
+	auto pins = config::getValvePins();
+	std::vector<ThermalActuator::Config> actuators;
+	actuators.reserve(pins.size());
+	for (auto const &p : pins) {
+		actuators.push_back(ThermalActuator::Config{std::chrono::seconds(p.openTime), std::chrono::seconds(p.closeTime), p.capacity});
+	}
+	return actuators;
+}
+
 inline std::unordered_map<std::string, uint8_t> buildValveLabelMap() {
 	auto pins = config::getValvePins();
 	std::unordered_map<std::string, uint8_t> map;
@@ -98,7 +122,18 @@ class HeatingController {
 public:
 	using boilerHeatingTemperatureOverride_t = BoilerController::boilerHeatingTemperatureOverride_t;
 
-	HeatingController() : openWeather_(config::getOpenWeatherConfig()), currentProgram_(config::getCurrentProgram()), rooms_(buildRoomsFromConfig()) {
+	HeatingController() : openWeather_(config::getOpenWeatherConfig()), currentProgram_(config::getCurrentProgram()), rooms_(buildRooms(currentProgram_)), sensorIndex_(SensorIndex_t::build(rooms_)) {
+		tempReader_.setBindKeys(buildBindKeys(rooms_, boilerConfig_.outdoor, nullptr));
+		if (auto state = config::getFlowOptimizerState()) {
+			boiler_.setOptimizerState(state.value());
+		}
+		if (auto state = config::getCurveLearnerState()) {
+			curveLearner_ = HeatingCurveLearner(state.value());
+		}
+		if (auto date = config::getWarmWaterLastCycleDate()) {
+			warmWater_.setLastCycleDate(date.value());
+		}
+		status_.setSections(buildStatusSections());
 		heating::logger.printf("HeatingController constructed\n");
 		bluetoothScan_ = true;
 		lastReadTemperatureCounter_.notifyNow();
@@ -112,7 +147,16 @@ public:
 		boilerHeatingTemperatureOverride_t boilerHeatingTempOverride;
 
 		std::set<uint8_t> valvesWhichShouldBeClosed;
-
+		FlowTemperatureOptimizer::Feedback feedback;
+		int32_t gainRateSum = 0;
+		uint8_t gainRates = 0;
+		int32_t demandingTemperatureSum = 0;
+		int32_t demandingSetSum = 0;
+		uint8_t demandingEvaluated = 0;
+		std::vector<std::pair<size_t, std::vector<std::string>>> zoneValves; // zone, valves of room
+
+		updateOutdoorTemperature();
+		zones_.clearDemand();
 		{ // mutex scope
 		std::lock_guard<std::mutex> lock(roomsAccessMutex_);
 		for (auto const &room : rooms_) {
@@ -122,12 +166,34 @@ public:
 				shouldStartBoiler = shouldStartBoiler || roomStatus == Room::TemperatureStatus::START_HEATING;
 				shouldBoilerContinue = shouldBoilerContinue || roomStatus == Room::TemperatureStatus::CONTINUE_HEATING;
 
+				if (roomStatus != Room::TemperatureStatus::MISSING_TEMPERATURE) {
+					feedback.rooms++;
+				}
+				if (roomStatus == Room::TemperatureStatus::START_HEATING || roomStatus == Room::TemperatureStatus::CONTINUE_HEATING) {
+					feedback.demanding++;
+					if (auto gainRate = room->getGainRate()) {
+						gainRateSum += gainRate.value();
+						gainRates++;
+					}
+					if (auto evaluation = room->getLastEvaluation()) {
+						demandingTemperatureSum += evaluation->temperature;
+						demandingSetSum += evaluation->set;
+						demandingEvaluated++;
+					}
+				}
+
 				if (roomBoilerHeatingTempOverride.has_value()) {
 					boilerHeatingTempOverride = std::max(boilerHeatingTempOverride.value_or(0), roomBoilerHeatingTempOverride.value()); // use highest boiler supply temperature from overrides
 				}
 
+				if (zones_.isEnabled()) {
+					auto zone = zones_.getZone(room->getName());
+					zones_.addRoom(zone, roomStatus != Room::TemperatureStatus::MISSING_TEMPERATURE, roomStatus == Room::TemperatureStatus::START_HEATING, roomStatus == Room::TemperatureStatus::CONTINUE_HEATING, roomBoilerHeatingTempOverride);
+					zoneValves.emplace_back(zone, room->getValves());
+				}
+
 				// valve should be closed only if temperature is in upper/lower margin - in case of no samples, valve should remain open but should not trigger or continue heating
-				if (roomStatus == Room::TemperatureStatus::TEMPERATURE_OK) {
+				if (roomStatus == Room::TemperatureStatus::TEMPERATURE_OK && !shouldPreopenValves(*room)) {
 					auto valves = room->getValves();
 					if (debug::debug.debugHeatingController) {
 						DBGLOGHC("  adding valves to close for room %s valves: ", room->getName().c_str());
@@ -154,9 +220,33 @@ public:
 		}
 		}
 
+		updateForecastOutlook();
+		if (zones_.isEnabled()) {
+			auto outdoor = boiler_.getCurveOutdoorTemperature(getOutdoorTemperature());
+			auto decision = zones_.aggregate(outdoor, boiler_.getCurveTemperature(outdoor), std::chrono::steady_clock::now());
+			boiler_.setZoneTemperature(decision.flowTemperature);
+			boilerHeatingTempOverride.reset(); // already in zone flow temperatures
+			if (decision.activeZone) {
+				closeInactiveZoneValves(decision.activeZone.value(), zoneValves, valvesWhichShouldBeClosed);
+			}
+		}
+
 		boiler_.handleValves(valvesWhichShouldBeClosed);
 		boiler_.startBoilerOrContinue(shouldStartBoiler, shouldBoilerContinue, boilerHeatingTempOverride);
+		updateWarmWater(shouldStartBoiler || shouldBoilerContinue);
+
+		if (gainRates > 0) {
+			feedback.gainRate = static_cast<int16_t>(gainRateSum / gainRates);
+		}
+		updateFlowOptimizer(feedback);
 
+		HeatingCurveLearner::Observation observation{};
+		observation.gainRate = feedback.gainRate;
+		if (demandingEvaluated > 0) {
+			observation.roomTemperature = static_cast<int16_t>(demandingTemperatureSum / demandingEvaluated);
+			observation.roomSet = static_cast<int16_t>(demandingSetSum / demandingEvaluated);
+		}
+		updateCurveLearner(observation);
 
 		DBGLOGHC("%s\n", boiler_.getStatus().c_str());
 
@@ -166,12 +256,48 @@ public:
 
 		openWeather_.operate();
 
+		status_.markDirty(""); // diagnostics and clock are refreshed only at this cadence, reads in between get the same version
 		mqtt_.operate();
 	}
 
 	void loop() {
+		auto now = std::chrono::steady_clock::now();
+		loopStats_.tick(now);
+		jobs_.execute(); // calls changing state mark their own sections
+		if (reloadPending_.exchange(false)) {
+			reloadConfiguration();
+		}
+		if (applySamples()) {
+			status_.markDirty("room/");
+		}
+		if (boiler_.loop()) {
+			status_.markDirty("boiler");
+		}
 		mqtt_.loop();
-		ems_.loop();
+		if (ems_.loop()) {
+			status_.markDirty("ems");
+		}
+		live_.publish(now);
+	}
+
+	// any task - snapshot and deltas for web UI viewers
+	LiveStatus &getLiveStatus() {
+		return live_;
+	}
+
+	// any task - rendered status fragments, current as of the last refreshStatus()
+	StatusCache const &getStatusCache() const {
+		return status_;
+	}
+
+	// controller task - renders fragments whose source changed since the last refresh
+	void refreshStatus() {
+		status_.refresh();
+	}
+
+	// from other tasks - runs the call on the controller task and waits for it, see ControllerJobs
+	bool runOnControllerTask(ControllerJobs::job_t job, std::chrono::milliseconds timeout) {
+		return jobs_.run(std::move(job), timeout);
 	}
 
 	void getBoilerStatus(std::ostream &ss) const {
@@ -198,19 +324,39 @@ public:
 		return ems_.getBoilerParams();
 	}
 
-	void getFullStatus(std::ostream &ss) const {
-		ss << "{";
-		ss << "\"rooms\": ";
-		getRoomsStatus(ss);
-		ss << ",";
-		{
-			std::lock_guard<std::mutex> lock(roomsAccessMutex_);
-			ss << "\"activeProgram\": \"" << currentProgram_ << "\",";
-		}
-		ss << "\"boiler\": "; boiler_.getStatus(ss); ss << ",";
-		ss << "\"ems\": "; ems_.getStatus(ss); ss << ",";
-		ss << "\"openweather\": " << openWeather_.getStatus() << ",";
+	// any task - assembled from the status cache, returns its version
+	// @param cbor  buffer of ss when it encodes CBOR, fragments are copied encoded then
+	uint32_t getFullStatus(std::ostream &ss, CborStreamBuf *cbor = nullptr) const {
+		ss << "{\"rooms\": [";
+		bool rooms = true;
+		bool firstRoom = true;
+		auto read = status_.forEach([&](StatusCache::Fragment const &fragment) {
+			if (isRoomSection(fragment.key)) {
+				ss << (firstRoom ? "" : ",");
+				StatusCache::writeValue(ss, cbor, fragment.json, fragment.cbor);
+				firstRoom = false;
+				return;
+			}
+			if (rooms) {
+				ss << "]";
+				rooms = false;
+			}
+			if (fragment.key == "clock") { // fields of the document itself
+				if (fragment.json.size() > 2 && fragment.json.front() == '{') {
+					ss << ", ";
+					StatusCache::writeValue(ss, cbor, members(fragment.json), members(fragment.cbor));
+				}
+			} else {
+				ss << ", \"" << fragment.key << "\": ";
+				StatusCache::writeValue(ss, cbor, fragment.json, fragment.cbor);
+			}
+		});
+		ss << (rooms ? "]}" : "}");
+		return read.version;
+	}
 
+	// "time", "date", "weekDay" and "uptime" fields
+	void getClockStatus(std::ostream &ss) const {
 		struct tm timeinfo;
 		getLocalTime(&timeinfo);
 
@@ -223,9 +369,6 @@ public:
 
 		ss << "\"weekDay\": " << timeinfo.tm_wday << ",";
 		ss << "\"uptime\": " << millis()/1000;
-
-
-		ss << "}";
 	}
 
 
@@ -241,21 +384,24 @@ public:
 		return ss.str();
 	}
 
-	size_t getRoomsStatus(std::ostream &ss) const {
+	// any task - assembled from the status cache, returns the last version any room changed at
+	uint32_t getRoomsStatus(std::ostream &ss, CborStreamBuf *cbor = nullptr) const {
 		ss << "[";
-		size_t r = 0;
-		std::lock_guard<std::mutex> lock(roomsAccessMutex_);
-
-		for (auto const &room : rooms_) {
-			room->getStatus(ss);
-			r++;
-			if (r != rooms_.size()) {
-				ss << ",";
+		bool first = true;
+		std::optional<uint32_t> version;
+		status_.forEach([&](StatusCache::Fragment const &fragment) {
+			if (!isRoomSection(fragment.key)) {
+				return;
 			}
-		}
+			ss << (first ? "" : ",");
+			StatusCache::writeValue(ss, cbor, fragment.json, fragment.cbor);
+			first = false;
+			if (!version || static_cast<int32_t>(fragment.version - *version) > 0) {
+				version = fragment.version;
+			}
+		});
 		ss << "]";
-
-		return rooms_.size();
+		return version.value_or(status_.getVersion());
 	}
 
 	size_t getRoomsCount() {
@@ -266,9 +412,10 @@ public:
 	bool setRoomTemporaryTemperature(std::string const &name, int16_t temperature, uint32_t validSeconds) {
 		std::lock_guard<std::mutex> lock(roomsAccessMutex_);
 
-		for (auto &room : rooms_) {
-			if (room->getName() == name) {
-				room->createTemporaryOverride(temperature, validSeconds);
+		for (size_t room = 0; room < rooms_.size(); ++room) {
+			if (rooms_[room]->getName() == name) {
+				rooms_[room]->createTemporaryOverride(temperature, validSeconds);
+				status_.markDirty("room/" + std::to_string(room));
 				return true;
 			}
 		}
@@ -277,23 +424,39 @@ public:
 		return false;
 	}
 
-	void startManualGpioTest(bool boilerState, std::vector<bool> const &valveStates, uint32_t durationSeconds) { boiler_.startManualTest(boilerState, valveStates, durationSeconds); }
+	void startManualGpioTest(bool boilerState, std::vector<bool> const &valveStates, uint32_t durationSeconds) {
+		boiler_.startManualTest(boilerState, valveStates, durationSeconds);
+		status_.markDirty("boiler");
+	}
 
-	void stopManualGpioTest() { boiler_.stopManualTest(); }
+	void stopManualGpioTest() {
+		boiler_.stopManualTest();
+		status_.markDirty("boiler");
+	}
 
-	void getDevicesFound(std::ostream &ss) {
-		std::lock_guard<std::mutex> lock(roomsAccessMutex_);
+	// details - objects with last seen age and RSSI instead of plain addresses
+	void getDevicesFound(std::ostream &ss, bool details = false) {
+		std::lock_guard<std::mutex> lock(devicesMutex_);
 
-		DBGLOGHC("getDevicesFound %zu\n", devicesFound_.size());
+		DBGLOGHC("getDevicesFound %zu evictions: %u\n", devicesFound_.size(), devicesFound_.getEvictions());
 
+		auto now = std::chrono::steady_clock::now();
+		bool first = true;
 		ss << "[";
-		for (auto it = devicesFound_.begin(); it != devicesFound_.end(); ++it) {
-			if (it != devicesFound_.begin()) {
-				ss << ", ";
+		devicesFound_.forEach([&](auto const &device) {
+			ss << (first ? "" : ", ");
+			first = false;
+			if (!details) {
+				ss << "\"" << BLEAddressToString(device.address) << "\"";
+				return;
 			}
-		    #define GETHEX_STR(val) std::hex  << std::setfill('0') << std::setw(2) << (int)val
-			ss << "\"" << GETHEX_STR(it->at(0)) << ':' << GETHEX_STR(it->at(1)) << ':' << GETHEX_STR(it->at(2)) << ':' << GETHEX_STR(it->at(3)) << ':' << GETHEX_STR(it->at(4)) << ':' << GETHEX_STR(it->at(5)) << "\"";
-		}
+			ss << "{\"address\": \"" << BLEAddressToString(device.address) << "\"";
+			ss << ", \"rssi\": " << static_cast<int>(device.rssi);
+			ss << ", \"lastSeenMs\": " << std::chrono::duration_cast<std::chrono::milliseconds>(now - device.lastSeen).count();
+			ss << ", \"advertisements\": " << device.advertisements;
+			ss << ", \"samplesPerHour\": " << (device.intervalMs ? 3600000 / device.intervalMs : 0);
+			ss << ", \"lost\": " << device.lost << "}";
+		});
 		ss << "]";
 	}
 
@@ -302,47 +465,321 @@ public:
 	}
 
 	void waitUntilBluetoothScanFinishAndDeinitBLE() {
+		tempReader_.stopScan();
 		while (tempReader_.isScanPending()) {
 			delay(1);
 		}
 		tempReader_.shutDownBLE();
 	}
 
+	// current and learnt heating curve for preview
+	void getCurveSuggestion(std::ostream &ss) const {
+		auto suggestion = curveLearner_.suggest(boilerConfig_.heatingCurve.heatingCurve, boilerConfig_.heatingCurve.minHeatingCurveTemp, boilerConfig_.heatingCurve.maxHeatingCurveTemp);
+		auto printCurve = [&ss](auto const &curve) {
+			ss << "[";
+			for (size_t i = 0; i < curve.size(); ++i) {
+				ss << (i ? ", " : "") << static_cast<int>(curve[i]);
+			}
+			ss << "]";
+		};
+		ss << "{\"ready\": " << (suggestion.ready ? "true" : "false");
+		ss << ", \"current\": "; printCurve(boilerConfig_.heatingCurve.heatingCurve);
+		ss << ", \"suggested\": "; printCurve(suggestion.curve);
+		ss << ", \"confidence\": "; printCurve(suggestion.confidence);
+		ss << ", \"learner\": "; curveLearner_.getStatus(ss);
+		ss << "}";
+	}
+
+	// controller task - the filesystem is about to be unmounted and overwritten by an image update, nothing is read from
+	// or saved to it until restart. State which would be saved is kept in memory only.
+	void releaseFilesystem() {
+		filesystemReleased_ = true;
+		heating::logger.printf("Filesystem released for update\n");
+	}
+
+	enum class ApplyCurveResult : uint8_t { APPLIED, NOT_READY, SAVE_FAILED };
+
+	// replaces configured heating curve with the learnt one - flow optimizer starts over from the new curve
+	ApplyCurveResult applyLearntCurve() {
+		auto suggestion = curveLearner_.suggest(boilerConfig_.heatingCurve.heatingCurve, boilerConfig_.heatingCurve.minHeatingCurveTemp, boilerConfig_.heatingCurve.maxHeatingCurveTemp);
+		if (!suggestion.ready) {
+			return ApplyCurveResult::NOT_READY;
+		}
+		if (filesystemReleased_ || !config::saveHeatingCurve(suggestion.curve)) {
+			return ApplyCurveResult::SAVE_FAILED;
+		}
+		boilerConfig_.heatingCurve.heatingCurve = suggestion.curve; // REST calls run on the controller task, boiler reads it only from operate()
+		boiler_.setHeatingCurve(suggestion.curve);
+		boiler_.setOptimizerState({});
+		config::saveFlowOptimizerState({});
+		status_.markDirty("boiler");
+		status_.markDirty("curveLearner");
+		heating::logger.printf("Learnt heating curve applied\n");
+		return ApplyCurveResult::APPLIED;
+	}
+
+	// any task - stored configuration is reloaded by the next loop
+	void requestReload() {
+		reloadPending_ = true;
+	}
+
+	// controller task - the program is loaded, from its compiled image when it's current, and the rooms built and indexed
+	// without the rooms lock, which is held only to swap them in. Rooms keep samples and overrides across the reload.
 	void reloadConfiguration() {
-		DBGLOGHC("reloadConfiguration%s\n", "");
-		std::lock_guard<std::mutex> lock(roomsAccessMutex_);
-		currentProgram_ = config::getCurrentProgram();
-		rooms_ = buildRoomsFromConfig();
+		if (filesystemReleased_) {
+			DBGLOGHC("reloadConfiguration skipped, filesystem released\n");
+			return;
+		}
+		auto program = config::getCurrentProgram();
+		auto rooms = buildRooms(program);
+		// samples and overrides are moved out of rooms still published in rooms_ and the sensor index, without the lock.
+		// That relies on this task being the only one reading room state - samples are applied, rooms evaluated and
+		// their status rendered here, other tasks reach rooms only through calls run here.
+		auto carried = carryRoomState(rooms_, rooms);
+		auto index = SensorIndex_t::build(rooms);
+		auto bindKeys = buildBindKeys(rooms, boilerConfig_.outdoor, tempReader_.getBindKeys().get());
+		{
+			std::lock_guard<std::mutex> lock(roomsAccessMutex_);
+			currentProgram_.swap(program);
+			rooms_.swap(rooms);
+		}
+		std::atomic_store(&sensorIndex_, index); // readers keep the previous index until they finish
+		tempReader_.setBindKeys(bindKeys);
+		status_.setSections(buildStatusSections()); // room count may differ
+		DBGLOGHC("reloadConfiguration '%s' rooms: %zu, state carried over: %zu\n", currentProgram_.c_str(), rooms_.size(), carried);
 	}
 
 private:
 
-	void pushTemperatureData(BleAddress_t address, std::optional<int16_t> temperature, std::optional<int16_t> humidity, std::optional<int8_t> battery) {
-		std::lock_guard<std::mutex> lock(roomsAccessMutex_);
+	struct BleSample {
+		BleAddress_t address;
+		int8_t rssi;
+		std::optional<uint8_t> counter;
+		std::optional<int16_t> temperature;
+		std::optional<int16_t> humidity;
+		std::optional<int8_t> battery;
+		std::chrono::steady_clock::time_point received;
+	};
+
+	// called from BLE task - only queues the sample, never blocks the BLE stack
+	void queueSample(BleSample const &sample) {
+		samples_.push(sample);
+	}
 
-		devicesFound_.emplace(address);
+	// called from controller task - applies samples queued by BLE task, at most one queue worth per call
+	size_t applySamples() {
+		size_t count = 0;
+		for (; count < samples_.capacity; ++count) {
+			auto sample = samples_.pop();
+			if (!sample) {
+				break;
+			}
+			pushTemperatureData(*sample);
+		}
+		return count;
+	}
 
-		auto room = std::find_if(std::begin(rooms_), std::end(rooms_), [&adr = address](auto const &room) { return (adr == room->getSensorAddress()); });
-		if (room == std::end(rooms_)) {
-			DBGLOGHC("No room for address '" PRiBleAddress "'\n", PRaBleAddress(address));
+	// "room/<index>" per room so a sample re-renders only the rooms, in the order of the full status document;
+	// renders run on the controller task
+	std::vector<std::pair<std::string, StatusCache::render_t>> buildStatusSections() {
+		std::vector<std::pair<std::string, StatusCache::render_t>> sections;
+		for (size_t room = 0; room < rooms_.size(); ++room) {
+			sections.emplace_back("room/" + std::to_string(room), [this, room](std::ostream &ss) {
+				std::lock_guard<std::mutex> lock(roomsAccessMutex_);
+				if (room < rooms_.size()) {
+					rooms_[room]->getStatus(ss);
+				}
+			});
+		}
+		sections.emplace_back("activeProgram", [this](std::ostream &ss) {
+			std::lock_guard<std::mutex> lock(roomsAccessMutex_);
+			ss << "\"" << currentProgram_ << "\"";
+		});
+		sections.emplace_back("boiler", [this](std::ostream &ss) { boiler_.getStatus(ss); });
+		sections.emplace_back("ems", [this](std::ostream &ss) { ems_.getStatus(ss); });
+		sections.emplace_back("openweather", [this](std::ostream &ss) { openWeather_.getStatus(ss); });
+		sections.emplace_back("openweatherWorker", [this](std::ostream &ss) { openWeather_.getWorkerStatus(ss); });
+		sections.emplace_back("forecast", [this](std::ostream &ss) { openWeather_.getForecastStatus(ss, forecastOutlook_); });
+		sections.emplace_back("outdoor", [this](std::ostream &ss) { outdoor_.getStatus(ss, std::chrono::steady_clock::now()); });
+		sections.emplace_back("ble", [this](std::ostream &ss) { tempReader_.getStatus(ss); });
+		sections.emplace_back("curveLearner", [this](std::ostream &ss) { curveLearner_.getStatus(ss); });
+		sections.emplace_back("zones", [this](std::ostream &ss) { zones_.getStatus(ss); });
+		sections.emplace_back("warmWater", [this](std::ostream &ss) { ss << "{\"program\": "; warmWater_.getStatus(ss); ss << ", \"events\": "; emsMetrics_.getWarmWaterEvents(ss); ss << "}"; });
+		sections.emplace_back("loop", [this](std::ostream &ss) { ss << "{\"period\": "; loopStats_.getStatus(ss); ss << ", \"calls\": "; jobs_.getStatus(ss); ss << "}"; });
+		sections.emplace_back("sampleQueue", [this](std::ostream &ss) {
+			ss << "{\"capacity\": " << samples_.capacity << ", \"size\": " << samples_.size() << ", \"highWaterMark\": " << samples_.getHighWaterMark() << ", \"pushed\": " << samples_.getPushed() << ", \"drops\": " << samples_.getDrops() << "}";
+		});
+		sections.emplace_back("live", [this](std::ostream &ss) { live_.getStatus(ss); });
+		sections.emplace_back("clock", [this](std::ostream &ss) { ss << "{"; getClockStatus(ss); ss << "}"; });
+		return sections;
+	}
+
+	static bool isRoomSection(std::string const &key) {
+		return key.compare(0, 5, "room/") == 0;
+	}
+
+	// members of an object, JSON without its braces or CBOR map without its head and break
+	static std::string_view members(std::string const &object) {
+		return object.size() > 2 ? std::string_view(object).substr(1, object.size() - 2) : std::string_view();
+	}
+
+	// routes through immutable index snapshot, doesn't take rooms mutex and locks only the target room
+	void pushTemperatureData(BleSample const &sample) {
+		auto const &[address, rssi, counter, temperature, humidity, battery, received] = sample;
+		{
+			std::lock_guard<std::mutex> lock(devicesMutex_);
+			devicesFound_.seen(address, rssi, received, counter);
+		}
+
+		bool outdoorBeacon = boilerConfig_.outdoor.bleAddress == address;
+		if (outdoorBeacon && temperature.has_value()) {
+			outdoor_.update(OutdoorTemperature::source_t::ble, {temperature.value(), received});
+		}
+
+		auto index = std::atomic_load(&sensorIndex_);
+		auto routes = index->find(address);
+		if (!routes) {
+			if (!outdoorBeacon) {
+				DBGLOGHC("No room for address '" PRiBleAddress "'\n", PRaBleAddress(address));
+			}
 			return;
 		}
 
-		DBGLOGHC("push '%s', " PRiBleAddress " temp: %d battery: %d%% BTC MinPeekStack: %d\n", (*room)->getName().c_str(), PRaBleAddress(address), temperature.value_or(std::numeric_limits<decltype(temperature)::value_type>::min()), battery.value_or(std::numeric_limits<decltype(battery)::value_type>::min()), uxTaskGetStackHighWaterMark(nullptr));
+		for (auto const &[room, sensor] : *routes) {
+			DBGLOGHC("push '%s', " PRiBleAddress " temp: %d battery: %d%% queued: %lldms\n", room->getName().c_str(), PRaBleAddress(address), temperature.value_or(std::numeric_limits<int16_t>::min()), battery.value_or(std::numeric_limits<int8_t>::min()), static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - received).count()));
+
+			if (temperature.has_value()) {
+				room->storeTemperature(sensor, temperature.value());
+				lastReadTemperatureCounter_.notifyNow();
+			}
+
+			if (humidity.has_value()) {
+				room->storeHumidity(humidity.value());
+			}
 
-		if (temperature.has_value()) {
-			(*room)->storeTemperature(temperature.value());
-			lastReadTemperatureCounter_.notifyNow();
+			if (battery.has_value()) {
+				room->storeBattery(sensor, battery.value());
+			}
 		}
+	}
 
-		if (humidity.has_value()) {
-			(*room)->storeHumidity(humidity.value());
+	void updateFlowOptimizer(FlowTemperatureOptimizer::Feedback feedback) {
+		{
+			ems::EmsBoilerState &boilerState = ems_.getBoilerState();
+			std::lock_guard<std::mutex> lock(boilerState.mutex);
+			if (boilerState.currentFlowTemperature) {
+				feedback.flowTemperature = static_cast<int16_t>(boilerState.currentFlowTemperature.value() * 10);
+			}
+			if (boilerState.returnTemperature) {
+				feedback.returnTemperature = static_cast<int16_t>(boilerState.returnTemperature.value() * 10);
+			}
 		}
 
-		if (battery.has_value()) {
-			(*room)->storeBattery(battery.value());
+		if (auto state = boiler_.updateOptimizer(feedback); state && !filesystemReleased_) {
+			config::saveFlowOptimizerState(state.value());
 		}
+	}
 
+	// time sliced zones - only the served zone gets water, valves shared with it stay as they are
+	void closeInactiveZoneValves(size_t activeZone, std::vector<std::pair<size_t, std::vector<std::string>>> const &zoneValves, std::set<uint8_t> &valvesToClose) const {
+		std::set<uint8_t> activeValves;
+		for (auto const &[zone, valves] : zoneValves) {
+			for (auto const &valve : valves) {
+				auto it = valveLabelMap_.find(valve);
+				if (zone == activeZone && it != valveLabelMap_.end()) {
+					activeValves.insert(it->second);
+				}
+			}
+		}
+		for (auto const &[zone, valves] : zoneValves) {
+			for (auto const &valve : valves) {
+				auto it = valveLabelMap_.find(valve);
+				if (zone != activeZone && it != valveLabelMap_.end() && activeValves.find(it->second) == activeValves.end()) {
+					valvesToClose.insert(it->second);
+				}
+			}
+		}
+	}
+
+	// tank set point from warm water program, boiler is told when it heats warm water instead of rooms
+	void updateWarmWater(bool heatingDemand) {
+		WarmWaterProgram::Inputs inputs;
+		bool charging = false;
+		{
+			ems::EmsBoilerState &boilerState = ems_.getBoilerState();
+			std::lock_guard<std::mutex> lock(boilerState.mutex);
+			charging = boilerState.warmWaterActive.value_or(false);
+			if (boilerState.currentWarmWaterTemperature && boilerState.currentWarmWaterTemperature.value() < 0x8000) { // 0x8000 - no sensor
+				inputs.tankTemperature = static_cast<int16_t>(boilerState.currentWarmWaterTemperature.value() * 10);
+			}
+		}
+		boiler_.setWarmWaterCharging(charging);
+
+		struct tm timeinfo;
+		if (!getLocalTime(&timeinfo)) {
+			return;
+		}
+		inputs.time = timeinfo.tm_hour * 100 + timeinfo.tm_min;
+		inputs.dayOfTheWeek = timeinfo.tm_wday;
+		inputs.date = (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+		inputs.heatingDemand = heatingDemand;
+		auto lastCycle = warmWater_.getLastCycleDate();
+		if (auto target = warmWater_.evaluate(inputs, std::chrono::steady_clock::now())) {
+			ems_.setWarmWater(target->enabled, target->temperature);
+		}
+		if (warmWater_.getLastCycleDate() != lastCycle && !filesystemReleased_) {
+			config::saveWarmWaterLastCycleDate(warmWater_.getLastCycleDate().value());
+		}
+	}
+
+	// shifts the heating curve towards the outdoor temperature of the coming hours
+	void updateForecastOutlook() {
+		forecastOutlook_ = {};
+		struct tm timeinfo;
+		auto outdoor = readOutdoorTemperature();
+		if (outdoor && getLocalTime(&timeinfo, 0)) {
+			forecastOutlook_ = openWeather_.getOutlook(static_cast<uint32_t>(time(nullptr)), outdoor.value());
+		}
+		boiler_.setOutdoorAdjustment(forecastOutlook_.valid ? forecastOutlook_.adjustment : 0);
+	}
+
+	void updateCurveLearner(HeatingCurveLearner::Observation observation) {
+		auto outdoor = readOutdoorTemperature();
+		if (!outdoor) {
+			return;
+		}
+		observation.outdoorTemperature = outdoor.value();
+		observation.flowTemperature = boiler_.getCurrentHeatingTemperature();
+		observation.heating = observation.flowTemperature.has_value();
+
+		auto now = std::chrono::steady_clock::now();
+		curveLearner_.add(observation, now);
+		if (!filesystemReleased_ && curveLearner_.getWindows() != persistedCurveLearnerWindows_ && (!lastCurveLearnerPersist_ || now - *lastCurveLearnerPersist_ >= curveLearnerPersistInterval)) {
+			config::saveCurveLearnerState(curveLearner_.getState());
+			persistedCurveLearnerWindows_ = curveLearner_.getWindows();
+			lastCurveLearnerPersist_ = now;
+		}
+	}
+
+	// keep valves open if heating will be needed before actuators manage to open
+	bool shouldPreopenValves(Room const &room) const {
+		if (!boilerConfig_.boiler.valvePreopen) {
+			return false;
+		}
+
+		std::chrono::seconds lead{0};
+		for (auto const &valve : room.getValves()) {
+			auto it = valveLabelMap_.find(valve);
+			if (it != valveLabelMap_.end()) {
+				lead = std::max(lead, boiler_.getValveOpenTime(it->second));
+			}
+		}
+
+		if (!room.isHeatingScheduledWithin(lead)) {
+			return false;
+		}
+		DBGLOGHC("  pre-opening valves for room %s\n", room.getName().c_str());
+		return true;
 	}
 
 	void resetIfNoDataForLongTime() {
@@ -352,71 +789,122 @@ private:
 		}
 	}
 
-	int16_t getOutdoorTemperature() {
-		static constexpr int16_t outdoorTemperatureIfInvalidRead = -2000;
-
-		std::optional<int16_t> temp;
-
-		if (boilerConfig_.boiler.outdoorSensor == config::BoilerConfig::outdoorSensor_t::openweather) {
-			temp = openWeather_.getTemperature();
-		} else if (boilerConfig_.boiler.outdoorSensor == config::BoilerConfig::outdoorSensor_t::ems) {
+	// sources are polled once per cycle, the merged value is read from cache everywhere else
+	void updateOutdoorTemperature() {
+		if (auto reading = openWeather_.getTemperature()) {
+			outdoor_.update(OutdoorTemperature::source_t::openweather, reading.value());
+		}
+		{
 			ems::EmsBoilerState &boilerState = ems_.getBoilerState();
 			std::lock_guard<std::mutex> lock(boilerState.mutex);
-			temp = boilerState.outdoorTemperature ;
-		} else {
-			// no temp sensor
+			if (boilerState.outdoorTemperature) {
+				outdoor_.update(OutdoorTemperature::source_t::ems, {boilerState.outdoorTemperature.value(), boilerState.outdoorTemperatureReceived});
+			}
 		}
+		outdoor_.evaluate(std::chrono::steady_clock::now());
+		if (!outdoor_.get()) {
+			DBGLOGHC("Outdoor temperature is invalid. Using fallback %d\n", outdoor_.getTemperature());
+		}
+	}
 
-		if (!temp.has_value()) { // try to get any valid temperature
-			DBGLOGHC("Outdoor temperature is invalid. Trying to get it from OpenWeather or EMS\n", "");
-			auto owtemp = openWeather_.getTemperature();
+	int16_t getOutdoorTemperature() const {
+		return outdoor_.getTemperature();
+	}
 
-			ems::EmsBoilerState &boilerState = ems_.getBoilerState();
-			std::lock_guard<std::mutex> lock(boilerState.mutex);
+	std::optional<int16_t> readOutdoorTemperature() const {
+		return outdoor_.get();
+	}
 
-			temp = owtemp.has_value() ? owtemp : boilerState.outdoorTemperature;
-		}
+	using SensorIndex_t = SensorIndex<heating::Room>;
 
-		if (!temp.has_value()) {
-			DBGLOGHC("Outdoor temperature is invalid. Setting to -20C\n", "");
-			return outdoorTemperatureIfInvalidRead;
-		} else {
-			return temp.value();
+	// key schedules are expanded here, once per sensor, not on the BLE callback path
+	static std::shared_ptr<BindKeys> buildBindKeys(std::vector<std::shared_ptr<heating::Room>> const &rooms, OutdoorTemperatureConfig const &outdoor, BindKeys const *previous) {
+		std::vector<std::pair<BleAddress_t, BindKeys::Key_t>> keys;
+		if (outdoor.bleAddress && outdoor.bleKey) {
+			keys.emplace_back(outdoor.bleAddress.value(), outdoor.bleKey.value());
 		}
+		for (auto const &room : rooms) {
+			for (auto const &sensor : room->getSensors()) {
+				bool known = std::any_of(keys.begin(), keys.end(), [&sensor](auto const &key) { return key.first == sensor.address_; });
+				if (sensor.bindKey_ && !known) {
+					keys.emplace_back(sensor.address_, *sensor.bindKey_);
+				}
+			}
+		}
+		return std::make_shared<BindKeys>(keys, previous);
 	}
 
-	std::vector<std::shared_ptr<heating::Room>> buildRoomsFromConfig() {
-		auto configs = config::getRoomsConfig(currentProgram_);
+	static std::vector<std::shared_ptr<heating::Room>> buildRooms(std::string const &program) {
+		auto configs = config::getRoomsConfig(program);
 		std::vector<std::shared_ptr<heating::Room>> rooms;
-		for (const auto config : configs) {
+		for (auto &config : configs) {
 			rooms.emplace_back(std::make_shared<heating::Room>(std::move(config)));
 		}
 		return rooms;
 	}
 
+	// matched by name, a room renamed or added starts without samples
+	static size_t carryRoomState(std::vector<std::shared_ptr<heating::Room>> const &previous, std::vector<std::shared_ptr<heating::Room>> const &rooms) {
+		std::vector<bool> taken(previous.size());
+		size_t carried = 0;
+		for (auto const &room : rooms) {
+			for (size_t i = 0; i < previous.size(); ++i) {
+				if (!taken[i] && previous[i]->getName() == room->getName()) {
+					room->carryStateFrom(*previous[i]);
+					taken[i] = true;
+					carried++;
+					break;
+				}
+			}
+		}
+		return carried;
+	}
+
 	std::atomic_bool bluetoothScan_;
-	BeaconTemperatureReader tempReader_{[this](BleAddress_t address, std::optional<int16_t> temperature, std::optional<int16_t> humidity, std::optional<int8_t> battery) { pushTemperatureData(std::move(address), temperature, humidity, battery); }};
+	std::atomic_bool reloadPending_{false};
+	bool filesystemReleased_ = false; // controller task only - set for a filesystem image update, holds until restart
+	SampleQueue<BleSample, 32> samples_; // BLE task -> controller task
+	ControllerJobs jobs_;                // REST workers -> controller task
+	LoopStats loopStats_;
+	StatusCache status_{esp_random() >> 1}; // first version per boot
+	LiveStatus live_{status_, {"room/", "activeProgram", "boiler", "ems", "openweather", "clock"}, esp_random()}; // epoch per boot
+	BeaconTemperatureReader tempReader_{[this](BleAddress_t address, int8_t rssi, std::optional<uint8_t> counter, std::optional<int16_t> temperature, std::optional<int16_t> humidity, std::optional<int8_t> battery) { queueSample({address, rssi, counter, temperature, humidity, battery, std::chrono::steady_clock::now()}); }};
 	OpenWeather openWeather_;
+	ForecastOutlook forecastOutlook_;
 	ems::EmsController ems_;
 	config::BoilerConfig boilerConfig_{config::getBoilerConfig()};
+	OutdoorTemperature outdoor_{boilerConfig_.outdoor}; // controller task only
 
 	PcfDeviceMap pcfDevices_{buildPcfDeviceMap()};
 	BoilerController boiler_{boilerConfig_, [this]() { return getOutdoorTemperature(); }, [&ems = ems_](bool enabled, uint8_t flowTempSet) {
 			ems.changeBoilerState(enabled, flowTempSet); }, [&ems = ems_](uint8_t heatingTemperature) {
-			ems.setHeatingTemperature(heatingTemperature); }, createBoilerPort(pcfDevices_), createValvePorts(pcfDevices_), createValveLabels()};
+			ems.setHeatingTemperature(heatingTemperature); }, createBoilerPort(pcfDevices_), createValvePorts(pcfDevices_), createValveLabels(), createValveActuators()};
 	std::string currentProgram_;
 	std::vector<std::shared_ptr<heating::Room>> rooms_;
+	std::shared_ptr<const SensorIndex_t> sensorIndex_; // swapped atomically
 	std::unordered_map<std::string, uint8_t> valveLabelMap_{buildValveLabelMap()};
 	ib::PeriodicCounter lastReadTemperatureCounter_{5 * 60 * 1000}; // 5 mins in ms
-	BeaconTemperatureReader::BleDevices_t devicesFound_;
+	DeviceTable<64> devicesFound_;
+	std::mutex devicesMutex_;
 	mutable std::mutex roomsAccessMutex_;
 
+	static constexpr std::chrono::hours curveLearnerPersistInterval{1}; // limits flash writes
+	HeatingCurveLearner curveLearner_;
+	uint32_t persistedCurveLearnerWindows_ = 0;
+	std::optional<std::chrono::steady_clock::time_point> lastCurveLearnerPersist_;
+
+	WarmWaterProgram warmWater_{boilerConfig_.warmWater};
+	ZoneAggregator zones_{boilerConfig_.zones};
+
 	ems::EmsMetrics emsMetrics_{[this](uint16_t telegramId, std::function<void(heating::ems::EmsTelegram const &)> processor) { ems_.registerTelegramProcessor(telegramId, processor); }};
 
 	MQTT mqtt_{
 		[this]() {return getRoomsCount();},
-		[this](std::ostream &ss) { getRoomsStatus(ss);},
-		[this](std::ostream &ss) { emsMetrics_.getMetrics(ss);}
+		[this](std::ostream &ss) { refreshStatus(); getRoomsStatus(ss);},
+		[this](std::ostream &ss) { emsMetrics_.getMetrics(ss);},
+		[this](std::ostream &ss) { zones_.getStatus(ss);},
+		boilerConfig_.outdoor.mqttTopic,
+		[this](int16_t temperature) { outdoor_.update(OutdoorTemperature::source_t::mqtt, {temperature, std::chrono::steady_clock::now()}); }
 		};
 };
 
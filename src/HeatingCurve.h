@@ -1,16 +1,24 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
 
 namespace heating {
 
+/// Outdoor axis of the configured heating curve, °C
+inline constexpr std::array<int8_t, 9> defaultOutdoorAxis{20, 15, 10, 5, 0, -5, -10, -15, -20};
+
 /// Pure heating curve interpolation — no hardware dependencies.
+/// Reference implementation - evaluates the curve from scratch on every call, use CompiledHeatingCurve for repeated evaluation.
 /// @param outdoorTemperature  outdoor temp in 1/100 °C (e.g. 570 = 5.7 °C)
 /// @param heatingCurve        9-element array of heating temps in °C for outdoor axis [20,15,10,5,0,-5,-10,-15,-20]
 /// @return heating temperature in 1/100 °C
 inline int16_t calcHeatingTemperature(int16_t outdoorTemperature, std::array<uint8_t, 9> const &heatingCurve) {
-	static constexpr std::array<int8_t, 9> hcOutdoorAxis{20, 15, 10, 5, 0, -5, -10, -15, -20};
+	static constexpr auto &hcOutdoorAxis = defaultOutdoorAxis;
 
 	for (size_t idx = 0; idx < hcOutdoorAxis.size(); ++idx) {
 		if (hcOutdoorAxis[idx] * 100 <= outdoorTemperature) {
@@ -28,4 +36,79 @@ inline int16_t calcHeatingTemperature(int16_t outdoorTemperature, std::array<uin
 	return heatingCurve[8] * 100;
 }
 
+/// Heating curve compiled once into fixed-point segments. Evaluation clamps the outdoor temperature to the axis,
+/// finds the segment by division - buckets as wide as the greatest common spacing of the axis, so a uniform axis maps
+/// bucket to segment 1:1 and any other axis through a small table - and interpolates in integers. No search, no floats.
+/// @tparam Points  number of curve points, at least 2
+template <size_t Points>
+class CompiledHeatingCurve {
+	static_assert(Points >= 2 && Points <= 256, "Heating curve needs 2 - 256 points");
+
+public:
+	using Axis_t = std::array<int8_t, Points>;   // outdoor temperatures in °C, strictly descending
+	using Curve_t = std::array<uint8_t, Points>; // heating temperatures in °C
+
+	/// @throws std::invalid_argument when axis isn't strictly descending
+	CompiledHeatingCurve(Curve_t const &curve, Axis_t const &axis) : curve_(curve), axis_(axis) {
+		int32_t spacing = 0;
+		for (size_t i = 1; i < Points; ++i) {
+			int32_t width = axis[i - 1] - axis[i];
+			if (width <= 0) {
+				throw std::invalid_argument("Heating curve axis must be strictly descending");
+			}
+			spacing = std::gcd(spacing, width);
+		}
+
+		high_ = axis.front() * 100;
+		low_ = axis.back() * 100;
+		bucketWidth_ = spacing * 100;
+
+		for (size_t i = 0; i + 1 < Points; ++i) {
+			int32_t x0 = axis[i] * 100;
+			int32_t dx = (axis[i] - axis[i + 1]) * 100;
+			int32_t dy = (curve[i + 1] - curve[i]) * 100;
+			int64_t scaled = static_cast<int64_t>(dy) * (int64_t{1} << fraction);
+			segments_[i] = Segment{static_cast<int16_t>(x0), static_cast<int16_t>(curve[i] * 100), static_cast<int32_t>((scaled + (scaled >= 0 ? dx / 2 : -dx / 2)) / dx)};
+			for (int32_t bucket = 0; bucket < dx / bucketWidth_; ++bucket) {
+				bucketSegment_.push_back(static_cast<uint8_t>(i));
+			}
+		}
+	}
+
+	/// @param outdoorTemperature  1/100 °C
+	/// @return heating temperature in 1/100 °C
+	int16_t operator()(int16_t outdoorTemperature) const {
+		int32_t x = std::clamp<int32_t>(outdoorTemperature, low_, high_);
+		size_t bucket = std::min<size_t>(static_cast<size_t>((high_ - x) / bucketWidth_), bucketSegment_.size() - 1);
+		auto const &segment = segments_[bucketSegment_[bucket]];
+		int64_t delta = static_cast<int64_t>(segment.slope) * (segment.x0 - x);
+		return static_cast<int16_t>(segment.y0 + ((delta + (int64_t{1} << (fraction - 1))) >> fraction));
+	}
+
+	Curve_t const &getCurve() const { return curve_; }
+	Axis_t const &getAxis() const { return axis_; }
+
+private:
+	static constexpr int fraction = 16; // slope fixed point bits
+
+	struct Segment {
+		int16_t x0;    // warmer end, 1/100 °C
+		int16_t y0;    // heating temperature at x0, 1/100 °C
+		int32_t slope; // heating temperature increase per 1/100 °C colder, Q16
+	};
+
+	Curve_t curve_;
+	Axis_t axis_;
+	std::array<Segment, Points - 1> segments_{};
+	std::vector<uint8_t> bucketSegment_;
+	int32_t high_ = 0;
+	int32_t low_ = 0;
+	int32_t bucketWidth_ = 1;
+};
+
+/// configured 9 point curve on the default outdoor axis
+inline CompiledHeatingCurve<9> compileHeatingCurve(std::array<uint8_t, 9> const &heatingCurve) {
+	return CompiledHeatingCurve<9>(heatingCurve, defaultOutdoorAxis);
+}
+
 }
@@ -0,0 +1,308 @@
+#pragma once
+
+#include "HeatingCurve.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+
+namespace heating {
+
+// Learnt flow temperature required to hold the rooms around each point of the heating curve outdoor axis.
+// Weighted sums of a local line - outdoor temperature relative to the point and required flow, both in °C.
+struct CurveLearnerState {
+	struct Point {
+		float weight = 0; // windows, fades with new evidence
+		float x = 0;
+		float y = 0;
+		float xx = 0;
+		float xy = 0;
+	};
+	std::array<Point, 9> points{};
+};
+
+// Fits heating curve from history. Every call accumulates one controller tick - outdoor temperature, whether rooms
+// demanded heat, flow temperature used and how the demanding rooms did - so the work per tick is constant. At the end
+// of each window the flow temperature which would have held the rooms without cycling is estimated:
+//  - boiler cycled: rooms needed only part of emitter output, scale flow - room difference by the duty
+//  - boiler ran the whole window and rooms stayed below set point: scale it by heat loss ratio (set point vs reached
+//    temperature against outdoor)
+// Emitter output grows with the temperature difference to power of emitterExponent. Every estimate updates a local
+// line at the two neighbouring curve points, so points at the edge of the weather seen aren't pulled towards its
+// middle. Old evidence fades, so the curve follows the house through the season. A suggestion is built only on request.
+class HeatingCurveLearner {
+public:
+	using clock_t = std::chrono::steady_clock;
+	using Curve_t = std::array<uint8_t, 9>;
+
+	static constexpr auto &outdoorAxis = defaultOutdoorAxis;
+	static constexpr std::chrono::seconds window{3600};
+	static constexpr std::chrono::seconds maxTick{60};  // longer gap between calls (e.g. OTA, reboot) isn't counted
+	static constexpr int16_t roomReference = 2000;      // room set point if rooms don't report one, 1/100 °C
+	static constexpr int16_t maxOutdoorSpread = 300;    // window with more outdoor temperature change is discarded
+	static constexpr int16_t targetGainRate = 50;       // 1/100 °C per hour, same meaning as in flow optimizer
+	static constexpr float emitterExponent = 1.2f;      // between underfloor (1.1) and radiators (1.3)
+	static constexpr float trustedWeight = 3;           // windows
+	static constexpr float maxWeight = 24;              // exponential forgetting - about a day of windows per point
+	static constexpr float maxRaise = 15;               // °C, single window estimate above flow used
+
+	struct Observation {
+		int16_t outdoorTemperature;                // 1/100 °C
+		bool heating = false;                      // rooms demand heat and boiler runs
+		std::optional<int16_t> flowTemperature;   // flow temperature set while heating, 1/100 °C
+		std::optional<int16_t> gainRate;          // mean gain of demanding rooms, 1/100 °C per hour
+		std::optional<int16_t> roomTemperature;   // mean of demanding rooms, 1/100 °C
+		std::optional<int16_t> roomSet;           // their mean set point
+	};
+
+	struct Suggestion {
+		Curve_t curve;
+		std::array<uint8_t, 9> confidence; // % - 0 point taken from the fitted line or current curve
+		bool ready = false;                // at least two points trusted
+	};
+
+	explicit HeatingCurveLearner(CurveLearnerState const &state = {}) : state_(state) {}
+
+	void add(Observation const &observation, clock_t::time_point now) {
+		if (!lastTick_) {
+			lastTick_ = now;
+			windowStart_ = now;
+			return;
+		}
+		auto tick = std::min<clock_t::duration>(now - *lastTick_, maxTick);
+		lastTick_ = now;
+		int64_t seconds = std::chrono::duration_cast<std::chrono::seconds>(tick).count();
+		if (seconds <= 0) {
+			return;
+		}
+
+		window_.seconds += seconds;
+		window_.outdoorSum += static_cast<int64_t>(observation.outdoorTemperature) * seconds;
+		window_.outdoorMin = std::min(window_.outdoorMin, observation.outdoorTemperature);
+		window_.outdoorMax = std::max(window_.outdoorMax, observation.outdoorTemperature);
+		if (observation.heating && observation.flowTemperature) {
+			window_.heatingSeconds += seconds;
+			window_.flowSum += static_cast<int64_t>(*observation.flowTemperature) * seconds;
+			if (observation.gainRate) {
+				window_.gainSum += *observation.gainRate;
+				window_.gains++;
+			}
+			if (observation.roomTemperature && observation.roomSet) {
+				window_.roomSum += *observation.roomTemperature;
+				window_.setSum += *observation.roomSet;
+				window_.rooms++;
+			}
+		}
+
+		if (now - windowStart_ >= window) {
+			closeWindow();
+			windowStart_ = now;
+		}
+	}
+
+	// learnt flow temperature at curve point, °C. Local slope is pulled towards the prior (flow °C per outdoor °C,
+	// e.g. of the current curve) when the weather seen around the point doesn't spread enough to tell it.
+	std::optional<float> getPointFlow(size_t point, float priorSlope) const {
+		auto const &p = state_.points[point];
+		if (p.weight <= 0) {
+			return std::nullopt;
+		}
+		float meanX = p.x / p.weight;
+		float meanY = p.y / p.weight;
+		float variance = std::max(p.xx / p.weight - meanX * meanX, 0.0f);
+		float covariance = p.xy / p.weight - meanX * meanY;
+		float slope = std::clamp((covariance + priorVariance * priorSlope) / (variance + priorVariance), minSlope, 0.0f);
+		return meanY - slope * meanX;
+	}
+
+	// slope of the curve around a point, flow °C per outdoor °C
+	static float getCurveSlope(Curve_t const &curve, size_t point) {
+		size_t warmer = point > 0 ? point - 1 : point;
+		size_t colder = point + 1 < curve.size() ? point + 1 : point;
+		return static_cast<float>(curve[warmer] - curve[colder]) / (outdoorAxis[warmer] - outdoorAxis[colder]);
+	}
+
+	Suggestion suggest(Curve_t const &current, uint8_t minTemperature, uint8_t maxTemperature) const {
+		std::array<std::optional<float>, 9> learnt;
+		for (size_t i = 0; i < learnt.size(); ++i) {
+			learnt[i] = getPointFlow(i, getCurveSlope(current, i));
+		}
+
+		// weighted line through learnt points - fills points where the weather hasn't been yet
+		double sumW = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+		size_t trusted = 0;
+		for (size_t i = 0; i < outdoorAxis.size(); ++i) {
+			if (!learnt[i]) {
+				continue;
+			}
+			double w = state_.points[i].weight;
+			trusted += w >= trustedWeight ? 1 : 0;
+			sumW += w;
+			sumX += w * outdoorAxis[i];
+			sumY += w * *learnt[i];
+			sumXX += w * outdoorAxis[i] * outdoorAxis[i];
+			sumXY += w * outdoorAxis[i] * *learnt[i];
+		}
+		double denominator = sumW * sumXX - sumX * sumX;
+		bool line = sumW > 0 && denominator > 1e-6 * sumW * sumW;
+		double slope = line ? (sumW * sumXY - sumX * sumY) / denominator : 0;
+		double intercept = line ? (sumY - slope * sumX) / sumW : 0;
+		if (line && slope > 0) { // warmer outside never needs hotter flow - noise, don't extrapolate it
+			line = false;
+		}
+
+		// single learnt region - keep shape of the current curve, move it there
+		double shift = 0;
+		if (!line && sumW > 0) {
+			for (size_t i = 0; i < outdoorAxis.size(); ++i) {
+				if (learnt[i]) {
+					shift += state_.points[i].weight * (*learnt[i] - current[i]);
+				}
+			}
+			shift /= sumW;
+		}
+
+		Suggestion suggestion;
+		suggestion.ready = trusted >= 2;
+		int32_t previous = 0;
+		for (size_t i = 0; i < outdoorAxis.size(); ++i) {
+			double fallback = line ? intercept + slope * outdoorAxis[i] : current[i] + shift;
+			double confidence = learnt[i] ? std::min(state_.points[i].weight, trustedWeight) / trustedWeight : 0.0;
+			double flow = confidence * learnt[i].value_or(0) + (1 - confidence) * fallback;
+
+			auto value = static_cast<int32_t>(std::lround(flow));
+			value = std::max(value, previous); // colder outside never needs cooler flow
+			if (minTemperature < maxTemperature) {
+				value = std::clamp<int32_t>(value, minTemperature, maxTemperature);
+			}
+			value = std::clamp<int32_t>(value, 0, UINT8_MAX);
+			previous = value;
+
+			suggestion.curve[i] = static_cast<uint8_t>(value);
+			suggestion.confidence[i] = static_cast<uint8_t>(std::lround(confidence * 100));
+		}
+		return suggestion;
+	}
+
+	CurveLearnerState const &getState() const { return state_; }
+	uint32_t getWindows() const { return windows_; }
+
+	void getStatus(std::ostream &ss) const {
+		ss << "{\"windows\": " << windows_ << ", \"discarded\": " << discarded_ << ", \"points\": [";
+		for (size_t i = 0; i < outdoorAxis.size(); ++i) {
+			auto const &p = state_.points[i];
+			ss << (i ? ", " : "") << "{\"outdoor\": " << static_cast<int>(outdoorAxis[i]) << ", \"weight\": " << p.weight;
+			if (p.weight > 0) {
+				ss << ", \"meanOutdoor\": " << outdoorAxis[i] + p.x / p.weight << ", \"meanFlow\": " << p.y / p.weight;
+			}
+			ss << "}";
+		}
+		ss << "]}";
+	}
+
+private:
+	static constexpr float priorVariance = 1.0f; // °C² of outdoor temperature spread the prior slope is worth
+	static constexpr float minSlope = -4.0f;   // flow °C per outdoor °C
+
+	struct Window {
+		int64_t seconds = 0;
+		int64_t heatingSeconds = 0;
+		int64_t outdoorSum = 0;
+		int64_t flowSum = 0;
+		int32_t gainSum = 0;
+		uint32_t gains = 0;
+		int32_t roomSum = 0;
+		int32_t setSum = 0;
+		uint32_t rooms = 0;
+		int16_t outdoorMin = INT16_MAX;
+		int16_t outdoorMax = INT16_MIN;
+	};
+
+	void closeWindow() {
+		auto window = window_;
+		window_ = {};
+
+		if (window.seconds == 0 || window.heatingSeconds == 0 || window.outdoorMax - window.outdoorMin > maxOutdoorSpread) {
+			discarded_++;
+			return;
+		}
+		float outdoor = window.outdoorSum / static_cast<float>(window.seconds) / 100;
+		float flow = window.flowSum / static_cast<float>(window.heatingSeconds) / 100;
+		float set = (window.rooms ? window.setSum / static_cast<float>(window.rooms) : roomReference) / 100;
+		std::optional<float> gainRate;
+		if (window.gains) {
+			gainRate = window.gainSum / static_cast<float>(window.gains);
+		}
+
+		float required;
+		if (window.heatingSeconds * 10 < window.seconds * 9) { // cycling
+			float duty = window.heatingSeconds / static_cast<float>(window.seconds);
+			required = set + std::pow(duty, 1 / emitterExponent) * (flow - set);
+		} else if (window.rooms) {
+			float room = window.roomSum / static_cast<float>(window.rooms) / 100;
+			if (gainRate.value_or(0) > targetGainRate || room - outdoor < 5) { // warming up after set back - not steady
+				discarded_++;
+				return;
+			}
+			float lossRatio = std::max(set - outdoor, 0.0f) / (room - outdoor);
+			required = set + std::pow(lossRatio, 1 / emitterExponent) * std::max(flow - room, 0.0f);
+		} else {
+			required = flow;
+			if (gainRate && *gainRate < targetGainRate) {
+				required += (targetGainRate - *gainRate) * 2 / 100;
+			}
+		}
+		learn(outdoor, std::clamp(required, set, flow + maxRaise));
+		windows_++;
+	}
+
+	void learn(float outdoor, float required) {
+		if (outdoor >= outdoorAxis.front()) {
+			learnPoint(0, outdoor, required, 1);
+			return;
+		}
+		for (size_t i = 1; i < outdoorAxis.size(); ++i) {
+			if (outdoor >= outdoorAxis[i]) {
+				float warmer = (outdoor - outdoorAxis[i]) / (outdoorAxis[i - 1] - outdoorAxis[i]);
+				learnPoint(i - 1, outdoor, required, warmer);
+				learnPoint(i, outdoor, required, 1 - warmer);
+				return;
+			}
+		}
+		learnPoint(outdoorAxis.size() - 1, outdoor, required, 1);
+	}
+
+	void learnPoint(size_t point, float outdoor, float required, float weight) {
+		if (weight <= 0) {
+			return;
+		}
+		auto &p = state_.points[point];
+		float x = outdoor - outdoorAxis[point];
+		p.weight += weight;
+		p.x += weight * x;
+		p.y += weight * required;
+		p.xx += weight * x * x;
+		p.xy += weight * x * required;
+		if (p.weight > maxWeight) {
+			float scale = maxWeight / p.weight;
+			p.weight = maxWeight;
+			p.x *= scale;
+			p.y *= scale;
+			p.xx *= scale;
+			p.xy *= scale;
+		}
+	}
+
+	CurveLearnerState state_;
+	Window window_;
+	std::optional<clock_t::time_point> lastTick_;
+	clock_t::time_point windowStart_;
+	uint32_t windows_ = 0;
+	uint32_t discarded_ = 0;
+};
+
+} // namespace heating
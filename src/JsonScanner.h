@@ -0,0 +1,279 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace heating {
+
+// Incremental JSON tokenizer for responses read straight from the network. Input comes in chunks of any size, only the
+// key path of the current value is kept - a short key per nesting level - and each scalar is handed to the parser once
+// it's complete, so memory use is fixed and nothing is allocated. cJSON needs the whole document and its tree in memory.
+// Derived parser implements:
+//   void onOpen();                                    // object or array opened, depth() includes it
+//   void onClose();                                   // object or array about to close, depth() still includes it
+//   void onValue(std::string_view value, bool string); // member scalar, null terminated; strings unescaped and cut to maxValue bytes
+//   void onElement(std::string_view value, bool string); // optional, array element scalar, same as onValue
+//   static constexpr bool rejectLongValues = true;       // optional, a string over maxValue bytes fails the document instead
+template <typename Derived, size_t MaxDepth = 6, size_t MaxKey = 15, size_t MaxValue = 47>
+class JsonScanner {
+public:
+	static constexpr size_t maxKey = MaxKey;
+	static constexpr size_t maxValue = MaxValue;
+
+	void reset() {
+		depth_ = 0;
+		expectKey_ = false;
+		capturingKey_ = false;
+		state_ = state_t::value;
+		valueLength_ = 0;
+		highSurrogate_ = 0;
+		error_ = false;
+		started_ = false;
+	}
+
+	void feed(char const *data, size_t length) {
+		for (size_t i = 0; i < length && !error_; ++i) {
+			feed(data[i]);
+		}
+	}
+
+	// true when one complete document was read
+	bool finish() {
+		endScalar();
+		return !error_ && started_ && depth_ == 0 && state_ == state_t::value;
+	}
+
+protected:
+	// nesting depth, the root object is level 0
+	size_t depth() const { return depth_; }
+	bool isArray(size_t level) const { return levels_[level].array; }
+	// key of the current member at given level
+	bool keyIs(size_t level, std::string_view key) const { return level < MaxDepth && !levels_[level].keyTruncated && key == levels_[level].key; }
+
+	void onElement(std::string_view, bool) {}
+	static constexpr bool rejectLongValues = false;
+
+private:
+	enum class state_t : uint8_t { value, string, escape, unicode };
+
+	struct Level {
+		bool array = false;
+		char key[maxKey + 1] = {};
+		bool keyTruncated = false;
+	};
+
+	Derived &derived() { return static_cast<Derived &>(*this); }
+
+	void feed(char c) {
+		if (state_ == state_t::escape) {
+			escape(c);
+			return;
+		}
+		if (state_ == state_t::unicode) {
+			unicode(c);
+			return;
+		}
+		if (state_ == state_t::string) {
+			if (c == '\\') {
+				state_ = state_t::escape;
+			} else if (c == '"') {
+				state_ = state_t::value;
+				if (!capturingKey_ && isTracked()) {
+					deliver(valueLength_, true);
+				}
+				capturingKey_ = false;
+				valueLength_ = 0;
+			} else {
+				appendString(c);
+			}
+			return;
+		}
+
+		switch (c) {
+		case '{':
+		case '[':
+			endScalar();
+			push(c == '[');
+			break;
+		case '}':
+		case ']':
+			endScalar();
+			pop();
+			break;
+		case ',':
+			endScalar();
+			expectKey_ = isTracked() && !levels_[depth_ - 1].array;
+			break;
+		case ':':
+			expectKey_ = false;
+			break;
+		case '"':
+			endScalar();
+			state_ = state_t::string;
+			valueLength_ = 0;
+			capturingKey_ = expectKey_ && isTracked();
+			if (capturingKey_) {
+				auto &level = levels_[depth_ - 1];
+				level.key[0] = '\0';
+				level.keyTruncated = false;
+			}
+			break;
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			endScalar();
+			break;
+		default:
+			if (valueLength_ == maxValue) {
+				error_ = true; // no number is this long
+				return;
+			}
+			value_[valueLength_++] = c;
+			break;
+		}
+	}
+
+	bool isTracked() const { return depth_ > 0 && depth_ <= MaxDepth; }
+
+	void escape(char c) {
+		state_ = state_t::string;
+		switch (c) {
+		case 'b': appendString('\b'); break;
+		case 'f': appendString('\f'); break;
+		case 'n': appendString('\n'); break;
+		case 'r': appendString('\r'); break;
+		case 't': appendString('\t'); break;
+		case 'u':
+			state_ = state_t::unicode;
+			unicodeDigits_ = 0;
+			codePoint_ = 0;
+			break;
+		default: appendString(c); break; // \" \\ \/
+		}
+	}
+
+	// \uXXXX, a surrogate pair is two of them
+	void unicode(char c) {
+		uint32_t digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			error_ = true;
+			return;
+		}
+		codePoint_ = codePoint_ << 4 | digit;
+		if (++unicodeDigits_ < 4) {
+			return;
+		}
+		state_ = state_t::string;
+		if (codePoint_ >= 0xd800 && codePoint_ < 0xdc00) {
+			highSurrogate_ = static_cast<uint16_t>(codePoint_); // low half follows as the next escape
+			return;
+		}
+		if (codePoint_ >= 0xdc00 && codePoint_ < 0xe000 && highSurrogate_) {
+			codePoint_ = 0x10000 + ((highSurrogate_ - 0xd800u) << 10) + (codePoint_ - 0xdc00);
+		}
+		highSurrogate_ = 0;
+		appendUtf8(codePoint_);
+	}
+
+	void appendUtf8(uint32_t codePoint) {
+		if (codePoint < 0x80) {
+			appendString(static_cast<char>(codePoint));
+		} else if (codePoint < 0x800) {
+			appendString(static_cast<char>(0xc0 | codePoint >> 6));
+			appendString(static_cast<char>(0x80 | (codePoint & 0x3f)));
+		} else if (codePoint < 0x10000) {
+			appendString(static_cast<char>(0xe0 | codePoint >> 12));
+			appendString(static_cast<char>(0x80 | (codePoint >> 6 & 0x3f)));
+			appendString(static_cast<char>(0x80 | (codePoint & 0x3f)));
+		} else {
+			appendString(static_cast<char>(0xf0 | codePoint >> 18));
+			appendString(static_cast<char>(0x80 | (codePoint >> 12 & 0x3f)));
+			appendString(static_cast<char>(0x80 | (codePoint >> 6 & 0x3f)));
+			appendString(static_cast<char>(0x80 | (codePoint & 0x3f)));
+		}
+	}
+
+	void appendString(char c) {
+		if (capturingKey_) {
+			auto &level = levels_[depth_ - 1];
+			if (valueLength_ == maxKey) {
+				level.keyTruncated = true;
+				return;
+			}
+			level.key[valueLength_++] = c;
+			level.key[valueLength_] = '\0';
+		} else if (valueLength_ < maxValue) {
+			value_[valueLength_++] = c;
+		} else if (Derived::rejectLongValues && isTracked()) {
+			error_ = true;
+		}
+	}
+
+	void push(bool array) {
+		if (depth_ == 0 && started_) {
+			error_ = true; // second document
+			return;
+		}
+		started_ = true;
+		if (depth_ < MaxDepth) {
+			levels_[depth_] = Level{array};
+		}
+		depth_++;
+		expectKey_ = !array;
+		derived().onOpen();
+	}
+
+	void pop() {
+		if (depth_ == 0) {
+			error_ = true;
+			return;
+		}
+		derived().onClose();
+		depth_--;
+		expectKey_ = false;
+	}
+
+	void endScalar() {
+		if (valueLength_ == 0) {
+			return;
+		}
+		auto length = valueLength_;
+		valueLength_ = 0;
+		if (isTracked()) {
+			deliver(length, false);
+		}
+	}
+
+	void deliver(size_t length, bool string) {
+		value_[length] = '\0';
+		if (levels_[depth_ - 1].array) {
+			derived().onElement(std::string_view(value_, length), string);
+		} else {
+			derived().onValue(std::string_view(value_, length), string);
+		}
+	}
+
+	std::array<Level, MaxDepth> levels_{};
+	size_t depth_ = 0;
+	bool expectKey_ = false;
+	bool capturingKey_ = false;
+	state_t state_ = state_t::value;
+	char value_[maxValue + 1] = {};
+	size_t valueLength_ = 0;
+	uint32_t codePoint_ = 0;
+	uint16_t highSurrogate_ = 0;
+	uint8_t unicodeDigits_ = 0;
+	bool error_ = false;
+	bool started_ = false;
+};
+
+} // namespace heating
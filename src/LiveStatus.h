@@ -0,0 +1,190 @@
+#pragma once
+
+#include "StatusCache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace heating {
+
+// Status pushed to web UI viewers as a snapshot followed by deltas, taken from the fragments of a StatusCache the
+// controller task keeps current. publish() sends the fragments whose version moved since the last delta. Nothing is
+// refreshed while nobody watches.
+//
+// Events are kept in a ring bounded by count and bytes, each viewer only remembers the last event id it got - a viewer
+// falling behind the ring asks for a snapshot instead, so memory doesn't grow with slow or many viewers.
+class LiveStatus {
+public:
+	using clock_t = std::chrono::steady_clock;
+
+	struct Limits {
+		size_t events = 16;
+		size_t bytes = 8192;
+		std::chrono::milliseconds interval{1000}; // changes within are coalesced into one delta
+	};
+
+	struct Event {
+		uint32_t id;
+		std::string data; // {"<section>": <json>, ...}
+	};
+
+	// @param keys   prefixes of the cached sections sent to viewers
+	// @param epoch  differs between boots, so an event id from before a reboot is never taken as a resume point
+	LiveStatus(StatusCache &cache, std::vector<std::string> keys, uint32_t epoch = 0) : LiveStatus(cache, std::move(keys), epoch, Limits{}) {}
+	LiveStatus(StatusCache &cache, std::vector<std::string> keys, uint32_t epoch, Limits limits) : cache_(cache), keys_(std::move(keys)), epoch_(epoch), limits_(limits) {}
+
+	// controller task - true when a delta was published
+	bool publish(clock_t::time_point now) {
+		size_t viewers;
+		uint32_t requested;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			viewers = viewers_;
+			requested = snapshotsRequested_;
+		}
+		bool snapshotWanted = requested != snapshotsServed_;
+		if (viewers == 0) {
+			return false; // dirty sections wait for a viewer
+		}
+		if (!snapshotWanted && (now < nextPublish_ || (!cache_.isDirty() && cache_.getVersion() == published_))) {
+			return false;
+		}
+		nextPublish_ = now + limits_.interval;
+		cache_.refresh();
+
+		std::string delta;
+		auto read = cache_.forEach(published_, [&](StatusCache::Fragment const &fragment) {
+			if (isSent(fragment.key)) {
+				append(delta, fragment);
+			}
+		});
+		published_ = read.version;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		bool published = !read.full && !delta.empty();
+		if (read.full) {
+			events_.clear(); // sections replaced - every remembered id is now behind the ring
+			bytes_ = 0;
+			lastId_++;
+		} else if (published) {
+			bytes_ += delta.size() + 2;
+			events_.push_back({++lastId_, "{" + std::move(delta) + "}"});
+			while (!events_.empty() && (events_.size() > limits_.events || bytes_ > limits_.bytes)) {
+				bytes_ -= events_.front().data.size();
+				events_.pop_front();
+			}
+			deltas_++;
+		}
+		if (snapshotWanted) {
+			std::string data;
+			cache_.forEach([&](StatusCache::Fragment const &fragment) {
+				if (isSent(fragment.key)) {
+					append(data, fragment);
+				}
+			});
+			snapshot_ = {lastId_, "{" + data + "}"};
+			snapshotsServed_ = requested;
+		}
+		return published;
+	}
+
+	// any task
+	void addViewer() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		viewers_++;
+	}
+
+	void removeViewer() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		viewers_--;
+	}
+
+	size_t getViewers() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return viewers_;
+	}
+
+	// any task - ticket for getSnapshot, the snapshot is rendered at the next publish
+	uint32_t requestSnapshot() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return ++snapshotsRequested_;
+	}
+
+	std::optional<Event> getSnapshot(uint32_t ticket) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (static_cast<int32_t>(snapshotsServed_ - ticket) < 0) {
+			return std::nullopt;
+		}
+		return snapshot_;
+	}
+
+	// any task - appends events after the id, false when some of them were already dropped
+	bool getEventsSince(uint32_t id, std::vector<Event> &events) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (id > lastId_) {
+			return false;
+		}
+		auto oldest = events_.empty() ? lastId_ + 1 : events_.front().id;
+		if (id + 1 < oldest) {
+			return false;
+		}
+		for (auto const &event : events_) {
+			if (event.id > id) {
+				events.push_back(event);
+			}
+		}
+		return true;
+	}
+
+	uint32_t getEpoch() const { return epoch_; }
+
+	void getStatus(std::ostream &ss) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		ss << "{\"viewers\": " << viewers_ << ", \"lastId\": " << lastId_ << ", \"deltas\": " << deltas_ << ", \"snapshots\": " << snapshotsServed_ << ", \"events\": " << events_.size() << ", \"bytes\": " << bytes_ << "}";
+	}
+
+private:
+	bool isSent(std::string const &key) const {
+		for (auto const &prefix : keys_) {
+			if (key.compare(0, prefix.size(), prefix) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static void append(std::string &data, StatusCache::Fragment const &fragment) {
+		if (!data.empty()) {
+			data += ", ";
+		}
+		data += "\"" + fragment.key + "\": " + fragment.json;
+	}
+
+	StatusCache &cache_;
+	std::vector<std::string> const keys_;
+	uint32_t const epoch_;
+	Limits const limits_;
+
+	// controller task only
+	clock_t::time_point nextPublish_{};
+	uint32_t published_ = 0; // cache version of the last delta
+
+	mutable std::mutex mutex_;
+	uint32_t snapshotsServed_ = 0; // written by controller task with the mutex held
+	std::deque<Event> events_;
+	size_t bytes_ = 0;
+	uint32_t lastId_ = 0;
+	uint32_t deltas_ = 0;
+	size_t viewers_ = 0;
+	uint32_t snapshotsRequested_ = 0;
+	Event snapshot_{0, "{}"};
+};
+
+} // namespace heating
@@ -8,7 +8,7 @@
 #include <cstdio>
 #include <string>
 
-// in case of extending, update REST.h configDebug() too
+// in case of extending, update REST.h configDebug() and DEBUG_OPTIONS in config.cpp too
 namespace debug {
 	struct debug {
 		bool debugRoomTemperatures : 1 = false;
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+
+namespace heating {
+
+// Period of the controller loop - time between starts of consecutive iterations. A long period is how long EMS
+// telegrams, MQTT keep-alives and queued calls waited, so the histogram shows loop jitter.
+class LoopStats {
+public:
+	using clock_t = std::chrono::steady_clock;
+
+	static constexpr std::array<uint16_t, 6> bucketsMs{1, 5, 20, 100, 500, 2000}; // upper bounds, last bucket counts the rest
+
+	// at the start of every iteration
+	void tick(clock_t::time_point now) {
+		if (last_) {
+			auto periodUs = static_cast<uint32_t>(std::min<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - *last_).count(), UINT32_MAX));
+			iterations_++;
+			totalUs_ += periodUs;
+			maxUs_ = std::max(maxUs_, periodUs);
+			size_t bucket = 0;
+			while (bucket < bucketsMs.size() && periodUs >= bucketsMs[bucket] * 1000u) {
+				bucket++;
+			}
+			histogram_[bucket]++;
+		}
+		last_ = now;
+	}
+
+	uint32_t getIterations() const { return iterations_; }
+	uint32_t getMaxUs() const { return maxUs_; }
+	uint32_t getMeanUs() const { return iterations_ ? static_cast<uint32_t>(totalUs_ / iterations_) : 0; }
+	uint32_t getBucket(size_t bucket) const { return histogram_[bucket]; }
+
+	void getStatus(std::ostream &ss) const {
+		ss << "{\"iterations\": " << iterations_ << ", \"meanUs\": " << getMeanUs() << ", \"maxUs\": " << maxUs_ << ", \"histogramMs\": {";
+		for (size_t i = 0; i < histogram_.size(); ++i) {
+			ss << (i ? ", " : "") << "\"";
+			if (i < bucketsMs.size()) {
+				ss << "<" << bucketsMs[i];
+			} else {
+				ss << ">=" << bucketsMs.back();
+			}
+			ss << "\": " << histogram_[i];
+		}
+		ss << "}}";
+	}
+
+private:
+	std::optional<clock_t::time_point> last_;
+	uint32_t iterations_ = 0;
+	uint64_t totalUs_ = 0;
+	uint32_t maxUs_ = 0;
+	std::array<uint32_t, bucketsMs.size() + 1> histogram_{};
+};
+
+} // namespace heating
@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "Logger.h"
+#include "OutdoorTemperature.h"
 #include "RTCTimeHelpers.h"
 
 #include <PubSubClient.h>
@@ -86,8 +87,11 @@ public:
 	using getRoomStatus_t = std::function<void(std::ostream &)>;
 	using getRoomCount_t = std::function<std::size_t()>;
 	using getEmsMetrics_t = std::function<void(std::ostream &)>;
+	using getZonesStatus_t = std::function<void(std::ostream &)>;
+	using outdoorTemperature_t = std::function<void(int16_t)>;
 
-	MQTT(getRoomCount_t getRoomsCount, getRoomStatus_t getRoomsStatus, getEmsMetrics_t getEmsMetrics) : config_(config::getMqttConfig()), client_{config_.brokerAddress.c_str(), config_.brokerPort}, getRoomsStatus_{std::move(getRoomsStatus)}, getEmsMetrics_(std::move(getEmsMetrics)) {
+	// outdoorTopic - external outdoor sensor subscribed to, none when empty
+	MQTT(getRoomCount_t getRoomsCount, getRoomStatus_t getRoomsStatus, getEmsMetrics_t getEmsMetrics, getZonesStatus_t getZonesStatus, std::string outdoorTopic, outdoorTemperature_t onOutdoorTemperature) : config_(config::getMqttConfig()), client_{config_.brokerAddress.c_str(), config_.brokerPort}, getRoomsStatus_{std::move(getRoomsStatus)}, getEmsMetrics_(std::move(getEmsMetrics)), getZonesStatus_(std::move(getZonesStatus)), outdoorTopic_(std::move(outdoorTopic)), onOutdoorTemperature_(std::move(onOutdoorTemperature)) {
 		DBGLOGMQTT("Enabled: %d\n", config_.enabled);
 		DBGLOGMQTT("%s:%d\n", config_.brokerAddress.c_str(), config_.brokerPort );
 		DBGLOGMQTT("publish interval %d, keep alive inteval: %d\n", config_.interval, config_.keepAlive);
@@ -101,6 +105,16 @@ public:
 			DBGLOGMQTT("HomeAssistant '%s' payload: '%s'\n", topic, payload);
 		});
 
+		if (!outdoorTopic_.empty()) {
+			client_.on(outdoorTopic_.c_str(), [this](char* topic, uint8_t* payload, unsigned int payloadLen) {
+				auto temperature = OutdoorPayloadParser::parse(std::string_view(reinterpret_cast<char const *>(payload), payloadLen));
+				DBGLOGMQTT("Outdoor temperature '%s' valid: %d value: %d\n", topic, temperature.has_value(), temperature.value_or(0));
+				if (temperature) {
+					onOutdoorTemperature_(temperature.value());
+				}
+			});
+		}
+
 		client_.onConnect([this, getRoomsCount](uint16_t connCount) {
 			DBGLOGMQTT("Connected to broker %d\n", connCount);
 			publishHADiscovery(getRoomsCount());
@@ -124,6 +138,7 @@ public:
 
 		if (client_.connected()) {
 			publishRoomData();
+			publishZoneData();
 			publishStatus();
 			publishDeviceStatus();
 			publishEmsMetrics();
@@ -184,6 +199,8 @@ private:
 		publishSensor("ems_metrics"sv, "opth_energy_heating"sv, "Energy used for space heating"sv, "heatingEnergyUsedKwh"sv, ""sv, "kWh"sv, "total"sv, "energy"sv);
 		publishSensor("ems_metrics"sv, "opth_warm_water_usage"sv, "Warm water usage"sv, "warmWaterUsage"sv, ""sv, unit_litre, "measurement"sv);
 		publishSensor("ems_metrics"sv, "opth_warm_water_avg_flow"sv, "Average flow of warm water"sv, "warmWaterAvgFlow"sv, ""sv, "L/min"sv, "measurement"sv);
+
+		publishSensor("zone_data"sv, "opth_zones_flow"sv, "Flow temperature chosen for zones"sv, "flowTemperature"sv, "/ 100"sv, "°C"sv, "measurement"sv, "temperature"sv);
 	}
 
 
@@ -252,6 +269,22 @@ private:
 		client_.publish("open_thermostat/room_data"sv, payloadBuf.view(), false);
 	}
 
+	void publishZoneData() {
+		if (!publishZoneDataCounter_.durationPassed()) {
+			DBGLOGMQTT("publishZoneData: waiting for publish interval (%lds) Time to wait: %ld ms \n", publishZoneDataCounter_.getIntervalMs() / 1000, publishZoneDataCounter_.getTimeToWaitMs());
+			return;
+		}
+
+		ib::viewable_stringbuf payloadBuf;
+		std::ostream ss(&payloadBuf);
+
+		getZonesStatus_(ss);
+
+		DBGLOGMQTT("publishZoneData %zu\n", payloadBuf.view().length());
+
+		client_.publish("open_thermostat/zone_data"sv, payloadBuf.view(), false);
+	}
+
 	void publishRoomBinarySensor(uint16_t roomNo, std::string_view sensorName, std::string_view sensorFriendlyName) {
 		ib::viewable_stringbuf payloadBuf;
 		std::ostream ss(&payloadBuf);
@@ -355,8 +388,12 @@ private:
 	ib::PeriodicCounter publishDeviceStatusCounter_{config_.interval * 1000u};
 	ib::PeriodicCounter publishStatusCounter_{config_.interval * 1000u};
 	ib::PeriodicCounter publishEmsMetricsCounter_{config_.interval * 1000u};
+	ib::PeriodicCounter publishZoneDataCounter_{config_.interval * 1000u};
 
 	getRoomStatus_t getRoomsStatus_;
 	getEmsMetrics_t getEmsMetrics_;
+	getZonesStatus_t getZonesStatus_;
+	std::string outdoorTopic_; // kept for the subscription
+	outdoorTemperature_t onOutdoorTemperature_;
 };
 }
@@ -1,146 +1,260 @@
 #pragma once
 
 #include "config.h"
+#include "CurrentWeather.h"
 #include "Logger.h"
+#include "OutdoorTemperature.h"
+#include "WeatherForecast.h"
 #include <HTTPClient.h>
-#include <cJSON.h>
 #include <memory>
 #include <mutex>
+#include <ostream>
 
 namespace heating {
 
 namespace openweather {
 
-static void fetchTask(void *pvParameters);
+static void workerTask(void *pvParameters);
 }
 
+// One long-lived worker fetches current conditions every interval, and the forecast every forecast interval, over a
+// reused connection. Responses are parsed while they arrive, the status JSON is rendered once per fetch and shared.
 class OpenWeather {
 public:
-	OpenWeather(config::OpenWeatherConfig config) : config_(std::move(config)), query_(buildQuery()), lastFetch_(0) {
-		DBGLOGOW("Configuration. Enabled: %d appid:%s lat:%s lon:%s interval: %d\n", config_.enabled, config_.appid.c_str(), config_.latitude.c_str(), config_.longitude.c_str(), config_.interval);
+	OpenWeather(config::OpenWeatherConfig config) : config_(std::move(config)), query_(buildQuery()), forecastQuery_(buildForecastQuery()) {
+		DBGLOGOW("Configuration. Enabled: %d appid:%s lat:%s lon:%s interval: %d forecast: %d\n", config_.enabled, config_.appid.c_str(), config_.latitude.c_str(), config_.longitude.c_str(), config_.interval, config_.forecast.enabled);
 	}
 
+	// starts the worker once, it runs until restart
 	void operate() {
-		if (!config_.enabled) {
+		if (!config_.enabled || workerStarted_) {
 			return;
 		}
+		workerStarted_ = true;
+		DBGLOGOW("Starting worker, free heap: %d\n", ESP.getFreeHeap());
+		xTaskCreate(heating::openweather::workerTask, "OWTask", workerStackSize, this, 1, NULL);
+	}
 
-		auto now = millis();
-		if (lastFetch_ > 0 && now < lastFetch_ + config_.interval * 1000) {
-			unsigned long timeToWait = static_cast<unsigned long>(config_.interval * 1000);
-			DBGLOGOW("Interval: %ld\n", timeToWait);
-			timeToWait = timeToWait - (now - lastFetch_);
-			DBGLOGOW("Waiting for interval (%ds) last: %ld, now: %ld, still need to wait for: %ld ms \n", config_.interval, lastFetch_, now, timeToWait);
-			return;
+	void getStatus(std::ostream &ss) const {
+		std::shared_ptr<const std::string> status;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			status = status_;
 		}
-
-		DBGLOGOW("Requesting temperature, last: %ld, now: %ld\n", lastFetch_, now);
-		lastFetch_ = now;
-
-		xTaskCreate(heating::openweather::fetchTask, "OWTask", 2500, this, 1, NULL);
+		ss << *status;
 	}
 
-	std::string getStatus() const {
+	// temperature of the last successful fetch and when it was fetched
+	std::optional<OutdoorReading> getTemperature() const {
 		std::lock_guard<std::mutex> lock(mutex_);
-
-		if (payload_.isEmpty()) {
-			return "{}";
+		if (!outdoor_.valid) {
+			return {};
 		}
-		return {payload_.c_str(), payload_.length()};
+		return OutdoorReading{outdoor_.temp, fetched_};
 	}
 
-	struct Outdoor {
-		bool valid = false;
-		int16_t temp = 0;
-		uint8_t humidity = 0;
-		uint16_t pressure = 0;
-		uint64_t date = 0;
-	};
-
-	std::optional<int16_t> getTemperature() {
-		std::unique_lock<std::mutex> lock(mutex_);
-		if (!outdoor_.valid) {
+	// @param now  UTC epoch
+	ForecastOutlook getOutlook(uint32_t now, int16_t currentTemperature) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!config_.forecast.enabled) {
 			return {};
 		}
-		return {outdoor_.temp};
+		return ForecastOutlook::evaluate(forecast_, now, currentTemperature, config_.forecast);
+	}
+
+	void getForecastStatus(std::ostream &ss, ForecastOutlook const &outlook) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		ss << "{\"enabled\": " << (config_.forecast.enabled ? "true" : "false") << ", \"entries\": " << forecast_.size() << ", \"failed\": " << forecastFailures_ << ", \"outlook\": ";
+		outlook.getStatus(ss);
+		ss << ", \"list\": ";
+		forecast_.getJSON(ss, 8);
+		ss << "}";
+	}
+
+	// heap is sampled around each fetch - free heap before it and the lowest free heap seen by the end of it. Free heap is
+	// also sampled while each response body streams to its parser, the lowest value of the last current conditions and
+	// forecast fetch tells what a fetch costs on its own
+	void getWorkerStatus(std::ostream &ss) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		ss << "{\"running\": " << (workerStarted_ ? "true" : "false") << ", \"fetches\": " << stats_.fetches << ", \"failures\": " << stats_.failures << ", \"consecutiveFailures\": " << static_cast<int>(stats_.consecutiveFailures)
+		   << ", \"nextFetchS\": " << stats_.nextDelayMs / 1000 << ", \"heapBefore\": " << stats_.heapBefore << ", \"heapMin\": " << stats_.heapMin << ", \"currentHeapMin\": " << stats_.currentHeapMin
+		   << ", \"forecastHeapBefore\": " << stats_.forecastHeapBefore << ", \"forecastHeapMin\": " << stats_.forecastHeapMin << ", \"stackFree\": " << stats_.stackFree << "}";
 	}
 
 private:
-	void parsePayload(String const &payload) {
-		outdoor_.valid = false;
-		std::unique_ptr<cJSON, decltype(&cJSON_Delete)> data(cJSON_Parse(payload.c_str()), &cJSON_Delete);
+	static constexpr uint32_t workerStackSize = 3072;
 
-		auto main = cJSON_GetObjectItem(data.get(), "main");
-		if (!main || main->type != cJSON_Object) {
-			DBGLOGOW("Error, missing main\n", nullptr);
-			return;
+	struct WorkerStats {
+		uint32_t fetches = 0;
+		uint32_t failures = 0;
+		uint8_t consecutiveFailures = 0;
+		uint32_t nextDelayMs = 0;
+		uint32_t heapBefore = 0;
+		uint32_t heapMin = 0;
+		uint32_t currentHeapMin = 0;     // lowest free heap while the current conditions body streamed
+		uint32_t forecastHeapBefore = 0; // free heap before the last forecast fetch
+		uint32_t forecastHeapMin = 0;    // lowest free heap while the forecast body streamed
+		uint32_t stackFree = 0;
+	};
+
+	// Stream the response body is written to, straight into a parser. Free heap is sampled per chunk - the client's
+	// buffers are held then.
+	template <typename Parser>
+	class ParserStream : public Stream {
+	public:
+		explicit ParserStream(Parser &parser) : parser_(parser), heapMin_(ESP.getFreeHeap()) {}
+
+		size_t write(uint8_t c) override {
+			parser_.feed(reinterpret_cast<char const *>(&c), 1);
+			return 1;
+		}
+
+		size_t write(uint8_t const *buffer, size_t size) override {
+			heapMin_ = std::min<uint32_t>(heapMin_, ESP.getFreeHeap());
+			parser_.feed(reinterpret_cast<char const *>(buffer), size);
+			return size;
 		}
 
-		auto temp = json::getFloat(main, "temp"); // example 6.34 C
+		uint32_t getHeapMin() const { return heapMin_; }
+
+		int available() override { return 0; }
+		int read() override { return -1; }
+		int peek() override { return -1; }
+		void flush() override {}
+
+	private:
+		Parser &parser_;
+		uint32_t heapMin_;
+	};
+
+	// @param heapMin  lowest free heap while the body streamed, untouched if there was no body
+	template <typename Parser>
+	bool fetch(std::string const &query, Parser &parser, uint32_t &heapMin) {
+		if (!http_.begin(query.c_str())) {
+			return false;
+		}
+		int httpResponseCode = http_.GET();
+		bool parsed = false;
+		if (httpResponseCode == HTTP_CODE_OK) {
+			parser.reset();
+			ParserStream<Parser> stream(parser);
+			int written = http_.writeToStream(&stream);
+			parsed = written > 0 && parser.finish();
+			heapMin = stream.getHeapMin();
+			DBGLOGOW("Content size: %d. Parsed: %d Heap min: %d\n", written, parsed, heapMin);
+		} else {
+			DBGLOGOW("Error code %d\n", httpResponseCode);
+		}
+		http_.end(); // keeps the connection for the next request when the server allows it
+		return parsed;
+	}
 
-		outdoor_.temp = static_cast<int16_t>(temp * 100); // example 634
-		outdoor_.pressure = static_cast<int16_t>(json::getInt(main, "pressure"));
-		outdoor_.humidity = static_cast<uint8_t>(json::getInt(main, "humidity"));
-		outdoor_.date = json::getInt(data.get(), "dt");
-		outdoor_.valid = true;
+	bool getData() {
+		uint32_t heapMin = 0;
+		bool parsed = fetch(query_, currentParser_, heapMin);
+		auto status = parsed ? std::make_shared<const std::string>(received_.getJSON()) : nullptr;
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (heapMin) {
+			stats_.currentHeapMin = heapMin;
+		}
+		if (!parsed) {
+			return false;
+		}
+		outdoor_ = received_;
+		fetched_ = std::chrono::steady_clock::now();
+		status_ = std::move(status);
+		DBGLOGOW("Date: %ld Temp: %f, Humidity: %d%% Pressure: %d hPa\n", static_cast<unsigned long>(outdoor_.date), static_cast<float>(outdoor_.temp) / 100, static_cast<int>(outdoor_.humidity), static_cast<int>(outdoor_.pressure));
+		return true;
 	}
 
-	void getData() {
-		std::unique_lock<std::mutex> lock(mutex_);
-		if (getDataInProgress_) {
-			DBGLOGOW("getData already in progress\n");
-			return;
+	bool getForecast() {
+		uint32_t heapBefore = ESP.getFreeHeap();
+		uint32_t heapMin = 0;
+		bool parsed = fetch(forecastQuery_, forecastParser_, heapMin);
+		DBGLOGOW("Forecast entries: %d parsed: %d\n", static_cast<int>(receivedForecast_.size()), parsed);
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (heapMin) {
+			stats_.forecastHeapBefore = heapBefore;
+			stats_.forecastHeapMin = heapMin;
+		}
+		if (parsed) {
+			forecast_ = receivedForecast_;
+		} else {
+			forecastFailures_++;
 		}
-		getDataInProgress_ = true;
-		lock.unlock();
+		return parsed;
+	}
 
-		http_.begin(query_.c_str());
-		int httpResponseCode = http_.GET();
-		if (httpResponseCode > 0) {
-			auto payload = http_.getString();
-
-			lock.lock();
-			payload_ = std::move(payload);
-			DBGLOGOW("Content size: %d. Response: %d\n", http_.getSize(), httpResponseCode);
-			if (payload_.length() > 0) {
-				parsePayload(payload_);
-				DBGLOGOW("Date: %ld Temp: %f, Humidity: %d%% Pressure: %d hPa\n", static_cast<unsigned long>(outdoor_.date), static_cast<float>(outdoor_.temp) / 100, static_cast<int>(outdoor_.humidity), static_cast<int>(outdoor_.pressure));
+	void work() {
+		http_.setReuse(true);
+		std::optional<unsigned long> lastForecastFetch;
+		for (;;) {
+			uint32_t heapBefore = ESP.getFreeHeap();
+			bool ok = getData();
+			// forecast changes slowly, it's fetched along with current conditions every forecast interval
+			auto now = millis();
+			if (config_.forecast.enabled && (!lastForecastFetch || now - *lastForecastFetch >= config_.forecast.interval * 1000ul)) {
+				if (getForecast()) {
+					lastForecastFetch = now;
+				} else {
+					ok = false;
+				}
+			}
+			if (!ok) {
+				http_.end(); // next attempt starts with a fresh connection
 			}
-			lock.unlock();
 
+			uint32_t delayMs;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stats_.fetches++;
+				stats_.failures += ok ? 0 : 1;
+				stats_.consecutiveFailures = ok ? 0 : std::min<uint8_t>(stats_.consecutiveFailures + 1, UINT8_MAX);
+				stats_.nextDelayMs = delayMs = FetchBackoff::nextDelayMs(config_.interval * 1000u, stats_.consecutiveFailures);
+				stats_.heapBefore = heapBefore;
+				stats_.heapMin = ESP.getMinFreeHeap();
+				stats_.stackFree = uxTaskGetStackHighWaterMark(nullptr);
+			}
+			DBGLOGOW("Fetch ok: %d next in %ds. Free memory before %d now %d/%d (minimum was: %d) MaxAlloc: %d MinPeekStack: %d UpTime: %lds\n", ok, delayMs / 1000, heapBefore, ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(), uxTaskGetStackHighWaterMark(nullptr), millis() / 1000);
+			vTaskDelay(pdMS_TO_TICKS(delayMs));
 		}
-		else {
-			DBGLOGOW("Error code %d\n", httpResponseCode);
-		}
-		http_.end();
-		lock.lock();
-		getDataInProgress_ = false;
 	}
 
 	std::string buildQuery() {
-		return "http://api.openweathermap.org/data/2.5/weather?lat=" + config_.latitude + "&lon=" + config_.longitude + "&appid=" + config_.appid + "&units=metric";
+		return config_.server + "/data/2.5/weather?lat=" + config_.latitude + "&lon=" + config_.longitude + "&appid=" + config_.appid + "&units=metric";
+	}
+
+	std::string buildForecastQuery() {
+		return config_.server + config_.forecast.path + "?lat=" + config_.latitude + "&lon=" + config_.longitude + "&appid=" + config_.appid + "&units=metric&cnt=" + std::to_string(config_.forecast.entries);
 	}
 
-	HTTPClient http_;
+	HTTPClient http_; // worker only
 	config::OpenWeatherConfig config_;
 	std::string query_;
-	unsigned long lastFetch_;
-	Outdoor outdoor_;
-	String payload_;
-	mutable std::mutex mutex_;
-	bool getDataInProgress_ = false;
-	friend void heating::openweather::fetchTask(void *pvParameters);
+	std::string forecastQuery_;
+	bool workerStarted_ = false;
+
+	// worker only - parsers fill these, published under mutex_ when complete
+	Outdoor received_;
+	CurrentWeatherParser currentParser_{received_};
+	HourlyForecast receivedForecast_;
+	ForecastParser forecastParser_{receivedForecast_};
 
+	mutable std::mutex mutex_;
+	Outdoor outdoor_;
+	std::chrono::steady_clock::time_point fetched_;
+	std::shared_ptr<const std::string> status_ = std::make_shared<const std::string>("{}");
+	HourlyForecast forecast_;
+	uint32_t forecastFailures_ = 0;
+	WorkerStats stats_;
 
+	friend void heating::openweather::workerTask(void *pvParameters);
 };
 
 namespace openweather {
-static void fetchTask(void *pvParameters) {
-	auto ow = reinterpret_cast<OpenWeather *>(pvParameters);
-	ow->getData();
-	DBGLOGOW("Free memory %d/%d (minimum was: %d) MaxAlloc: %d MinPeekStack: %d UpTime: %lds\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(), uxTaskGetStackHighWaterMark(nullptr), millis()/1000);
-	vTaskDelete(NULL);
+static void workerTask(void *pvParameters) {
+	reinterpret_cast<OpenWeather *>(pvParameters)->work();
 }
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "JsonScanner.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace heating {
+
+// temperature of one source and the time it was taken
+struct OutdoorReading {
+	int16_t temperature; // 1/100 °C
+	std::chrono::steady_clock::time_point at;
+};
+
+struct OutdoorTemperatureConfig {
+	enum class source_t : uint8_t { ems, openweather, mqtt, ble };
+	static constexpr size_t sources = 4;
+
+	struct Source {
+		bool enabled = true;
+		uint8_t quality = 50;  // 0 - 100, trust in the source when its reading is fresh
+		uint16_t maxAge = 1800; // s, reading is stale after this
+	};
+
+	std::array<Source, sources> source{{
+		{true, 50, 600},   // ems - boiler outdoor sensor, telegram every minute
+		{true, 50, 3600},  // openweather - station kilometres away, fetched every few minutes
+		{false, 80, 1800}, // mqtt - external sensor on a topic
+		{false, 80, 1800}, // ble - outdoor beacon
+	}};
+	std::string mqttTopic;                            // payload is a number or JSON with "temperature"
+	std::optional<std::array<uint8_t, 6>> bleAddress; // outdoor beacon
+	std::optional<std::array<uint8_t, 16>> bleKey;
+	uint16_t smoothing = 900;         // s, time constant of the exponential smoothing
+	uint16_t hold = 6 * 3600;         // s, last good value is held this long when all sources are stale
+	int16_t fallbackTemperature = -2000; // 1/100 °C, used with no value at all - heating curve maximum by default
+};
+
+// Merges outdoor temperature from several sources into one cached value. Every reading carries the time it was taken;
+// its score is the source quality fading linearly to zero at the source's maxAge. Sources scoring at least half of the
+// best one are averaged weighted by score - a clearly preferred source is used alone, similar ones complement each
+// other. The merged value is smoothed, so a source dropping in or out doesn't step the flow temperature, and held
+// when all sources go stale. Controller task only: sources are fed and consumers read the cache without locking.
+class OutdoorTemperature {
+public:
+	using clock_t = std::chrono::steady_clock;
+	using source_t = OutdoorTemperatureConfig::source_t;
+
+	explicit OutdoorTemperature(OutdoorTemperatureConfig const &config = {}) : config_(config) {}
+
+	OutdoorTemperatureConfig const &getConfig() const { return config_; }
+
+	bool isEnabled(source_t source) const { return config_.source[index(source)].enabled; }
+
+	// feeding the same reading again doesn't refresh it
+	void update(source_t source, OutdoorReading const &update) {
+		auto &reading = readings_[index(source)];
+		if (!isEnabled(source) || (reading.at && *reading.at >= update.at)) {
+			return;
+		}
+		reading.temperature = update.temperature;
+		reading.at = update.at;
+		reading.count++;
+	}
+
+	// recomputes the cached value, once per control cycle
+	void evaluate(clock_t::time_point now) {
+		std::array<int32_t, OutdoorTemperatureConfig::sources> scores{};
+		int32_t best = 0;
+		for (size_t i = 0; i < readings_.size(); ++i) {
+			scores[i] = score(i, now);
+			best = std::max(best, scores[i]);
+		}
+
+		if (best > 0) {
+			int64_t weighted = 0;
+			int64_t weights = 0;
+			for (size_t i = 0; i < readings_.size(); ++i) {
+				if (scores[i] * 2 >= best) {
+					weighted += static_cast<int64_t>(readings_[i].temperature) * scores[i];
+					weights += scores[i];
+				}
+			}
+			auto merged = static_cast<int16_t>(weighted / weights);
+			smooth(merged, now);
+			lastGood_ = now;
+			held_ = false;
+			return;
+		}
+
+		held_ = smoothed_ && lastGood_ && now - *lastGood_ < std::chrono::seconds(config_.hold);
+		if (!held_) {
+			smoothed_.reset();
+			lastEvaluation_.reset();
+		}
+	}
+
+	// cached merged value, none when there's nothing fresh and hold expired
+	std::optional<int16_t> get() const { return smoothed_; }
+
+	// never missing - fallback temperature when there's no value
+	int16_t getTemperature() const { return smoothed_.value_or(config_.fallbackTemperature); }
+
+	bool isHeld() const { return held_; }
+
+	void getStatus(std::ostream &ss, clock_t::time_point now) const {
+		static constexpr std::array<char const *, OutdoorTemperatureConfig::sources> names{"ems", "openweather", "mqtt", "ble"};
+		ss << "{";
+		if (smoothed_) {
+			ss << "\"temperature\": " << smoothed_.value() << ", ";
+		}
+		ss << "\"held\": " << (held_ ? "true" : "false") << ", \"sources\": {";
+		bool first = true;
+		for (size_t i = 0; i < readings_.size(); ++i) {
+			if (!config_.source[i].enabled) {
+				continue;
+			}
+			ss << (first ? "" : ", ") << "\"" << names[i] << "\": {\"readings\": " << readings_[i].count;
+			first = false;
+			if (readings_[i].at) {
+				ss << ", \"temperature\": " << readings_[i].temperature << ", \"ageS\": " << std::chrono::duration_cast<std::chrono::seconds>(now - *readings_[i].at).count() << ", \"score\": " << score(i, now);
+			}
+			ss << "}";
+		}
+		ss << "}}";
+	}
+
+private:
+	struct Reading {
+		int16_t temperature = 0;
+		std::optional<clock_t::time_point> at;
+		uint32_t count = 0;
+	};
+
+	static constexpr size_t index(source_t source) { return static_cast<size_t>(source); }
+
+	// quality fading with age, 0 - stale or missing, up to 100 * 1000
+	int32_t score(size_t source, clock_t::time_point now) const {
+		auto const &reading = readings_[source];
+		auto const &config = config_.source[source];
+		if (!config.enabled || !reading.at || config.maxAge == 0) {
+			return 0;
+		}
+		auto ageMs = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(now - *reading.at).count());
+		int64_t maxAgeMs = config.maxAge * 1000ll;
+		if (ageMs >= maxAgeMs) {
+			return 0;
+		}
+		return static_cast<int32_t>(config.quality * (1000 - ageMs * 1000 / maxAgeMs));
+	}
+
+	// smoothed in 1/256 of 1/100 °C, so small differences still converge
+	void smooth(int16_t merged, clock_t::time_point now) {
+		int32_t target = static_cast<int32_t>(merged) * fraction;
+		if (!smoothed_ || !lastEvaluation_ || config_.smoothing == 0) {
+			state_ = target;
+		} else {
+			auto dtMs = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(now - *lastEvaluation_).count());
+			int64_t tauMs = config_.smoothing * 1000ll;
+			state_ += static_cast<int32_t>(static_cast<int64_t>(target - state_) * dtMs / (tauMs + dtMs));
+		}
+		smoothed_ = static_cast<int16_t>((state_ + (state_ < 0 ? -fraction / 2 : fraction / 2)) / fraction);
+		lastEvaluation_ = now;
+	}
+
+	static constexpr int32_t fraction = 256;
+
+	OutdoorTemperatureConfig config_;
+	std::array<Reading, OutdoorTemperatureConfig::sources> readings_{};
+	int32_t state_ = 0;
+	std::optional<int16_t> smoothed_;
+	std::optional<clock_t::time_point> lastEvaluation_;
+	std::optional<clock_t::time_point> lastGood_;
+	bool held_ = false;
+};
+
+// Temperature from an MQTT payload: a plain number like "-3.5", or JSON with a "temperature" member at any level, as
+// sent by Zigbee2MQTT ({"temperature": -3.5}) or Tasmota ({"DS18B20": {"Temperature": -3.5}}).
+class OutdoorPayloadParser : public JsonScanner<OutdoorPayloadParser> {
+public:
+	static std::optional<int16_t> parse(std::string_view payload) {
+		auto first = payload.find_first_not_of(" \t\r\n");
+		if (first == std::string_view::npos) {
+			return {};
+		}
+		if (payload[first] != '{') {
+			return toHundredths(payload.substr(first));
+		}
+		OutdoorPayloadParser parser;
+		parser.reset();
+		parser.feed(payload.data(), payload.size());
+		if (!parser.finish()) {
+			return {};
+		}
+		return parser.temperature_;
+	}
+
+private:
+	friend class JsonScanner<OutdoorPayloadParser>;
+
+	void onOpen() {}
+	void onClose() {}
+
+	void onValue(std::string_view text, bool string) {
+		auto level = depth() - 1;
+		if (!string && !temperature_ && (keyIs(level, "temperature") || keyIs(level, "Temperature") || keyIs(level, "temp"))) {
+			temperature_ = toHundredths(text);
+		}
+	}
+
+	static std::optional<int16_t> toHundredths(std::string_view text) {
+		char buffer[maxValue + 1];
+		auto length = std::min(text.size(), maxValue);
+		std::copy_n(text.data(), length, buffer);
+		buffer[length] = '\0';
+		char *end = nullptr;
+		double value = std::strtod(buffer, &end);
+		if (end == buffer || !(value >= -100 && value <= 100)) { // not a number or not an outdoor temperature
+			return {};
+		}
+		return static_cast<int16_t>(value * 100 + (value < 0 ? -0.5 : 0.5));
+	}
+
+	std::optional<int16_t> temperature_;
+};
+
+} // namespace heating
@@ -18,6 +18,7 @@ struct PcfDevice {
 	uint8_t address;
 	bool is16bit;       // true = PCF8575 (16 pins), false = PCF8574/8574a (8 pins)
 	uint16_t shadow = 0xFFFF; // start with all HIGH (default PCF state)
+	bool dirty = false;       // shadow changed by setPin() but not flushed yet
 
 	PcfDevice(uint8_t addr, bool wide) : address(addr), is16bit(wide), shadow(0xFFFF) {
 		// Drive all pins HIGH immediately — active-low relays: HIGH = coil OFF (safe default).
@@ -25,14 +26,28 @@ struct PcfDevice {
 	}
 
 	void writePin(uint8_t pin, bool high) {
+		setPin(pin, high);
+		flush();
+	}
+
+	// update shadow only - call commit() to send all pending changes in one transaction
+	void setPin(uint8_t pin, bool high) {
+		auto previous = shadow;
 		if (high)
 			shadow |= static_cast<uint16_t>(1u << pin);
 		else
 			shadow &= static_cast<uint16_t>(~(1u << pin));
-		flush();
+		dirty = dirty || shadow != previous;
+	}
+
+	void commit() {
+		if (dirty) {
+			flush();
+		}
 	}
 
 	void flush() {
+		dirty = false;
 #ifdef ARDUINO
 		Wire.beginTransmission(address);
 		Wire.write(static_cast<uint8_t>(shadow & 0xFF));
@@ -57,6 +72,14 @@ public:
 		device_->writePin(pin_, !high); // invert: active-low relay — HIGH=off, LOW=on
 	}
 
+	void stage(bool high) override {
+		device_->setPin(pin_, !high);
+	}
+
+	void commit() override {
+		device_->commit();
+	}
+
 private:
 	std::shared_ptr<PcfDevice> device_;
 	uint8_t pin_;
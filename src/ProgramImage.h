@@ -0,0 +1,262 @@
+#pragma once
+
+#include "AssetImage.h"
+#include "RoomConfig.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace heating {
+
+// Program compiled from its JSON into a binary image kept next to it, /programs/<name>.bin. Loading one is a bounds
+// checked copy into RoomConfig - no tokenizing, number or time parsing. The image carries the hash of the JSON it was
+// compiled from, an edited or replaced JSON makes it stale, and the hash of its body, so a damaged one isn't used.
+//
+// Little endian layout:
+//   header  magic "HPI2", u32 image length, u64 FNV-1a 64 of the JSON, u64 FNV-1a 64 of the body
+//   body    u16 room count, rooms:
+//     room     str name, u8 enabled, u16 base temperature, u8 margin up, u8 margin down, filter, u16 sensor count,
+//              sensors, valves, u16 setting count, settings
+//     filter   u8 method, u16 outlier tolerance, u16 max rate, u8 ewma alpha, u8 min confidence, u8 staleness
+//              weighting, u32 max age s, u16 sample interval s
+//     sensor   6 bytes address, u8 weight, u8 has key, 16 bytes key when it has
+//     setting  str name, u16 from, u16 to, i16 temperature, u8 has override, u8 override, u8 enabled, u8 days bits, valves
+//     valves   u16 count, str each
+//     str      u16 length, bytes
+class ProgramImage {
+public:
+	static constexpr uint32_t magic = 0x32495048; // "HPI2"
+	static constexpr size_t headerSize = 24;
+
+	// source - hash of the JSON the rooms were parsed from
+	static std::string build(std::vector<RoomConfig> const &rooms, uint64_t source) {
+		Writer body;
+		body.u16(rooms.size());
+		for (auto const &room : rooms) {
+			writeRoom(body, room);
+		}
+
+		Writer image;
+		image.u32(magic);
+		image.u32(headerSize + body.bytes.size());
+		image.u64(source);
+		image.u64(hash(body.bytes));
+		image.bytes += body.bytes;
+		return image.bytes;
+	}
+
+	// rooms of an image compiled from JSON with the source hash, none when it's stale or fails any check
+	static std::optional<std::vector<RoomConfig>> load(std::string_view image, uint64_t source) {
+		Reader header{image.substr(0, headerSize)};
+		if (header.u32() != magic || header.u32() != image.size() || header.u64() != source || !header.ok) {
+			return std::nullopt;
+		}
+		auto bodyHash = header.u64();
+		auto bodyBytes = image.substr(headerSize);
+		if (hash(bodyBytes) != bodyHash) {
+			return std::nullopt;
+		}
+
+		Reader body{bodyBytes};
+		auto count = body.u16();
+		if (count > bodyBytes.size()) {
+			return std::nullopt;
+		}
+		std::vector<RoomConfig> rooms(count);
+		for (auto &room : rooms) {
+			if (!body.ok) {
+				break;
+			}
+			readRoom(body, room);
+		}
+		if (!body.ok || body.at != bodyBytes.size()) {
+			return std::nullopt;
+		}
+		return rooms;
+	}
+
+	static uint64_t hash(std::string_view bytes) {
+		AssetHash hash;
+		hash.update(reinterpret_cast<uint8_t const *>(bytes.data()), bytes.size());
+		return hash.get();
+	}
+
+private:
+	struct Writer {
+		std::string bytes;
+
+		void u8(uint8_t value) { bytes += static_cast<char>(value); }
+		void u16(uint16_t value) { u8(value); u8(value >> 8); }
+		void u32(uint32_t value) { u16(value); u16(value >> 16); }
+		void u64(uint64_t value) { u32(value); u32(value >> 32); }
+
+		void str(std::string const &text) {
+			auto length = std::min<size_t>(text.size(), UINT16_MAX);
+			u16(length);
+			bytes.append(text, 0, length);
+		}
+
+		void strings(std::vector<std::string> const &texts) {
+			u16(texts.size());
+			for (auto const &text : texts) {
+				str(text);
+			}
+		}
+	};
+
+	// past the end reads give zeros and clear ok
+	struct Reader {
+		std::string_view bytes;
+		size_t at = 0;
+		bool ok = true;
+
+		uint8_t u8() {
+			if (at >= bytes.size()) {
+				ok = false;
+				return 0;
+			}
+			return static_cast<uint8_t>(bytes[at++]);
+		}
+		uint16_t u16() {
+			uint16_t low = u8();
+			return low | u8() << 8;
+		}
+		uint32_t u32() {
+			uint32_t low = u16();
+			return low | uint32_t(u16()) << 16;
+		}
+		uint64_t u64() {
+			uint64_t low = u32();
+			return low | uint64_t(u32()) << 32;
+		}
+
+		std::string str() {
+			auto length = u16();
+			if (length > bytes.size() - std::min(at, bytes.size())) {
+				ok = false;
+				return {};
+			}
+			at += length;
+			return std::string(bytes.substr(at - length, length));
+		}
+
+		void strings(std::vector<std::string> &texts) {
+			auto count = u16();
+			for (uint16_t i = 0; i < count && ok; ++i) {
+				texts.push_back(str());
+			}
+		}
+	};
+
+	static void writeRoom(Writer &out, RoomConfig const &room) {
+		out.str(room.name_);
+		out.u8(room.enabled_);
+		out.u16(room.baseTemperature_);
+		out.u8(room.temperatureMarginUp_);
+		out.u8(room.temperatureMarginDown_);
+
+		auto const &filter = room.filter_;
+		out.u8(static_cast<uint8_t>(filter.method));
+		out.u16(filter.outlierTolerance);
+		out.u16(filter.maxRatePerMinute);
+		out.u8(filter.ewmaAlpha);
+		out.u8(filter.minConfidence);
+		out.u8(filter.stalenessWeighting);
+		out.u32(filter.maxSampleAge.count());
+		out.u16(filter.sampleInterval.count());
+
+		out.u16(room.sensors_.size());
+		for (auto const &sensor : room.sensors_) {
+			out.bytes.append(reinterpret_cast<char const *>(sensor.address_.data()), sensor.address_.size());
+			out.u8(sensor.weight_);
+			out.u8(sensor.bindKey_.has_value());
+			if (sensor.bindKey_) {
+				out.bytes.append(reinterpret_cast<char const *>(sensor.bindKey_->data()), sensor.bindKey_->size());
+			}
+		}
+		out.strings(room.valves_);
+
+		out.u16(room.temperatures_.size());
+		for (auto const &setting : room.temperatures_) {
+			out.str(setting.name_);
+			out.u16(setting.timeFrom_);
+			out.u16(setting.timeTo_);
+			out.u16(static_cast<uint16_t>(setting.temperature_));
+			out.u8(setting.heatingTemperatureOverride_.has_value());
+			out.u8(setting.heatingTemperatureOverride_.value_or(0));
+			out.u8(setting.enabled_);
+			uint8_t days = 0;
+			for (size_t day = 0; day < setting.days_.size(); ++day) {
+				days |= setting.days_[day] << day;
+			}
+			out.u8(days);
+			out.strings(setting.valves_);
+		}
+	}
+
+	static void readRoom(Reader &in, RoomConfig &room) {
+		room.name_ = in.str();
+		room.enabled_ = in.u8();
+		room.baseTemperature_ = in.u16();
+		room.temperatureMarginUp_ = in.u8();
+		room.temperatureMarginDown_ = in.u8();
+
+		auto &filter = room.filter_;
+		auto method = in.u8();
+		if (method > static_cast<uint8_t>(TemperatureFilterConfig::method_t::ewma)) {
+			in.ok = false;
+		}
+		filter.method = static_cast<TemperatureFilterConfig::method_t>(method);
+		filter.outlierTolerance = in.u16();
+		filter.maxRatePerMinute = in.u16();
+		filter.ewmaAlpha = in.u8();
+		filter.minConfidence = in.u8();
+		filter.stalenessWeighting = in.u8();
+		filter.maxSampleAge = std::chrono::seconds(in.u32());
+		filter.sampleInterval = std::chrono::seconds(in.u16());
+
+		auto sensors = in.u16();
+		for (uint16_t i = 0; i < sensors && in.ok; ++i) {
+			auto &sensor = room.sensors_.emplace_back();
+			for (auto &byte : sensor.address_) {
+				byte = in.u8();
+			}
+			sensor.weight_ = in.u8();
+			if (in.u8()) {
+				auto &key = sensor.bindKey_.emplace();
+				for (auto &byte : key) {
+					byte = in.u8();
+				}
+			}
+		}
+		in.strings(room.valves_);
+
+		auto settings = in.u16();
+		for (uint16_t i = 0; i < settings && in.ok; ++i) {
+			auto &setting = room.temperatures_.emplace_back();
+			setting.name_ = in.str();
+			setting.timeFrom_ = in.u16();
+			setting.timeTo_ = in.u16();
+			setting.temperature_ = static_cast<int16_t>(in.u16());
+			bool hasOverride = in.u8();
+			auto override = in.u8();
+			if (hasOverride) {
+				setting.heatingTemperatureOverride_ = override;
+			}
+			setting.enabled_ = in.u8();
+			auto days = in.u8();
+			for (size_t day = 0; day < setting.days_.size(); ++day) {
+				setting.days_[day] = days >> day & 1;
+			}
+			in.strings(setting.valves_);
+		}
+	}
+};
+
+} // namespace heating
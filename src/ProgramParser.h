@@ -0,0 +1,292 @@
+#pragma once
+
+#include "BeaconBleAddress.h"
+#include "JsonScanner.h"
+#include "Logger.h"
+#include "RoomConfig.h"
+#include "TimeUtils.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace heating {
+
+// bind key as 32 hex digits, as shown by the sensor flashing / pairing tools
+inline std::optional<std::array<uint8_t, 16>> parseBindKey(std::string_view hex) {
+	std::array<uint8_t, 16> key;
+	if (hex.empty()) {
+		return std::nullopt;
+	}
+	if (hex.length() != key.size() * 2 || !std::all_of(hex.begin(), hex.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); })) {
+		heating::logger.printf("Invalid bind key length %zu - 32 hex digits expected\n", hex.length());
+		return std::nullopt;
+	}
+	auto nibble = [](char c) { return static_cast<uint8_t>(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10); };
+	for (size_t i = 0; i < key.size(); ++i) {
+		key[i] = static_cast<uint8_t>(nibble(hex[i * 2]) << 4 | nibble(hex[i * 2 + 1]));
+	}
+	return key;
+}
+
+// sensors are bluetooth beacons only, "xx:xx:xx:xx:xx:xx" - anything else is logged and the sensor left out
+inline std::optional<BleAddress_t> parseBleAddress(std::string_view text) {
+	bool valid = text.length() == 17;
+	for (size_t i = 0; i < text.length() && valid; ++i) {
+		valid = i % 3 == 2 ? text[i] == ':' : std::isxdigit(static_cast<unsigned char>(text[i])) != 0;
+	}
+	if (!valid) {
+		heating::logger.printf("Invalid sensor address '%.*s' - bluetooth address expected\n", static_cast<int>(text.length()), text.data());
+		return std::nullopt;
+	}
+	return BLEAddresFromString(text);
+}
+
+// Program - the rooms and their temperature settings - parsed straight into RoomConfig while the file or request body
+// is read in chunks, so neither the document nor a cJSON tree of it is held, only the rooms being filled:
+//   [{"name", "base_temp", "temp_margin_up", "temp_margin_down", "enabled", "valves": ["<name>" | <index>, ...],
+//     "sensor", "sensor_key", "sensors": ["<address>" | {"address", "weight", "key"}, ...], "filter": {...},
+//     "temperatures": [{"name", "time_from", "time_to", "temp", "boiler_temp", "enabled", "valves", "days": [0-6, ...]}]}]
+// Missing members get the values the cJSON parser gave them - 0 for temperatures and margins, "" for names. A string
+// over 63 bytes fails the program rather than being cut.
+class ProgramParser : public JsonScanner<ProgramParser, 6, 23, 63> {
+public:
+	explicit ProgramParser(std::vector<RoomConfig> &rooms) : rooms_(rooms) { reset(); }
+
+	void reset() {
+		JsonScanner::reset();
+		rooms_.clear();
+		rootArray_ = false;
+	}
+
+	// true when a complete array of rooms was parsed
+	bool finish() { return JsonScanner::finish() && rootArray_; }
+
+private:
+	friend class JsonScanner<ProgramParser, 6, 23, 63>;
+	static constexpr bool rejectLongValues = true;
+
+	// room object or anything inside it
+	bool inRoom() const { return depth() >= 2 && isArray(0) && !isArray(1); }
+	bool inRoomArray(std::string_view key) const { return depth() >= 3 && inRoom() && keyIs(1, key) && isArray(2); }
+
+	bool isRoomLevel() const { return depth() == 2 && inRoom(); }
+	bool isFilterLevel() const { return depth() == 3 && inRoom() && keyIs(1, "filter") && !isArray(2); }
+	bool isSensorLevel() const { return depth() == 4 && inRoomArray("sensors") && !isArray(3); }
+	bool isSettingLevel() const { return depth() == 4 && inRoomArray("temperatures") && !isArray(3); }
+	bool isSettingArrayLevel() const { return depth() == 5 && inRoomArray("temperatures") && !isArray(3) && isArray(4); }
+
+	void onOpen() {
+		if (depth() == 1) {
+			rootArray_ = isArray(0);
+		} else if (isRoomLevel()) {
+			auto &room = rooms_.emplace_back();
+			room.baseTemperature_ = 0;
+			room.temperatureMarginUp_ = 0;
+			room.temperatureMarginDown_ = 0;
+			primarySensor_.clear();
+			primaryKey_.clear();
+		} else if (isSensorLevel()) {
+			sensorAddress_.clear();
+			sensorKey_.clear();
+			sensorWeight_ = RoomConfig::Sensor{}.weight_;
+		} else if (isSettingLevel()) {
+			auto &setting = rooms_.back().temperatures_.emplace_back();
+			setting.timeFrom_ = 0;
+			setting.timeTo_ = 0;
+			timeFrom_.clear();
+			timeTo_.clear();
+		} else if (isSettingArrayLevel()) {
+			firstElement_ = true;
+		}
+	}
+
+	void onClose() {
+		if (isRoomLevel()) {
+			closeRoom(rooms_.back());
+		} else if (isSensorLevel()) {
+			addSensor(rooms_.back(), sensorAddress_, sensorWeight_, sensorKey_);
+		} else if (isSettingLevel()) {
+			auto &setting = rooms_.back().temperatures_.back();
+			try {
+				setting.timeFrom_ = ib::timeutils::parseTimeHHMM(timeFrom_);
+				setting.timeTo_ = ib::timeutils::parseTimeHHMM(timeTo_);
+			} catch (std::exception const &e) {
+				heating::logger.printf("Exception parsing temperature '%s' time ranges: %s\n", setting.name_.c_str(), e.what());
+			}
+		}
+	}
+
+	void onValue(std::string_view text, bool string) {
+		if (isRoomLevel()) {
+			auto &room = rooms_.back();
+			if (keyIs(1, "name") && string) {
+				room.name_ = text;
+			} else if (keyIs(1, "base_temp")) {
+				room.baseTemperature_ = static_cast<uint16_t>(toInt(text, string).value_or(0));
+			} else if (keyIs(1, "temp_margin_up")) {
+				room.temperatureMarginUp_ = static_cast<uint8_t>(toInt(text, string).value_or(0));
+			} else if (keyIs(1, "temp_margin_down")) {
+				room.temperatureMarginDown_ = static_cast<uint8_t>(toInt(text, string).value_or(0));
+			} else if (keyIs(1, "enabled")) {
+				room.enabled_ = isTrue(text, string);
+			} else if (keyIs(1, "sensor") && string) {
+				primarySensor_ = text;
+			} else if (keyIs(1, "sensor_key") && string) {
+				primaryKey_ = text;
+			}
+		} else if (isFilterLevel()) {
+			filterValue(rooms_.back().filter_, text, string);
+		} else if (isSensorLevel()) {
+			if (keyIs(3, "address") && string) {
+				sensorAddress_ = text;
+			} else if (keyIs(3, "key") && string) {
+				sensorKey_ = text;
+			} else if (keyIs(3, "weight")) {
+				sensorWeight_ = static_cast<uint8_t>(toInt(text, string).value_or(sensorWeight_));
+			}
+		} else if (isSettingLevel()) {
+			auto &setting = rooms_.back().temperatures_.back();
+			if (keyIs(3, "name") && string) {
+				setting.name_ = text;
+			} else if (keyIs(3, "time_from") && string) {
+				timeFrom_ = text;
+			} else if (keyIs(3, "time_to") && string) {
+				timeTo_ = text;
+			} else if (keyIs(3, "temp")) {
+				setting.temperature_ = static_cast<int16_t>(toInt(text, string).value_or(0));
+			} else if (keyIs(3, "boiler_temp")) {
+				auto value = toInt(text, string);
+				setting.heatingTemperatureOverride_ = value ? std::optional<uint8_t>(static_cast<uint8_t>(*value)) : std::nullopt;
+			} else if (keyIs(3, "enabled")) {
+				setting.enabled_ = isTrue(text, string);
+			}
+		}
+	}
+
+	void onElement(std::string_view text, bool string) {
+		if (depth() == 3 && inRoom() && isArray(2)) {
+			if (keyIs(1, "valves")) {
+				addValve(rooms_.back().valves_, text, string);
+			} else if (keyIs(1, "sensors") && string) {
+				addSensor(rooms_.back(), text, RoomConfig::Sensor{}.weight_, {});
+			}
+		} else if (isSettingArrayLevel()) {
+			auto &setting = rooms_.back().temperatures_.back();
+			if (keyIs(3, "valves")) {
+				addValve(setting.valves_, text, string);
+			} else if (keyIs(3, "days")) {
+				if (firstElement_) {
+					setting.days_ = {{false, false, false, false, false, false, false}};
+					firstElement_ = false;
+				}
+				auto day = toInt(text, string);
+				if (day && *day >= 0 && *day < 7) {
+					setting.days_[*day] = true;
+				}
+			}
+		}
+	}
+
+	void filterValue(TemperatureFilterConfig &filter, std::string_view text, bool string) {
+		using method_t = TemperatureFilterConfig::method_t;
+		if (keyIs(2, "method") && string) {
+			if (text == "mean") {
+				filter.method = method_t::mean;
+			} else if (text == "median") {
+				filter.method = method_t::median;
+			} else if (text == "ewma") {
+				filter.method = method_t::ewma;
+			} else if (text == "trimmed_mean") {
+				filter.method = method_t::trimmedMean;
+			}
+		} else if (keyIs(2, "staleness_weighting")) {
+			filter.stalenessWeighting = isTrue(text, string);
+		} else if (auto value = toInt(text, string)) {
+			if (keyIs(2, "outlier_tolerance")) {
+				filter.outlierTolerance = static_cast<uint16_t>(*value);
+			} else if (keyIs(2, "max_rate")) {
+				filter.maxRatePerMinute = static_cast<uint16_t>(*value);
+			} else if (keyIs(2, "ewma_alpha")) {
+				filter.ewmaAlpha = static_cast<uint8_t>(*value);
+			} else if (keyIs(2, "min_confidence")) {
+				filter.minConfidence = static_cast<uint8_t>(*value);
+			} else if (keyIs(2, "max_age")) {
+				filter.maxSampleAge = std::chrono::seconds(static_cast<uint16_t>(*value));
+			} else if (keyIs(2, "sample_interval")) {
+				filter.sampleInterval = std::chrono::seconds(static_cast<uint16_t>(*value));
+			}
+		}
+	}
+
+	// number the way cJSON gives it as valueint - truncated, saturated
+	static std::optional<int> toInt(std::string_view text, bool string) {
+		if (string) {
+			return std::nullopt;
+		}
+		char *end = nullptr;
+		double value = std::strtod(text.data(), &end);
+		if (end == text.data()) {
+			return std::nullopt; // true, false, null
+		}
+		return value >= INT_MAX ? INT_MAX : value <= INT_MIN ? INT_MIN : static_cast<int>(value);
+	}
+
+	static bool isTrue(std::string_view text, bool string) { return !string && text == "true"; }
+
+	static void addValve(std::vector<std::string> &valves, std::string_view text, bool string) {
+		if (string) {
+			valves.emplace_back(text);
+		} else if (auto index = toInt(text, string)) {
+			valves.push_back(std::to_string(*index)); // backward compat: index as string
+		}
+	}
+
+	static void addSensor(RoomConfig &room, std::string_view address, uint8_t weight, std::string_view bindKey) {
+		if (address.empty()) {
+			return;
+		}
+		auto bleAddress = parseBleAddress(address);
+		if (!bleAddress) {
+			return;
+		}
+		auto found = std::find_if(room.sensors_.begin(), room.sensors_.end(), [&bleAddress](auto const &sensor) { return sensor.address_ == *bleAddress; });
+		if (found == room.sensors_.end()) {
+			room.sensors_.push_back({*bleAddress, weight, parseBindKey(bindKey)});
+		}
+	}
+
+	// "sensor" is the primary one wherever it appears in the room, "sensors" repeating it are dropped
+	void closeRoom(RoomConfig &room) {
+		if (primarySensor_.empty()) {
+			return;
+		}
+		auto bleAddress = parseBleAddress(primarySensor_);
+		if (!bleAddress) {
+			return;
+		}
+		room.sensors_.erase(std::remove_if(room.sensors_.begin(), room.sensors_.end(), [&bleAddress](auto const &sensor) { return sensor.address_ == *bleAddress; }), room.sensors_.end());
+		room.sensors_.insert(room.sensors_.begin(), {*bleAddress, RoomConfig::Sensor{}.weight_, parseBindKey(primaryKey_)});
+	}
+
+	std::vector<RoomConfig> &rooms_;
+	// members kept until their object closes, in any order
+	std::string primarySensor_;
+	std::string primaryKey_;
+	std::string sensorAddress_;
+	std::string sensorKey_;
+	std::string timeFrom_;
+	std::string timeTo_;
+	uint8_t sensorWeight_ = RoomConfig::Sensor{}.weight_;
+	bool firstElement_ = false;
+	bool rootArray_ = false;
+};
+
+} // namespace heating
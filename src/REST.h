@@ -1,26 +1,51 @@
 #pragma once
 
 #include <esp_ota_ops.h>
-#include <SPIFFS.h>
+#include <lwip/sockets.h>
+#include <LittleFS.h>
 #include <WebServer.h>
 #include <Wire.h>
 #include <uri/UriBraces.h>
-#include <cJSON.h>
 
 #include "viewable_stringbuf.h"
+#include "AssetIndex.h"
+#include "CborStreamBuf.h"
+#include "ConnectionQueue.h"
 #include "HeatingController.h"
 
 #include "Network.h"
+#include "ProgramParser.h"
+#include "RequestParsers.h"
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
 #include <iomanip>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 namespace heating {
 
 using namespace std::string_view_literals;
 using namespace std::string_literals;
 
+namespace rest {
+static void serverTask(void *pvParameters);
+static void workerTask(void *pvParameters);
+static void liveTask(void *pvParameters);
+}
+
+// web asset image packed by scripts/pack_assets.py, linked through board_build.embed_files
+extern "C" uint8_t const assetImageStart[] asm("_binary__pio_assets_bin_start");
+extern "C" uint8_t const assetImageEnd[] asm("_binary__pio_assets_bin_end");
+
 class WebServerStringView : public WebServer {
 public:
 	WebServerStringView(uint16_t listenPort) : WebServer(listenPort) {
@@ -45,72 +70,424 @@ public:
 	void endResponse() { _finalizeResponse(); }
 
 	HTTPUpload *getUpload() { return _currentUpload.get(); }
+
+	// connection accepted by another task - served until the response was sent and the client closed it, or the
+	// WebServer's timeouts dropped it. This server never listens.
+	void serveClient(WiFiClient client) {
+		_currentClient = client;
+		_currentStatus = HC_WAIT_READ;
+		_statusChange = millis();
+		for (;;) {
+			handleClient();
+			if (_currentStatus == HC_NONE) {
+				return;
+			}
+			vTaskDelay(pdMS_TO_TICKS(2));
+		}
+	}
+
+	// takes over the connection of the current request - the server neither waits for it to close nor closes it
+	WiFiClient detachClient() {
+		WiFiClient client = _currentClient;
+		_currentClient = WiFiClient();
+		return client;
+	}
+};
+
+// Status written as JSON, or as CBOR when the client accepts it - the same writers produce both, CBOR is encoded while
+// they write so no JSON is kept for it. Status cache fragments are copied as encoded at their refresh.
+class StatusPayload {
+public:
+	explicit StatusPayload(bool cbor) : cbor_(cbor), stream_(cbor ? static_cast<std::streambuf *>(&cborBuf_) : &jsonBuf_) {}
+
+	std::ostream &stream() { return stream_; }
+	bool isCbor() const { return cbor_; }
+	// for writers copying CBOR encoded already, nullptr when JSON is written
+	CborStreamBuf *cbor() { return cbor_ ? &cborBuf_ : nullptr; }
+	std::string_view contentType() const { return cbor_ ? "application/cbor"sv : "application/json"sv; }
+
+	// false when the writers' JSON couldn't be encoded
+	bool finish() { return !cbor_ || cborBuf_.finish(); }
+	std::string_view view() { return cbor_ ? cborBuf_.view() : jsonBuf_.view(); }
+
+private:
+	bool cbor_;
+	ib::viewable_stringbuf jsonBuf_;
+	CborStreamBuf cborBuf_;
+	std::ostream stream_;
 };
 
+// Served from tasks of its own, so a slow client or an OTA upload doesn't hold up the controller loop - EMS telegrams,
+// MQTT keep-alives and control keep running. Connections are served concurrently by a few workers, handlers reach the
+// controller only through calls run on the controller task.
 class REST {
 public:
-	REST(HeatingController &controller, uint16_t listenPort) : controller_(controller), server_(listenPort) {
-		server_.enableCORS(true);
-		server_.enableCrossOrigin(true);
+	using networkReady_t = std::function<bool()>;
+
+	REST(HeatingController &controller, uint16_t listenPort, networkReady_t networkReady) : controller_(controller), listener_(listenPort), networkReady_(std::move(networkReady)) {
+		for (auto &worker : workers_) {
+			worker.rest = this;
+			addRoutes(worker.server);
+		}
+	}
+
+	// starts the server task once, it and the tasks it starts run until reboot
+	void begin() {
+		if (taskStarted_) {
+			return;
+		}
+		taskStarted_ = true;
+		xTaskCreate(heating::rest::serverTask, "RESTTask", serverStackSize, this, 1, NULL);
+	}
+
+	// any task - the server task restarts listening before it accepts the next client
+	void restart() {
+		restart_ = true;
+	}
+
+private:
+	static constexpr size_t workerCount = 3;          // connections served at once
+	static constexpr uint32_t workerStackSize = 6144; // handlers used to run on the loop task with ARDUINO_LOOP_STACK_SIZE
+	static constexpr uint32_t serverStackSize = 4096; // accepts connections, pumps live viewers
+	static constexpr std::chrono::milliseconds controllerTimeout{3000};
+	static constexpr size_t maxLiveViewers = 4; // each holds a socket as does every worker and the listener, lwIP has 10 by default
+	static constexpr unsigned long liveKeepAliveMs = 15000;
+	static constexpr long liveSendTimeoutMs = 200; // longest the live task waits for one viewer's socket
+
+	// One connection per worker. A connection is accepted only for a worker waiting for it, so a slow download or an
+	// upload holds one worker while the others serve. Live viewers are pumped by a task of their own, a viewer's send
+	// timeout holds up neither accepting nor serving.
+	void serve() {
+		indexAssets(); // before any worker reads the index
+		for (auto &worker : workers_) {
+			xTaskCreate(heating::rest::workerTask, "RESTWorker", workerStackSize, &worker, 1, NULL);
+		}
+		xTaskCreate(heating::rest::liveTask, "RESTLive", serverStackSize, this, 1, NULL);
+		for (;;) {
+			if (restart_.exchange(false)) {
+				listener_.end();
+				listener_.begin();
+				listener_.setNoDelay(true);
+			}
+			if (networkReady_() && connections_.hasIdleWorker()) {
+				if (auto client = listener_.available()) {
+					connections_.push(client);
+					continue;
+				}
+			}
+			vTaskDelay(pdMS_TO_TICKS(2));
+		}
+	}
+
+	struct OTAUpload {
+		bool started = false;
+		bool success = false;
+		bool claimed = false; // holds otaRunning_
+		const esp_partition_t *partition = nullptr;
+		size_t offset = 0;
+		esp_ota_handle_t handle = 0;
+		esp_err_t error = ESP_OK;
+		std::string errorMessage;
+		bool writeErrorReported = false;
+	};
+
+	// POST body handed over by the raw handler in chunks of HTTP_RAW_BUFLEN - fed to the parser as it arrives and, when
+	// the document is stored, written aside the target file to be renamed over it once accepted. Never held whole.
+	struct RequestBody {
+		std::variant<std::monostate, ProgramParser, ProgramSelectionParser, DebugOptionsParser, TemporaryOverrideParser, GpioTestParser> parser;
+		std::vector<heating::RoomConfig> rooms; // filled by ProgramParser
+		AssetHash hash;
+		size_t length = 0;
+		std::string target;
+		File file;
+		bool writeFailed = false;
+
+		template <typename Parser>
+		Parser &start(std::string targetFile) {
+			clear();
+			target = std::move(targetFile);
+			if (!target.empty()) {
+				file = LittleFS.open(aside().c_str(), FILE_WRITE);
+				writeFailed = !file;
+			}
+			if constexpr (std::is_same_v<Parser, ProgramParser>) {
+				return parser.emplace<ProgramParser>(rooms);
+			} else {
+				return parser.emplace<Parser>();
+			}
+		}
+
+		// parser of the body received, nullptr when there was none
+		template <typename Parser>
+		Parser *get() { return std::get_if<Parser>(&parser); }
+
+		void write(uint8_t const *data, size_t size) {
+			length += size;
+			hash.update(data, size);
+			if (file && file.write(data, size) != size) {
+				writeFailed = true;
+			}
+		}
+
+		void close() {
+			if (file) {
+				file.close();
+			}
+		}
+
+		// renamed over the target, a reset while writing leaves the previous one
+		bool store() {
+			close();
+			if (target.empty() || writeFailed || !LittleFS.rename(aside().c_str(), target.c_str())) {
+				discard();
+				return false;
+			}
+			target.clear();
+			return true;
+		}
+
+		void discard() {
+			close();
+			if (!target.empty()) {
+				LittleFS.remove(aside().c_str());
+				target.clear();
+			}
+		}
+
+		// parsed rooms can be large, released after each request
+		void clear() {
+			discard();
+			parser.emplace<std::monostate>();
+			std::vector<heating::RoomConfig>().swap(rooms);
+			hash = AssetHash{};
+			length = 0;
+			writeFailed = false;
+		}
 
-		server_.on("/status/wifi", [this]() {
+		// "/programs/a.json" -> "/programs/a.tmp", not listed as a program
+		std::string aside() const { return target.substr(0, target.rfind('.')) + ".tmp"; }
+	};
+
+	// serves a connection at a time with a WebServer of its own - workers share the routes, not a request
+	struct Worker {
+		REST *rest = nullptr;
+		WebServerStringView server{80}; // never listens, connections come from the server task
+		OTAUpload ota;
+		RequestBody body;
+	};
+
+	void work(Worker &worker) {
+		current_ = &worker;
+		for (;;) {
+			worker.server.serveClient(connections_.pop());
+			worker.body.clear();
+			connections_.done();
+		}
+	}
+
+	// the worker running the handler, set once on each worker task
+	static Worker &worker() { return *current_; }
+	static WebServerStringView &server() { return current_->server; }
+
+	void pumpLiveViewers() {
+		for (;;) {
+			pumpLive();
+			vTaskDelay(pdMS_TO_TICKS(2));
+		}
+	}
+
+	struct LiveViewer {
+		WiFiClient client;
+		uint32_t lastId = 0;
+		std::optional<uint32_t> snapshotTicket;
+		unsigned long lastWrite = 0;
+	};
+
+	// every worker's server has all routes, a handler answers through server() of the worker it runs on
+	void addRoutes(WebServerStringView &webServer) {
+		webServer.enableCORS(true);
+		webServer.enableCrossOrigin(true);
+
+		webServer.on("/status/wifi", [this]() {
 			DBGLOGREST("REST:wifiNetworks\n");
 
 			ib::viewable_stringbuf payloadBuf;
 			std::ostream payload(&payloadBuf);
 
 			getWiFiNetworks(payload);
-			server_.sendView(200, "application/json"sv, payloadBuf.view());
+			server().sendView(200, "application/json"sv, payloadBuf.view());
 		});
 
-		server_.on("/status", [this]() { status(); });
-		server_.on("/status/boiler", [this]() { boilerStatus(); });
-		server_.on("/status/ems", [this]() { emsStatus(); });
-		server_.on("/status/rooms", [this]() { roomsStatus(); });
-		server_.on("/status/devices", [this]() { devicesFound(); });
-		server_.on("/status/programs", HTTP_GET, [this]() { showPrograms(); }); // show available programs
-		server_.on("/status/version", [this]() { version(); });
-		server_.on("/params/boiler", [this]() { emsParams(); });
-
+		webServer.on("/status", [this]() { status(); }); // ?since=<version> only sections changed after it
+		webServer.on("/status/boiler", [this]() { boilerStatus(); });
+		webServer.on("/status/ems", [this]() { emsStatus(); });
+		webServer.on("/status/rooms", [this]() { roomsStatus(); });
+		webServer.on("/status/devices", [this]() { devicesFound(); });
+		webServer.on("/status/programs", HTTP_GET, [this]() { showPrograms(); }); // show available programs
+		webServer.on("/status/version", [this]() { version(); });
+		webServer.on("/status/assets", HTTP_GET, [this]() { assetsStatus(); });
+		webServer.on("/status/cache", HTTP_GET, [this]() { statusCacheStatus(); });
+		webServer.on("/status/server", HTTP_GET, [this]() { serverStatus(); });
+		webServer.on("/status/live", HTTP_GET, [this]() { subscribeLive(); }); // text/event-stream, snapshot then deltas
+		webServer.on("/params/boiler", [this]() { emsParams(); });
+
+
+		webServer.on("/config/temporary", HTTP_POST, [this]() { temporaryOverride(); }, [this]() { receiveBody<TemporaryOverrideParser>(); }); // GET/POST/DELETE name without .json, case sensitive
+
+		webServer.on(UriBraces("/config/programs/{}"), HTTP_ANY, [this]() { configPrograms(); }, [this]() { receiveProgram(); }); // GET/POST/DELETE name without .json, case sensitive
+		webServer.on("/config/wifi", [this]() { configWiFi(); });
+		webServer.on("/config/device", [this]() { configDevice(); });
+		webServer.on("/config/boiler", [this]() { configBoiler(); });
+		webServer.on("/config/curve/learnt", [this]() { configLearntCurve(); }); // GET preview, POST apply
+		webServer.on("/config/hardware", [this]() { configHardware(); });
+		webServer.on("/hardware/i2c/scan", HTTP_GET, [this]() { i2cScan(); });
+		webServer.on("/hardware/test/gpio", HTTP_POST, [this]() { gpioTestStart(); }, [this]() { receiveBody<GpioTestParser>(); });
+		webServer.on("/hardware/test/gpio", HTTP_DELETE, [this]() { gpioTestStop(); });
+		webServer.on("/config/debug", HTTP_ANY, [this]() { configDebug(); }, [this]() { receiveBody<DebugOptionsParser>("/cfg/cfgdebug.json"); });
+
+		webServer.on("/config/program/current", HTTP_ANY, [this]() { configProgramCurrent(); }, [this]() { receiveBody<ProgramSelectionParser>("/cfg/cfgprogram.json"); }); // get selected program
+		webServer.on("/config/reboot", HTTP_GET, [this]() { configReboot(); });
+
+		webServer.on("/ota", HTTP_POST, [this]() { handleOTAResponse(); }, [this]() { handleOTAUpdate(); });
+		webServer.on("/otafs", HTTP_POST, [this]() { handleOTAResponse(); }, [this]() { handleOTAFFSUpdate(); });
+
+		webServer.on("/", HTTP_GET, [this]() { index(); });
+
+		webServer.onNotFound([this]() {
+			serveFile(server().uri().c_str());
+		});
 
-		server_.on("/config/temporary", HTTP_POST, [this]() { temporaryOverride(); }); // GET/POST/DELETE name without .json, case sensitive
+		const char *headers[] = {"If-None-Match", "Last-Event-ID", "Accept"};
+		webServer.collectHeaders(headers, 3);
+	}
 
-		server_.on(UriBraces("/config/programs/{}"), [this]() { configPrograms(); }); // GET/POST/DELETE name without .json, case sensitive
-		server_.on("/config/wifi", [this]() { configWiFi(); });
-		server_.on("/config/device", [this]() { configDevice(); });
-		server_.on("/config/boiler", [this]() { configBoiler(); });
-		server_.on("/config/hardware", [this]() { configHardware(); });
-		server_.on("/hardware/i2c/scan", HTTP_GET, [this]() { i2cScan(); });
-		server_.on("/hardware/test/gpio", HTTP_POST, [this]() { gpioTestStart(); });
-		server_.on("/hardware/test/gpio", HTTP_DELETE, [this]() { gpioTestStop(); });
-		server_.on("/config/debug", [this]() { configDebug(); });
+	// worker task - the connection is handed to the live task, which streams to it from then on
+	void subscribeLive() {
+		if (liveViewerCount_.fetch_add(1) >= maxLiveViewers) {
+			liveViewerCount_--;
+			server().send(503, "text/plain", "Too many viewers");
+			return;
+		}
+		auto &live = controller_.getLiveStatus();
+		LiveViewer viewer{server().detachClient()};
+		timeval sendTimeout{0, liveSendTimeoutMs * 1000};
+		setsockopt(viewer.client.fd(), SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+		viewer.client.print("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\nretry: 3000\n\n");
+		viewer.lastWrite = millis();
+
+		// "<epoch>-<id>" of the last event the browser got, resumes with deltas when they are still kept
+		unsigned epoch = 0;
+		unsigned lastId = 0;
+		if (sscanf(server().header("Last-Event-ID").c_str(), "%x-%u", &epoch, &lastId) == 2 && epoch == live.getEpoch()) {
+			viewer.lastId = lastId;
+		} else {
+			viewer.snapshotTicket = live.requestSnapshot();
+		}
+		live.addViewer();
+		DBGLOGREST("Live viewer connected, resume: %d, viewers: %zu\n", !viewer.snapshotTicket, liveViewerCount_.load());
+		std::lock_guard<std::mutex> lock(subscribedMutex_);
+		subscribed_.push_back(std::move(viewer));
+	}
 
-		server_.on("/config/program/current", [this]() { configProgramCurrent(); }); // get selected program
-		server_.on("/config/reboot", HTTP_GET, [this]() { configReboot(); });
+	// live task - sends what the controller task published since each viewer's last event, drops viewers which
+	// disconnected or can't keep up; the browser reconnects and starts again from a snapshot
+	void pumpLive() {
+		{
+			std::lock_guard<std::mutex> lock(subscribedMutex_);
+			std::move(subscribed_.begin(), subscribed_.end(), std::back_inserter(liveViewers_));
+			subscribed_.clear();
+		}
+		if (liveViewers_.empty()) {
+			return;
+		}
+		auto &live = controller_.getLiveStatus();
+		auto now = millis();
+		for (auto it = liveViewers_.begin(); it != liveViewers_.end();) {
+			if (sendLive(live, *it, now)) {
+				++it;
+			} else {
+				it->client.stop();
+				it = liveViewers_.erase(it);
+				liveViewerCount_--;
+				live.removeViewer();
+				DBGLOGREST("Live viewer dropped, viewers: %zu\n", liveViewers_.size());
+			}
+		}
+	}
 
-		server_.on("/ota", HTTP_POST, [this]() { handleOTAResponse(); }, [this]() { handleOTAUpdate(); });
-		server_.on("/otafs", HTTP_POST, [this]() { handleOTAResponse(); }, [this]() { handleOTAFFSUpdate(); });
+	bool sendLive(LiveStatus &live, LiveViewer &viewer, unsigned long now) {
+		if (!viewer.client.connected()) {
+			return false;
+		}
+		std::vector<LiveStatus::Event> events;
+		if (viewer.snapshotTicket) {
+			auto snapshot = live.getSnapshot(*viewer.snapshotTicket);
+			if (snapshot) {
+				viewer.snapshotTicket.reset();
+				viewer.lastId = snapshot->id;
+				if (!writeLiveEvent(live, viewer, "snapshot", *snapshot)) {
+					return false;
+				}
+			}
+		} else if (!live.getEventsSince(viewer.lastId, events)) {
+			viewer.snapshotTicket = live.requestSnapshot(); // fell behind the kept events
+		}
+		for (auto const &event : events) {
+			viewer.lastId = event.id;
+			if (!writeLiveEvent(live, viewer, "delta", event)) {
+				return false;
+			}
+		}
+		if (events.empty() && now - viewer.lastWrite >= liveKeepAliveMs) {
+			viewer.lastWrite = now;
+			return writeLive(viewer, ": keep-alive\n\n"sv); // finds connections closed without FIN
+		}
+		return true;
+	}
 
-		server_.on("/", HTTP_GET, [this]() { index(); });
+	bool writeLiveEvent(LiveStatus const &live, LiveViewer &viewer, char const *type, LiveStatus::Event const &event) {
+		char header[64];
+		auto length = snprintf(header, sizeof(header), "id: %x-%u\nevent: %s\ndata: ", static_cast<unsigned>(live.getEpoch()), static_cast<unsigned>(event.id), type);
+		std::string message; // JSON is on one line, fits one data field
+		message.reserve(length + event.data.size() + 2);
+		message.append(header, length).append(event.data).append("\n\n");
+		viewer.lastWrite = millis();
+		return writeLive(viewer, message);
+	}
 
-		server_.onNotFound([this]() {
-			serveFile(server_.uri().c_str());
-		});
+	// one send bounded by the socket's send timeout - WiFiClient::write retries for seconds. Partially sent means the
+	// viewer can't keep up, the caller drops it as the stream can't be resumed mid event.
+	bool writeLive(LiveViewer &viewer, std::string_view data) {
+		auto sent = ::send(viewer.client.fd(), data.data(), data.size(), 0);
+		return sent == static_cast<ssize_t>(data.size());
 	}
 
-	void restart() {
-		server_.stop();
-		server_.begin();
+	// runs the call on the controller task, answers 503 when the controller doesn't get to it in time
+	template <typename F>
+	bool onController(F &&call) {
+		if (controller_.runOnControllerTask(std::forward<F>(call), controllerTimeout)) {
+			return true;
+		}
+		DBGLOGREST("Controller busy, request '%s' not served\n", server().uri().c_str());
+		server().send(503, "text/plain", "Controller busy");
+		return false;
 	}
 
-	void handle() {
-		server_.handleClient();
+	// configuration is already stored - a reload the controller doesn't get to in time is left to its next loop, answered
+	// with 202
+	bool reloadOnController() {
+		if (controller_.runOnControllerTask([this] { controller_.reloadConfiguration(); }, controllerTimeout)) {
+			return true;
+		}
+		DBGLOGREST("Controller busy, reload after '%s' pending\n", server().uri().c_str());
+		controller_.requestReload();
+		server().send(202, "text/plain", "Configuration stored, reload pending");
+		return false;
 	}
 
-private:
 	// bool auth() {
-	// 	if (!server_.authenticate("admin", "admin")) {
-	// 		server_.requestAuthentication(DIGEST_AUTH);
+	// 	if (!server().authenticate("admin", "admin")) {
+	// 		server().requestAuthentication(DIGEST_AUTH);
 	// 		return false;
 	// 	}
 	// 	return true;
@@ -123,7 +500,7 @@ private:
 		std::ostream ss(&payloadBuf);
 
 		ss << "[";
-		File path = SPIFFS.open("/programs");
+		File path = LittleFS.open("/programs");
 		bool first = true;
 		while (path) {
 			using namespace std::string_view_literals;
@@ -158,62 +535,62 @@ private:
 
 		path.close();
 		ss << "]";
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		server().sendView(200, "application/json"sv, payloadBuf.view());
 	}
 
 	void configProgramCurrent() {
-		DBGLOGREST("configProgramCurrent method: %d\n", server_.method());
+		DBGLOGREST("configProgramCurrent method: %d\n", server().method());
 
-		switch (server_.method()) {
+		switch (server().method()) {
 			case HTTP_GET: {
-				File file = SPIFFS.open("/cfg/cfgprogram.json", FILE_READ);
+				File file = LittleFS.open("/cfg/cfgprogram.json", FILE_READ);
 				if (!file) {
 					DBGLOGREST("configProgramCurrent missing config");
-					server_.send(500, "text/plain", "Missing config");
+					server().send(500, "text/plain", "Missing config");
 					return;
 				}
-				server_.streamFile(file, "application/json");
+				server().streamFile(file, "application/json");
 				file.close();
 				break;
 			}
 			case HTTP_POST: {
-				if (!server_.hasArg("plain")) {
-					server_.send(500, "text/plain", "missing body");
+				auto &body = worker().body;
+				auto parser = body.get<ProgramSelectionParser>();
+				if (!parser || body.length == 0) {
+					server().send(500, "text/plain", "missing body");
 					return;
 				}
-				auto body = server_.arg("plain");
 
-				auto program = config::parseProgram(body.c_str());
-				if (program.empty()) {
+				if (!parser->finish()) {
 					DBGLOGREST("configProgramCurrent error parsing program\n");
-					server_.send(400, "text/html", "Program parsing failure. Config not modified");
+					server().send(400, "text/html", "Program parsing failure. Config not modified");
 					return;
 				}
+				auto const &program = parser->program();
 
 				std::string filename = "/programs/" + program + ".json";
 
-				if (!SPIFFS.exists(filename.c_str())) {
+				if (!LittleFS.exists(filename.c_str())) {
 					DBGLOGREST("Received new program configuration: '%s'. Program does not exists!\n", program.c_str());
-					server_.send(400, "text/html", "Program does not exists. Config not modified");
+					server().send(400, "text/html", "Program does not exists. Config not modified");
 					return;
 				}
 
 				DBGLOGREST("Received new program configuration: '%s'\n", program.c_str());
-				File file = SPIFFS.open("/cfg/cfgprogram.json", FILE_WRITE);
-				if (!file) {
-					server_.send(500, "text/html", "Filesystem failure. Unable to write program.");
+				if (!body.store()) {
+					server().send(500, "text/html", "Filesystem failure. Unable to write program.");
 					return;
 				}
-				file.write((uint8_t *)body.c_str(), body.length());
-				file.close();
 
-				server_.send(204);
-				controller_.reloadConfiguration();
+				if (!reloadOnController()) {
+					return;
+				}
+				server().send(204);
 				break;
 			}
 			default:
-				server_.sendHeader("Allow", "GET, POST");
-				server_.send(405);
+				server().sendHeader("Allow", "GET, POST");
+				server().send(405);
 				break;
 		}
 
@@ -222,49 +599,115 @@ private:
 
 	void configReboot() {
 		DBGLOGREST("configReboot\n");
-		server_.send(200);
-		server_.stop();
+		server().send(200);
+		server().stop();
 		ESP.restart();
 	}
 
 	void boilerStatus() {
 		DBGLOGREST("boilerStatus\n");
 
-		ib::viewable_stringbuf payloadBuf;
-		std::ostream payload(&payloadBuf);
-
-		controller_.getBoilerStatus(payload);
+		StatusPayload payload(acceptsCbor());
+		if (!onController([&] { controller_.getBoilerStatus(payload.stream()); })) {
+			return;
+		}
 
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		sendPayload(payload);
 	}
 
 	void emsStatus() {
 		DBGLOGREST("emsStatus\n");
 
-		ib::viewable_stringbuf payloadBuf;
-		std::ostream ss(&payloadBuf);
-		controller_.getEMSStatus(ss);
+		StatusPayload payload(acceptsCbor());
+		if (!onController([&] { controller_.getEMSStatus(payload.stream()); })) {
+			return;
+		}
 
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		sendPayload(payload);
 	}
 
 	void emsParams() {
 		DBGLOGREST("emsParams\n");
-		ib::viewable_stringbuf payloadBuf;
-		std::ostream payload(&payloadBuf);
-		controller_.getEMSBoilerParams(payload);
+		StatusPayload payload(acceptsCbor());
+		if (!onController([&] { controller_.getEMSBoilerParams(payload.stream()); })) {
+			return;
+		}
 
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		sendPayload(payload);
 	}
 
 	void status() {
 		DBGLOGREST("status\n");
-		server_.enableCORS(true);
+		server().enableCORS(true);
+		if (!refreshStatus()) {
+			return;
+		}
+
+		StatusPayload payload(acceptsCbor());
+		uint32_t version;
+		if (server().hasArg("since")) {
+			auto since = static_cast<uint32_t>(strtoul(server().arg("since").c_str(), nullptr, 10));
+			auto read = controller_.getStatusCache().write(payload.stream(), since, payload.cbor());
+			if (!read.full && read.version == since) {
+				server().send(304);
+				return;
+			}
+			version = read.version;
+		} else {
+			version = controller_.getFullStatus(payload.stream(), payload.cbor());
+		}
+		sendStatus(version, payload);
+	}
+
+	// renders on the controller task only fragments whose source changed, a clean cache is served as it is
+	bool refreshStatus() {
+		if (!controller_.getStatusCache().isDirty()) {
+			return true;
+		}
+		return onController([this] { controller_.refreshStatus(); });
+	}
+
+	// payload written from the status cache at the version - 304 when the client has it already
+	void sendStatus(uint32_t version, StatusPayload &payload) {
+		char etag[16];
+		snprintf(etag, sizeof(etag), "\"%08x%s\"", static_cast<unsigned>(version), payload.isCbor() ? "-cbor" : "");
+		server().sendHeader("ETag", etag);
+		server().sendHeader("Cache-Control", "no-cache");
+		if (server().header("If-None-Match") == etag) {
+			server().sendHeader("Vary", "Accept");
+			server().send(304);
+			return;
+		}
+		sendPayload(payload);
+	}
+
+	bool acceptsCbor() {
+		return server().header("Accept").indexOf("application/cbor") >= 0;
+	}
+
+	// 500 when the status couldn't be encoded as CBOR
+	void sendPayload(StatusPayload &payload) {
+		if (!payload.finish()) {
+			DBGLOGREST("CBOR encoding of '%s' failed\n", server().uri().c_str());
+			server().send(500, "text/plain", "Encoding failed");
+			return;
+		}
+		server().sendHeader("Vary", "Accept");
+		server().sendView(200, payload.contentType(), payload.view());
+	}
+
+	void statusCacheStatus() {
 		ib::viewable_stringbuf payloadBuf;
 		std::ostream payload(&payloadBuf);
-		controller_.getFullStatus(payload);
+		controller_.getStatusCache().getStatus(payload);
+		server().sendView(200, "application/json"sv, payloadBuf.view());
+	}
 
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+	void serverStatus() {
+		ib::viewable_stringbuf payloadBuf;
+		std::ostream payload(&payloadBuf);
+		connections_.getStatus(payload);
+		server().sendView(200, "application/json"sv, payloadBuf.view());
 	}
 
 	void version() {
@@ -286,59 +729,64 @@ private:
 		}
 		payload << "\"}";
 
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		server().sendView(200, "application/json"sv, payloadBuf.view());
 	}
 
 	void roomsStatus() {
 		DBGLOGREST("roomsStatus\n");
-		server_.enableCORS(true);
+		server().enableCORS(true);
 
-		ib::viewable_stringbuf payloadBuf;
-		std::ostream payload(&payloadBuf);
-		controller_.getRoomsStatus(payload);
+		if (!refreshStatus()) {
+			return;
+		}
 
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		StatusPayload payload(acceptsCbor());
+		auto version = controller_.getRoomsStatus(payload.stream(), payload.cbor());
+		sendStatus(version, payload);
 	}
 
 	void devicesFound() {
 		DBGLOGREST("devicesFound\n");
 		ib::viewable_stringbuf payloadBuf;
 		std::ostream payload(&payloadBuf);
-		controller_.getDevicesFound(payload);
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		bool details = server().hasArg("details");
+		if (!onController([&] { controller_.getDevicesFound(payload, details); })) {
+			return;
+		}
+		server().sendView(200, "application/json"sv, payloadBuf.view());
 	}
 
 	void configWiFi() {
-		DBGLOGREST("configWiFi METHOD %d\n", server_.method());
+		DBGLOGREST("configWiFi METHOD %d\n", server().method());
 
-		switch (server_.method()) {
+		switch (server().method()) {
 			default:
 			case HTTP_GET: {
 				ib::viewable_stringbuf payloadBuf;
 				std::ostream payload(&payloadBuf);
 				getWiFiSSID(payload);
-				server_.sendView(200, "application/json"sv, payloadBuf.view());
+				server().sendView(200, "application/json"sv, payloadBuf.view());
 				break;
 			}
 			case HTTP_POST: {
-				if (!server_.hasArg("plain")) {
-					server_.send(204);
+				if (!server().hasArg("plain")) {
+					server().send(204);
 					break;
 				}
-				auto body = server_.arg("plain");
+				auto body = server().arg("plain");
 				if (body.isEmpty()) {
-					server_.send(204);
+					server().send(204);
 					break;
 				}
 
-				File file = SPIFFS.open("/cfg/cfgwifi.json", FILE_WRITE);
+				File file = LittleFS.open("/cfg/cfgwifi.json", FILE_WRITE);
 				if (!file) {
-					server_.send(500, "text/plain", "Internal server error. Can't save wifi settings.");
+					server().send(500, "text/plain", "Internal server error. Can't save wifi settings.");
 					break;
 				}
 				file.write((uint8_t *)body.c_str(), body.length());
 				file.close();
-				server_.send(201);
+				server().send(201);
 				break;
 			}
 		}
@@ -346,80 +794,80 @@ private:
 	}
 
 	void configDevice() {
-		DBGLOGREST("configDevice METHOD %d\n", server_.method());
+		DBGLOGREST("configDevice METHOD %d\n", server().method());
 
-		switch (server_.method()) {
+		switch (server().method()) {
 			default:
 			case HTTP_GET: {
-				File file = SPIFFS.open("/cfg/cfgnetwork.json", FILE_READ);
+				File file = LittleFS.open("/cfg/cfgnetwork.json", FILE_READ);
 				if (!file) {
-					server_.send(404, "text/plain", "FileNotFound");
+					server().send(404, "text/plain", "FileNotFound");
 					return;
 				}
-				server_.streamFile(file, "application/json");
+				server().streamFile(file, "application/json");
 				file.close();
 				break;
 			}
 			case HTTP_POST: {
-				if (!server_.hasArg("plain")) {
-					server_.send(204);
+				if (!server().hasArg("plain")) {
+					server().send(204);
 					break;
 				}
-				auto body = server_.arg("plain");
+				auto body = server().arg("plain");
 				if (body.isEmpty()) {
-					server_.send(204);
+					server().send(204);
 					break;
 				}
 
-				File file = SPIFFS.open("/cfg/cfgnetwork.json", FILE_WRITE);
+				File file = LittleFS.open("/cfg/cfgnetwork.json", FILE_WRITE);
 				if (!file) {
 					DBGLOGREST("configDevice. Can't open config file for write.\n");
-					server_.send(500, "text/plain", "Internal server error. Can't save device settings.");
+					server().send(500, "text/plain", "Internal server error. Can't save device settings.");
 					break;
 				}
 				file.write((uint8_t *)body.c_str(), body.length());
 				file.close();
-				server_.send(201);
+				server().send(201);
 				break;
 			}
 		}
 	}
 
 	void configHardware() {
-		DBGLOGREST("configHardware METHOD %d\n", server_.method());
+		DBGLOGREST("configHardware METHOD %d\n", server().method());
 
-		switch (server_.method()) {
+		switch (server().method()) {
 			default:
 			case HTTP_GET: {
-				File file = SPIFFS.open("/cfg/cfgpins.json", FILE_READ);
+				File file = LittleFS.open("/cfg/cfgpins.json", FILE_READ);
 				if (!file) {
-					server_.send(404, "text/plain", "FileNotFound");
+					server().send(404, "text/plain", "FileNotFound");
 					return;
 				}
-				server_.streamFile(file, "application/json");
+				server().streamFile(file, "application/json");
 				file.close();
 				break;
 			}
 			case HTTP_POST: {
-				if (!server_.hasArg("plain")) {
-					server_.send(204);
+				if (!server().hasArg("plain")) {
+					server().send(204);
 					break;
 				}
-				auto body = server_.arg("plain");
+				auto body = server().arg("plain");
 				if (body.isEmpty()) {
-					server_.send(204);
+					server().send(204);
 					break;
 				}
 
-				File file = SPIFFS.open("/cfg/cfgpins.json", FILE_WRITE);
+				File file = LittleFS.open("/cfg/cfgpins.json", FILE_WRITE);
 				if (!file) {
 					DBGLOGREST("configHardware. Can't open config file for write.\n");
-					server_.send(500, "text/plain", "Internal server error. Can't save hardware settings.");
+					server().send(500, "text/plain", "Internal server error. Can't save hardware settings.");
 					break;
 				}
 				file.write((uint8_t *)body.c_str(), body.length());
 				file.close();
-				server_.send(201);
+				server().send(201);
 				break;
 			}
 		}
@@ -447,83 +895,83 @@ private:
 		ss << "[";
 		bool first = true;
 
-		for (uint8_t addr = 0x03; addr < 0x78; ++addr) {
-			Wire.beginTransmission(addr);
-			if (Wire.endTransmission() == 0) {
-				const char *guessedType = "unknown";
-				for (auto const &r : ranges) {
-					if (addr >= r.from && addr <= r.to) {
-						guessedType = r.type;
-						break;
+		// controller drives the extenders and the RTC on the same bus
+		bool scanned = onController([&] {
+			for (uint8_t addr = 0x03; addr < 0x78; ++addr) {
+				Wire.beginTransmission(addr);
+				if (Wire.endTransmission() == 0) {
+					const char *guessedType = "unknown";
+					for (auto const &r : ranges) {
+						if (addr >= r.from && addr <= r.to) {
+							guessedType = r.type;
+							break;
+						}
 					}
+					if (!first)
+						ss << ",";
+					first = false;
+					ss << "{\"address\":" << static_cast<int>(addr) << ",\"type\":\"" << guessedType << "\"}";
 				}
-				if (!first)
-					ss << ",";
-				first = false;
-				ss << "{\"address\":" << static_cast<int>(addr) << ",\"type\":\"" << guessedType << "\"}";
 			}
+		});
+		if (!scanned) {
+			return;
 		}
 		ss << "]";
 
-		server_.sendView(200, "application/json"sv, payloadBuf.view());
+		server().sendView(200, "application/json"sv, payloadBuf.view());
 	}
 
 	void gpioTestStart() {
 		DBGLOGREST("gpioTestStart\n");
 
-		if (!server_.hasArg("plain")) {
-			server_.send(400, "text/plain", "Missing body");
+		auto &body = worker().body;
+		auto parser = body.get<GpioTestParser>();
+		if (!parser) {
+			server().send(400, "text/plain", "Missing body");
 			return;
 		}
-		auto body = server_.arg("plain");
-		if (body.isEmpty()) {
-			server_.send(400, "text/plain", "Empty body");
+		if (body.length == 0) {
+			server().send(400, "text/plain", "Empty body");
 			return;
 		}
 
-		std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(body.c_str()), &cJSON_Delete);
-		if (!root) {
-			server_.send(400, "text/plain", "Invalid JSON");
+		if (!parser->finish()) {
+			server().send(400, "text/plain", "Invalid JSON");
 			return;
 		}
 
-		auto durationObj = cJSON_GetObjectItem(root.get(), "duration");
-		if (!durationObj || !cJSON_IsNumber(durationObj) || durationObj->valueint <= 0 || durationObj->valueint > 3600) {
-			server_.send(400, "text/plain", "Invalid duration (1-3600s)");
+		auto durationValue = parser->duration();
+		if (!durationValue || *durationValue <= 0 || *durationValue > 3600) {
+			server().send(400, "text/plain", "Invalid duration (1-3600s)");
 			return;
 		}
-		uint32_t duration = durationObj->valueint;
-
-		auto boilerObj = cJSON_GetObjectItem(root.get(), "boiler");
-		bool boilerState = boilerObj && cJSON_IsTrue(boilerObj);
+		uint32_t duration = *durationValue;
 
-		auto valvesArr = cJSON_GetObjectItem(root.get(), "valves");
-		std::vector<bool> valveStates;
-		if (valvesArr && cJSON_IsArray(valvesArr)) {
-			int size = cJSON_GetArraySize(valvesArr);
-			for (int i = 0; i < size; ++i) {
-				auto item = cJSON_GetArrayItem(valvesArr, i);
-				valveStates.push_back(cJSON_IsTrue(item));
-			}
-		}
+		bool boilerState = parser->boiler();
+		auto const &valveStates = parser->valves();
 
 		DBGLOGREST("gpioTestStart boiler: %d, valves: %zu, duration: %ds\n", boilerState, valveStates.size(), duration);
-		controller_.startManualGpioTest(boilerState, valveStates, duration);
-		server_.send(200, "text/plain", "OK");
+		if (!onController([&] { controller_.startManualGpioTest(boilerState, valveStates, duration); })) {
+			return;
+		}
+		server().send(200, "text/plain", "OK");
 	}
 
 	void gpioTestStop() {
 		DBGLOGREST("gpioTestStop\n");
-		controller_.stopManualGpioTest();
-		server_.send(200, "text/plain", "OK");
+		if (!onController([this] { controller_.stopManualGpioTest(); })) {
+			return;
+		}
+		server().send(200, "text/plain", "OK");
 	}
 
 	void configDebug() {
-		DBGLOGREST("configDebug METHOD %d\n", server_.method());
+		DBGLOGREST("configDebug METHOD %d\n", server().method());
 
 		#define DEBUG_OPTION_TO_STREAM(name) "\""#name"\": " << (debug::debug.name ? "true" : "false")
 
-		switch (server_.method()) {
+		switch (server().method()) {
 			default:
 			case HTTP_GET: {
 				ib::viewable_stringbuf payloadBuf;
@@ -542,34 +990,32 @@ private:
 				ss << DEBUG_OPTION_TO_STREAM(debugMQTT) << ",";
 				ss << DEBUG_OPTION_TO_STREAM(debugFatal);
 				ss << "}";
-				server_.sendView(200, "application/json"sv, payloadBuf.view());
+				server().sendView(200, "application/json"sv, payloadBuf.view());
 				break;
 			}
 			case HTTP_POST: {
-				if (!server_.hasArg("plain")) {
-					server_.send(204);
-					return;
-				}
-				auto body = server_.arg("plain");
-				if (body.isEmpty()) {
-					server_.send(204);
+				auto &body = worker().body;
+				auto parser = body.get<DebugOptionsParser>();
+				if (!parser || body.length == 0) {
+					server().send(204);
 					return;
 				}
 
-				config::setDebugOptionsFromJson(body.c_str());
+				if (!parser->finish()) {
+					DBGLOGREST("configDebug. Malformed options.\n");
+					server().send(400, "text/plain", "Debug options parsing failure. Config not modified");
+					break;
+				}
 				DBGLOGREST("configDebug. Flags set.\n");
 
-				File file = SPIFFS.open("/cfg/cfgdebug.json", FILE_WRITE);
-				if (!file) {
-					DBGLOGREST("configDebug. Can't open config file for write.\n");
-					server_.send(500, "text/plain", "Internal server error. Can't save hardware settings.");
+				if (!body.store()) {
+					DBGLOGREST("configDebug. Can't write config file.\n");
+					server().send(500, "text/plain", "Internal server error. Can't save hardware settings.");
 					break;
 				}
-				file.write((uint8_t *)body.c_str(), body.length());
-				file.close();
 
 				DBGLOGREST("configDebug. Flags stored.\n");
-				server_.send(201);
+				server().send(201);
 				break;
 			}
 
@@ -578,258 +1024,356 @@ private:
 
 
 	void configBoiler() {
-		DBGLOGREST("configBoiler METHOD %d\n", server_.method());
+		DBGLOGREST("configBoiler METHOD %d\n", server().method());
 
-		switch (server_.method()) {
+		switch (server().method()) {
 			default:
 			case HTTP_GET: {
-				File file = SPIFFS.open("/cfg/cfgboiler.json", FILE_READ);
+				File file = LittleFS.open("/cfg/cfgboiler.json", FILE_READ);
 				if (!file) {
-					server_.send(404, "text/plain", "FileNotFound");
+					server().send(404, "text/plain", "FileNotFound");
 					return;
 				}
-				server_.streamFile(file, "application/json");
+				server().streamFile(file, "application/json");
 				file.close();
 				break;
 			}
 			case HTTP_POST: {
-				if (!server_.hasArg("plain")) {
-					server_.send(204);
+				if (!server().hasArg("plain")) {
+					server().send(204);
 					break;
 				}
-				auto body = server_.arg("plain");
+				auto body = server().arg("plain");
 				if (body.isEmpty()) {
-					server_.send(204);
+					server().send(204);
 					break;
 				}
 
-				File file = SPIFFS.open("/cfg/cfgboiler.json", FILE_WRITE);
+				File file = LittleFS.open("/cfg/cfgboiler.json", FILE_WRITE);
 				if (!file) {
 					DBGLOGREST("configBoiler. Can't open config file for write.\n");
-					server_.send(500, "text/plain", "Internal server error. Can't save boiler settings.");
+					server().send(500, "text/plain", "Internal server error. Can't save boiler settings.");
 					break;
 				}
 				file.write((uint8_t *)body.c_str(), body.length());
 				file.close();
-				server_.send(201);
+				server().send(201);
 				break;
 			}
 		}
 	}
 
-	void temporaryOverride() {
-		if (!server_.hasArg("plain")) {
-			server_.send(204);
-			return;
+	void configLearntCurve() {
+		DBGLOGREST("configLearntCurve METHOD %d\n", server().method());
+
+		switch (server().method()) {
+			case HTTP_GET: {
+				ib::viewable_stringbuf payloadBuf;
+				std::ostream payload(&payloadBuf);
+				if (!onController([&] { controller_.getCurveSuggestion(payload); })) {
+					return;
+				}
+				server().sendView(200, "application/json"sv, payloadBuf.view());
+				break;
+			}
+			case HTTP_POST: {
+				ib::viewable_stringbuf payloadBuf;
+				std::ostream payload(&payloadBuf);
+				auto result = HeatingController::ApplyCurveResult::NOT_READY;
+				if (!onController([&] {
+						result = controller_.applyLearntCurve();
+						if (result == HeatingController::ApplyCurveResult::APPLIED) {
+							controller_.getCurveSuggestion(payload);
+						}
+					})) {
+					return;
+				}
+				switch (result) {
+					case HeatingController::ApplyCurveResult::APPLIED: {
+						server().sendView(200, "application/json"sv, payloadBuf.view());
+						break;
+					}
+					case HeatingController::ApplyCurveResult::NOT_READY:
+						server().send(409, "text/plain", "Not enough history to suggest heating curve. Config not modified");
+						break;
+					case HeatingController::ApplyCurveResult::SAVE_FAILED:
+						server().send(500, "text/plain", "Internal server error. Can't save boiler settings.");
+						break;
+				}
+				break;
+			}
+			default:
+				server().sendHeader("Allow", "GET, POST");
+				server().send(405);
+				break;
 		}
-		auto body = server_.arg("plain");
-		if (body.isEmpty()) {
-			server_.send(204);
+	}
+
+	void temporaryOverride() {
+		auto &body = worker().body;
+		auto parser = body.get<TemporaryOverrideParser>();
+		if (!parser || body.length == 0) {
+			server().send(204);
 			return;
 		}
-
-		std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(body.c_str()), &cJSON_Delete);
-
-		auto obj = cJSON_GetObjectItem(root.get(), "temperature");
-		if (!obj || obj->type != cJSON_Number) {
-			DBGLOGREST("temporaryOverride bad request: '%s'\n", body.c_str())
-			server_.send(400, "text/html", "Bad request. Missing temperature.");
+		if (!parser->finish() || !parser->temperature()) {
+			DBGLOGREST("temporaryOverride bad request: missing temperature\n")
+			server().send(400, "text/html", "Bad request. Missing temperature.");
 			return;
 		}
-		auto temperature = obj->valueint;
+		auto temperature = *parser->temperature();
 
-		obj = cJSON_GetObjectItem(root.get(), "validSeconds");
-		if (!obj || obj->type != cJSON_Number) {
-			DBGLOGREST("temporaryOverride bad request: '%s'\n", body.c_str())
-			server_.send(400, "text/html", "Bad request. Missing time.");
+		if (!parser->validSeconds()) {
+			DBGLOGREST("temporaryOverride bad request: missing time\n")
+			server().send(400, "text/html", "Bad request. Missing time.");
 			return;
 		}
-		auto validSeconds = obj->valueint;
+		auto validSeconds = *parser->validSeconds();
 
-		obj = cJSON_GetObjectItem(root.get(), "roomName");
-		if (!obj || obj->type != cJSON_String) {
-			DBGLOGREST("temporaryOverride bad request: '%s'\n", body.c_str())
-			server_.send(400, "text/html", "Bad request. Missing room name.");
+		if (!parser->roomName()) {
+			DBGLOGREST("temporaryOverride bad request: missing room name\n")
+			server().send(400, "text/html", "Bad request. Missing room name.");
 			return;
 		}
-		auto roomName = obj->valuestring;
+		auto roomName = parser->roomName()->c_str();
 
 		DBGLOGREST("temporaryOverride '%s' temp: %d secs: %d\n", roomName, temperature, validSeconds);
 
-		if (!controller_.setRoomTemporaryTemperature(roomName, temperature, validSeconds)) {
+		bool found = false;
+		if (!onController([&] { found = controller_.setRoomTemporaryTemperature(roomName, temperature, validSeconds); })) {
+			return;
+		}
+		if (!found) {
 			std::stringstream error;
 			error << "Room " << roomName << " not found";
 			std::string errorStr = error.str();
-			server_.send(404, "text/plain", errorStr.c_str());
+			server().send(404, "text/plain", errorStr.c_str());
 			return;
 		}
-		server_.send(201);
+		server().send(201);
+	}
+
+	// name from the path, one that would leave /programs is refused
+	static bool isValidProgramName(String const &programName) {
+		return programName.indexOf("..") < 0 && programName.indexOf('/') < 0 && programName.indexOf('\\') < 0;
 	}
 
 	void configPrograms() {
-		auto programName = server_.pathArg(0);
-		if (programName.indexOf("..") >= 0 || programName.indexOf('/') >= 0 || programName.indexOf('\\') >= 0) {
-			server_.send(400, "text/plain", "Invalid program name");
+		auto programName = server().pathArg(0);
+		if (!isValidProgramName(programName)) {
+			server().send(400, "text/plain", "Invalid program name");
 			return;
 		}
 		String filename = "/programs/" + programName + ".json";
 
-		DBGLOGREST("configPrograms for '%s' METHOD %d\n", filename.c_str(), server_.method());
+		DBGLOGREST("configPrograms for '%s' METHOD %d\n", filename.c_str(), server().method());
 
-		switch (server_.method()) {
+		switch (server().method()) {
 			case HTTP_GET: {
-				if (!SPIFFS.exists(filename)) {
-					server_.send(404, "text/plain", "Program " + server_.pathArg(0) + " not found");
+				if (!LittleFS.exists(filename)) {
+					server().send(404, "text/plain", "Program " + server().pathArg(0) + " not found");
 					break;
 				}
 
 				DBGLOGREST("Reading config for '%s'\n", filename.c_str());
-				File file = SPIFFS.open(filename, FILE_READ);
-				server_.streamFile(file, "application/json");
+				File file = LittleFS.open(filename, FILE_READ);
+				server().streamFile(file, "application/json");
 				file.close();
 				break;
 			}
 			case HTTP_POST: {
-				if (!server_.hasArg("plain")) {
-					server_.send(204);
+				auto &body = worker().body;
+				auto parser = body.get<ProgramParser>();
+				if (!parser || body.length == 0) {
+					server().send(204);
 					break;
 				}
-				auto body = server_.arg("plain");
-				if (body.isEmpty()) {
-					server_.send(204);
+
+				if (!parser->finish()) {
+					DBGLOGREST("Program parsing failure: '%s'\n", filename.c_str());
+					server().send(400, "text/plain", "Program parsing failure. Program not stored");
 					break;
 				}
 
-				//TODO parse/validate json
-				DBGLOGREST("Received program: '%s'\n", filename.c_str());
-				File file = SPIFFS.open(filename, FILE_WRITE);
-				if (!file) {
-					server_.send(500, "text/plain", "Failed to open file for writing");
+				DBGLOGREST("Received program: '%s', rooms: %zu\n", filename.c_str(), body.rooms.size());
+				if (!body.store()) {
+					server().send(500, "text/plain", "Failed to open file for writing");
 					break;
 				}
-				file.write((uint8_t *)body.c_str(), body.length());
-				file.close();
+				// compiled here while the rooms are at hand, the reload below or the next boot loads the image
+				if (!config::saveProgramImage(server().pathArg(0).c_str(), body.rooms, body.hash.get())) {
+					DBGLOGREST("Unable to save program image for '%s'\n", filename.c_str());
+				}
 
 				auto currentProgram = config::getCurrentProgram();
-				if (currentProgram == server_.pathArg(0).c_str()) {
+				if (currentProgram == server().pathArg(0).c_str()) {
 					DBGLOGREST("Program reloaded: '%s'\n", filename.c_str());
-					controller_.reloadConfiguration();
-					server_.send(205);
+					if (!reloadOnController()) {
+						return;
+					}
+					server().send(205);
 					return;
 				}
-				server_.send(204);
+				server().send(204);
 				break;
 			}
 			case HTTP_DELETE: {
-				if (!SPIFFS.exists(filename)) {
-					server_.send(404, "text/plain", "Program " + server_.pathArg(0) + " not found");
+				if (!LittleFS.exists(filename)) {
+					server().send(404, "text/plain", "Program " + server().pathArg(0) + " not found");
 					break;
 				}
-				if (SPIFFS.remove(filename)) {
-					server_.send(204);
+				if (LittleFS.remove(filename)) {
+					config::removeProgramImage(server().pathArg(0).c_str());
+					server().send(204);
 				} else {
-					server_.send(500, "text/plain", "Internal server error during removing program " + server_.pathArg(0));
+					server().send(500, "text/plain", "Internal server error during removing program " + server().pathArg(0));
 				}
 				break;
 			}
 			case HTTP_OPTIONS:
-				server_.sendHeader("Allow", "OPTIONS, GET, POST, DELETE");
-				server_.sendHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS, DELETE");
+				server().sendHeader("Allow", "OPTIONS, GET, POST, DELETE");
+				server().sendHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS, DELETE");
 
-				server_.send(204);
+				server().send(204);
 				break;
 			default:
-				server_.send(501, "text/plain", "Not implemented");
+				server().send(501, "text/plain", "Not implemented");
 				break;
 		}
 
 	}
 
+	// parsed the way it'll be loaded while it arrives, hashed for the program image
+	void receiveProgram() {
+		auto programName = server().pathArg(0);
+		receiveBody<ProgramParser>(isValidProgramName(programName) ? "/programs/"s + programName.c_str() + ".json" : ""s);
+	}
+
+	// raw handler - a POST body fed to Parser chunk by chunk and written aside target when given, see RequestBody
+	template <typename Parser>
+	void receiveBody(std::string target = {}) {
+		if (server().method() != HTTP_POST) {
+			return; // DELETE of the same route reads its body here as well
+		}
+		auto &raw = server().raw();
+		auto &body = worker().body;
+		switch (raw.status) {
+			case RAW_START:
+				body.start<Parser>(std::move(target));
+				break;
+			case RAW_WRITE:
+				if (auto parser = body.get<Parser>()) {
+					parser->feed(reinterpret_cast<char const *>(raw.buf), raw.currentSize);
+					body.write(raw.buf, raw.currentSize);
+				}
+				break;
+			case RAW_END:
+				body.close();
+				break;
+			case RAW_ABORTED:
+				DBGLOGREST("Request body aborted after %zu bytes\n", raw.totalSize);
+				body.clear();
+				break;
+		}
+	}
+
 	void index() {
 		serveFile("/index.html");
 	}
 
+	// server task before it starts the workers - the image is linked into the firmware, hashed by the build
+	void indexAssets() {
+		AssetImage image(assetImageStart, assetImageEnd - assetImageStart);
+		if (!image.isValid()) {
+			DBGLOGREST("Web asset image missing or damaged\n");
+			return;
+		}
+		assets_.add(image);
+		DBGLOGREST("Indexed %zu assets\n", assets_.size());
+	}
+
 	void serveFile(const char *serverPath) {
 		DBGLOGREST("Request for: '%s'\n", serverPath);
 
-		String path = "/html";
-		path += serverPath;
-
-		if (!SPIFFS.exists(path)) {
-			path += ".gz";
+		auto response = assets_.resolve(serverPath, server().arg("v").c_str(), server().header("If-None-Match").c_str());
+		if (response.result == AssetIndex::result_t::notFound) {
+			server().send(404, "text/plain", "FileNotFound");
+			return;
 		}
 
-		if (!SPIFFS.exists(path)) {
-			server_.send(404, "text/plain", "FileNotFound");
+		auto const &asset = *response.asset;
+		server().sendHeader("ETag", asset.etag);
+		server().sendHeader("Cache-Control", response.cacheControl);
+		if (response.result == AssetIndex::result_t::notModified) {
+			server().send(304);
 			return;
 		}
-		File file = SPIFFS.open(path, FILE_READ);
-		if (!file) {
-			server_.send(500, "text/plain", "Internal Server Error. Can't open file.");
-			return;
+		if (asset.gzip) {
+			server().sendHeader("Content-Encoding", "gzip");
 		}
+		server().sendView(200, asset.contentType, std::string_view(reinterpret_cast<char const *>(asset.data), asset.size)); // straight from mapped flash
+	}
 
-		auto content = getContentType(path);
+	void assetsStatus() {
+		ib::viewable_stringbuf payloadBuf;
+		std::ostream payload(&payloadBuf);
+		assets_.getStatus(payload);
+		server().sendView(200, "application/json"sv, payloadBuf.view());
+	}
 
-		if (content.first) {
-			server_.sendHeader("Cache-Control", "max-age=3600");
-			server_.sendHeader("Cache-Control", "private");
+	// one update at a time - another one, received by another worker meanwhile, fails
+	bool claimOta(OTAUpload &ota) {
+		if (otaRunning_.exchange(true)) {
+			DBGLOGREST("Update already in progress\n");
+			ota.errorMessage = "Another update in progress"sv;
+			ota.error = -1;
+			return false;
 		}
-
-		server_.streamFile(file, content.second);
-		file.close();
+		ota.claimed = true;
+		return true;
 	}
 
-	std::pair<bool, const char *>getContentType(String path) {
-		if (path.endsWith("css")) {
-			return {false, "text/css"};
-		} else if (path.endsWith("css.gz")) {
-			return {false, "text/css"};
-		} else if (path.endsWith("js")) {
-			return {false, "text/javascript"};
-		} else if (path.endsWith("js.gz")) {
-			return {false, "text/javascript"};
-		} else if (path.endsWith("png")) {
-			return {true, "image/png"};
-		} else if (path.endsWith("jpg")) {
-			return {true, "image/jpeg"};
-		} else if (path.endsWith("html.gz")) {
-			return {false, "text/html"};
-		} else if (path.endsWith("html")) {
-			return {false, "text/html"};
-		} else {
-			return {true, "text/plain"};
+	// at the response, or when the upload was aborted and there is none
+	void releaseOta(OTAUpload &ota) {
+		if (ota.claimed) {
+			ota.claimed = false;
+			otaRunning_ = false;
 		}
 	}
 
 	void handleOTAUpdate() {
-		HTTPUpload &upload = server_.upload();
+		auto &ota = worker().ota;
+		HTTPUpload &upload = server().upload();
 
 		if (upload.status == UPLOAD_FILE_START) {
-			auto size = server_.arg("size");
+			auto size = server().arg("size");
 			long fileSize = atol(size.c_str());
 
 			DBGLOGREST("handleOTA START '%s', totalSize: '%zu'\n", upload.filename.c_str(), fileSize);
 
-			ota_ = OTAUpload{};
+			releaseOta(ota);
+			ota = OTAUpload{};
+			if (!claimOta(ota)) {
+				return;
+			}
 
-			ota_.partition = esp_ota_get_next_update_partition(NULL);
-			if (!ota_.partition) {
+			ota.partition = esp_ota_get_next_update_partition(NULL);
+			if (!ota.partition) {
 				DBGLOGREST("OTA partition not found\n");
-				ota_.errorMessage = "OTA partition not found"sv;
-				ota_.error = -1;
+				ota.errorMessage = "OTA partition not found"sv;
+				ota.error = -1;
 				return;
 			}
 
-			if (fileSize > 0 && fileSize > ota_.partition->size) {
-				DBGLOGREST("handleOTAFFSUpdate Partition size %zu smaller than binary file %zu!\n", ota_.partition->size, fileSize);
-				ota_.errorMessage = "Partition smaller than file"sv;
-				ota_.error = -1;
+			if (fileSize > 0 && fileSize > ota.partition->size) {
+				DBGLOGREST("handleOTAFFSUpdate Partition size %zu smaller than binary file %zu!\n", ota.partition->size, fileSize);
+				ota.errorMessage = "Partition smaller than file"sv;
+				ota.error = -1;
 				return;
 			}
 
 
-			DBGLOGREST("handleOTA Found partition '%s', size: %d, encrypted: %d\n", ota_.partition->label, ota_.partition->size, ota_.partition->encrypted);
+			DBGLOGREST("handleOTA Found partition '%s', size: %d, encrypted: %d\n", ota.partition->label, ota.partition->size, ota.partition->encrypted);
 
 			DBGLOGREST("Beginning OTA\n");
 
@@ -837,162 +1381,197 @@ private:
 				DBGLOGREST("Beginning OTA: esp_ota_mark_app_valid_cancel_rollback failed\n");
 			}
 
-			ota_.error = esp_ota_begin(ota_.partition, OTA_SIZE_UNKNOWN, &ota_.handle);
-			if (ota_.error != ESP_OK) {
+			ota.error = esp_ota_begin(ota.partition, OTA_SIZE_UNKNOWN, &ota.handle);
+			if (ota.error != ESP_OK) {
 				DBGLOGREST("Beginning OTA failed!\n");
 				return;
 			}
-			ota_.started = true;
+			ota.started = true;
 
-			DBGLOGREST("Beginning OTA handle: %d\n", ota_.handle);
+			DBGLOGREST("Beginning OTA handle: %d\n", ota.handle);
 		} else if (upload.status == UPLOAD_FILE_WRITE) {
-			if (!ota_.started || ota_.error != ESP_OK) {
-				if (!ota_.writeErrorReported) {
-					DBGLOGREST("handleOTA writing skipped, OTA error: %d\n", ota_.error);
-					ota_.writeErrorReported = true;
+			if (!ota.started || ota.error != ESP_OK) {
+				if (!ota.writeErrorReported) {
+					DBGLOGREST("handleOTA writing skipped, OTA error: %d\n", ota.error);
+					ota.writeErrorReported = true;
 				}
 				return;
 			}
 
-			DBGLOGREST("handleOTA writing to OTA handle %d, size: %zu\n", ota_.handle, upload.currentSize);
+			DBGLOGREST("handleOTA writing to OTA handle %d, size: %zu\n", ota.handle, upload.currentSize);
 
-			ota_.error = esp_ota_write(ota_.handle, upload.buf, upload.currentSize);
-			if (ota_.error != ESP_OK) {
-				DBGLOGREST("handleOTA writing to OTA handle %d, size: %zu FAILED, error: %d\n", ota_.handle, upload.currentSize, ota_.error);
-				esp_ota_abort(ota_.handle);
+			ota.error = esp_ota_write(ota.handle, upload.buf, upload.currentSize);
+			if (ota.error != ESP_OK) {
+				DBGLOGREST("handleOTA writing to OTA handle %d, size: %zu FAILED, error: %d\n", ota.handle, upload.currentSize, ota.error);
+				esp_ota_abort(ota.handle);
 				return;
 			}
 		} else if (upload.status == UPLOAD_FILE_END) {
-			if (!ota_.started || ota_.error != ESP_OK) {
-				DBGLOGREST("handleOTA upload end, error: %d\n", ota_.error);
+			if (!ota.started || ota.error != ESP_OK) {
+				DBGLOGREST("handleOTA upload end, error: %d\n", ota.error);
 				return;
 			}
 
 			DBGLOGREST("handleOTA ending OTA\n");
 
-			ota_.error = esp_ota_end(ota_.handle);
-			if (ota_.error != ESP_OK) {
-				DBGLOGREST("handleOTA finalizing OTA handle %d, FAILED, error: %d\n", ota_.handle, ota_.error);
+			ota.error = esp_ota_end(ota.handle);
+			if (ota.error != ESP_OK) {
+				DBGLOGREST("handleOTA finalizing OTA handle %d, FAILED, error: %d\n", ota.handle, ota.error);
 				return;
 			}
 
 			DBGLOGREST("handleOTA setting boot partition\n");
 
-			ota_.error = esp_ota_set_boot_partition(ota_.partition);
-			if (ota_.error != ESP_OK) {
-				DBGLOGREST("handleOTA setting boot partition FAILED, error: %d\n", ota_.error);
+			ota.error = esp_ota_set_boot_partition(ota.partition);
+			if (ota.error != ESP_OK) {
+				DBGLOGREST("handleOTA setting boot partition FAILED, error: %d\n", ota.error);
 				return;
 			}
-			ota_.success = true;
+			ota.success = true;
 
 		} else if (upload.status == UPLOAD_FILE_ABORTED) {
-			if (!ota_.started) {
-				DBGLOGREST("handleOTA upload aborted, OTA not started. Error: %d\n", ota_.error);
+			releaseOta(ota);
+			if (!ota.started) {
+				DBGLOGREST("handleOTA upload aborted, OTA not started. Error: %d\n", ota.error);
 				return;
 			}
 			DBGLOGREST("handleOTA ABORTED\n");
-			esp_ota_abort(ota_.handle);
+			esp_ota_abort(ota.handle);
 		}
 	}
 
 	void handleOTAResponse() {
+		auto &ota = worker().ota;
+		releaseOta(ota);
 		auto ctype = "text/plain"sv;
-		if (ota_.success) {
-			server_.sendView(200, ctype, "success"sv);
+		if (ota.success) {
+			server().sendView(200, ctype, "success"sv);
 		} else {
 			ib::viewable_stringbuf payloadBuf;
 			std::ostream ss(&payloadBuf);
 			ss << "Failure: ";
-			ss << ota_.errorMessage << " (" << ota_.error << ')';
-			server_.sendView(500, ctype, payloadBuf.view());
+			ss << ota.errorMessage << " (" << ota.error << ')';
+			server().sendView(500, ctype, payloadBuf.view());
 		}
 	}
 
 	void handleOTAFFSUpdate() {
-		HTTPUpload &upload = server_.upload();
+		auto &ota = worker().ota;
+		HTTPUpload &upload = server().upload();
 
 		if (upload.status == UPLOAD_FILE_START) {
-			auto size = server_.arg("size");
+			auto size = server().arg("size");
 			long fileSize = atol(size.c_str());
 
 			DBGLOGREST("handleOTAFFSUpdate START '%s', totalSize: '%zu'\n", upload.filename.c_str(), fileSize);
 
-			ota_ = OTAUpload{};
-			ota_.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
-			if (!ota_.partition) {
+			releaseOta(ota);
+			ota = OTAUpload{};
+			if (!claimOta(ota)) {
+				return;
+			}
+			ota.partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr); // LittleFS image, partition subtype kept
+			if (!ota.partition) {
 				DBGLOGREST("handleOTAFFSUpdate partition not found\n");
-				ota_.errorMessage = "FS partition not found"sv;
-				ota_.error = -1;
+				ota.errorMessage = "FS partition not found"sv;
+				ota.error = -1;
 				return;
 			}
 
-			DBGLOGREST("handleOTAFFSUpdate Found partition '%s', size: %d, encrypted: %d\n", ota_.partition->label, ota_.partition->size, ota_.partition->encrypted);
+			DBGLOGREST("handleOTAFFSUpdate Found partition '%s', size: %d, encrypted: %d\n", ota.partition->label, ota.partition->size, ota.partition->encrypted);
 
-			if (fileSize > 0 && fileSize > ota_.partition->size) {
-				DBGLOGREST("handleOTAFFSUpdate Partition size %zu smaller than binary file %zu!\n", ota_.partition->size, fileSize);
-				ota_.errorMessage = "FS partition smaller than file"sv;
-				ota_.error = -1;
+			if (fileSize > 0 && fileSize > ota.partition->size) {
+				DBGLOGREST("handleOTAFFSUpdate Partition size %zu smaller than binary file %zu!\n", ota.partition->size, fileSize);
+				ota.errorMessage = "FS partition smaller than file"sv;
+				ota.error = -1;
 				return;
 			}
 
-			SPIFFS.end();
+			// the controller task saves state and loads programs at any time - it lets go of the filesystem, and stays away
+			// from it until restart, before the partition is erased
+			if (!controller_.runOnControllerTask([this] { controller_.releaseFilesystem(); LittleFS.end(); }, controllerTimeout)) {
+				DBGLOGREST("handleOTAFFSUpdate controller busy, filesystem not released\n");
+				ota.errorMessage = "Controller busy, FS not released"sv;
+				ota.error = -1;
+				return;
+			}
 
 			DBGLOGREST("handleOTAFFSUpdate Erasing partition\n");
-			ota_.error = esp_partition_erase_range(ota_.partition, 0, ota_.partition->size);
-			if (ota_.error != ESP_OK) {
-				ota_.errorMessage = "FS partition erase failure"sv;
-				DBGLOGREST("handleOTAFFSUpdate Failed to erase SPIFFS partition!\n");
+			ota.error = esp_partition_erase_range(ota.partition, 0, ota.partition->size);
+			if (ota.error != ESP_OK) {
+				ota.errorMessage = "FS partition erase failure"sv;
+				DBGLOGREST("handleOTAFFSUpdate Failed to erase FS partition!\n");
 				return;
 			}
 
-			ota_.started = true;
+			ota.started = true;
 		} else if (upload.status == UPLOAD_FILE_WRITE) {
-			if (!ota_.started || ota_.error != ESP_OK) {
-				if (!ota_.writeErrorReported) {
-					DBGLOGREST("handleOTAFFSUpdate writing skipped, OTA error: %d\n", ota_.error);
-					ota_.writeErrorReported = true;
+			if (!ota.started || ota.error != ESP_OK) {
+				if (!ota.writeErrorReported) {
+					DBGLOGREST("handleOTAFFSUpdate writing skipped, OTA error: %d\n", ota.error);
+					ota.writeErrorReported = true;
 				}
 				return;
 			}
-			DBGLOGREST("handleOTAFFSUpdate writing SPIFFS offset: %zu, size: %zu\n", ota_.offset, upload.currentSize);
+			DBGLOGREST("handleOTAFFSUpdate writing FS offset: %zu, size: %zu\n", ota.offset, upload.currentSize);
 
-			ota_.error = esp_partition_write(ota_.partition, ota_.offset, upload.buf, upload.currentSize);
-			if (ota_.error != ESP_OK) {
-				ota_.errorMessage = "FS partition write error"sv;
-				DBGLOGREST("handleOTAFFSUpdate Failed to write SPIFFS partition: %d\n", ota_.error);
+			ota.error = esp_partition_write(ota.partition, ota.offset, upload.buf, upload.currentSize);
+			if (ota.error != ESP_OK) {
+				ota.errorMessage = "FS partition write error"sv;
+				DBGLOGREST("handleOTAFFSUpdate Failed to write FS partition: %d\n", ota.error);
 				return;
 			}
-			ota_.offset += upload.currentSize;
+			ota.offset += upload.currentSize;
 		} else if (upload.status == UPLOAD_FILE_END) {
-			if (!ota_.started || ota_.error != ESP_OK) {
-				DBGLOGREST("handleOTAFFSUpdate upload end, error: %d\n", ota_.error);
+			if (!ota.started || ota.error != ESP_OK) {
+				DBGLOGREST("handleOTAFFSUpdate upload end, error: %d\n", ota.error);
 				return;
 			}
 			DBGLOGREST("handleOTAFFSUpdate finished\n");
-			ota_.success = true;
+			ota.success = true;
 		} else if (upload.status == UPLOAD_FILE_ABORTED) {
-			if (!ota_.started) {
-				DBGLOGREST("handleOTAFFSUpdate upload aborted. Not started. Error: %d\n", ota_.error);
+			releaseOta(ota);
+			if (!ota.started) {
+				DBGLOGREST("handleOTAFFSUpdate upload aborted. Not started. Error: %d\n", ota.error);
 				return;
 			}
 			DBGLOGREST("handleOTAFFSUpdate ABORTED\n");
 		}
 	}
 
-	struct OTAUpload {
-		bool started = false;
-		bool success = false;
-		const esp_partition_t *partition = nullptr;
-		size_t offset = 0;
-		esp_ota_handle_t handle = 0;
-		esp_err_t error = ESP_OK;
-		std::string errorMessage;
-		bool writeErrorReported = false;
-	} ota_;
-
 	HeatingController &controller_;
-	WebServerStringView server_;
-
+	WiFiServer listener_;
+	networkReady_t networkReady_;
+	std::array<Worker, workerCount> workers_;
+	static inline thread_local Worker *current_ = nullptr;
+	ConnectionQueue<WiFiClient> connections_; // server task -> workers
+	AssetIndex assets_; // indexed before workers start, read only then
+	std::atomic_bool otaRunning_{false}; // one update at a time, whichever worker receives it
+	bool taskStarted_ = false;
+	std::atomic_bool restart_{false};
+	std::atomic<size_t> liveViewerCount_{0}; // streamed and subscribed
+	std::mutex subscribedMutex_;
+	std::vector<LiveViewer> subscribed_; // workers -> live task
+	std::vector<LiveViewer> liveViewers_; // live task only
+
+	friend void heating::rest::serverTask(void *pvParameters);
+	friend void heating::rest::workerTask(void *pvParameters);
+	friend void heating::rest::liveTask(void *pvParameters);
 };
 
+namespace rest {
+static void serverTask(void *pvParameters) {
+	reinterpret_cast<REST *>(pvParameters)->serve();
+}
+
+static void workerTask(void *pvParameters) {
+	auto &worker = *reinterpret_cast<REST::Worker *>(pvParameters);
+	worker.rest->work(worker);
+}
+
+static void liveTask(void *pvParameters) {
+	reinterpret_cast<REST *>(pvParameters)->pumpLiveViewers();
+}
+}
+
 }
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "JsonScanner.h"
+#include "Logger.h"
+
+#include <climits>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace heating {
+
+// Small documents of the REST API, parsed while the request body arrives in chunks of the raw handler - the body isn't
+// collected into a String and no cJSON tree of it is built. Only members of the root object are read.
+
+namespace requestparsers {
+// number the way cJSON gives it as valueint - truncated, saturated
+inline std::optional<int> toInt(std::string_view text, bool string) {
+	if (string) {
+		return std::nullopt;
+	}
+	char *end = nullptr;
+	double value = std::strtod(text.data(), &end);
+	if (end == text.data()) {
+		return std::nullopt; // true, false, null
+	}
+	return value >= INT_MAX ? INT_MAX : value <= INT_MIN ? INT_MIN : static_cast<int>(value);
+}
+}
+
+#define DEBUG_OPTIONS(OPTION) \
+	OPTION(debugRoomTemperatures) \
+	OPTION(debugHeatingController) \
+	OPTION(debugTemperatureReader) \
+	OPTION(debugREST) \
+	OPTION(debugOpenWeather) \
+	OPTION(debugBoilerController) \
+	OPTION(debugEmsBusUart) \
+	OPTION(debugEmsBusUartForwarder) \
+	OPTION(debugEmsController) \
+	OPTION(debugEmsVerbose) \
+	OPTION(debugMQTT) \
+	OPTION(debugFatal)
+
+// {"debugREST": true, ...} - options missing from the document are turned off, a malformed one changes nothing
+class DebugOptionsParser : public JsonScanner<DebugOptionsParser, 1, 31> {
+public:
+	DebugOptionsParser() { reset(); }
+
+	void reset() {
+		JsonScanner::reset();
+		#define CLEAR_DEBUG_OPTION(name) options_.name = false;
+		DEBUG_OPTIONS(CLEAR_DEBUG_OPTION)
+		#undef CLEAR_DEBUG_OPTION
+	}
+
+	bool finish() {
+		if (!JsonScanner::finish()) {
+			return false;
+		}
+		debug::debug = options_;
+		return true;
+	}
+
+private:
+	friend class JsonScanner<DebugOptionsParser, 1, 31>;
+
+	void onOpen() {}
+	void onClose() {}
+
+	void onValue(std::string_view text, bool string) {
+		bool value = !string && text == "true";
+		#define READ_DEBUG_OPTION(name) if (keyIs(0, #name)) { options_.name = value; }
+		DEBUG_OPTIONS(READ_DEBUG_OPTION)
+		#undef READ_DEBUG_OPTION
+	}
+
+	struct debug::debug options_;
+};
+
+// {"program": "<name>"} - the selected program, stored as /cfg/cfgprogram.json
+class ProgramSelectionParser : public JsonScanner<ProgramSelectionParser, 1, 15, 63> {
+public:
+	ProgramSelectionParser() { reset(); }
+
+	void reset() {
+		JsonScanner::reset();
+		program_.clear();
+		rootObject_ = false;
+	}
+
+	// true when the document names a program
+	bool finish() { return JsonScanner::finish() && rootObject_ && !program_.empty(); }
+
+	std::string const &program() const { return program_; }
+
+private:
+	friend class JsonScanner<ProgramSelectionParser, 1, 15, 63>;
+	static constexpr bool rejectLongValues = true;
+
+	void onOpen() {
+		if (depth() == 1) {
+			rootObject_ = !isArray(0);
+		}
+	}
+	void onClose() {}
+
+	void onValue(std::string_view text, bool string) {
+		if (keyIs(0, "program") && string) {
+			program_ = text;
+		}
+	}
+
+	std::string program_;
+	bool rootObject_ = false;
+};
+
+// {"roomName": "<name>", "temperature": <1/100 deg>, "validSeconds": <s>} - members of a wrong type are left unset
+class TemporaryOverrideParser : public JsonScanner<TemporaryOverrideParser, 1, 15, 63> {
+public:
+	TemporaryOverrideParser() { reset(); }
+
+	void reset() {
+		JsonScanner::reset();
+		roomName_.reset();
+		temperature_.reset();
+		validSeconds_.reset();
+		rootObject_ = false;
+	}
+
+	// true when the document is a complete object, the members are checked by the caller
+	bool finish() { return JsonScanner::finish() && rootObject_; }
+
+	std::optional<std::string> const &roomName() const { return roomName_; }
+	std::optional<int> temperature() const { return temperature_; }
+	std::optional<int> validSeconds() const { return validSeconds_; }
+
+private:
+	friend class JsonScanner<TemporaryOverrideParser, 1, 15, 63>;
+	static constexpr bool rejectLongValues = true;
+
+	void onOpen() {
+		if (depth() == 1) {
+			rootObject_ = !isArray(0);
+		}
+	}
+	void onClose() {}
+
+	void onValue(std::string_view text, bool string) {
+		if (keyIs(0, "roomName")) {
+			roomName_ = string ? std::optional<std::string>(text) : std::nullopt;
+		} else if (keyIs(0, "temperature")) {
+			temperature_ = requestparsers::toInt(text, string);
+		} else if (keyIs(0, "validSeconds")) {
+			validSeconds_ = requestparsers::toInt(text, string);
+		}
+	}
+
+	std::optional<std::string> roomName_;
+	std::optional<int> temperature_;
+	std::optional<int> validSeconds_;
+	bool rootObject_ = false;
+};
+
+// {"duration": <s>, "boiler": true, "valves": [true, false, ...]} - anything but true is off
+class GpioTestParser : public JsonScanner<GpioTestParser, 2, 15> {
+public:
+	GpioTestParser() { reset(); }
+
+	void reset() {
+		JsonScanner::reset();
+		duration_.reset();
+		boiler_ = false;
+		valves_.clear();
+		rootObject_ = false;
+	}
+
+	// true when the document is a complete object, the duration is checked by the caller
+	bool finish() { return JsonScanner::finish() && rootObject_; }
+
+	std::optional<int> duration() const { return duration_; }
+	bool boiler() const { return boiler_; }
+	std::vector<bool> const &valves() const { return valves_; }
+
+private:
+	friend class JsonScanner<GpioTestParser, 2, 15>;
+
+	void onOpen() {
+		if (depth() == 1) {
+			rootObject_ = !isArray(0);
+		} else if (depth() == 3 && inValves()) {
+			valves_.push_back(false); // object or array in place of a state
+		}
+	}
+	void onClose() {}
+
+	void onValue(std::string_view text, bool string) {
+		if (depth() != 1) {
+			return;
+		}
+		if (keyIs(0, "duration")) {
+			duration_ = requestparsers::toInt(text, string);
+		} else if (keyIs(0, "boiler")) {
+			boiler_ = !string && text == "true";
+		}
+	}
+
+	void onElement(std::string_view text, bool string) {
+		if (depth() == 2 && inValves()) {
+			valves_.push_back(!string && text == "true");
+		}
+	}
+
+	bool inValves() const { return !isArray(0) && keyIs(0, "valves") && isArray(1); }
+
+	std::optional<int> duration_;
+	bool boiler_ = false;
+	std::vector<bool> valves_;
+	bool rootObject_ = false;
+};
+
+} // namespace heating
@@ -1,13 +1,19 @@
 
 
 #include "Room.h"
+#include "TimeUtils.h"
+#include <algorithm>
 #include <limits>
 
 namespace heating {
 
-void Room::storeBattery(int8_t batteryLevel) {
-	batteryLevel_ = batteryLevel;
-	DBGLOGROOM("storeBattery %-15.15s batt: %d%%\n", config_.name_.c_str(), batteryLevel);
+void Room::storeBattery(size_t sensor, int8_t batteryLevel) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (sensor >= sensors_.size()) {
+		return;
+	}
+	sensors_[sensor].batteryLevel = batteryLevel;
+	DBGLOGROOM("storeBattery %-15.15s sensor: %zu batt: %d%%\n", config_.name_.c_str(), sensor, batteryLevel);
 }
 
 void Room::storeHumidity(int16_t humidity) {
@@ -15,10 +21,13 @@ void Room::storeHumidity(int16_t humidity) {
 	DBGLOGROOM("storeHumidity %-15.15s humidity: %d%%\n", config_.name_.c_str(), humidity);
 }
 
-void Room::storeTemperature(int16_t temperature) {
+void Room::storeTemperature(size_t sensor, int16_t temperature) {
 	std::lock_guard<std::mutex> lock(mutex_);
-	DBGLOGROOM("storeTemperature %-15.15s temp: %d\n", config_.name_.c_str(), temperature);
-	temperatureData_.push(temperatureData_t{clock_t::now(), temperature});
+	if (sensor >= sensors_.size()) {
+		return;
+	}
+	DBGLOGROOM("storeTemperature %-15.15s sensor: %zu temp: %d\n", config_.name_.c_str(), sensor, temperature);
+	sensors_[sensor].temperatureData.push(temperatureData_t{clock_t::now(), temperature});
 }
 
 void Room::createTemporaryOverride(int16_t temperature, uint32_t validSeconds) {
@@ -26,6 +35,26 @@ void Room::createTemporaryOverride(int16_t temperature, uint32_t validSeconds) {
 	temporaryOverride_ = std::make_unique<TemporaryOverride>(temperature, validSeconds);
 }
 
+void Room::carryStateFrom(Room &previous) {
+	std::scoped_lock lock(mutex_, previous.mutex_);
+	auto const &previousSensors = previous.config_.sensors_;
+	for (size_t sensor = 0; sensor < sensors_.size(); ++sensor) {
+		auto const &address = config_.sensors_[sensor].address_;
+		auto found = std::find_if(previousSensors.begin(), previousSensors.end(), [&address](auto const &previousSensor) { return previousSensor.address_ == address; });
+		if (found != previousSensors.end()) {
+			sensors_[sensor] = std::move(previous.sensors_[found - previousSensors.begin()]);
+		}
+	}
+	currentHumidity_ = previous.currentHumidity_.load();
+	temporaryOverride_ = std::move(previous.temporaryOverride_);
+	gainRate_ = previous.gainRate_;
+	stats.shouldStartBoiler_ = previous.stats.shouldStartBoiler_;
+	stats.shouldHeat_ = previous.stats.shouldHeat_;
+	stats.evaluation_ = previous.stats.evaluation_; // temperature and set point, plain values
+	// stats.currentProgram_ isn't carried - it points into the previous config, the next evaluation finds it again
+	DBGLOGROOM("carryStateFrom %-15.15s sensors: %zu/%zu\n", config_.name_.c_str(), sensors_.size(), previousSensors.size());
+}
+
 // optional boiler heating temperature override
 std::tuple<Room::TemperatureStatus, std::optional<uint8_t>> Room::shouldStartBoilerAndHeat() {
 	std::lock_guard<std::mutex> lock(mutex_);
@@ -33,6 +62,7 @@ std::tuple<Room::TemperatureStatus, std::optional<uint8_t>> Room::shouldStartBoi
 	// start heat boiler, continue heat, data error
 	if (!isTemperatureValid()) {
 		DBGLOGROOM("SSB  %-15.15s no samples\n", config_.name_.c_str());
+		stats.evaluation_.reset();
 		return std::make_tuple(Room::TemperatureStatus::MISSING_TEMPERATURE, std::nullopt);
 	}
 
@@ -45,11 +75,14 @@ std::tuple<Room::TemperatureStatus, std::optional<uint8_t>> Room::shouldStartBoi
 		currentSet = temporaryOverride_->getTemperature();
 	}
 
-	auto meanTemperature = getAverageTemperature();
-	if (!meanTemperature.has_value()) {
-		DBGLOGROOM("SSB  %-15.15s %d dOw: %d mean: %d, set: %d, margin: u%d/d%d Boiler: 0 Heat: 1 no samples\n", config_.name_.c_str(), time, dayOfTheWeek, meanTemperature, currentSet, getTemperatureMarginUp(), getTemperatureMarginDown());
+	auto filtered = getFilteredTemperature();
+	if (!filtered || filtered->confidence < config_.filter_.minConfidence) {
+		DBGLOGROOM("SSB  %-15.15s %d dOw: %d set: %d confidence: %u%% too low\n", config_.name_.c_str(), time, dayOfTheWeek, currentSet, filtered ? filtered->confidence : 0);
+		stats.evaluation_.reset();
 		return std::make_tuple(Room::TemperatureStatus::MISSING_TEMPERATURE, std::nullopt);
 	}
+	auto meanTemperature = filtered->temperature;
+	stats.evaluation_ = Evaluation{meanTemperature, currentSet};
 
 	bool shouldStartBoiler = meanTemperature < currentSet - getTemperatureMarginDown();
 	bool shouldContinueHeating = meanTemperature < currentSet + getTemperatureMarginUp();
@@ -66,20 +99,58 @@ std::tuple<Room::TemperatureStatus, std::optional<uint8_t>> Room::shouldStartBoi
 		status = Room::TemperatureStatus::CONTINUE_HEATING;
 	}
 
+	if (status == Room::TemperatureStatus::TEMPERATURE_OK) {
+		gainRate_.reset();
+	} else {
+		gainRate_.add(meanTemperature, clock_t::now());
+	}
+
 	return std::make_tuple(status, currentProgram ? currentProgram->getHeatingTemperatureOverride() : std::optional<uint8_t>{});
 }
 
+std::optional<int16_t> Room::getGainRate() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return gainRate_.get();
+}
+
+std::optional<Room::Evaluation> Room::getLastEvaluation() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats.evaluation_;
+}
+
 bool Room::isEnabled() const {
 	std::lock_guard<std::mutex> lock(mutex_);
 	return config_.enabled_;
 }
 
+bool Room::isHeatingScheduledWithin(std::chrono::seconds lead) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (lead.count() <= 0 || !isTemperatureValid() || (temporaryOverride_ && temporaryOverride_->isValid())) {
+		return false;
+	}
+
+	auto filtered = getFilteredTemperature();
+	if (!filtered || filtered->confidence < config_.filter_.minConfidence) {
+		return false;
+	}
+
+	auto [time, dayOfTheWeek] = getTimeNow();
+	auto [upcomingTime, upcomingDay] = ib::timeutils::addMinutesHHMM(time, dayOfTheWeek, std::chrono::duration_cast<std::chrono::minutes>(lead).count());
+	auto upcomingSet = getTemperatureSet(upcomingTime, upcomingDay).first;
+
+	bool needed = filtered->temperature < upcomingSet - getTemperatureMarginDown();
+	DBGLOGROOM("HSW  %-15.15s mean: %d, upcoming set: %d at %d (lead %llds) needed: %d\n", config_.name_.c_str(), filtered->temperature, upcomingSet, upcomingTime, static_cast<long long>(lead.count()), needed);
+	return needed;
+}
+
 bool Room::isTemperatureValid() const {
-	if (temperatureData_.empty()) {
+	auto newest = getNewestSample();
+	if (!newest) {
 		return false;
 	}
 
-	auto lastSampleTime = std::get<0>(temperatureData_.newest());
+	auto lastSampleTime = std::get<0>(newest.value());
 	if (lastSampleTime + std::chrono::minutes(5) < clock_t::now()) {
 		DBGLOGROOM("isTemperatureValid %-15.15s temperature too old, last read time: %ld, current: %ld\n", config_.name_.c_str(), lastSampleTime, millis());
 		return false;
@@ -131,36 +202,59 @@ std::pair<uint16_t, uint8_t> Room::getTimeNow() const {
 	return {time, timeinfo.tm_wday};
 }
 
-std::optional<int16_t> Room::getAverageTemperature() const {
-	int32_t avgTemp = 0;
+size_t Room::copySamples(size_t sensor, std::array<TemperatureFilter::Sample, TemperatureFilter::maxSamples> &samples) const {
+	auto const &temperatureData = sensors_[sensor].temperatureData;
+	size_t count = 0;
+	for (size_t i = 0; i < temperatureData.size() && count < samples.size(); i++) {
+		auto const &[sampleTime, sampleTemp] = temperatureData.get(i);
+		samples[count++] = TemperatureFilter::Sample{sampleTime, sampleTemp};
+	}
+	return count;
+}
 
-	// TODO int64_t esp_timer_get_time()
-	auto currentTime = clock_t::now();
-	size_t validSamples = 0;
+std::optional<TemperatureFilter::Result> Room::getFilteredTemperature(size_t sensor) const {
+	std::array<TemperatureFilter::Sample, TemperatureFilter::maxSamples> samples;
+	auto count = copySamples(sensor, samples);
+	auto result = TemperatureFilter(config_.filter_).apply(samples.data(), count, clock_t::now());
+	if (result) {
+		DBGLOGROOM("GFT  %-15.15s sensor: %zu samples: %zu, accepted: %u, rejected: %u, temp: %d, confidence: %u%%\n", config_.name_.c_str(), sensor, count, result->samples, result->rejected, result->temperature, result->confidence);
+	}
+	return result;
+}
 
-	//		logger.printf("getMeanTemperature %-15.15s size: %zu\n", config_.name_.c_str(), temperatureData_.size());
-	for (size_t i = 0; i < temperatureData_.size(); i++) {
-		//			logger.printf("%-15.15s idx: %d t: %f\n", config_.name_.c_str(), i, std::get<1>(temperatureData_.get(i)));
-		auto sampleTime = std::get<0>(temperatureData_.get(i));
+// room temperature fused from all sensors
+std::optional<TemperatureFilter::Result> Room::getFilteredTemperature() const {
+	std::vector<std::array<TemperatureFilter::Sample, TemperatureFilter::maxSamples>> samples(sensors_.size());
+	std::vector<TemperatureFilter::SensorSamples> sensors;
+	sensors.reserve(sensors_.size());
+	for (size_t sensor = 0; sensor < sensors_.size(); ++sensor) {
+		sensors.push_back({samples[sensor].data(), copySamples(sensor, samples[sensor]), config_.sensors_[sensor].weight_});
+	}
+	auto result = TemperatureFilter(config_.filter_).apply(sensors.data(), sensors.size(), clock_t::now());
+	if (result) {
+		DBGLOGROOM("GFT  %-15.15s sensors: %zu, accepted: %u, rejected: %u, temp: %d, confidence: %u%%\n", config_.name_.c_str(), sensors.size(), result->samples, result->rejected, result->temperature, result->confidence);
+	}
+	return result;
+}
 
-		if (currentTime - sampleTime <= getMaxSampleAgeMs()) {
-			validSamples++;
-		} else {
-			continue;
+std::optional<Room::temperatureData_t> Room::getNewestSample() const {
+	std::optional<temperatureData_t> newest;
+	for (auto const &sensor : sensors_) {
+		if (!sensor.temperatureData.empty() && (!newest || std::get<0>(sensor.temperatureData.newest()) > std::get<0>(newest.value()))) {
+			newest = sensor.temperatureData.newest();
 		}
-
-		avgTemp += std::get<1>(temperatureData_.get(i));
 	}
+	return newest;
+}
 
-	if (validSamples == 0) {
-		return std::nullopt;
+int8_t Room::getLowestBatteryLevel() const {
+	int8_t lowest = -1;
+	for (auto const &sensor : sensors_) {
+		if (sensor.batteryLevel >= 0 && (lowest < 0 || sensor.batteryLevel < lowest)) {
+			lowest = sensor.batteryLevel;
+		}
 	}
-
-	avgTemp /= validSamples;
-
-	DBGLOGROOM("GAT  %-15.15s samples: %zu, valid: %zu, AvgTemp: %d (%f)\n", config_.name_.c_str(), temperatureData_.size(), validSamples, avgTemp, (float)avgTemp / 100);
-
-	return avgTemp;
+	return lowest;
 }
 
 std::string Room::getStatus() const {
@@ -174,14 +268,31 @@ void Room::getStatus(std::ostream &ss) const {
 
 	ss << "{\"name\": \"" << config_.name_ << "\", \"enabled\": " << (config_.enabled_ ? "true" : "false");
 
-	if (!temperatureData_.empty()) {
-		auto [lastSampleTime, lastSampleTemp] = temperatureData_.newest();
+	if (auto newest = getNewestSample()) {
+		auto [lastSampleTime, lastSampleTemp] = newest.value();
 		ss << ", \"currentTemp\": " << lastSampleTemp;
 		ss << ", \"currentHumidity\": " << currentHumidity_.load();
 		ss << ", \"currentTempAgeMs\": " << std::chrono::duration_cast<std::chrono::milliseconds>(clock_t::now() - lastSampleTime).count();
-		ss << ", \"batteryLevel\": " << static_cast<int>(batteryLevel_.load());
-		ss << ", \"meanTemp\": " << getAverageTemperature().value_or(0);
+		ss << ", \"batteryLevel\": " << static_cast<int>(getLowestBatteryLevel());
+		auto filtered = getFilteredTemperature();
+		ss << ", \"meanTemp\": " << (filtered ? filtered->temperature : 0);
+		ss << ", \"tempConfidence\": " << static_cast<int>(filtered ? filtered->confidence : 0);
+		ss << ", \"tempRejected\": " << static_cast<int>(filtered ? filtered->rejected : 0);
+	}
+
+	ss << ", \"sensors\": [";
+	for (size_t sensor = 0; sensor < sensors_.size(); ++sensor) {
+		auto filtered = getFilteredTemperature(sensor);
+		ss << (sensor ? ", " : "") << "{\"address\": \"" << BLEAddressToString(config_.sensors_[sensor].address_) << "\"";
+		ss << ", \"weight\": " << static_cast<int>(config_.sensors_[sensor].weight_);
+		ss << ", \"encrypted\": " << (config_.sensors_[sensor].bindKey_ ? "true" : "false");
+		ss << ", \"batteryLevel\": " << static_cast<int>(sensors_[sensor].batteryLevel);
+		if (filtered) {
+			ss << ", \"temp\": " << filtered->temperature << ", \"confidence\": " << static_cast<int>(filtered->confidence);
+		}
+		ss << "}";
 	}
+	ss << "]";
 
 	auto temperatureSet = (stats.currentProgram_ ? stats.currentProgram_->temperature_ : config_.baseTemperature_);
 
@@ -2,9 +2,11 @@
 
 #include "RoomConfig.h"
 #include "BeaconBleAddress.h"
+#include "FlowTemperatureOptimizer.h"
 #include "CircularBuffer.h"
 #include "Logger.h"
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <memory>
@@ -14,6 +16,7 @@
 #include <mutex>
 #include <tuple>
 #include <optional>
+#include <vector>
 
 namespace heating {
 class Room {
@@ -22,7 +25,7 @@ public:
 
 	enum class TemperatureStatus : uint8_t { MISSING_TEMPERATURE, TEMPERATURE_OK, START_HEATING, CONTINUE_HEATING };
 
-	Room(RoomConfig config) : config_(std::move(config)) {}
+	Room(RoomConfig config) : config_(std::move(config)), sensors_(config_.sensors_.size()) {}
 
 	Room(Room &&r) = default;
 	Room &operator=(Room &&r) = default;
@@ -50,20 +53,38 @@ public:
 		std::chrono::steady_clock::time_point activation_;
 	};
 
-	void storeTemperature(int16_t temperature);
-	void storeBattery(int8_t batteryLevel);
+	// sensor - index in RoomConfig::sensors_
+	void storeTemperature(size_t sensor, int16_t temperature);
+	void storeBattery(size_t sensor, int8_t batteryLevel);
 	void storeHumidity(int16_t humidity);
 
 	void createTemporaryOverride(int16_t temperature, uint32_t validSeconds);
 
+	// room of the reloaded program taking over live state of the one it replaces - samples and battery of sensors with
+	// the same address, humidity, temporary override, gain rate and the last evaluation
+	void carryStateFrom(Room &previous);
+
 	std::tuple<TemperatureStatus, std::optional<uint8_t>> shouldStartBoilerAndHeat();
 
 	bool isEnabled() const;
 
+	// temperature gain while the room demands heat, 1/100 °C per hour
+	std::optional<int16_t> getGainRate() const;
+
+	struct Evaluation {
+		int16_t temperature; // filtered, 1/100 °C
+		int16_t set;
+	};
+	// temperature and set point used by the last shouldStartBoilerAndHeat, none if temperature was missing
+	std::optional<Evaluation> getLastEvaluation() const;
+
+	// true if temperature scheduled within lead time will require heating - valves should be opened in advance
+	bool isHeatingScheduledWithin(std::chrono::seconds lead) const;
+
 	const std::string &getName() const { return config_.name_; }
 
 	auto getValves() const { return config_.valves_; }
-	auto const &getSensorAddress() const { return config_.sensorAddress_; }
+	auto const &getSensors() const { return config_.sensors_; }
 
 	std::string getStatus() const;
 	void getStatus(std::ostream &ss) const;
@@ -75,24 +96,33 @@ private:
 	int16_t getTemperatureMarginUp() const;
 	int16_t getTemperatureMarginDown() const;
 	std::pair<uint16_t, uint8_t> getTimeNow() const;
-	std::optional<int16_t> getAverageTemperature() const;
-
-	auto getMaxSampleAgeMs() const { return std::chrono::minutes(3); }
+	std::optional<TemperatureFilter::Result> getFilteredTemperature() const;
+	std::optional<TemperatureFilter::Result> getFilteredTemperature(size_t sensor) const;
+	size_t copySamples(size_t sensor, std::array<TemperatureFilter::Sample, TemperatureFilter::maxSamples> &samples) const; // oldest first
+	std::optional<temperatureData_t> getNewestSample() const;
+	int8_t getLowestBatteryLevel() const;
 
 	bool debugLog_ = true;
 	RoomConfig config_;
 	std::unique_ptr<TemporaryOverride> temporaryOverride_;
-	ib::CircularBuffer<temperatureData_t, 10> temperatureData_;
+
+	struct SensorData {
+		ib::CircularBuffer<temperatureData_t, 10> temperatureData;
+		int8_t batteryLevel = -1;
+	};
+
+	std::vector<SensorData> sensors_; // same order as config_.sensors_
+	GainRateEstimator gainRate_;       // reset when room stops demanding heat
 	mutable std::mutex mutex_;
 
 	//	// statistical data
-	std::atomic<int8_t> batteryLevel_ = -1;
 	std::atomic<int16_t> currentHumidity_ = std::numeric_limits<decltype(currentHumidity_)>::min(); // humidity 6005 - 60.05%
 
 	struct Statistics {
 		const RoomConfig::TemperatureSetting *currentProgram_ = nullptr;
 		bool shouldStartBoiler_ = false;
 		bool shouldHeat_ = false;
+		std::optional<Evaluation> evaluation_;
 	} stats;
 };
 }
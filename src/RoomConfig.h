@@ -1,5 +1,7 @@
 #pragma once
 
+#include "TemperatureFilter.h"
+
 #include <array>
 #include <optional>
 #include <string>
@@ -33,7 +35,14 @@ struct RoomConfig {
 	uint8_t temperatureMarginDown_ = 20;
 	std::string name_; // TODO memory limit to 15 to avoid allocation?
 
-	BleAddress_t sensorAddress_;
+	struct Sensor {
+		BleAddress_t address_;
+		uint8_t weight_ = 100; // relative weight in fused room temperature
+		std::optional<std::array<uint8_t, 16>> bindKey_; // AES key of sensor sending encrypted advertisements
+	};
+
+	std::vector<Sensor> sensors_;
+	TemperatureFilterConfig filter_;
 
 	std::vector<TemperatureSetting> temperatures_;
 	std::vector<std::string> valves_;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace heating {
+
+// Bounded lock-free queue for exactly one producer task and one consumer task (BLE host task -> controller task).
+// Producer never blocks nor allocates - when the queue is full the new item is dropped and counted, so a stalled
+// consumer can't stall the producer. Statistics may be read from any task.
+template <typename T, size_t Capacity>
+class SampleQueue {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+
+public:
+	static constexpr size_t capacity = Capacity;
+
+	// producer only
+	bool push(T const &item) {
+		auto tail = tail_.load(std::memory_order_relaxed);
+		auto head = head_.load(std::memory_order_acquire);
+		if (tail - head >= Capacity) {
+			drops_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		slots_[tail & mask] = item;
+		tail_.store(tail + 1, std::memory_order_release);
+
+		auto size = tail + 1 - head;
+		if (size > highWaterMark_.load(std::memory_order_relaxed)) {
+			highWaterMark_.store(size, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	// consumer only
+	std::optional<T> pop() {
+		auto head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire)) {
+			return std::nullopt;
+		}
+
+		std::optional<T> item = slots_[head & mask];
+		head_.store(head + 1, std::memory_order_release);
+		return item;
+	}
+
+	size_t size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+	uint32_t getPushed() const { return tail_.load(std::memory_order_relaxed); }
+	uint32_t getDrops() const { return drops_.load(std::memory_order_relaxed); }
+	uint32_t getHighWaterMark() const { return highWaterMark_.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr uint32_t mask = Capacity - 1;
+
+	std::array<T, Capacity> slots_{};
+	std::atomic<uint32_t> head_{0}; // next to pop, written by consumer
+	std::atomic<uint32_t> tail_{0}; // next to push, written by producer - indices wrap, difference is the size
+	std::atomic<uint32_t> drops_{0};
+	std::atomic<uint32_t> highWaterMark_{0};
+};
+
+} // namespace heating
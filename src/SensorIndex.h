@@ -0,0 +1,45 @@
+#pragma once
+
+#include "BeaconBleAddress.h"
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace heating {
+
+// Address of a sensor -> rooms and sensor slots its samples go to, one sensor may serve several rooms. Built when rooms
+// are (re)loaded and published as a whole, so samples are routed without the rooms lock.
+template <typename Room>
+class SensorIndex {
+public:
+	struct Route {
+		std::shared_ptr<Room> room;
+		size_t sensor; // index in room sensors
+	};
+
+	static std::shared_ptr<const SensorIndex> build(std::vector<std::shared_ptr<Room>> const &rooms) {
+		auto index = std::make_shared<SensorIndex>();
+		for (auto const &room : rooms) {
+			auto const &sensors = room->getSensors();
+			for (size_t sensor = 0; sensor < sensors.size(); ++sensor) {
+				index->routes_[sensors[sensor].address_].push_back({room, sensor});
+			}
+		}
+		return index;
+	}
+
+	// nullptr for an address no room has
+	std::vector<Route> const *find(BleAddress_t const &address) const {
+		auto found = routes_.find(address);
+		return found == routes_.end() ? nullptr : &found->second;
+	}
+
+	size_t size() const { return routes_.size(); }
+
+private:
+	std::unordered_map<BleAddress_t, std::vector<Route>, BleAddressHash> routes_;
+};
+
+} // namespace heating
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "CborStreamBuf.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace heating {
+
+// Status document kept as rendered JSON fragments - a room, the boiler, EMS, weather, ... The controller task marks
+// fragments dirty where their source changes and refresh() renders only those. A fragment whose JSON differs gets the
+// next version, so readers on any task serve the whole document or the fragments changed since a version they already
+// have from memory, without touching the controller state.
+//
+// Versions only grow. Replacing the sections restarts readers from the full document.
+//
+// A changed fragment is encoded as CBOR once, when it's rendered, and kept next to its JSON. CBOR readers get it from
+// memory instead of lexing the JSON again per request - about 6x the CPU of serving the JSON. It costs the CBOR copy of
+// the document in RAM (~72% of the JSON) and an encoding per change even with no CBOR reader.
+class StatusCache {
+public:
+	using render_t = std::function<void(std::ostream &)>;
+
+	struct Fragment {
+		std::string key;
+		std::string json;
+		std::string cbor; // json encoded, empty if it couldn't be
+		uint32_t version;
+	};
+
+	struct Read {
+		uint32_t version;
+		bool full; // every fragment visited - since was before the sections were replaced, or isn't from this boot
+	};
+
+	// @param firstVersion  differs between boots, so a version from before a reboot isn't taken as a recent one
+	explicit StatusCache(uint32_t firstVersion = 0) : version_(firstVersion), reset_(firstVersion) {}
+
+	// controller task - replaces all sections, rendered at the next refresh
+	void setSections(std::vector<std::pair<std::string, render_t>> sections) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		version_++;
+		reset_ = version_;
+		sections_.clear();
+		renders_.clear();
+		bytes_ = 0;
+		for (auto &[key, render] : sections) {
+			sections_.push_back({std::move(key), "null", "\xf6", version_});
+			renders_.push_back({std::move(render), true});
+			bytes_ += sections_.back().json.size() + sections_.back().cbor.size();
+		}
+		dirty_ = true;
+	}
+
+	// controller task - sections with the prefix are rendered at the next refresh, "" marks all
+	void markDirty(std::string_view prefix) {
+		for (size_t i = 0; i < sections_.size(); ++i) {
+			if (sections_[i].key.compare(0, prefix.size(), prefix) == 0) {
+				renders_[i].dirty = true;
+				dirty_ = true;
+			}
+		}
+	}
+
+	// any task - true when refresh() would render something
+	bool isDirty() const {
+		return dirty_;
+	}
+
+	// controller task - renders dirty sections, returns how many of them changed
+	size_t refresh() {
+		if (!dirty_.exchange(false)) {
+			return 0;
+		}
+		struct Changed {
+			size_t section;
+			std::string json;
+			std::string cbor;
+		};
+		std::vector<Changed> changed;
+		uint32_t renders = 0;
+		for (size_t i = 0; i < sections_.size(); ++i) {
+			if (!renders_[i].dirty) {
+				continue;
+			}
+			renders_[i].dirty = false;
+			std::stringstream ss;
+			renders_[i].render(ss);
+			renders++;
+			auto json = ss.str();
+			if (json.empty()) {
+				json = "null";
+			}
+			if (json != sections_[i].json) { // only this task writes fragments, comparing needs no lock
+				auto cbor = CborStreamBuf::encode(json);
+				changed.push_back({i, std::move(json), std::move(cbor)});
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		rendered_ += renders;
+		if (!changed.empty()) {
+			version_++;
+			for (auto &[i, json, cbor] : changed) {
+				bytes_ += json.size() + cbor.size();
+				bytes_ -= sections_[i].json.size() + sections_[i].cbor.size();
+				sections_[i].json = std::move(json);
+				sections_[i].cbor = std::move(cbor);
+				sections_[i].version = version_;
+			}
+			changes_ += changed.size();
+		}
+		return changed.size();
+	}
+
+	// any task
+	uint32_t getVersion() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return version_;
+	}
+
+	// any task - visits fragments changed after since in section order, with the lock held so they're one version
+	template <typename F>
+	Read forEach(uint32_t since, F &&visit) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		Read read{version_, static_cast<int32_t>(since - reset_) < 0 || static_cast<int32_t>(version_ - since) < 0};
+		for (auto const &fragment : sections_) {
+			if (read.full || static_cast<int32_t>(fragment.version - since) > 0) {
+				visit(fragment);
+			}
+		}
+		return read;
+	}
+
+	// any task - visits all fragments
+	template <typename F>
+	Read forEach(F &&visit) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto const &fragment : sections_) {
+			visit(fragment);
+		}
+		return {version_, true};
+	}
+
+	// any task - {"version": <v>, "full": <bool>, "sections": {"<key>": <json>, ...}} with fragments changed after since
+	// @param cbor  buffer of ss when it encodes CBOR, fragments are copied encoded then
+	Read write(std::ostream &ss, uint32_t since, CborStreamBuf *cbor = nullptr) const {
+		bool first = true;
+		ss << "{\"sections\": {";
+		auto read = forEach(since, [&](Fragment const &fragment) {
+			ss << (first ? "" : ", ") << "\"" << fragment.key << "\": ";
+			writeValue(ss, cbor, fragment.json, fragment.cbor);
+			first = false;
+		});
+		ss << "}, \"version\": " << read.version << ", \"full\": " << (read.full ? "true" : "false") << "}";
+		return read;
+	}
+
+	// JSON of a fragment, or its CBOR when cbor is the buffer of ss
+	static void writeValue(std::ostream &ss, CborStreamBuf *cbor, std::string_view json, std::string_view encoded) {
+		if (cbor) {
+			cbor->writeEncoded(encoded);
+		} else {
+			ss << json;
+		}
+	}
+
+	// bytes - JSON and CBOR of all fragments
+	void getStatus(std::ostream &ss) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		ss << "{\"version\": " << version_ << ", \"sections\": " << sections_.size() << ", \"bytes\": " << bytes_ << ", \"renders\": " << rendered_ << ", \"changes\": " << changes_ << "}";
+	}
+
+private:
+	struct Render {
+		render_t render;
+		bool dirty;
+	};
+
+	// controller task only
+	std::vector<Render> renders_;
+	std::atomic_bool dirty_{false};
+
+	mutable std::mutex mutex_;
+	std::vector<Fragment> sections_; // written by controller task with the mutex held
+	uint32_t version_;
+	uint32_t reset_;
+	size_t bytes_ = 0;
+	uint32_t rendered_ = 0;
+	uint32_t changes_ = 0;
+};
+
+} // namespace heating
@@ -0,0 +1,131 @@
+#include "Storage.h"
+
+#include <LittleFS.h>
+#include <SPIFFS.h>
+#include <esp_partition.h>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Logger.h"
+
+namespace heating {
+
+namespace {
+
+constexpr char const *partitionLabel = "spiffs"; // LittleFS takes over the partition, label kept so OTA FS updates find it
+constexpr size_t migrationLimit = 64 * 1024; // config and programs are a few kB, kept in RAM while the partition is formatted
+constexpr size_t erasedCheckChunk = 256; // bytes read at a time, on the setup() stack
+constexpr char const *migratedDirectories[] = {"/cfg", "/programs"}; // html came along in old images, now in firmware
+
+struct MigratedFile {
+	std::string path;
+	std::string content;
+};
+
+bool isMigrated(std::string const &path) {
+	for (auto directory : migratedDirectories) {
+		auto length = strlen(directory);
+		if (path.compare(0, length, directory) == 0 && path.size() > length && path[length] == '/') {
+			return true;
+		}
+	}
+	return false;
+}
+
+// SPIFFS has no directories, everything is listed from the root with the full path. None if SPIFFS doesn't mount or
+// any file to migrate can't be read whole - the partition mustn't be formatted then.
+std::optional<std::vector<MigratedFile>> readSpiffs() {
+	if (!SPIFFS.begin(false, "/spiffs", 10, partitionLabel)) {
+		logger.printf("Storage: SPIFFS not mounted\n");
+		return std::nullopt;
+	}
+	std::optional<std::vector<MigratedFile>> files{std::in_place};
+	size_t total = 0;
+	File root = SPIFFS.open("/");
+	while (File file = root.openNextFile()) {
+		std::string path = file.path();
+		if (file.isDirectory() || !isMigrated(path)) {
+			continue;
+		}
+		if (total + file.size() > migrationLimit) {
+			logger.printf("Storage: '%s' over %zu bytes of files to migrate\n", path.c_str(), migrationLimit);
+			files.reset();
+			break;
+		}
+		MigratedFile migrated{path, std::string(file.size(), '\0')};
+		if (file.read(reinterpret_cast<uint8_t *>(migrated.content.data()), migrated.content.size()) != migrated.content.size()) {
+			logger.printf("Storage: reading '%s' failed\n", path.c_str());
+			files.reset();
+			break;
+		}
+		total += migrated.content.size();
+		files->push_back(std::move(migrated));
+	}
+	root.close();
+	SPIFFS.end();
+	return files;
+}
+
+// nothing written yet - a new device whose filesystem image wasn't uploaded
+bool isErased() {
+	auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+	if (!partition) {
+		return false;
+	}
+	uint32_t chunk[erasedCheckChunk / sizeof(uint32_t)];
+	for (size_t offset = 0; offset < partition->size; offset += sizeof(chunk)) {
+		if (esp_partition_read(partition, offset, chunk, sizeof(chunk)) != ESP_OK) {
+			return false;
+		}
+		for (auto word : chunk) {
+			if (word != UINT32_MAX) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+bool mountStorage() {
+	if (LittleFS.begin(false, "/littlefs", 10, partitionLabel)) {
+		return true;
+	}
+
+	// formatted only with everything to migrate in RAM - a damaged LittleFS or an unreadable SPIFFS is left as it is
+	logger.printf("Storage: no LittleFS, migrating from SPIFFS\n");
+	std::optional<std::vector<MigratedFile>> files;
+	if (isErased()) {
+		files.emplace();
+	} else {
+		files = readSpiffs();
+	}
+	if (!files) {
+		logger.printf("Storage: partition '%s' left untouched, neither LittleFS nor SPIFFS readable\n", partitionLabel);
+		return false;
+	}
+
+	if (!LittleFS.begin(true, "/littlefs", 10, partitionLabel)) {
+		logger.printf("Storage: formatting LittleFS failed\n");
+		return false;
+	}
+	for (auto directory : migratedDirectories) {
+		LittleFS.mkdir(directory);
+	}
+	size_t migrated = 0;
+	for (auto const &file : *files) {
+		File target = LittleFS.open(file.path.c_str(), FILE_WRITE);
+		if (!target || target.write(reinterpret_cast<uint8_t const *>(file.content.data()), file.content.size()) != file.content.size()) {
+			logger.printf("Storage: writing '%s' failed\n", file.path.c_str());
+			continue;
+		}
+		migrated++;
+	}
+	logger.printf("Storage: migrated %zu/%zu files to LittleFS\n", migrated, files->size());
+	return true;
+}
+
+} // namespace heating
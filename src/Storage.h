@@ -0,0 +1,11 @@
+#pragma once
+
+namespace heating {
+
+// Mounts the persistent store - LittleFS on the partition SPIFFS used, converting it on the first boot after the
+// switch. The partition is formatted only when it's blank or when SPIFFS mounted and every file of /cfg and /programs was
+// read; otherwise it's left untouched and false returned. Web assets no longer live there, they are linked into the
+// firmware (AssetImage.h).
+bool mountStorage();
+
+} // namespace heating
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace heating {
+
+struct TemperatureFilterConfig {
+	enum class method_t : uint8_t { mean, median, trimmedMean, ewma };
+
+	method_t method = method_t::trimmedMean;
+	uint16_t outlierTolerance = 50;   // 1/100 °C - allowed distance from window median
+	uint16_t maxRatePerMinute = 100;  // 1/100 °C per minute - additional allowed distance for samples taken at different time
+	uint8_t ewmaAlpha = 64;           // Q8 (64 = 0.25), used by ewma method
+	bool stalenessWeighting = true;   // older samples weigh less (down to half at max age)
+	uint8_t minConfidence = 20;       // % - below this room is treated as missing temperature
+	std::chrono::seconds maxSampleAge{180};
+	std::chrono::seconds sampleInterval{60}; // expected time between samples of one sensor - bluetooth duplicateRefresh
+};
+
+// Fixed-point (integer only) filter pipeline for room temperature samples:
+// staleness weighting -> outlier rejection (distance from median limited by tolerance and rate of change) -> aggregation.
+// Besides temperature it reports confidence (0-100%) derived from number of accepted samples against the number expected
+// within max age, freshness of newest one and ratio of rejected samples. A single sample no older than the sensor interval
+// gives 66%, still 33% at max age, so a room with one sensor stays above the default min confidence between its samples.
+class TemperatureFilter {
+public:
+	using clock_t = std::chrono::steady_clock;
+	static constexpr size_t maxSamples = 16;
+
+	struct Sample {
+		clock_t::time_point time;
+		int16_t temperature;
+	};
+
+	struct Result {
+		int16_t temperature;
+		uint8_t confidence; // %
+		uint8_t samples;    // accepted
+		uint8_t rejected;   // outliers
+	};
+
+	explicit TemperatureFilter(TemperatureFilterConfig const &config) : config_(config) {}
+
+	// samples must be ordered from oldest to newest
+	std::optional<Result> apply(Sample const *samples, size_t count, clock_t::time_point now) const {
+		std::array<Entry, maxSamples> fresh;
+		size_t freshCount = 0;
+
+		auto maxAgeMs = std::chrono::duration_cast<std::chrono::milliseconds>(config_.maxSampleAge).count();
+		if (maxAgeMs <= 0) {
+			return std::nullopt;
+		}
+
+		for (size_t i = 0; i < count && freshCount < maxSamples; ++i) {
+			auto ageMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - samples[i].time).count();
+			if (ageMs > maxAgeMs) {
+				continue;
+			}
+			if (ageMs < 0) {
+				ageMs = 0;
+			}
+			fresh[freshCount++] = Entry{static_cast<int32_t>(ageMs / 1000), samples[i].temperature, stalenessWeight(ageMs, maxAgeMs)};
+		}
+
+		if (freshCount == 0) {
+			return std::nullopt;
+		}
+
+		// outlier rejection - reference is the sample holding median value, of two middle ones the newer - the one that
+		// follows a change of temperature
+		auto byValue = fresh;
+		sortByValue(byValue.data(), freshCount);
+		auto reference = byValue[freshCount / 2];
+		if (freshCount % 2 == 0 && byValue[freshCount / 2 - 1].ageS < reference.ageS) {
+			reference = byValue[freshCount / 2 - 1];
+		}
+
+		std::array<Entry, maxSamples> accepted;
+		size_t acceptedCount = 0;
+		for (size_t i = 0; i < freshCount; ++i) {
+			int32_t allowed = config_.outlierTolerance + static_cast<int32_t>(config_.maxRatePerMinute) * std::abs(fresh[i].ageS - reference.ageS) / 60;
+			if (std::abs(fresh[i].temperature - reference.temperature) > allowed) {
+				continue;
+			}
+			accepted[acceptedCount++] = fresh[i];
+		}
+
+		if (acceptedCount == 0) {
+			return std::nullopt;
+		}
+
+		Result result;
+		result.samples = static_cast<uint8_t>(acceptedCount);
+		result.rejected = static_cast<uint8_t>(freshCount - acceptedCount);
+		result.temperature = aggregate(accepted.data(), acceptedCount);
+		result.confidence = confidence(accepted.data(), acceptedCount, freshCount);
+		return result;
+	}
+
+	struct SensorSamples {
+		Sample const *samples; // oldest first
+		size_t count;
+		uint8_t weight;
+	};
+
+	// room estimate - samples of every sensor filtered on their own, the estimates fused
+	std::optional<Result> apply(SensorSamples const *sensors, size_t count, clock_t::time_point now) const {
+		std::vector<WeightedEstimate> estimates;
+		estimates.reserve(count);
+		for (size_t i = 0; i < count; ++i) {
+			estimates.push_back({apply(sensors[i].samples, sensors[i].count, now), sensors[i].weight});
+		}
+		return fuse(estimates.data(), estimates.size(), config_.minConfidence);
+	}
+
+	struct WeightedEstimate {
+		std::optional<Result> estimate;
+		uint8_t weight;
+	};
+
+	// Fuses estimates of several sensors of one room weighted by configured weight and confidence.
+	// Sensors without estimate or with confidence below minConfidence are skipped, so the room falls back to the remaining ones.
+	static std::optional<Result> fuse(WeightedEstimate const *estimates, size_t count, uint8_t minConfidence) {
+		int64_t sum = 0;
+		int64_t weights = 0; // sensor weight * confidence
+		int64_t sensorWeights = 0;
+		Result result{0, 0, 0, 0};
+
+		for (size_t i = 0; i < count; ++i) {
+			auto const &estimate = estimates[i].estimate;
+			if (!estimate || estimate->confidence < minConfidence || estimates[i].weight == 0) {
+				continue;
+			}
+			int64_t weight = static_cast<int64_t>(estimates[i].weight) * estimate->confidence;
+			sum += static_cast<int64_t>(estimate->temperature) * weight;
+			weights += weight;
+			sensorWeights += estimates[i].weight;
+			result.samples += estimate->samples;
+			result.rejected += estimate->rejected;
+		}
+
+		if (weights == 0) {
+			return std::nullopt;
+		}
+		result.temperature = static_cast<int16_t>(roundedDiv(sum, weights));
+		result.confidence = static_cast<uint8_t>(weights / sensorWeights);
+		return result;
+	}
+
+private:
+	static constexpr int32_t one = 256; // Q8
+
+	struct Entry {
+		int32_t ageS;
+		int16_t temperature;
+		int32_t weight; // Q8
+	};
+
+	int32_t stalenessWeight(int64_t ageMs, int64_t maxAgeMs) const {
+		if (!config_.stalenessWeighting) {
+			return one;
+		}
+		return one - static_cast<int32_t>(ageMs * (one / 2) / maxAgeMs); // 1.0 for new sample, 0.5 at max age
+	}
+
+	static void sortByValue(Entry *entries, size_t count) { // insertion sort - at most maxSamples entries
+		for (size_t i = 1; i < count; ++i) {
+			auto entry = entries[i];
+			size_t j = i;
+			while (j > 0 && entries[j - 1].temperature > entry.temperature) {
+				entries[j] = entries[j - 1];
+				--j;
+			}
+			entries[j] = entry;
+		}
+	}
+
+	static int16_t weightedMean(Entry const *entries, size_t count) {
+		int64_t sum = 0;
+		int64_t weights = 0;
+		for (size_t i = 0; i < count; ++i) {
+			sum += static_cast<int64_t>(entries[i].temperature) * entries[i].weight;
+			weights += entries[i].weight;
+		}
+		return static_cast<int16_t>(roundedDiv(sum, weights));
+	}
+
+	static int64_t roundedDiv(int64_t value, int64_t divisor) {
+		return value >= 0 ? (value + divisor / 2) / divisor : (value - divisor / 2) / divisor;
+	}
+
+	int16_t aggregate(Entry *entries, size_t count) const {
+		switch (config_.method) {
+			case TemperatureFilterConfig::method_t::median: {
+				std::array<Entry, maxSamples> sorted;
+				std::copy(entries, entries + count, sorted.begin());
+				sortByValue(sorted.data(), count);
+				if (count % 2) {
+					return sorted[count / 2].temperature;
+				}
+				return static_cast<int16_t>(roundedDiv(sorted[count / 2 - 1].temperature + sorted[count / 2].temperature, 2));
+			}
+			case TemperatureFilterConfig::method_t::trimmedMean: {
+				std::array<Entry, maxSamples> sorted;
+				std::copy(entries, entries + count, sorted.begin());
+				sortByValue(sorted.data(), count);
+				size_t trim = count / 4; // drop lowest and highest quarter
+				return weightedMean(sorted.data() + trim, count - 2 * trim);
+			}
+			case TemperatureFilterConfig::method_t::ewma: {
+				int32_t value = entries[0].temperature * one; // Q8, oldest first
+				for (size_t i = 1; i < count; ++i) {
+					value += static_cast<int32_t>(config_.ewmaAlpha) * (entries[i].temperature * one - value) / one;
+				}
+				return static_cast<int16_t>(roundedDiv(value, one));
+			}
+			case TemperatureFilterConfig::method_t::mean:
+			default:
+				return weightedMean(entries, count);
+		}
+	}
+
+	// 1.0 while the newest sample is no older than the sensor interval, then down to 0.5 at max age
+	int64_t freshness(int32_t ageS) const {
+		auto interval = static_cast<int32_t>(config_.sampleInterval.count());
+		auto maxAge = static_cast<int32_t>(config_.maxSampleAge.count());
+		if (ageS <= interval || maxAge <= interval) {
+			return one;
+		}
+		return one - static_cast<int64_t>(std::min(ageS, maxAge) - interval) * (one / 2) / (maxAge - interval);
+	}
+
+	uint8_t confidence(Entry const *accepted, size_t acceptedCount, size_t freshCount) const {
+		// samples a sensor sends within max age, one of them counts for half
+		auto interval = std::max<int64_t>(config_.sampleInterval.count(), 1);
+		auto expected = static_cast<size_t>(std::clamp<int64_t>(config_.maxSampleAge.count() / interval, 1, maxSamples));
+		int64_t countFactor = static_cast<int64_t>(expected + std::min(acceptedCount, expected)) * one / (2 * expected);
+		int64_t newest = freshness(accepted[acceptedCount - 1].ageS);
+		int64_t outlierFactor = static_cast<int64_t>(acceptedCount) * one / freshCount;
+		return static_cast<uint8_t>(100 * countFactor * newest * outlierFactor / (one * one * one));
+	}
+
+	TemperatureFilterConfig const &config_;
+};
+
+} // namespace heating
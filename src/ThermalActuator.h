@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace heating {
+
+// Estimated position of a thermal (wax) valve actuator. Valves are normally open: energized coil closes the valve.
+// Actuator travels linearly between fully closed and fully open within configured open/close times, starting
+// from the position it had reached when the coil state changed (reversal in the middle of travel is handled).
+class ThermalActuator {
+public:
+	using clock_t = std::chrono::steady_clock;
+	static constexpr uint16_t fullyOpen = 1000; // per mille
+
+	struct Config {
+		std::chrono::seconds openTime{180};
+		std::chrono::seconds closeTime{180};
+		uint8_t capacity = 1; // relative flow capacity of the heating circuit
+	};
+
+	ThermalActuator() = default;
+	explicit ThermalActuator(Config config) : config_(config) {}
+
+	void setEnergized(bool energized, clock_t::time_point now) {
+		if (energized == energized_) {
+			return;
+		}
+		position_ = getPosition(now);
+		since_ = now;
+		energized_ = energized;
+	}
+
+	// per mille, 0 - closed, 1000 - fully open
+	uint16_t getPosition(clock_t::time_point now) const {
+		auto travelTime = energized_ ? config_.closeTime : config_.openTime;
+		if (travelTime.count() <= 0 || since_ == clock_t::time_point{}) {
+			return energized_ ? 0 : fullyOpen;
+		}
+
+		auto elapsedMs = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(now - since_).count());
+		int64_t delta = elapsedMs * fullyOpen / (std::chrono::duration_cast<std::chrono::milliseconds>(travelTime).count());
+
+		if (energized_) {
+			return static_cast<uint16_t>(std::max<int64_t>(0, position_ - delta));
+		}
+		return static_cast<uint16_t>(std::min<int64_t>(fullyOpen, position_ + delta));
+	}
+
+	bool isEnergized() const { return energized_; }
+
+	Config const &getConfig() const { return config_; }
+
+private:
+	Config config_;
+	bool energized_ = false;
+	uint16_t position_ = fullyOpen; // position at since_
+	clock_t::time_point since_{};
+};
+
+} // namespace heating
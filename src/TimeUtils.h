@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 namespace ib::timeutils {
 
@@ -21,4 +22,13 @@ inline uint16_t parseTimeHHMM(const std::string &str) {
 	return static_cast<uint16_t>(hours * 100 + minutes);
 }
 
+// Adds minutes to HHMM time, wrapping over midnight to the following days of the week (0 - Sunday).
+inline std::pair<uint16_t, uint8_t> addMinutesHHMM(uint16_t time, uint8_t dayOfTheWeek, uint32_t minutes) {
+	static constexpr uint32_t minutesPerDay = 24 * 60;
+	uint32_t total = (time / 100) * 60 + time % 100 + minutes;
+	uint8_t day = static_cast<uint8_t>((dayOfTheWeek + total / minutesPerDay) % 7);
+	total %= minutesPerDay;
+	return {static_cast<uint16_t>((total / 60) * 100 + total % 60), day};
+}
+
 }
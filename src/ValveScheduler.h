@@ -0,0 +1,137 @@
+#pragma once
+
+#include "GpioPort.h"
+#include "ThermalActuator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace heating {
+
+// Keeps desired and applied valve states apart and applies only the differences.
+// Energizing an actuator (closing a valve) draws inrush current, so at most maxEnergizedPerStep_ coils are switched on
+// per step and the next step is scheduled stepInterval_ later instead of blocking. De-energizing is applied at once.
+// All changes from one step are staged first and committed together, so pins sharing an I2C extender are written once.
+class ValveScheduler {
+public:
+	using clock_t = std::chrono::steady_clock;
+	using onActuation_t = std::function<void(uint8_t valve, bool closed)>;
+
+	ValveScheduler(std::vector<std::unique_ptr<gpio::GpioPort>> ports, std::chrono::milliseconds stepInterval, uint8_t maxEnergizedPerStep, onActuation_t onActuation = {}, std::vector<ThermalActuator::Config> const &actuators = {})
+		: ports_(std::move(ports)), stepInterval_(stepInterval), maxEnergizedPerStep_(maxEnergizedPerStep > 0 ? maxEnergizedPerStep : 1), onActuation_(std::move(onActuation))
+		, desiredClosed_(ports_.size(), false), closed_(ports_.size(), false), actuations_(ports_.size(), 0), actuators_(ports_.size()) {
+		for (auto &port : ports_) {
+			port->initOutput(); // coil off = valve open
+		}
+		for (size_t valve = 0; valve < actuators_.size() && valve < actuators.size(); ++valve) {
+			actuators_[valve] = ThermalActuator(actuators[valve]);
+		}
+	}
+
+	size_t size() const { return ports_.size(); }
+
+	void setClosed(uint8_t valve, bool closed) {
+		if (valve < desiredClosed_.size()) {
+			desiredClosed_[valve] = closed;
+		}
+	}
+
+	void setAllOpen() {
+		std::fill(desiredClosed_.begin(), desiredClosed_.end(), false);
+	}
+
+	bool isPending() const { return desiredClosed_ != closed_; }
+
+	// applied state, not the requested one
+	bool isClosed(uint8_t valve) const { return valve < closed_.size() && closed_[valve]; }
+
+	uint32_t getActuations(uint8_t valve) const { return valve < actuations_.size() ? actuations_[valve] : 0; }
+
+	// estimated actuator position in per mille
+	uint16_t getPosition(uint8_t valve, clock_t::time_point now) const { return valve < actuators_.size() ? actuators_[valve].getPosition(now) : 0; }
+
+	// Opened part (per mille) of the capacity of valves which are supposed to be open.
+	// If no valve is supposed to be open there is nothing to wait for.
+	uint16_t getOpenCapacity(clock_t::time_point now) const {
+		uint32_t total = 0;
+		uint32_t opened = 0;
+		for (size_t valve = 0; valve < actuators_.size(); ++valve) {
+			if (desiredClosed_[valve]) {
+				continue;
+			}
+			auto capacity = actuators_[valve].getConfig().capacity;
+			total += capacity * ThermalActuator::fullyOpen;
+			opened += capacity * actuators_[valve].getPosition(now);
+		}
+		return total == 0 ? ThermalActuator::fullyOpen : static_cast<uint16_t>(opened * ThermalActuator::fullyOpen / total);
+	}
+
+	std::chrono::seconds getOpenTime(uint8_t valve) const { return valve < actuators_.size() ? actuators_[valve].getConfig().openTime : std::chrono::seconds{0}; }
+
+	// Applies one step of pending changes. Returns number of valves switched.
+	size_t process(clock_t::time_point now) {
+		if (!isPending()) {
+			return 0;
+		}
+
+		size_t switched = 0;
+		uint8_t energized = 0;
+		bool energizeAllowed = now >= nextEnergizeTime_;
+
+		for (size_t valve = 0; valve < ports_.size(); ++valve) {
+			bool closed = desiredClosed_[valve];
+			if (closed == closed_[valve]) {
+				continue;
+			}
+
+			if (closed) {
+				if (!energizeAllowed || energized >= maxEnergizedPerStep_) {
+					continue;
+				}
+				energized++;
+			}
+
+			ports_[valve]->stage(closed); // HIGH = coil on = closed
+			closed_[valve] = closed;
+			actuators_[valve].setEnergized(closed, now);
+			actuations_[valve]++;
+			switched++;
+			if (onActuation_) {
+				onActuation_(valve, closed);
+			}
+		}
+
+		if (switched > 0) {
+			commitAll();
+		}
+
+		if (energized > 0) {
+			nextEnergizeTime_ = now + stepInterval_;
+		}
+		return switched;
+	}
+
+private:
+	void commitAll() {
+		for (auto &port : ports_) {
+			port->commit();
+		}
+	}
+
+	std::vector<std::unique_ptr<gpio::GpioPort>> ports_;
+	std::chrono::milliseconds stepInterval_;
+	uint8_t maxEnergizedPerStep_;
+	onActuation_t onActuation_;
+
+	std::vector<bool> desiredClosed_;
+	std::vector<bool> closed_;
+	std::vector<uint32_t> actuations_;
+	std::vector<ThermalActuator> actuators_;
+	clock_t::time_point nextEnergizeTime_{};
+};
+
+} // namespace heating
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+namespace heating {
+
+struct WarmWaterConfig {
+	enum class mode_t : uint8_t { comfort, eco };
+	enum class priority_t : uint8_t { warmWater, heating }; // who gets the boiler first when both demand
+
+	struct Window {
+		uint16_t timeFrom = 0; // HHMM
+		uint16_t timeTo = 0;   // HHMM, smaller than timeFrom - over midnight
+		std::array<bool, 7> days = {{true, true, true, true, true, true, true}}; // 0 - Sunday
+		mode_t mode = mode_t::comfort;
+
+		bool doesFit(uint16_t time, uint8_t dayOfTheWeek) const {
+			if (time >= 2400 || dayOfTheWeek > 6 || !days[dayOfTheWeek]) {
+				return false;
+			}
+			if (timeFrom <= timeTo) {
+				return time >= timeFrom && time <= timeTo;
+			}
+			return time >= timeFrom || time <= timeTo;
+		}
+	};
+
+	struct AntiLegionella {
+		bool enabled = false;
+		uint8_t day = 0;            // 0 - Sunday
+		uint16_t time = 200;        // HHMM
+		uint8_t temperature = 60;   // °C
+		uint16_t holdMinutes = 30;  // at temperature
+		uint16_t maxMinutes = 180;  // cycle gives up after this
+	};
+
+	bool enabled = false;             // program writes warm water settings to the boiler
+	uint8_t comfortTemperature = 55;  // °C
+	uint8_t ecoTemperature = 48;
+	uint8_t setbackTemperature = 40;  // outside of windows, 0 - warm water off
+	std::vector<Window> windows;
+	priority_t priority = priority_t::warmWater;
+	uint16_t maxDeferralMinutes = 60; // heating priority postpones warm water at most this long
+	AntiLegionella antiLegionella;
+};
+
+// Decides warm water set point from time windows, anti-legionella cycle and space heating demand.
+// The boiler keeps its own tank hysteresis and warm water priority - program only moves the set point, so the tank
+// isn't held at comfort temperature when nobody draws water. With heating priority, raising the set point waits while
+// rooms demand heat, at most maxDeferralMinutes.
+class WarmWaterProgram {
+public:
+	using clock_t = std::chrono::steady_clock;
+	enum class state_t : uint8_t { off, setback, eco, comfort, deferred, antiLegionella };
+
+	struct Target {
+		bool enabled = false;    // warm water on boiler
+		uint8_t temperature = 0; // °C
+		state_t state = state_t::off;
+
+		bool operator==(Target const &other) const { return enabled == other.enabled && temperature == other.temperature && state == other.state; }
+		bool operator!=(Target const &other) const { return !(*this == other); }
+	};
+
+	struct Inputs {
+		uint16_t time = 0;        // HHMM
+		uint8_t dayOfTheWeek = 0; // 0 - Sunday
+		uint32_t date = 0;        // YYYYMMDD
+		bool heatingDemand = false;
+		std::optional<int16_t> tankTemperature; // 1/100 °C
+	};
+
+	explicit WarmWaterProgram(WarmWaterConfig config = {}) : config_(std::move(config)) {}
+
+	// date (YYYYMMDD) of the last finished anti-legionella cycle, passed or failed - kept across restarts so the cycle
+	// doesn't run twice on its day
+	std::optional<uint32_t> getLastCycleDate() const { return lastCycleDate_; }
+	void setLastCycleDate(uint32_t date) { lastCycleDate_ = date; }
+
+	// none when the program is disabled - boiler settings are left as they are
+	std::optional<Target> evaluate(Inputs const &inputs, clock_t::time_point now) {
+		if (!config_.enabled) {
+			return std::nullopt;
+		}
+
+		Target target = getScheduled(inputs);
+		if (auto disinfection = updateAntiLegionella(inputs, now)) {
+			target = disinfection.value();
+		} else if (shouldDefer(target, inputs.heatingDemand, now)) {
+			target = Target{config_.setbackTemperature > 0, config_.setbackTemperature, state_t::deferred};
+		}
+		last_ = target;
+		return target;
+	}
+
+	void getStatus(std::ostream &ss) const {
+		static constexpr std::array<char const *, 6> states{"off", "setback", "eco", "comfort", "deferred", "antiLegionella"};
+		ss << "{\"enabled\": " << (config_.enabled ? "true" : "false");
+		if (last_) {
+			ss << ", \"state\": \"" << states[static_cast<size_t>(last_->state)] << "\", \"temperature\": " << static_cast<int>(last_->temperature);
+		}
+		ss << ", \"antiLegionella\": {\"cycles\": " << disinfections_ << ", \"failed\": " << failedDisinfections_ << "}}";
+	}
+
+private:
+	static constexpr uint16_t toMinutes(uint16_t hhmm) { return (hhmm / 100) * 60 + hhmm % 100; }
+
+	Target getScheduled(Inputs const &inputs) const {
+		auto window = std::find_if(config_.windows.begin(), config_.windows.end(), [&inputs](auto const &w) { return w.doesFit(inputs.time, inputs.dayOfTheWeek); });
+		if (window == config_.windows.end()) {
+			return Target{config_.setbackTemperature > 0, config_.setbackTemperature, config_.setbackTemperature > 0 ? state_t::setback : state_t::off};
+		}
+		if (window->mode == WarmWaterConfig::mode_t::eco) {
+			return Target{true, config_.ecoTemperature, state_t::eco};
+		}
+		return Target{true, config_.comfortTemperature, state_t::comfort};
+	}
+
+	std::optional<Target> updateAntiLegionella(Inputs const &inputs, clock_t::time_point now) {
+		auto const &cycle = config_.antiLegionella;
+		if (!cycle.enabled) {
+			return std::nullopt;
+		}
+		if (disinfectionStart_ && inputs.date != cycleDate_) { // cut off at midnight, its day is over
+			disinfections_++;
+			failedDisinfections_++;
+			finishAntiLegionella();
+		}
+		if (inputs.dayOfTheWeek != cycle.day || lastCycleDate_ == inputs.date || toMinutes(inputs.time) < toMinutes(cycle.time)) {
+			return std::nullopt;
+		}
+
+		if (!disinfectionStart_) {
+			disinfectionStart_ = now;
+			disinfectionReached_.reset();
+			cycleDate_ = inputs.date;
+		}
+		if (!disinfectionReached_ && inputs.tankTemperature && *inputs.tankTemperature >= cycle.temperature * 100 - reachedMargin) {
+			disinfectionReached_ = now;
+		}
+
+		if (disinfectionReached_ && now - *disinfectionReached_ >= std::chrono::minutes(cycle.holdMinutes)) {
+			disinfections_++;
+			finishAntiLegionella();
+			return std::nullopt;
+		}
+		if (now - *disinfectionStart_ >= std::chrono::minutes(cycle.maxMinutes)) {
+			disinfections_++;
+			failedDisinfections_++;
+			finishAntiLegionella();
+			return std::nullopt;
+		}
+		return Target{true, cycle.temperature, state_t::antiLegionella};
+	}
+
+	void finishAntiLegionella() {
+		lastCycleDate_ = cycleDate_;
+		disinfectionStart_.reset();
+		disinfectionReached_.reset();
+	}
+
+	// deferral starts with heating demand and lasts until demand ends or the limit passes - then waits for demand to end
+	bool shouldDefer(Target const &scheduled, bool heatingDemand, clock_t::time_point now) {
+		if (config_.priority != WarmWaterConfig::priority_t::heating || !heatingDemand) {
+			deferralStart_.reset();
+			return false;
+		}
+		if (!scheduled.enabled || scheduled.temperature <= config_.setbackTemperature) {
+			return false;
+		}
+		if (!deferralStart_) {
+			deferralStart_ = now;
+		}
+		return now - *deferralStart_ < std::chrono::minutes(config_.maxDeferralMinutes);
+	}
+
+	static constexpr int16_t reachedMargin = 200; // tank sensor sits away from the coldest spot, 1/100 °C
+
+	WarmWaterConfig config_;
+	std::optional<Target> last_;
+	std::optional<clock_t::time_point> deferralStart_;
+	std::optional<clock_t::time_point> disinfectionStart_;
+	std::optional<clock_t::time_point> disinfectionReached_;
+	uint32_t cycleDate_ = 0; // of the running cycle
+	std::optional<uint32_t> lastCycleDate_;
+	uint32_t disinfections_ = 0;
+	uint32_t failedDisinfections_ = 0;
+};
+
+// Energy and water of single warm water events - boiler reports warm water activity, metrics attribute gas and flow to it.
+class WarmWaterEvents {
+public:
+	static constexpr size_t capacity = 8;
+
+	struct Event {
+		uint64_t startMs = 0;
+		uint32_t durationMs = 0;
+		double energyKwh = 0;
+		double liters = 0;
+	};
+
+	// call after energy and water of the passed interval were added
+	void update(bool active, uint64_t nowMs) {
+		if (active && !current_) {
+			current_ = Event{nowMs};
+		} else if (!active && current_) {
+			current_->durationMs = static_cast<uint32_t>(nowMs - current_->startMs);
+			events_[(first_ + count_) % capacity] = current_.value();
+			if (count_ == capacity) {
+				first_ = (first_ + 1) % capacity;
+			} else {
+				count_++;
+			}
+			total_++;
+			current_.reset();
+		}
+	}
+
+	void addEnergy(double kwh) {
+		if (current_) {
+			current_->energyKwh += kwh;
+		}
+	}
+
+	void addWater(double liters) {
+		if (current_) {
+			current_->liters += liters;
+		}
+	}
+
+	bool isActive() const { return current_.has_value(); }
+	size_t size() const { return count_; }
+	uint32_t getTotal() const { return total_; }
+
+	// oldest first
+	Event const &operator[](size_t index) const { return events_[(first_ + index) % capacity]; }
+
+	// events completed after `since` (total count when last read), at most capacity of them
+	void getJSON(std::ostream &ss, uint32_t since = 0) const {
+		size_t skip = count_ - std::min<size_t>(count_, total_ - std::min(since, total_));
+		ss << "[";
+		for (size_t i = skip; i < count_; ++i) {
+			auto const &event = (*this)[i];
+			ss << (i > skip ? ", " : "") << "{\"durationS\": " << event.durationMs / 1000 << ", \"energyKwh\": " << event.energyKwh << ", \"liters\": " << event.liters << "}";
+		}
+		ss << "]";
+	}
+
+private:
+	std::array<Event, capacity> events_{};
+	size_t first_ = 0;
+	size_t count_ = 0;
+	uint32_t total_ = 0;
+	std::optional<Event> current_;
+};
+
+} // namespace heating
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "JsonScanner.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace heating {
+
+struct ForecastConfig {
+	bool enabled = false;
+	std::string path = "/data/2.5/forecast"; // hourly endpoints ("hourly" array) are understood too
+	uint16_t interval = 3600;                // s
+	uint8_t entries = 16;                    // cnt parameter, 3 h steps on the free API
+	uint8_t lookaheadHours = 4;              // roughly the time constant of the building
+	uint8_t gain = 50;                       // % of the coming temperature change applied to the curve now
+	int16_t solarGain = 200;                 // 1/100 °C added to outdoor temperature for a clear sky around noon
+	int16_t maxAdjustment = 500;             // 1/100 °C
+};
+
+// Forecast kept in a fixed array - no allocation when it's refreshed.
+class HourlyForecast {
+public:
+	static constexpr size_t capacity = 48;
+
+	struct Entry {
+		uint32_t time = 0;       // UTC epoch
+		int16_t temperature = 0; // 1/100 °C
+		uint8_t clouds = 0;      // %
+	};
+
+	void clear() {
+		size_ = 0;
+		timezoneOffset_ = 0;
+	}
+
+	// entries must come in time order, false when full
+	bool push(Entry const &entry) {
+		if (size_ == capacity || (size_ > 0 && entry.time <= entries_[size_ - 1].time)) {
+			return false;
+		}
+		entries_[size_++] = entry;
+		return true;
+	}
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	Entry const &operator[](size_t index) const { return entries_[index]; }
+
+	int32_t getTimezoneOffset() const { return timezoneOffset_; }
+	void setTimezoneOffset(int32_t offset) { timezoneOffset_ = offset; }
+
+	// linear interpolation between entries; before the first entry its value is used up to maxLead seconds ahead
+	std::optional<int16_t> temperatureAt(uint32_t time, uint32_t maxLead = 3 * 3600) const {
+		if (size_ == 0 || time > entries_[size_ - 1].time || time + maxLead < entries_[0].time) {
+			return std::nullopt;
+		}
+		if (time <= entries_[0].time) {
+			return entries_[0].temperature;
+		}
+		size_t next = 1;
+		while (entries_[next].time < time) {
+			++next;
+		}
+		auto const &a = entries_[next - 1];
+		auto const &b = entries_[next];
+		int32_t span = static_cast<int32_t>(b.time - a.time);
+		int32_t offset = static_cast<int32_t>(time - a.time);
+		return static_cast<int16_t>(a.temperature + (static_cast<int32_t>(b.temperature - a.temperature) * offset) / span);
+	}
+
+	// clouds of the step the time falls into
+	std::optional<uint8_t> cloudsAt(uint32_t time, uint32_t maxLead = 3 * 3600) const {
+		if (size_ == 0 || time > entries_[size_ - 1].time || time + maxLead < entries_[0].time) {
+			return std::nullopt;
+		}
+		size_t index = 0;
+		while (index + 1 < size_ && entries_[index + 1].time <= time) {
+			++index;
+		}
+		return entries_[index].clouds;
+	}
+
+	void getJSON(std::ostream &ss, size_t limit = capacity) const {
+		ss << "[";
+		for (size_t i = 0; i < std::min(limit, size_); ++i) {
+			ss << (i ? ", " : "") << "{\"dt\": " << entries_[i].time << ", \"temp\": " << entries_[i].temperature << ", \"clouds\": " << static_cast<int>(entries_[i].clouds) << "}";
+		}
+		ss << "]";
+	}
+
+private:
+	std::array<Entry, capacity> entries_{};
+	size_t size_ = 0;
+	int32_t timezoneOffset_ = 0; // s, local time = UTC + offset
+};
+
+// Parser of OpenWeather forecast responses fed in network sized chunks, keeps only the fields used for control:
+//   {"list"|"hourly": [{"dt", "temp" | "main": {"temp"}, "clouds" | "clouds": {"all"}}, ...], "city": {"timezone"} | "timezone_offset"}
+class ForecastParser : public JsonScanner<ForecastParser> {
+public:
+	explicit ForecastParser(HourlyForecast &forecast) : forecast_(forecast) { reset(); }
+
+	void reset() {
+		JsonScanner::reset();
+		forecast_.clear();
+	}
+
+	// true when a complete document with at least one entry was parsed
+	bool finish() { return JsonScanner::finish() && !forecast_.empty(); }
+
+private:
+	friend class JsonScanner<ForecastParser>;
+
+	bool isForecastArray() const { return depth() >= 2 && !isArray(0) && isArray(1) && (keyIs(0, "list") || keyIs(0, "hourly")); }
+
+	// inside one object of the forecast array
+	bool isEntryLevel() const { return depth() == 3 && isForecastArray() && !isArray(2); }
+
+	void onOpen() {
+		if (isEntryLevel()) {
+			entry_ = {};
+			hasTime_ = false;
+			hasTemperature_ = false;
+		}
+	}
+
+	void onClose() {
+		if (isEntryLevel() && hasTime_ && hasTemperature_) {
+			forecast_.push(entry_);
+		}
+	}
+
+	void onValue(std::string_view text, bool string) {
+		if (string) {
+			return;
+		}
+		char *end = nullptr;
+		double value = std::strtod(text.data(), &end);
+		if (end == text.data()) {
+			return; // true, false, null
+		}
+
+		if (depth() == 1 && keyIs(0, "timezone_offset")) {
+			forecast_.setTimezoneOffset(static_cast<int32_t>(value));
+		} else if (depth() == 2 && keyIs(0, "city") && keyIs(1, "timezone")) {
+			forecast_.setTimezoneOffset(static_cast<int32_t>(value));
+		} else if (isEntryLevel()) {
+			if (keyIs(2, "dt")) {
+				entry_.time = static_cast<uint32_t>(value);
+				hasTime_ = true;
+			} else if (keyIs(2, "temp")) {
+				setTemperature(value);
+			} else if (keyIs(2, "clouds")) {
+				setClouds(value);
+			}
+		} else if (depth() == 4 && isForecastArray() && !isArray(2)) {
+			if (keyIs(2, "main") && keyIs(3, "temp")) {
+				setTemperature(value);
+			} else if (keyIs(2, "clouds") && keyIs(3, "all")) {
+				setClouds(value);
+			}
+		}
+	}
+
+	void setTemperature(double value) {
+		entry_.temperature = static_cast<int16_t>(std::clamp(value, -300.0, 300.0) * 100 + (value < 0 ? -0.5 : 0.5));
+		hasTemperature_ = true;
+	}
+
+	void setClouds(double value) { entry_.clouds = static_cast<uint8_t>(std::clamp(value, 0.0, 100.0)); }
+
+	HourlyForecast &forecast_;
+	HourlyForecast::Entry entry_;
+	bool hasTime_ = false;
+	bool hasTemperature_ = false;
+};
+
+// What the forecast means for the heating curve right now. The building reacts with a delay of a few hours, so the
+// curve is evaluated at an outdoor temperature shifted towards the coming one: a cold snap pre-charges the building
+// with a warmer flow before it arrives, a warm spell or sunny hours let it coast on stored heat.
+struct ForecastOutlook {
+	bool valid = false;
+	int16_t meanTemperature = 0; // 1/100 °C over the lookahead
+	uint8_t sun = 0;             // %, clear sky daylight share of the lookahead hours
+	int16_t adjustment = 0;      // 1/100 °C added to outdoor temperature for the heating curve
+
+	static constexpr uint8_t daylightFrom = 9; // local hours with noticeable solar gain through windows
+	static constexpr uint8_t daylightTo = 16;
+
+	// @param now                 UTC epoch
+	// @param currentTemperature  1/100 °C
+	static ForecastOutlook evaluate(HourlyForecast const &forecast, uint32_t now, int16_t currentTemperature, ForecastConfig const &config) {
+		ForecastOutlook outlook;
+		int32_t temperatureSum = 0;
+		int32_t samples = 0;
+		int32_t sunSum = 0;
+		for (uint8_t hour = 1; hour <= config.lookaheadHours; ++hour) {
+			uint32_t time = now + hour * 3600u;
+			auto temperature = forecast.temperatureAt(time);
+			if (!temperature) {
+				continue;
+			}
+			temperatureSum += temperature.value();
+			samples++;
+
+			auto localHour = static_cast<uint8_t>(((static_cast<int64_t>(time) + forecast.getTimezoneOffset()) / 3600) % 24);
+			if (localHour >= daylightFrom && localHour < daylightTo) {
+				sunSum += 100 - forecast.cloudsAt(time).value_or(100);
+			}
+		}
+		if (samples == 0) {
+			return outlook;
+		}
+
+		outlook.valid = true;
+		outlook.meanTemperature = static_cast<int16_t>(temperatureSum / samples);
+		// a single sunny hour out of four adds a quarter of the gain
+		outlook.sun = static_cast<uint8_t>(sunSum / samples);
+		int32_t change = (static_cast<int32_t>(outlook.meanTemperature) - currentTemperature) * config.gain / 100;
+		int32_t solar = static_cast<int32_t>(config.solarGain) * outlook.sun / 100;
+		outlook.adjustment = static_cast<int16_t>(std::clamp<int32_t>(change + solar, -config.maxAdjustment, config.maxAdjustment));
+		return outlook;
+	}
+
+	void getStatus(std::ostream &ss) const {
+		ss << "{\"valid\": " << (valid ? "true" : "false");
+		if (valid) {
+			ss << ", \"meanTemperature\": " << meanTemperature << ", \"sun\": " << static_cast<int>(sun) << ", \"adjustment\": " << adjustment;
+		}
+		ss << "}";
+	}
+};
+
+} // namespace heating
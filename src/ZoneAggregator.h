@@ -0,0 +1,199 @@
+#pragma once
+
+#include "HeatingCurve.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace heating {
+
+// Group of rooms sharing emitters - underfloor, radiators - with its own heating curve
+struct ZoneConfig {
+	std::string name;
+	std::vector<std::string> rooms;
+	std::optional<std::array<uint8_t, 9>> heatingCurve; // none - boiler heating curve
+	uint8_t weight = 1;                                 // weighted policy, per demanding room
+};
+
+struct ZonesConfig {
+	enum class policy_t : uint8_t { max, weighted, timeSliced };
+
+	policy_t policy = policy_t::max;
+	std::chrono::seconds slice{900}; // time sliced policy - how long one zone is served before the next one
+	std::vector<ZoneConfig> zones;   // empty - no zones, boiler heating curve for all rooms
+};
+
+// Collects demand of rooms per zone and chooses the single flow temperature the boiler gets:
+//   max        - the hottest demanding zone, nobody is underheated
+//   weighted   - mean of demanding zones weighted by demanding rooms and zone weight
+//   timeSliced - demanding zones served in turns at their own flow temperature, the others' valves closed meanwhile
+// Rooms not listed in any zone fall into an implicit default zone following the boiler heating curve.
+class ZoneAggregator {
+public:
+	using clock_t = std::chrono::steady_clock;
+
+	struct Decision {
+		bool start = false;                     // any zone starts heating
+		bool keep = false;                      // any zone continues heating
+		std::optional<int16_t> flowTemperature; // 1/100 °C, none without zones or demand
+		std::optional<size_t> activeZone;       // time sliced policy
+	};
+
+	explicit ZoneAggregator(ZonesConfig const &config = {}) : policy_(config.policy), slice_(config.slice) {
+		for (auto const &zone : config.zones) {
+			zones_.push_back(Zone{zone.name, zone.rooms, zone.heatingCurve ? std::optional(compileHeatingCurve(*zone.heatingCurve)) : std::nullopt, std::max<uint8_t>(zone.weight, 1), Demand{}, std::nullopt});
+		}
+		if (!zones_.empty()) {
+			zones_.push_back(Zone{"default", {}, std::nullopt, 1, Demand{}, std::nullopt});
+		}
+	}
+
+	bool isEnabled() const { return !zones_.empty(); }
+	size_t size() const { return zones_.size(); }
+
+	// zone index of a room, rooms outside configured zones go to the default zone (last)
+	size_t getZone(std::string const &room) const {
+		for (size_t zone = 0; zone + 1 < zones_.size(); ++zone) {
+			if (std::find(zones_[zone].rooms.begin(), zones_[zone].rooms.end(), room) != zones_[zone].rooms.end()) {
+				return zone;
+			}
+		}
+		return zones_.empty() ? 0 : zones_.size() - 1;
+	}
+
+	void clearDemand() {
+		for (auto &zone : zones_) {
+			zone.demand = Demand{};
+			zone.flowTemperature.reset();
+		}
+	}
+
+	// boilerTemperatureOverride in °C, like room settings
+	void addRoom(size_t zone, bool hasTemperature, bool start, bool keep, std::optional<uint8_t> boilerTemperatureOverride) {
+		if (zone >= zones_.size()) {
+			return;
+		}
+		auto &demand = zones_[zone].demand;
+		demand.rooms += hasTemperature ? 1 : 0;
+		demand.start = demand.start || start;
+		demand.keep = demand.keep || keep;
+		if (start || keep) {
+			demand.demanding++;
+		}
+		if (boilerTemperatureOverride) {
+			demand.override = std::max(demand.override.value_or(0), boilerTemperatureOverride.value());
+		}
+	}
+
+	// defaultCurveTemperature - boiler heating curve at current outdoor temperature, 1/100 °C
+	Decision aggregate(int16_t outdoorTemperature, int16_t defaultCurveTemperature, clock_t::time_point now) {
+		Decision decision;
+		int32_t weighted = 0;
+		int32_t weights = 0;
+		for (auto &zone : zones_) {
+			decision.start = decision.start || zone.demand.start;
+			decision.keep = decision.keep || zone.demand.keep;
+			if (!isDemanding(zone)) {
+				continue;
+			}
+			int16_t flow = zone.curve ? (*zone.curve)(outdoorTemperature) : defaultCurveTemperature;
+			if (zone.demand.override) {
+				flow = std::max<int16_t>(flow, zone.demand.override.value() * 100);
+			}
+			zone.flowTemperature = flow;
+			decision.flowTemperature = std::max<int16_t>(decision.flowTemperature.value_or(INT16_MIN), flow);
+			weighted += static_cast<int32_t>(flow) * zone.weight * zone.demand.demanding;
+			weights += zone.weight * zone.demand.demanding;
+		}
+
+		if (!decision.flowTemperature) {
+			active_.reset();
+			flowTemperature_.reset();
+			return decision;
+		}
+
+		if (policy_ == ZonesConfig::policy_t::weighted && weights > 0) {
+			decision.flowTemperature = static_cast<int16_t>(weighted / weights);
+		} else if (policy_ == ZonesConfig::policy_t::timeSliced) {
+			rotate(now);
+			decision.activeZone = active_;
+			decision.flowTemperature = zones_[active_.value()].flowTemperature;
+		}
+		flowTemperature_ = decision.flowTemperature;
+		return decision;
+	}
+
+	void getStatus(std::ostream &ss) const {
+		static constexpr std::array<char const *, 3> policies{"max", "weighted", "timeSliced"};
+		ss << "{\"policy\": \"" << policies[static_cast<size_t>(policy_)] << "\"";
+		if (flowTemperature_) {
+			ss << ", \"flowTemperature\": " << flowTemperature_.value();
+		}
+		ss << ", \"zones\": [";
+		for (size_t i = 0; i < zones_.size(); ++i) {
+			auto const &zone = zones_[i];
+			ss << (i ? ", " : "") << "{\"name\": \"" << zone.name << "\", \"rooms\": " << static_cast<int>(zone.demand.rooms) << ", \"demanding\": " << static_cast<int>(zone.demand.demanding);
+			ss << ", \"demand\": " << (isDemanding(zone) ? "true" : "false");
+			if (zone.flowTemperature) {
+				ss << ", \"flowTemperature\": " << zone.flowTemperature.value();
+			}
+			if (policy_ == ZonesConfig::policy_t::timeSliced) {
+				ss << ", \"active\": " << (active_ == i ? "true" : "false");
+			}
+			ss << "}";
+		}
+		ss << "]}";
+	}
+
+private:
+	struct Demand {
+		uint8_t rooms = 0; // with valid temperature
+		uint8_t demanding = 0;
+		bool start = false;
+		bool keep = false;
+		std::optional<uint8_t> override;
+	};
+
+	struct Zone {
+		std::string name;
+		std::vector<std::string> rooms;
+		std::optional<CompiledHeatingCurve<9>> curve;
+		uint8_t weight = 1;
+		Demand demand;
+		std::optional<int16_t> flowTemperature;
+	};
+
+	static bool isDemanding(Zone const &zone) { return zone.demand.start || zone.demand.keep; }
+
+	// keeps serving the active zone for a slice while it demands, then moves to the next demanding one
+	void rotate(clock_t::time_point now) {
+		bool expired = !active_ || !isDemanding(zones_[active_.value()]) || now - sliceStart_ >= slice_;
+		if (!expired) {
+			return;
+		}
+		size_t first = active_ ? active_.value() + 1 : 0;
+		for (size_t i = 0; i < zones_.size(); ++i) {
+			size_t candidate = (first + i) % zones_.size();
+			if (isDemanding(zones_[candidate])) { // may be the same zone again when it's the only one demanding
+				active_ = candidate;
+				sliceStart_ = now;
+				return;
+			}
+		}
+	}
+
+	ZonesConfig::policy_t policy_;
+	std::chrono::seconds slice_;
+	std::vector<Zone> zones_;
+	std::optional<size_t> active_;
+	clock_t::time_point sliceStart_;
+	std::optional<int16_t> flowTemperature_;
+};
+
+} // namespace heating
@@ -1,10 +1,16 @@
 #include "config.h"
 #include "BeaconBleAddress.h"
+#include "JsonScanner.h"
 #include "Logger.h"
+#include "ProgramImage.h"
+#include "ProgramParser.h"
+#include "RequestParsers.h"
 #include "TimeUtils.h"
 
-#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <algorithm>
 #include <memory>
+#include <string_view>
 
 namespace json {
 std::string getString(cJSON *root, const char *name) {
@@ -45,101 +51,256 @@ namespace config {
 
 namespace helper {
 
-std::vector<std::string> parseValves(cJSON *root) {
-	std::vector<std::string> retVal;
-	auto valves = cJSON_GetObjectItem(root, "valves");
-	if (valves && valves->type == cJSON_Array) {
-		auto noValves = cJSON_GetArraySize(valves);
-		for (auto valve = 0; valve < noValves; ++valve) {
-			auto item = cJSON_GetArrayItem(valves, valve);
-			if (cJSON_IsString(item)) {
-				retVal.push_back(item->valuestring);
-			} else if (cJSON_IsNumber(item)) {
-				retVal.push_back(std::to_string(item->valueint)); // backward compat: index as string
+heating::ZonesConfig parseZones(cJSON *obj) {
+	heating::ZonesConfig config;
+	auto policy = json::getString(obj, "policy");
+	if (policy == "weighted") {
+		config.policy = heating::ZonesConfig::policy_t::weighted;
+	} else if (policy == "timesliced") {
+		config.policy = heating::ZonesConfig::policy_t::timeSliced;
+	}
+	config.slice = std::chrono::seconds(json::getOptInt<uint16_t>(obj, "slice").value_or(config.slice.count()));
+
+	auto list = cJSON_GetObjectItem(obj, "list");
+	if (!cJSON_IsArray(list)) {
+		return config;
+	}
+	cJSON *item;
+	cJSON_ArrayForEach(item, list) {
+		heating::ZoneConfig zone;
+		zone.name = json::getString(item, "name");
+		zone.weight = json::getOptInt<uint8_t>(item, "weight").value_or(zone.weight);
+		auto rooms = cJSON_GetObjectItem(item, "rooms");
+		cJSON *room;
+		cJSON_ArrayForEach(room, rooms) {
+			if (cJSON_IsString(room)) {
+				zone.rooms.emplace_back(room->valuestring);
+			}
+		}
+		auto curve = cJSON_GetObjectItem(item, "heatingCurve");
+		if (cJSON_IsArray(curve) && cJSON_GetArraySize(curve) == 9) {
+			std::array<uint8_t, 9> points{};
+			for (int pt = 0; pt < 9; ++pt) {
+				points[pt] = static_cast<uint8_t>(cJSON_GetArrayItem(curve, pt)->valueint);
 			}
+			zone.heatingCurve = points;
 		}
+		config.zones.push_back(std::move(zone));
 	}
-	return retVal;
+	return config;
 }
 
-heating::RoomConfig::TemperatureSetting parseTemperature(cJSON *obj) {
-	heating::RoomConfig::TemperatureSetting temp;
-	temp.name_ = json::getString(obj, "name");
-	try {
-		temp.timeFrom_ = ib::timeutils::parseTimeHHMM(json::getString(obj, "time_from"));
-		temp.timeTo_ = ib::timeutils::parseTimeHHMM(json::getString(obj, "time_to"));
-	} catch (std::exception const &e) {
-		heating::logger.printf("Exception parsing temperature '%s' time ranges: %s\n", temp.name_.c_str(), e.what());
-	}
-	temp.temperature_ = json::getInt(obj, "temp");
-	temp.heatingTemperatureOverride_ = json::getOptInt<uint8_t>(obj, "boiler_temp");
-	temp.valves_ = parseValves(obj);
-
-	if (cJSON_HasObjectItem(obj, "enabled")) {
-		auto item = cJSON_GetObjectItem(obj, "enabled");
-		temp.enabled_ = cJSON_IsTrue(item);
+heating::WarmWaterConfig parseWarmWater(cJSON *obj) {
+	heating::WarmWaterConfig config;
+	config.enabled = json::getBool(obj, "enabled");
+	config.comfortTemperature = json::getOptInt<uint8_t>(obj, "comfortTemp").value_or(config.comfortTemperature);
+	config.ecoTemperature = json::getOptInt<uint8_t>(obj, "ecoTemp").value_or(config.ecoTemperature);
+	config.setbackTemperature = json::getOptInt<uint8_t>(obj, "setbackTemp").value_or(config.setbackTemperature);
+	config.maxDeferralMinutes = json::getOptInt<uint16_t>(obj, "maxDeferral").value_or(config.maxDeferralMinutes);
+	if (json::getString(obj, "priority") == "heating") {
+		config.priority = heating::WarmWaterConfig::priority_t::heating;
 	}
 
-	if (cJSON_HasObjectItem(obj, "days")) {
-		auto days = cJSON_GetObjectItem(obj, "days");
-		if (days && days->type == cJSON_Array) {
-			auto noDays = cJSON_GetArraySize(days);
-			if (noDays > 0) {
-				temp.days_ = {{false, false, false, false, false, false, false}};
+	auto windows = cJSON_GetObjectItem(obj, "windows");
+	if (cJSON_IsArray(windows)) {
+		cJSON *item;
+		cJSON_ArrayForEach(item, windows) {
+			heating::WarmWaterConfig::Window window;
+			try {
+				window.timeFrom = ib::timeutils::parseTimeHHMM(json::getString(item, "time_from"));
+				window.timeTo = ib::timeutils::parseTimeHHMM(json::getString(item, "time_to"));
+			} catch (std::exception const &e) {
+				heating::logger.printf("Exception parsing warm water window time ranges: %s\n", e.what());
+				continue;
 			}
-
-			for (auto day = 0; day < noDays; ++day) {
-				auto item = cJSON_GetArrayItem(days, day);
-				if (cJSON_IsNumber(item)) {
-					if (item->valueint >= 0 && item->valueint < 7) {
-						temp.days_[item->valueint] = true;
+			if (json::getString(item, "mode") == "eco") {
+				window.mode = heating::WarmWaterConfig::mode_t::eco;
+			}
+			auto days = cJSON_GetObjectItem(item, "days");
+			if (cJSON_IsArray(days) && cJSON_GetArraySize(days) > 0) {
+				window.days = {{false, false, false, false, false, false, false}};
+				cJSON *day;
+				cJSON_ArrayForEach(day, days) {
+					if (cJSON_IsNumber(day) && day->valueint >= 0 && day->valueint < 7) {
+						window.days[day->valueint] = true;
 					}
 				}
 			}
+			config.windows.push_back(window);
 		}
 	}
 
-	return temp;
+	auto antiLegionella = cJSON_GetObjectItem(obj, "antiLegionella");
+	if (cJSON_IsObject(antiLegionella)) {
+		auto &cycle = config.antiLegionella;
+		cycle.enabled = json::getBool(antiLegionella, "enabled");
+		cycle.day = json::getOptInt<uint8_t>(antiLegionella, "day").value_or(cycle.day) % 7;
+		cycle.temperature = json::getOptInt<uint8_t>(antiLegionella, "temp").value_or(cycle.temperature);
+		cycle.holdMinutes = json::getOptInt<uint16_t>(antiLegionella, "hold").value_or(cycle.holdMinutes);
+		cycle.maxMinutes = json::getOptInt<uint16_t>(antiLegionella, "max").value_or(cycle.maxMinutes);
+		try {
+			cycle.time = ib::timeutils::parseTimeHHMM(json::getString(antiLegionella, "time"));
+		} catch (std::exception const &e) {
+			heating::logger.printf("Exception parsing anti-legionella time: %s\n", e.what());
+		}
+	}
+	return config;
 }
 
-heating::RoomConfig parseRoom(cJSON *obj) {
-	heating::RoomConfig room;
-	room.baseTemperature_ = json::getInt(obj, "base_temp");
-	room.temperatureMarginUp_ = json::getInt(obj, "temp_margin_up");
-	room.temperatureMarginDown_ = json::getInt(obj, "temp_margin_down");
-	room.name_ = json::getString(obj, "name");
-	room.sensorAddress_ = heating::BLEAddresFromString(json::getString(obj, "sensor"));
+heating::ForecastConfig parseForecast(cJSON *obj) {
+	heating::ForecastConfig config;
+	config.enabled = json::getBool(obj, "enabled");
+	if (auto path = json::getString(obj, "path"); !path.empty()) {
+		config.path = path;
+	}
+	config.interval = std::max<uint16_t>(json::getOptInt<uint16_t>(obj, "interval").value_or(config.interval), 600);
+	config.entries = std::clamp<uint8_t>(json::getOptInt<uint8_t>(obj, "entries").value_or(config.entries), 1, heating::HourlyForecast::capacity);
+	config.lookaheadHours = json::getOptInt<uint8_t>(obj, "lookahead").value_or(config.lookaheadHours);
+	config.gain = json::getOptInt<uint8_t>(obj, "gain").value_or(config.gain);
+	config.solarGain = json::getOptInt<int16_t>(obj, "solarGain").value_or(config.solarGain);
+	config.maxAdjustment = json::getOptInt<int16_t>(obj, "maxAdjustment").value_or(config.maxAdjustment);
+	return config;
+}
 
-	if (cJSON_HasObjectItem(obj, "enabled")) {
-		auto item = cJSON_GetObjectItem(obj, "enabled");
-		room.enabled_ = cJSON_IsTrue(item);
+// legacy "outdoorSensor" makes the selected source preferred, the other one stands in when it gets stale
+heating::OutdoorTemperatureConfig outdoorFromSensor(BoilerConfig::outdoorSensor_t sensor) {
+	using source_t = heating::OutdoorTemperatureConfig::source_t;
+	heating::OutdoorTemperatureConfig config;
+	auto &ems = config.source[static_cast<size_t>(source_t::ems)];
+	auto &openweather = config.source[static_cast<size_t>(source_t::openweather)];
+	if (sensor == BoilerConfig::outdoorSensor_t::ems) {
+		ems.quality = 100;
+		openweather.quality = 40;
+	} else if (sensor == BoilerConfig::outdoorSensor_t::openweather) {
+		ems.quality = 40;
+		openweather.quality = 100;
 	}
+	return config;
+}
 
-	room.valves_ = parseValves(obj);
+// "outdoor": {"smoothing": 900, "hold": 21600, "fallback": -2000, "ems": {"enabled": true, "quality": 100, "maxAge": 600},
+//             "openweather": {...}, "mqtt": {..., "topic": "sensors/outdoor"}, "ble": {..., "address": "58:2d:34:3a:71:56", "key": "<32 hex digits>"}}
+void parseOutdoor(cJSON *obj, heating::OutdoorTemperatureConfig &config) {
+	config.smoothing = json::getOptInt<uint16_t>(obj, "smoothing").value_or(config.smoothing);
+	config.hold = json::getOptInt<uint16_t>(obj, "hold").value_or(config.hold);
+	config.fallbackTemperature = json::getOptInt<int16_t>(obj, "fallback").value_or(config.fallbackTemperature);
+
+	static constexpr std::array<char const *, heating::OutdoorTemperatureConfig::sources> names{"ems", "openweather", "mqtt", "ble"};
+	for (size_t i = 0; i < names.size(); ++i) {
+		auto source = cJSON_GetObjectItem(obj, names[i]);
+		if (!cJSON_IsObject(source)) {
+			continue;
+		}
+		auto &sourceConfig = config.source[i];
+		if (cJSON_HasObjectItem(source, "enabled")) {
+			sourceConfig.enabled = json::getBool(source, "enabled");
+		}
+		sourceConfig.quality = std::min<uint8_t>(json::getOptInt<uint8_t>(source, "quality").value_or(sourceConfig.quality), 100);
+		sourceConfig.maxAge = json::getOptInt<uint16_t>(source, "maxAge").value_or(sourceConfig.maxAge);
+	}
 
-	auto temperatures = cJSON_GetObjectItem(obj, "temperatures");
-	if (temperatures && temperatures->type == cJSON_Array) {
-		for (auto it = 0; it < cJSON_GetArraySize(temperatures); ++it) {
-			auto item = cJSON_GetArrayItem(temperatures, it);
-			if (cJSON_IsObject(item)) {
-				room.temperatures_.push_back(parseTemperature(item));
-			}
+	auto mqtt = cJSON_GetObjectItem(obj, "mqtt");
+	if (cJSON_IsObject(mqtt)) {
+		config.mqttTopic = json::getString(mqtt, "topic");
+	}
+	auto ble = cJSON_GetObjectItem(obj, "ble");
+	if (cJSON_IsObject(ble)) {
+		auto address = json::getString(ble, "address");
+		if (!address.empty()) {
+			config.bleAddress = heating::BLEAddresFromString(address);
 		}
+		config.bleKey = heating::parseBindKey(json::getString(ble, "key"));
 	}
 
-	heating::logger.printf("Room '%s' sensor: '" PRiBleAddress "' baseTemp: %d enabled: %d valves: %zu temperatures: %zu valves: ", room.name_.c_str(), PRaBleAddress(room.sensorAddress_), room.baseTemperature_, room.enabled_, room.valves_.size(), room.temperatures_.size());
+	// external sensors are used once configured, unless disabled
+	using source_t = heating::OutdoorTemperatureConfig::source_t;
+	config.source[static_cast<size_t>(source_t::mqtt)].enabled = !config.mqttTopic.empty() && !cJSON_IsFalse(cJSON_GetObjectItem(mqtt, "enabled"));
+	config.source[static_cast<size_t>(source_t::ble)].enabled = config.bleAddress && !cJSON_IsFalse(cJSON_GetObjectItem(ble, "enabled"));
+}
+
+void logRoom(heating::RoomConfig const &room) {
+	heating::logger.printf("Room '%s' sensors: %zu baseTemp: %d enabled: %d valves: %zu temperatures: %zu valves: ", room.name_.c_str(), room.sensors_.size(), room.baseTemperature_, room.enabled_, room.valves_.size(), room.temperatures_.size());
 
 	for (auto const &valve : room.valves_) {
 		heating::logger.printf("'%s' ", valve.c_str());
 	}
+	heating::logger.print("sensors: ");
+	for (auto const &sensor : room.sensors_) {
+		heating::logger.printf("'" PRiBleAddress "' (%u%s) ", PRaBleAddress(sensor.address_), sensor.weight_, sensor.bindKey_ ? ", encrypted" : "");
+	}
 	heating::logger.println("");
+}
+
+// file read in small chunks, the parser keeps what it needs; hash - of the content, when given
+template <typename Parser>
+bool parseFile(File &file, Parser &parser, heating::AssetHash *hash = nullptr) {
+	uint8_t chunk[256];
+	while (file.available()) {
+		auto length = file.read(chunk, sizeof(chunk));
+		if (length == 0) {
+			break;
+		}
+		if (hash) {
+			hash->update(chunk, length);
+		}
+		parser.feed(reinterpret_cast<char const *>(chunk), length);
+	}
+	return parser.finish();
+}
+
+heating::AssetHash hashFile(File &file) {
+	heating::AssetHash hash;
+	uint8_t chunk[256];
+	while (file.available()) {
+		auto length = file.read(chunk, sizeof(chunk));
+		if (length == 0) {
+			break;
+		}
+		hash.update(chunk, length);
+	}
+	return hash;
+}
 
-	return room;
+// compiled program next to its JSON - "/programs/<name>.json" -> "/programs/<name>.bin"
+std::string programImageName(std::string const &filename) {
+	return filename.substr(0, filename.rfind('.')) + ".bin";
+}
+
+std::optional<std::vector<heating::RoomConfig>> loadProgramImage(std::string const &filename, File &json) {
+	File file = LittleFS.open(filename.c_str(), FILE_READ);
+	if (!file) {
+		return std::nullopt;
+	}
+	std::string image(file.size(), '\0');
+	auto length = file.read(reinterpret_cast<uint8_t *>(image.data()), image.size());
+	file.close();
+	if (length != image.size()) {
+		return std::nullopt;
+	}
+	auto rooms = heating::ProgramImage::load(image, hashFile(json).get());
+	heating::logger.printf("Program image '%s' %s\n", filename.c_str(), rooms ? "loaded" : "stale");
+	return rooms;
+}
+
+// written aside and renamed over the previous one, a reset while writing leaves that one or none
+bool saveProgramImage(std::string const &filename, std::string const &image) {
+	auto temporary = filename + ".tmp";
+	File file = LittleFS.open(temporary.c_str(), FILE_WRITE);
+	if (!file) {
+		return false;
+	}
+	bool written = file.write(reinterpret_cast<uint8_t const *>(image.data()), image.size()) == image.size();
+	file.close();
+	if (!written || !LittleFS.rename(temporary.c_str(), filename.c_str())) {
+		LittleFS.remove(temporary.c_str());
+		return false;
+	}
+	return true;
 }
 }
 
 std::optional<PinConfig> getBoilerPin() {
-	File file = SPIFFS.open("/cfg/cfgpins.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgpins.json", FILE_READ);
 	if (!file)
 		return {};
 	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
@@ -170,7 +331,7 @@ std::optional<PinConfig> getBoilerPin() {
 }
 
 RTCPins getRTCPins() {
-	File file = SPIFFS.open("/cfg/cfgpins.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgpins.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -207,7 +368,7 @@ RTCPins getRTCPins() {
 }
 
 EmsPins getEmsPins() {
-	File file = SPIFFS.open("/cfg/cfgpins.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgpins.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -244,7 +405,7 @@ EmsPins getEmsPins() {
 }
 
 std::optional<EmsForwarderPins> getEmsForwarderPins() {
-	File file = SPIFFS.open("/cfg/cfgpins.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgpins.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -281,7 +442,7 @@ std::optional<EmsForwarderPins> getEmsForwarderPins() {
 }
 
 std::vector<PinConfig> getValvePins() {
-	File file = SPIFFS.open("/cfg/cfgpins.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgpins.json", FILE_READ);
 	if (!file)
 		return {};
 	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
@@ -317,7 +478,11 @@ std::vector<PinConfig> getValvePins() {
 				auto lbl = cJSON_GetObjectItem(item, "label");
 				if (lbl && cJSON_IsString(lbl))
 					label = lbl->valuestring;
-				result.push_back(PinConfig{src->valuestring, static_cast<uint8_t>(pin->valueint), std::move(label)});
+				PinConfig pinConfig{src->valuestring, static_cast<uint8_t>(pin->valueint), std::move(label)};
+				pinConfig.openTime = json::getOptInt<uint16_t>(item, "openTime").value_or(pinConfig.openTime);
+				pinConfig.closeTime = json::getOptInt<uint16_t>(item, "closeTime").value_or(pinConfig.closeTime);
+				pinConfig.capacity = json::getOptInt<uint8_t>(item, "capacity").value_or(pinConfig.capacity);
+				result.push_back(std::move(pinConfig));
 			}
 			continue;
 		}
@@ -331,7 +496,7 @@ std::vector<PinConfig> getValvePins() {
 }
 
 std::vector<GpioExtenderConfig> getGpioExtenders() {
-	File file = SPIFFS.open("/cfg/cfgpins.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgpins.json", FILE_READ);
 	if (!file)
 		return {};
 	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
@@ -361,7 +526,7 @@ std::vector<GpioExtenderConfig> getGpioExtenders() {
 }
 
 APConfig getAPConfig() {
-	File file = SPIFFS.open("/cfg/cfgap.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgap.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -392,7 +557,7 @@ APConfig getAPConfig() {
 }
 
 WiFiConfig getWiFiConfig() {
-	File file = SPIFFS.open("/cfg/cfgwifi.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgwifi.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -411,7 +576,7 @@ WiFiConfig getWiFiConfig() {
 }
 
 EmsConfig getEmsConfig() {
-	File file = SPIFFS.open("/cfg/cfgnetwork.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgnetwork.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -433,7 +598,7 @@ EmsConfig getEmsConfig() {
 }
 
 NetworkConfig getNetworkConfig() {
-	File file = SPIFFS.open("/cfg/cfgnetwork.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgnetwork.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -469,7 +634,7 @@ NetworkConfig getNetworkConfig() {
 }
 
 BluetoothConfig getBluetoothConfig() {
-	File file = SPIFFS.open("/cfg/cfgnetwork.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgnetwork.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -492,13 +657,25 @@ BluetoothConfig getBluetoothConfig() {
 	BluetoothConfig config;
 	config.scanTime = json::getOptInt<uint16_t>(bt, "scanTime").value_or(60);
 	config.scanInterval = json::getOptInt<uint16_t>(bt, "scanInterval").value_or(60);
+	config.windowMs = json::getOptInt<uint16_t>(bt, "windowMs").value_or(config.windowMs);
+	config.periodMs = json::getOptInt<uint16_t>(bt, "periodMs").value_or(config.periodMs);
+	config.duplicateRefresh = json::getOptInt<uint16_t>(bt, "duplicateRefresh").value_or(config.duplicateRefresh);
+	if (cJSON_HasObjectItem(bt, "continuous")) {
+		config.continuous = cJSON_IsTrue(cJSON_GetObjectItem(bt, "continuous"));
+	}
+	if (cJSON_HasObjectItem(bt, "active")) {
+		config.active = cJSON_IsTrue(cJSON_GetObjectItem(bt, "active"));
+	}
+	if (config.windowMs > config.periodMs) {
+		config.windowMs = config.periodMs;
+	}
 
 	return config;
 }
 
 
 MqttConfig getMqttConfig() {
-	File file = SPIFFS.open("/cfg/cfgnetwork.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgnetwork.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -532,7 +709,7 @@ MqttConfig getMqttConfig() {
 }
 
 OpenWeatherConfig getOpenWeatherConfig() {
-	File file = SPIFFS.open("/cfg/cfgnetwork.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgnetwork.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -557,11 +734,18 @@ OpenWeatherConfig getOpenWeatherConfig() {
 	config.latitude = json::getString(openweather, "latitude");
 	config.longitude = json::getString(openweather, "longitude");
 	config.interval = json::getInt(openweather, "interval");
+	if (auto server = json::getString(openweather, "server"); !server.empty()) {
+		config.server = server;
+	}
+	auto forecast = cJSON_GetObjectItem(openweather, "forecast");
+	if (cJSON_IsObject(forecast)) {
+		config.forecast = helper::parseForecast(forecast);
+	}
 	return config;
 }
 
 BoilerConfig getBoilerConfig() {
-	File file = SPIFFS.open("/cfg/cfgboiler.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgboiler.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
@@ -600,6 +784,12 @@ BoilerConfig getBoilerConfig() {
 	}
 
 	config.boiler.valvePreheatingDelay = json::getInt(boiler, "valvePreheatingDelay");
+	config.boiler.valveSwitchStepMs = json::getOptInt<uint16_t>(boiler, "valveSwitchStepMs").value_or(config.boiler.valveSwitchStepMs);
+	config.boiler.valveSwitchBatchSize = json::getOptInt<uint8_t>(boiler, "valveSwitchBatchSize").value_or(config.boiler.valveSwitchBatchSize);
+	config.boiler.valveOpenCapacityToStart = json::getOptInt<uint8_t>(boiler, "valveOpenCapacityToStart").value_or(config.boiler.valveOpenCapacityToStart);
+	if (cJSON_HasObjectItem(boiler, "valvePreopen")) {
+		config.boiler.valvePreopen = json::getBool(boiler, "valvePreopen");
+	}
 	config.boiler.minHeatingTemp = json::getInt(boiler, "minHeatingTemp");
 	config.boiler.minHeatingTemp = json::getInt(boiler, "maxHeatingTemp");
 	auto controlMode = json::getString(boiler, "controlMode");
@@ -620,91 +810,239 @@ BoilerConfig getBoilerConfig() {
 		config.boiler.outdoorSensor = BoilerConfig::outdoorSensor_t::no;
 	}
 
+	config.outdoor = helper::outdoorFromSensor(config.boiler.outdoorSensor);
+	auto outdoor = cJSON_GetObjectItem(root.get(), "outdoor");
+	if (cJSON_IsObject(outdoor)) {
+		helper::parseOutdoor(outdoor, config.outdoor);
+	}
+
+	auto optimizer = cJSON_GetObjectItem(root.get(), "optimizer");
+	if (cJSON_IsObject(optimizer)) {
+		config.optimizer.enabled = json::getBool(optimizer, "enabled");
+		config.optimizer.updateInterval = std::chrono::seconds(json::getOptInt<uint16_t>(optimizer, "updateInterval").value_or(config.optimizer.updateInterval.count()));
+		config.optimizer.maxStep = json::getOptInt<int16_t>(optimizer, "maxStep").value_or(config.optimizer.maxStep);
+		config.optimizer.maxOffset = json::getOptInt<int16_t>(optimizer, "maxOffset").value_or(config.optimizer.maxOffset);
+		config.optimizer.minSlope = json::getOptInt<uint16_t>(optimizer, "minSlope").value_or(config.optimizer.minSlope);
+		config.optimizer.maxSlope = json::getOptInt<uint16_t>(optimizer, "maxSlope").value_or(config.optimizer.maxSlope);
+		config.optimizer.targetGainRate = json::getOptInt<int16_t>(optimizer, "targetGainRate").value_or(config.optimizer.targetGainRate);
+		config.optimizer.condensingReturn = json::getOptInt<int16_t>(optimizer, "condensingReturn").value_or(config.optimizer.condensingReturn);
+		config.optimizer.minFlowReturnDelta = json::getOptInt<int16_t>(optimizer, "minFlowReturnDelta").value_or(config.optimizer.minFlowReturnDelta);
+		if (config.optimizer.minSlope > config.optimizer.maxSlope) {
+			config.optimizer.minSlope = config.optimizer.maxSlope;
+		}
+	}
+
+	auto zones = cJSON_GetObjectItem(root.get(), "zones");
+	if (cJSON_IsObject(zones)) {
+		config.zones = helper::parseZones(zones);
+	}
+
+	auto warmWater = cJSON_GetObjectItem(root.get(), "warmWater");
+	if (cJSON_IsObject(warmWater)) {
+		config.warmWater = helper::parseWarmWater(warmWater);
+	}
+
 	return config;
 }
 
+std::optional<heating::FlowOptimizerState> getFlowOptimizerState() {
+	File file = LittleFS.open("/cfg/optimizer.json", FILE_READ);
+	if (!file) {
+		return std::nullopt;
+	}
+	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
+	file.close();
+	if (!root || root->type != cJSON_Object) {
+		return std::nullopt;
+	}
 
-std::string parseProgram(std::string const &data) {
-	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(data.c_str()), &cJSON_Delete);
-	if (!root) {
-		heating::logger.println("Error parsing json");
-		return {};
+	heating::FlowOptimizerState state;
+	state.offset = json::getOptInt<int16_t>(root.get(), "offset").value_or(state.offset);
+	state.slope = json::getOptInt<uint16_t>(root.get(), "slope").value_or(state.slope);
+	return state;
+}
+
+bool saveFlowOptimizerState(heating::FlowOptimizerState const &state) {
+	File file = LittleFS.open("/cfg/optimizer.json", FILE_WRITE);
+	if (!file) {
+		heating::logger.printf("Unable to save flow optimizer state\n");
+		return false;
 	}
-	return json::getString(root.get(), "program");
+	file.printf("{\"offset\": %d, \"slope\": %u}", state.offset, state.slope);
+	file.close();
+	return true;
 }
 
+std::optional<heating::CurveLearnerState> getCurveLearnerState() {
+	File file = LittleFS.open("/cfg/curvelearner.json", FILE_READ);
+	if (!file) {
+		return std::nullopt;
+	}
+	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
+	file.close();
+	if (!root || root->type != cJSON_Object) {
+		return std::nullopt;
+	}
+	auto points = cJSON_GetObjectItem(root.get(), "points");
+	if (!cJSON_IsArray(points) || cJSON_GetArraySize(points) != 9) {
+		heating::logger.printf("Curve learner state invalid, starting over\n");
+		return std::nullopt;
+	}
+
+	heating::CurveLearnerState state;
+	for (int pt = 0; pt < 9; ++pt) {
+		auto item = cJSON_GetArrayItem(points, pt);
+		if (!cJSON_IsArray(item) || cJSON_GetArraySize(item) != 5) {
+			return std::nullopt;
+		}
+		auto value = [item](int idx) { return static_cast<float>(cJSON_GetArrayItem(item, idx)->valuedouble); };
+		state.points[pt] = heating::CurveLearnerState::Point{value(0), value(1), value(2), value(3), value(4)};
+	}
+	return state;
+}
+
+bool saveCurveLearnerState(heating::CurveLearnerState const &state) {
+	File file = LittleFS.open("/cfg/curvelearner.json", FILE_WRITE);
+	if (!file) {
+		heating::logger.printf("Unable to save curve learner state\n");
+		return false;
+	}
+	file.print("{\"points\": [");
+	for (size_t pt = 0; pt < state.points.size(); ++pt) {
+		auto const &p = state.points[pt];
+		file.printf("%s[%.4g, %.4g, %.4g, %.4g, %.4g]", pt ? ", " : "", p.weight, p.x, p.y, p.xx, p.xy);
+	}
+	file.print("]}");
+	file.close();
+	return true;
+}
+
+std::optional<uint32_t> getWarmWaterLastCycleDate() {
+	File file = LittleFS.open("/cfg/warmwater.json", FILE_READ);
+	if (!file) {
+		return std::nullopt;
+	}
+	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
+	file.close();
+	if (!root || root->type != cJSON_Object) {
+		return std::nullopt;
+	}
+	return json::getOptInt<uint32_t>(root.get(), "lastCycleDate");
+}
+
+bool saveWarmWaterLastCycleDate(uint32_t date) {
+	File file = LittleFS.open("/cfg/warmwater.json", FILE_WRITE);
+	if (!file) {
+		heating::logger.printf("Unable to save warm water state\n");
+		return false;
+	}
+	file.printf("{\"lastCycleDate\": %u}", static_cast<unsigned>(date));
+	file.close();
+	return true;
+}
+
+bool saveHeatingCurve(std::array<uint8_t, 9> const &curve) {
+	File file = LittleFS.open("/cfg/cfgboiler.json", FILE_READ);
+	if (!file) {
+		return false;
+	}
+	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
+	file.close();
+	if (!root || root->type != cJSON_Object) {
+		heating::logger.printf("Error parsing boiler config, heating curve not saved\n");
+		return false;
+	}
+
+	std::array<int, 9> points;
+	std::copy(curve.begin(), curve.end(), points.begin());
+	cJSON_DeleteItemFromObject(root.get(), "heatingCurve");
+	cJSON_AddItemToObject(root.get(), "heatingCurve", cJSON_CreateIntArray(points.data(), static_cast<int>(points.size())));
+
+	std::unique_ptr<char, decltype(&cJSON_free)> text(cJSON_Print(root.get()), &cJSON_free);
+	if (!text) {
+		return false;
+	}
+	file = LittleFS.open("/cfg/cfgboiler.json", FILE_WRITE);
+	if (!file) {
+		heating::logger.printf("Unable to save boiler config\n");
+		return false;
+	}
+	file.print(text.get());
+	file.close();
+	return true;
+}
+
+
 std::string getCurrentProgram() {
-	File file = SPIFFS.open("/cfg/cfgprogram.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgprogram.json", FILE_READ);
 	if (!file) {
 		return {};
 	}
-	auto program = parseProgram(file.readString().c_str());
+	heating::ProgramSelectionParser parser;
+	bool parsed = helper::parseFile(file, parser);
 	file.close();
-	return program;
+	if (!parsed) {
+		heating::logger.println("Error parsing json");
+		return {};
+	}
+	return parser.program();
 }
 
 std::vector<heating::RoomConfig> getRoomsConfig(std::string const &program) {
 	std::string filename = "/programs/" + program + ".json";
 
-	heating::logger.printf("Reading config for '%s', exists: %d\n", filename.c_str(), SPIFFS.exists(filename.c_str()));
+	heating::logger.printf("Reading config for '%s', exists: %d\n", filename.c_str(), LittleFS.exists(filename.c_str()));
 
-	if (!SPIFFS.exists(filename.c_str())) {
+	if (!LittleFS.exists(filename.c_str())) {
 		filename = "/programs/default.json";
-		heating::logger.printf("Program not found. Reading config for '%s', exists: %d\n", filename.c_str(), SPIFFS.exists(filename.c_str()));
+		heating::logger.printf("Program not found. Reading config for '%s', exists: %d\n", filename.c_str(), LittleFS.exists(filename.c_str()));
 	}
 
-	File file = SPIFFS.open(filename.c_str(), FILE_READ);
-	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> rooms(cJSON_Parse(file.readString().c_str()), &cJSON_Delete);
-	file.close();
-
+	File file = LittleFS.open(filename.c_str(), FILE_READ);
+	auto imageName = helper::programImageName(filename);
+	auto rooms = helper::loadProgramImage(imageName, file);
 	if (!rooms) {
-		heating::logger.printf("Error parsing json. No rooms: '%s'\n", cJSON_GetErrorPtr());
-		return {};
+		// compiled once, until the JSON changes
+		file.seek(0);
+		heating::AssetHash source;
+		heating::ProgramParser parser(rooms.emplace());
+		if (!helper::parseFile(file, parser, &source)) {
+			file.close();
+			heating::logger.printf("Error parsing json. No rooms: '%s'\n", filename.c_str());
+			return {};
+		}
+		if (!helper::saveProgramImage(imageName, heating::ProgramImage::build(*rooms, source.get()))) {
+			heating::logger.printf("Unable to save program image '%s'\n", imageName.c_str());
+		}
 	}
+	file.close();
 
-	if (rooms->type != cJSON_Array) {
-		return {};
+	for (auto const &room : *rooms) {
+		helper::logRoom(room);
 	}
+	return std::move(*rooms);
+}
 
-	std::vector<heating::RoomConfig> retVal;
+bool saveProgramImage(std::string const &program, std::vector<heating::RoomConfig> const &rooms, uint64_t source) {
+	return helper::saveProgramImage(helper::programImageName("/programs/" + program + ".json"), heating::ProgramImage::build(rooms, source));
+}
 
-	auto noRooms = cJSON_GetArraySize(rooms.get());
-	for (auto room = 0; room < noRooms; ++room) {
-		auto item = cJSON_GetArrayItem(rooms.get(), room);
-		if (cJSON_IsObject(item)) {
-			retVal.emplace_back(helper::parseRoom(item));
-		}
-	}
-	return retVal;
+void removeProgramImage(std::string const &program) {
+	LittleFS.remove(helper::programImageName("/programs/" + program + ".json").c_str());
 }
 
 void readDebugOptions() {
-	File file = SPIFFS.open("/cfg/cfgdebug.json", FILE_READ);
+	File file = LittleFS.open("/cfg/cfgdebug.json", FILE_READ);
 	if (!file) {
 		heating::logger.printf("Debug options not found. Using defaults\n");
 		return;
 	}
 	heating::logger.printf("Reading debug options from file\n");
-	String cfg = file.readString();
-	setDebugOptionsFromJson(cfg.c_str());
+	heating::DebugOptionsParser parser;
+	if (!helper::parseFile(file, parser)) {
+		heating::logger.printf("Error parsing debug options. Using defaults\n");
+	}
 	file.close();
 }
 
-void setDebugOptionsFromJson(const char *json) {
-	std::unique_ptr<cJSON, decltype(&cJSON_Delete)> root(cJSON_Parse(json), &cJSON_Delete);
-	#define READ_JSON_DEBUG_OPTION(name) debug::debug.name = json::getBool(root.get(), #name)
-	READ_JSON_DEBUG_OPTION(debugRoomTemperatures);
-	READ_JSON_DEBUG_OPTION(debugHeatingController);
-	READ_JSON_DEBUG_OPTION(debugTemperatureReader);
-	READ_JSON_DEBUG_OPTION(debugREST);
-	READ_JSON_DEBUG_OPTION(debugOpenWeather);
-	READ_JSON_DEBUG_OPTION(debugBoilerController);
-	READ_JSON_DEBUG_OPTION(debugEmsBusUart);
-	READ_JSON_DEBUG_OPTION(debugEmsBusUartForwarder);
-	READ_JSON_DEBUG_OPTION(debugEmsController);
-	READ_JSON_DEBUG_OPTION(debugEmsVerbose);
-	READ_JSON_DEBUG_OPTION(debugMQTT);
-	READ_JSON_DEBUG_OPTION(debugFatal);
-}
-
 }
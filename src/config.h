@@ -8,7 +8,13 @@
 #include <string>
 #include <vector>
 
+#include "FlowTemperatureOptimizer.h"
+#include "HeatingCurveLearner.h"
+#include "OutdoorTemperature.h"
 #include "RoomConfig.h"
+#include "WarmWaterProgram.h"
+#include "WeatherForecast.h"
+#include "ZoneAggregator.h"
 
 namespace json {
 
@@ -35,6 +41,9 @@ struct PinConfig {
 	std::string source = "builtin"; // "builtin" or "ext:<label>"
 	uint8_t pin = 0;
 	std::string label;
+	uint16_t openTime = 180;  // s, thermal actuator travel time
+	uint16_t closeTime = 180; // s
+	uint8_t capacity = 1;     // relative flow capacity of the heating circuit
 };
 
 struct GpioExtenderConfig {
@@ -101,11 +110,18 @@ struct OpenWeatherConfig {
 	std::string latitude;
 	std::string longitude;
 	uint16_t interval;
+	std::string server = "http://api.openweathermap.org"; // a local stand-in can serve recorded responses
+	heating::ForecastConfig forecast;
 };
 
 struct BluetoothConfig {
-	uint16_t scanTime = 60;
-	uint16_t scanInterval = 60;
+	uint16_t scanTime = 60;     // s, used when continuous is disabled
+	uint16_t scanInterval = 60; // s, used when continuous is disabled
+	bool continuous = true;     // scan all the time, radio duty cycle given by window/period
+	bool active = false;        // passive scan doesn't request scan responses
+	uint16_t windowMs = 30;
+	uint16_t periodMs = 100;
+	uint16_t duplicateRefresh = 60; // s, unchanged advertisement is forwarded again after this time
 };
 
 struct BoilerConfig {
@@ -120,11 +136,20 @@ struct BoilerConfig {
 
 	struct Boiler {
 		uint16_t valvePreheatingDelay = 0;
+		uint16_t valveSwitchStepMs = 500;  // delay between steps energizing valve actuators (inrush current)
+		uint8_t valveSwitchBatchSize = 2;  // number of actuators energized in one step
+		uint8_t valveOpenCapacityToStart = 0; // % of valves capacity which must be open to start boiler, 0 - don't wait
+		bool valvePreopen = false;            // open valves ahead of scheduled temperature increase
 		uint8_t minHeatingTemp = 20;
 		uint8_t maxHeatingTemp = 90;
 		controlMode_t controlMode = controlMode_t::onoff;
 		outdoorSensor_t	outdoorSensor = outdoorSensor_t::no;
 	} boiler;
+
+	heating::FlowOptimizerConfig optimizer; // closed loop curve correction, ems and onoff_outdoor modes
+	heating::WarmWaterConfig warmWater;     // ems mode only
+	heating::ZonesConfig zones;             // rooms grouped by emitters, each with own heating curve
+	heating::OutdoorTemperatureConfig outdoor; // sources merged into outdoor temperature
 };
 
 struct WiFiConfig {
@@ -156,16 +181,28 @@ OpenWeatherConfig getOpenWeatherConfig();
 BoilerConfig getBoilerConfig();
 BluetoothConfig getBluetoothConfig();
 
+// learnt heating curve correction, kept apart from user editable boiler config
+std::optional<heating::FlowOptimizerState> getFlowOptimizerState();
+bool saveFlowOptimizerState(heating::FlowOptimizerState const &state);
+std::optional<heating::CurveLearnerState> getCurveLearnerState();
+bool saveCurveLearnerState(heating::CurveLearnerState const &state);
+// date (YYYYMMDD) of the last anti-legionella cycle, so a restart on its day doesn't run it again
+std::optional<uint32_t> getWarmWaterLastCycleDate();
+bool saveWarmWaterLastCycleDate(uint32_t date);
+// replaces heatingCurve in boiler config, other settings are kept
+bool saveHeatingCurve(std::array<uint8_t, 9> const &curve);
+
 RTCPins getRTCPins();
 EmsPins getEmsPins();
 std::optional<EmsForwarderPins> getEmsForwarderPins();
 EmsConfig getEmsConfig();
 
+// from the compiled image next to the program JSON while it's of the same JSON, otherwise parsed and compiled
 std::vector<heating::RoomConfig> getRoomsConfig(std::string const &program);
+// source - hash of the JSON the rooms were parsed from, ProgramImage::hash()
+bool saveProgramImage(std::string const &program, std::vector<heating::RoomConfig> const &rooms, uint64_t source);
+void removeProgramImage(std::string const &program);
 std::string getCurrentProgram();
 
-std::string parseProgram(std::string const &data);
-
-void setDebugOptionsFromJson(const char *json);
 void readDebugOptions();
 }
@@ -3,7 +3,7 @@
 #include <time.h>
 
 #include <WiFi.h>
-#include <SPIFFS.h>
+#include <LittleFS.h>
 #include <ESPmDNS.h>
 #include <TimeHelpers.h>
 
@@ -11,6 +11,9 @@
 #include "HeatingController.h"
 #include "REST.h"
 #include "RTCTimeHelpers.h"
+#include "Storage.h"
+
+#include <atomic>
 
 #define ONBOARD_LED 2
 
@@ -26,7 +29,7 @@ Logger logger;
 
 std::unique_ptr<REST> rest;
 
-bool wifiAPMode = false;
+std::atomic_bool wifiAPMode{false}; // read by REST task
 }
 
 void WiFiGotIP(arduino_event_id_t event, arduino_event_info_t info) {
@@ -176,13 +179,13 @@ void setup() {
 	heating::logger.printf("SERIAL 1 ENABLED\n");
 #endif
 
-	if (!SPIFFS.begin(false)) {
-		heating::logger.println("An Error has occurred while mounting SPIFFS");
+	if (!heating::mountStorage()) {
+		heating::logger.println("An Error has occurred while mounting LittleFS");
 	}
 
 	config::readDebugOptions();
 
-	heating::logger.printf("Free memory %d/%d (minimum was: %d) MaxAlloc: %d SPIFFS\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
+	heating::logger.printf("Free memory %d/%d (minimum was: %d) MaxAlloc: %d FS\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
 
 	auto networkConfig = config::getNetworkConfig();
 
@@ -205,7 +208,8 @@ void setup() {
 	bool startAP = wifiConfig.ssid.empty() /*|| TODO PUSHBUTTON PRESSED */;
 
 	heating::controller = new heating:: HeatingController();
-	heating::rest = std::make_unique<heating::REST>(*heating::controller, startAP ? apConfig.listenPort : networkConfig.listenPort);
+	heating::rest = std::make_unique<heating::REST>(*heating::controller, startAP ? apConfig.listenPort : networkConfig.listenPort, []() { return heating::wifiAPMode || WiFi.isConnected(); });
+	heating::rest->begin();
 
 	heating::logger.printf("Free memory %d/%d (minimum was: %d) MaxAlloc: %d STUFF\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
 
@@ -221,7 +225,7 @@ void loop() {
 		lastMillis = now;
 
 		heating::controller->operate();
-		heating::logger.printf("Free memory %d/%d (minimum was: %d) MaxAlloc: %d MinPeekStack: %d boxTemp: %f, UpTime: %lds SPIFFS: %zu/%zu\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(), uxTaskGetStackHighWaterMark(nullptr), heating::rtcGetTemp(), esp_timer_get_time()/1000000, SPIFFS.usedBytes(), SPIFFS.totalBytes());
+		heating::logger.printf("Free memory %d/%d (minimum was: %d) MaxAlloc: %d MinPeekStack: %d boxTemp: %f, UpTime: %lds FS: %zu/%zu\n", ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(), uxTaskGetStackHighWaterMark(nullptr), heating::rtcGetTemp(), esp_timer_get_time()/1000000, LittleFS.usedBytes(), LittleFS.totalBytes());
 
 		if (!WiFi.isConnected()) {
 			heating::logger.printf("WiFi not connected. Reconnecting.\n");
@@ -231,9 +235,6 @@ void loop() {
 		}
 	}
 
-	heating::controller->loop();
-
-	if (heating::wifiAPMode || WiFi.isConnected()) {
-		heating::rest->handle();
-	}
+	heating::controller->loop(); // also runs calls queued by REST task
+	delay(1); // yields as the idle WebServer::handleClient() did when it was served here
 }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap use of the test thread while counting, operator new / delete are replaced in stubs.cpp
+namespace heap {
+
+struct Counter {
+	bool enabled = false;
+	size_t allocations = 0;
+	size_t bytes = 0; // requested by allocations
+	long live = 0;    // held by blocks allocated or freed while counting
+	long peak = 0;
+};
+
+extern thread_local Counter counter;
+
+// counts from zero
+inline void start() {
+	counter = {};
+	counter.enabled = true;
+}
+
+inline void stop() {
+	counter.enabled = false;
+}
+
+} // namespace heap
@@ -1,7 +1,13 @@
 // Stubs for Arduino-dependent symbols
 #include <gtest/gtest.h>
+#include "HeapCounter.h"
 #include "Logger.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
 namespace debug {
 struct debug debug;
 }
@@ -10,7 +16,35 @@ namespace heating {
 Logger logger;
 }
 
+namespace heap {
+thread_local Counter counter;
+}
+
+__attribute__((noinline)) void *operator new(size_t size) {
+	void *p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	if (heap::counter.enabled) {
+		heap::counter.allocations++;
+		heap::counter.bytes += size;
+		heap::counter.live += malloc_usable_size(p);
+		heap::counter.peak = std::max(heap::counter.peak, heap::counter.live);
+	}
+	return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+	if (p && heap::counter.enabled) {
+		heap::counter.live -= malloc_usable_size(p);
+	}
+	std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { operator delete(p); }
+
 // RoomConfig method implementations (avoiding Arduino-dependent Logger.h from src/RoomConfig.cpp)
+#include "BeaconBleAddress.h"
 #include "RoomConfig.h"
 
 namespace heating {
@@ -34,6 +68,30 @@ int16_t RoomConfig::TemperatureSetting::getTemperature() const {
 std::optional<uint8_t> RoomConfig::TemperatureSetting::getHeatingTemperatureOverride() const {
 	return heatingTemperatureOverride_;
 }
+
+// BeaconBleAddress.cpp without the Arduino build
+std::string BLEAddressToString(BleAddress_t const &bda) {
+	std::string result;
+	constexpr size_t size = 18;
+	result.reserve(size);
+	result.resize(size - 1);
+	snprintf(result.data(), size, PRiBleAddress, PRaBleAddress(bda));
+	return result;
+}
+
+BleAddress_t BLEAddresFromString(std::string_view address) {
+	if (address.length() < 17) {
+		return BleAddress_t{0, 0, 0, 0, 0, 0};
+	}
+	return BleAddress_t{
+		static_cast<uint8_t>(std::strtoul(address.data(), nullptr, 16)),
+		static_cast<uint8_t>(std::strtoul(address.data() + 3, nullptr, 16)),
+		static_cast<uint8_t>(std::strtoul(address.data() + 6, nullptr, 16)),
+		static_cast<uint8_t>(std::strtoul(address.data() + 9, nullptr, 16)),
+		static_cast<uint8_t>(std::strtoul(address.data() + 12, nullptr, 16)),
+		static_cast<uint8_t>(std::strtoul(address.data() + 15, nullptr, 16))
+		};
+}
 } // namespace heating
 
 int main(int argc, char **argv) {
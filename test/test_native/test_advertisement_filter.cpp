@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include "AdvertisementFilter.h"
+
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+using Filter = heating::AdvertisementFilter<16>;
+
+class AdvertisementFilterTest : public ::testing::Test {
+protected:
+	Filter filter{60s};
+	Filter::clock_t::time_point now = Filter::clock_t::now();
+	heating::BleAddress_t sensor{0xa4, 0xc1, 0x38, 0x01, 0x02, 0x03};
+	std::vector<uint8_t> payload{0x02, 0x01, 0x06, 0x10, 0x16, 0x1a, 0x18, 0x08, 0x34};
+
+	bool isNew(std::vector<uint8_t> const &data, Filter::clock_t::time_point time) { return filter.isNew(sensor, data.data(), data.size(), time); }
+};
+
+TEST_F(AdvertisementFilterTest, RepeatedPayloadIsDropped) {
+	EXPECT_TRUE(isNew(payload, now));
+	EXPECT_FALSE(isNew(payload, now + 1s));
+	EXPECT_FALSE(isNew(payload, now + 2s));
+	EXPECT_EQ(filter.getReceived(), 3u);
+	EXPECT_EQ(filter.getDuplicates(), 2u);
+}
+
+TEST_F(AdvertisementFilterTest, ChangedPayloadPasses) {
+	EXPECT_TRUE(isNew(payload, now));
+	auto changed = payload;
+	changed.back()++;
+	EXPECT_TRUE(isNew(changed, now + 1s));
+	EXPECT_TRUE(isNew(payload, now + 2s));
+}
+
+TEST_F(AdvertisementFilterTest, UnchangedPayloadRefreshed) {
+	EXPECT_TRUE(isNew(payload, now));
+	EXPECT_FALSE(isNew(payload, now + 59s));
+	EXPECT_TRUE(isNew(payload, now + 60s));
+	EXPECT_FALSE(isNew(payload, now + 61s));
+}
+
+TEST_F(AdvertisementFilterTest, DifferentDevicesSamePayload) {
+	heating::BleAddress_t other{0xa4, 0xc1, 0x38, 0x01, 0x02, 0x04};
+	EXPECT_TRUE(isNew(payload, now));
+	EXPECT_TRUE(filter.isNew(other, payload.data(), payload.size(), now));
+	EXPECT_FALSE(filter.isNew(other, payload.data(), payload.size(), now));
+}
+
+} // anonymous namespace
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include "AesCcm.h"
+
+#include <vector>
+
+namespace {
+
+using namespace heating::crypto;
+using Bytes = std::vector<uint8_t>;
+
+// FIPS-197 appendix B and C.1
+TEST(Aes128Test, Fips197Vectors) {
+	Aes128 aes(Aes128::Key_t{0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c});
+	Aes128::Block_t block{0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34};
+	aes.encrypt(block);
+	EXPECT_EQ(block, (Aes128::Block_t{0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32}));
+
+	Aes128 aes2(Aes128::Key_t{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f});
+	block = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+	aes2.encrypt(block);
+	EXPECT_EQ(block, (Aes128::Block_t{0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a}));
+}
+
+// RFC 3610 packet vector #1: 13 byte nonce, 8 bytes associated data, 8 byte tag
+class CcmTest : public ::testing::Test {
+protected:
+	Aes128 aes{Aes128::Key_t{0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF}};
+	Bytes nonce{0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5};
+	Bytes aad{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+	Bytes plain{0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E};
+	Bytes cipher{0x58, 0x8C, 0x97, 0x9A, 0x61, 0xC6, 0x63, 0xD2, 0xF0, 0x66, 0xD0, 0xC2, 0xC0, 0xF9, 0x89, 0x80, 0x6D, 0x5F, 0x6B, 0x61, 0xDA, 0xC3, 0x84};
+	Bytes tag{0x17, 0xE8, 0xD1, 0x2C, 0xFD, 0xF9, 0x26, 0xE0};
+};
+
+TEST_F(CcmTest, Rfc3610Encrypt) {
+	Bytes outCipher(plain.size()), outTag(tag.size());
+	ASSERT_TRUE(ccm::encrypt(aes, nonce.data(), nonce.size(), aad.data(), aad.size(), plain.data(), plain.size(), outCipher.data(), outTag.data(), outTag.size()));
+	EXPECT_EQ(outCipher, cipher);
+	EXPECT_EQ(outTag, tag);
+}
+
+TEST_F(CcmTest, Rfc3610Decrypt) {
+	Bytes out(cipher.size());
+	ASSERT_TRUE(ccm::decrypt(aes, nonce.data(), nonce.size(), aad.data(), aad.size(), cipher.data(), cipher.size(), tag.data(), tag.size(), out.data()));
+	EXPECT_EQ(out, plain);
+}
+
+TEST_F(CcmTest, RejectsTamperedFrame) {
+	Bytes out(cipher.size());
+
+	auto tamperedCipher = cipher;
+	tamperedCipher[5] ^= 0x01;
+	EXPECT_FALSE(ccm::decrypt(aes, nonce.data(), nonce.size(), aad.data(), aad.size(), tamperedCipher.data(), tamperedCipher.size(), tag.data(), tag.size(), out.data()));
+	EXPECT_EQ(out, Bytes(out.size(), 0)); // nothing unauthenticated returned
+
+	auto tamperedTag = tag;
+	tamperedTag[7] ^= 0x80;
+	EXPECT_FALSE(ccm::decrypt(aes, nonce.data(), nonce.size(), aad.data(), aad.size(), cipher.data(), cipher.size(), tamperedTag.data(), tamperedTag.size(), out.data()));
+
+	auto tamperedAad = aad;
+	tamperedAad[0] ^= 0x01;
+	EXPECT_FALSE(ccm::decrypt(aes, nonce.data(), nonce.size(), tamperedAad.data(), tamperedAad.size(), cipher.data(), cipher.size(), tag.data(), tag.size(), out.data()));
+
+	Aes128 otherKey(Aes128::Key_t{});
+	EXPECT_FALSE(ccm::decrypt(otherKey, nonce.data(), nonce.size(), aad.data(), aad.size(), cipher.data(), cipher.size(), tag.data(), tag.size(), out.data()));
+}
+
+TEST_F(CcmTest, RoundTripShortTagsAndLongData) {
+	Bytes data(40);
+	for (size_t i = 0; i < data.size(); ++i) {
+		data[i] = static_cast<uint8_t>(i * 7);
+	}
+	Bytes longAad(20, 0x11);
+	for (size_t nonceLength : {7u, 12u, 13u}) {
+		for (size_t tagLength : {4u, 8u, 16u}) {
+			Bytes outCipher(data.size()), outTag(tagLength), out(data.size());
+			ASSERT_TRUE(ccm::encrypt(aes, nonce.data(), nonceLength, longAad.data(), longAad.size(), data.data(), data.size(), outCipher.data(), outTag.data(), tagLength));
+			EXPECT_NE(outCipher, data);
+			ASSERT_TRUE(ccm::decrypt(aes, nonce.data(), nonceLength, longAad.data(), longAad.size(), outCipher.data(), outCipher.size(), outTag.data(), tagLength, out.data())) << nonceLength << " " << tagLength;
+			EXPECT_EQ(out, data);
+		}
+	}
+}
+
+TEST_F(CcmTest, RejectsInvalidParameters) {
+	Bytes out(cipher.size());
+	EXPECT_FALSE(ccm::decrypt(aes, nonce.data(), 6, aad.data(), aad.size(), cipher.data(), cipher.size(), tag.data(), tag.size(), out.data()));
+	EXPECT_FALSE(ccm::decrypt(aes, nonce.data(), nonce.size(), aad.data(), aad.size(), cipher.data(), cipher.size(), tag.data(), 3, out.data()));
+}
+
+} // anonymous namespace
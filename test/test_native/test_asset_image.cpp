@@ -0,0 +1,295 @@
+#include <gtest/gtest.h>
+#include "AssetImage.h"
+#include "AssetIndex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+using heating::AssetImage;
+using heating::AssetImageWriter;
+using heating::AssetIndex;
+
+std::string content(size_t size, char seed) {
+	std::string text(size, seed);
+	for (size_t i = 0; i < size; ++i) {
+		text[i] = static_cast<char>(seed + i * 7);
+	}
+	return text;
+}
+
+TEST(AssetImageTest, FindsEveryEntry) {
+	AssetImageWriter writer;
+	writer.add("/index.html", "<html></html>", true);
+	writer.add("/deps/jquery.min.js.gz", content(1000, 'j'));
+	writer.add("/about.html", "about");
+	auto bytes = writer.build();
+
+	AssetImage image(bytes.data(), bytes.size());
+	ASSERT_TRUE(image.isValid());
+	ASSERT_EQ(image.size(), 3u);
+	EXPECT_EQ(image.at(0).path, "/about.html"); // sorted
+
+	auto index = image.find("/index.html");
+	ASSERT_TRUE(index);
+	EXPECT_TRUE(index->gzip);
+	EXPECT_EQ(std::string_view(reinterpret_cast<char const *>(index->data), index->size), "<html></html>");
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(index->data) % 4, reinterpret_cast<uintptr_t>(bytes.data()) % 4);
+
+	auto jquery = image.find("/deps/jquery.min.js.gz");
+	ASSERT_TRUE(jquery);
+	EXPECT_FALSE(jquery->gzip);
+	EXPECT_EQ(jquery->size, 1000u);
+	heating::AssetHash hash;
+	hash.update(jquery->data, jquery->size);
+	EXPECT_EQ(jquery->hash, hash.get());
+
+	EXPECT_FALSE(image.find("/missing.html"));
+	EXPECT_FALSE(image.find(""));
+}
+
+TEST(AssetImageTest, RejectsDamagedImage) {
+	AssetImageWriter writer;
+	writer.add("/a.html", "a");
+	writer.add("/b.html", "b");
+	auto bytes = writer.build();
+
+	EXPECT_FALSE(AssetImage(bytes.data(), bytes.size() - 1).isValid()); // truncated
+	EXPECT_FALSE(AssetImage(nullptr, 0).isValid());
+
+	auto badMagic = bytes;
+	badMagic[0] = 'X';
+	EXPECT_FALSE(AssetImage(badMagic.data(), badMagic.size()).isValid());
+
+	auto badOffset = bytes;
+	badOffset[AssetImage::headerSize + 16 + 3] = 0x7f; // first data offset far past the end
+	EXPECT_FALSE(AssetImage(badOffset.data(), badOffset.size()).isValid());
+
+	auto unsorted = bytes;
+	std::swap_ranges(unsorted.begin() + AssetImage::headerSize, unsorted.begin() + AssetImage::headerSize + AssetImage::entrySize, unsorted.begin() + AssetImage::headerSize + AssetImage::entrySize);
+	EXPECT_FALSE(AssetImage(unsorted.data(), unsorted.size()).isValid());
+}
+
+TEST(AssetImageTest, IndexServesFromImage) {
+	AssetImageWriter writer;
+	writer.add("/index.html", "<html></html>", true);
+	writer.add("/deps/bs.min.css.gz", content(100, 'c'));
+	auto bytes = writer.build();
+	AssetImage image(bytes.data(), bytes.size());
+
+	AssetIndex index;
+	index.add(image);
+	auto html = index.find("/index.html");
+	ASSERT_NE(html, nullptr);
+	EXPECT_TRUE(html->gzip);
+	EXPECT_EQ(html->data, image.find("/index.html")->data); // no copy
+	auto css = index.find("/deps/bs.min.css");
+	ASSERT_NE(css, nullptr);
+	EXPECT_STREQ(css->contentType, "text/css");
+}
+
+// Cost models of the three ways to get at a file: SPIFFS scans every object header on flash to open one and keeps
+// obsolete objects until garbage collected, LittleFS walks the directory tree, the image is a binary search over a
+// table in mapped flash. Reads count flash page/block accesses; wall time of the simulation is printed for reference.
+class SimulatedSpiffs {
+public:
+	static constexpr size_t pageSize = 256;
+	static constexpr size_t pagePayload = 256 - 5; // object header per page
+
+	void write(std::string const &name, std::string const &data) {
+		for (auto &object : objects_) {
+			if (object.live && object.name == name) {
+				object.live = false; // rewritten files leave an obsolete object behind
+			}
+		}
+		objects_.push_back({name, data, true});
+	}
+
+	std::string const *open(std::string const &name) {
+		for (auto const &object : objects_) {
+			pageReads++; // object index header
+			if (object.live && object.name == name) {
+				return &object.data;
+			}
+		}
+		return nullptr;
+	}
+
+	size_t read(std::string const &data, std::vector<char> &buffer) {
+		buffer.resize(data.size());
+		for (size_t at = 0; at < data.size(); at += pagePayload) {
+			pageReads++;
+			std::memcpy(buffer.data() + at, data.data() + at, std::min(pagePayload, data.size() - at));
+		}
+		return data.size();
+	}
+
+	size_t pageReads = 0;
+
+private:
+	struct Object {
+		std::string name;
+		std::string data;
+		bool live;
+	};
+	std::vector<Object> objects_;
+};
+
+class SimulatedLittleFs {
+public:
+	static constexpr size_t blockSize = 4096;
+	static constexpr size_t entriesPerBlock = 16; // directory entries per metadata block
+
+	void write(std::string const &path, std::string const &data) {
+		auto *directory = &root_;
+		size_t from = 1;
+		for (auto slash = path.find('/', from); slash != std::string::npos; slash = path.find('/', from)) {
+			directory = &directory->directories[path.substr(from, slash - from)];
+			from = slash + 1;
+		}
+		directory->files[path.substr(from)] = data;
+	}
+
+	std::string const *open(std::string const &path) {
+		auto *directory = &root_;
+		size_t from = 1;
+		for (auto slash = path.find('/', from); slash != std::string::npos; slash = path.find('/', from)) {
+			auto it = lookup(directory->directories, path.substr(from, slash - from));
+			if (!it) {
+				return nullptr;
+			}
+			directory = it;
+			from = slash + 1;
+		}
+		return lookup(directory->files, path.substr(from));
+	}
+
+	size_t read(std::string const &data, std::vector<char> &buffer) {
+		buffer.resize(data.size());
+		for (size_t at = 0; at < data.size(); at += blockSize) {
+			blockReads++;
+			std::memcpy(buffer.data() + at, data.data() + at, std::min(blockSize, data.size() - at));
+		}
+		return data.size();
+	}
+
+	size_t blockReads = 0;
+
+private:
+	struct Directory {
+		std::map<std::string, Directory> directories;
+		std::map<std::string, std::string> files;
+	};
+
+	// entries of a directory are scanned in order, block by block
+	template <typename T>
+	T *lookup(std::map<std::string, T> &entries, std::string const &name) {
+		size_t position = 0;
+		for (auto &[entryName, entry] : entries) {
+			if (position++ % entriesPerBlock == 0) {
+				blockReads++;
+			}
+			if (entryName == name) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	Directory root_;
+};
+
+TEST(AssetImageBench, OpenAndReadLatency) {
+	std::vector<std::pair<std::string, std::string>> assets{
+		{"/index.html", content(10461, 'i')}, {"/curve.html", content(5262, 'c')}, {"/rooms.html", content(5737, 'r')}, {"/network.html", content(5308, 'n')},
+		{"/hardware.html", content(5988, 'h')}, {"/about.html", content(513, 'a')}, {"/update.html", content(1235, 'u')}, {"/deps/chart.umd.js.gz", content(69199, 'C')},
+		{"/deps/jquery.min.js.gz", content(30842, 'J')}, {"/deps/bs.min.css.gz", content(23806, 'B')}, {"/deps/bs.bundle.min.js.gz", content(21662, 'b')}, {"/deps/bms.min.js.gz", content(6913, 'M')}};
+	std::vector<std::pair<std::string, std::string>> configs;
+	for (auto name : {"cfgap", "cfgboiler", "cfgdebug", "cfgnetwork", "cfgpins", "cfgprogram", "cfgwifi", "optimizer", "curvelearner"}) {
+		configs.emplace_back(std::string("/cfg/") + name + ".json", content(800, 'x'));
+	}
+	for (int i = 0; i < 8; ++i) {
+		configs.emplace_back("/programs/program" + std::to_string(i) + ".json", content(3200, 'p'));
+	}
+
+	// SPIFFS held assets and config together; a season of config saves leaves obsolete objects behind
+	SimulatedSpiffs spiffs;
+	SimulatedLittleFs littlefs;
+	for (auto const &[path, data] : assets) {
+		spiffs.write("/html" + path, data);
+	}
+	for (int save = 0; save < 20; ++save) {
+		for (auto const &[path, data] : configs) {
+			spiffs.write(path, data);
+			littlefs.write(path, data);
+		}
+	}
+	AssetImageWriter writer;
+	for (auto const &[path, data] : assets) {
+		writer.add(path, data);
+	}
+	auto bytes = writer.build();
+	AssetImage image(bytes.data(), bytes.size());
+	ASSERT_TRUE(image.isValid());
+
+	constexpr int rounds = 200;
+	std::vector<char> buffer;
+	size_t checksum = 0;
+	auto measure = [&](auto &&body) {
+		auto started = std::chrono::steady_clock::now();
+		for (int round = 0; round < rounds; ++round) {
+			body();
+		}
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count() / rounds;
+	};
+
+	auto spiffsAssetsNs = measure([&] {
+		for (auto const &[path, data] : assets) {
+			auto file = spiffs.open("/html" + path);
+			checksum += spiffs.read(*file, buffer);
+		}
+	});
+	auto spiffsAssetReads = spiffs.pageReads / rounds;
+	auto imageAssetsNs = measure([&] {
+		for (auto const &[path, data] : assets) {
+			auto entry = image.find(path);
+			checksum += entry->size + entry->data[0]; // served from the mapping, nothing copied
+		}
+	});
+
+	spiffs.pageReads = 0;
+	auto spiffsConfigNs = measure([&] {
+		for (auto const &[path, data] : configs) {
+			checksum += spiffs.read(*spiffs.open(path), buffer);
+		}
+	});
+	auto spiffsConfigReads = spiffs.pageReads / rounds;
+	auto littlefsConfigNs = measure([&] {
+		for (auto const &[path, data] : configs) {
+			checksum += littlefs.read(*littlefs.open(path), buffer);
+		}
+	});
+	auto littlefsConfigReads = littlefs.blockReads / rounds;
+
+	RecordProperty("assets", static_cast<int>(assets.size()));
+	RecordProperty("spiffsAssetPageReads", static_cast<int>(spiffsAssetReads));
+	RecordProperty("spiffsAssetsNs", static_cast<int>(spiffsAssetsNs));
+	RecordProperty("imageAssetsNs", static_cast<int>(imageAssetsNs));
+	RecordProperty("configs", static_cast<int>(configs.size()));
+	RecordProperty("spiffsConfigPageReads", static_cast<int>(spiffsConfigReads));
+	RecordProperty("spiffsConfigNs", static_cast<int>(spiffsConfigNs));
+	RecordProperty("littlefsConfigBlockReads", static_cast<int>(littlefsConfigReads));
+	RecordProperty("littlefsConfigNs", static_cast<int>(littlefsConfigNs));
+	EXPECT_NE(checksum, 0u);
+
+	// opening by scanning every object grows with everything ever written, a directory lookup with the directory
+	EXPECT_GT(spiffsConfigReads, configs.size() * assets.size());
+	EXPECT_LT(littlefsConfigReads * 4, spiffsConfigReads);
+}
+
+} // anonymous namespace
@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+#include "AssetIndex.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using heating::AssetHash;
+using heating::AssetIndex;
+using result_t = AssetIndex::result_t;
+
+uint64_t hashOf(std::string const &content) {
+	AssetHash hash;
+	hash.update(reinterpret_cast<uint8_t const *>(content.data()), content.size());
+	return hash.get();
+}
+
+AssetIndex makeIndex() {
+	AssetIndex index;
+	index.add("/index.html", nullptr, 4000, hashOf("<html>index</html>"), false);
+	index.add("/deps/bs.min.css.gz", nullptr, 23806, hashOf("bs css"), false); // sizes of web/deps
+	index.add("/deps/chart.umd.js.gz", nullptr, 69199, hashOf("chart"), false);
+	index.add("/deps/jquery.min.js.gz", nullptr, 30842, hashOf("jquery"), false);
+	index.add("/deps/bs.bundle.min.js.gz", nullptr, 21662, hashOf("bs js"), false);
+	return index;
+}
+
+TEST(AssetIndexTest, HashIsFnv1a64) {
+	EXPECT_EQ(hashOf(""), 0xcbf29ce484222325ull);
+	EXPECT_EQ(hashOf("a"), 0xaf63dc4c8601ec8cull);
+}
+
+TEST(AssetIndexTest, FindsExactOrCompressed) {
+	auto index = makeIndex();
+	ASSERT_EQ(index.size(), 5u);
+
+	auto html = index.find("/index.html");
+	ASSERT_NE(html, nullptr);
+	EXPECT_FALSE(html->gzip);
+	EXPECT_STREQ(html->contentType, "text/html");
+
+	auto css = index.find("/deps/bs.min.css");
+	ASSERT_NE(css, nullptr);
+	EXPECT_EQ(css->path, "/deps/bs.min.css.gz");
+	EXPECT_TRUE(css->gzip);
+	EXPECT_STREQ(css->contentType, "text/css");
+	EXPECT_EQ(index.find("/deps/bs.min.css.gz"), css);
+
+	EXPECT_EQ(index.find("/deps/missing.js"), nullptr);
+	EXPECT_EQ(index.find("/index"), nullptr);
+}
+
+TEST(AssetIndexTest, CompressedByPackerKeepsPath) {
+	AssetIndex index;
+	index.add("/about.html", nullptr, 100, 1, true);
+	auto html = index.find("/about.html");
+	ASSERT_NE(html, nullptr);
+	EXPECT_TRUE(html->gzip);
+	EXPECT_STREQ(html->contentType, "text/html");
+}
+
+TEST(AssetIndexTest, ContentTypes) {
+	EXPECT_STREQ(AssetIndex::getContentType("/a.js.gz"), "text/javascript");
+	EXPECT_STREQ(AssetIndex::getContentType("/a.svg"), "image/svg+xml");
+	EXPECT_STREQ(AssetIndex::getContentType("/a.json"), "application/json");
+	EXPECT_STREQ(AssetIndex::getContentType("/a.gz"), "text/plain");
+}
+
+TEST(AssetIndexTest, EtagIsQuotedHash) {
+	AssetIndex index;
+	index.add("/a.js", nullptr, 1, 0x0123456789abcdefull, false);
+	auto asset = index.find("/a.js");
+	ASSERT_NE(asset, nullptr);
+	EXPECT_STREQ(asset->etag, "\"0123456789abcdef\"");
+	EXPECT_EQ(asset->version(), "01234567");
+}
+
+TEST(AssetIndexTest, VersionedReferenceIsImmutable) {
+	auto index = makeIndex();
+	auto version = std::string(index.find("/deps/jquery.min.js")->version());
+
+	auto response = index.resolve("/deps/jquery.min.js", version, "");
+	EXPECT_EQ(response.result, result_t::ok);
+	EXPECT_STREQ(response.cacheControl, AssetIndex::cacheImmutable);
+
+	// stale reference - page still points to old content, not cached for long
+	response = index.resolve("/deps/jquery.min.js", "deadbeef", "");
+	EXPECT_EQ(response.result, result_t::ok);
+	EXPECT_STREQ(response.cacheControl, AssetIndex::cacheShort);
+
+	response = index.resolve("/deps/jquery.min.js", "", "");
+	EXPECT_STREQ(response.cacheControl, AssetIndex::cacheShort);
+}
+
+TEST(AssetIndexTest, HtmlRevalidates) {
+	auto index = makeIndex();
+	auto html = index.find("/index.html");
+
+	auto response = index.resolve("/index.html", "", "");
+	EXPECT_EQ(response.result, result_t::ok);
+	EXPECT_STREQ(response.cacheControl, AssetIndex::cacheRevalidate);
+
+	response = index.resolve("/index.html", "", html->etag);
+	EXPECT_EQ(response.result, result_t::notModified);
+	EXPECT_STREQ(response.cacheControl, AssetIndex::cacheRevalidate);
+
+	response = index.resolve("/index.html", "", "\"0000000000000000\"");
+	EXPECT_EQ(response.result, result_t::ok);
+}
+
+TEST(AssetIndexTest, IfNoneMatchListWeakAndAny) {
+	auto index = makeIndex();
+	std::string etag = index.find("/index.html")->etag;
+
+	EXPECT_EQ(index.resolve("/index.html", "", "\"1\", " + etag).result, result_t::notModified);
+	EXPECT_EQ(index.resolve("/index.html", "", "W/" + etag).result, result_t::notModified);
+	EXPECT_EQ(index.resolve("/index.html", "", "*").result, result_t::notModified);
+	EXPECT_EQ(index.resolve("/index.html", "", " , ").result, result_t::ok);
+	EXPECT_EQ(index.resolve("/missing.html", "", "*").result, result_t::notFound);
+}
+
+// asset requests of web/index.html and the four deps it references with ?v= - a browser honouring the headers fetches
+// everything once, then on reload only revalidates the page. API calls the page makes afterwards aren't counted.
+TEST(AssetIndexTest, RepeatIndexLoadOnlyRevalidatesHtml) {
+	auto index = makeIndex();
+	std::vector<std::string> deps{"/deps/bs.min.css", "/deps/chart.umd.js", "/deps/jquery.min.js", "/deps/bs.bundle.min.js"};
+
+	struct Cached {
+		std::string etag;
+		bool immutable;
+	};
+	std::vector<std::pair<std::string, Cached>> cache;
+	auto cached = [&](std::string const &path) -> Cached * {
+		for (auto &entry : cache) {
+			if (entry.first == path) {
+				return &entry.second;
+			}
+		}
+		return nullptr;
+	};
+
+	struct Load {
+		size_t requests = 0;
+		size_t bytes = 0;
+		size_t notModified = 0;
+	};
+	auto load = [&] {
+		Load result;
+		auto fetch = [&](std::string const &path, std::string const &version) {
+			auto entry = cached(path);
+			if (entry && entry->immutable) {
+				return;
+			}
+			auto response = index.resolve(path, version, entry ? entry->etag : "");
+			ASSERT_NE(response.result, result_t::notFound);
+			result.requests++;
+			if (response.result == result_t::notModified) {
+				result.notModified++;
+				return;
+			}
+			result.bytes += response.asset->size;
+			Cached fresh{response.asset->etag, response.cacheControl == AssetIndex::cacheImmutable};
+			if (entry) {
+				*entry = fresh;
+			} else {
+				cache.emplace_back(path, fresh);
+			}
+		};
+		fetch("/index.html", "");
+		for (auto const &dep : deps) {
+			fetch(dep, std::string(index.find(dep)->version()));
+		}
+		return result;
+	};
+
+	auto first = load();
+	EXPECT_EQ(first.requests, 5u);
+	EXPECT_EQ(first.bytes, 4000u + 23806 + 69199 + 30842 + 21662);
+	EXPECT_EQ(first.notModified, 0u);
+
+	auto repeat = load();
+	EXPECT_EQ(repeat.requests, 1u);
+	EXPECT_EQ(repeat.bytes, 0u);
+	EXPECT_EQ(repeat.notModified, 1u);
+
+	std::stringstream ss;
+	index.getStatus(ss);
+	EXPECT_NE(ss.str().find(std::string("{\"path\": \"/index.html\", \"size\": 4000, \"etag\": \"") + std::string(index.find("/index.html")->etag + 1, 16) + "\", \"served\": 1, \"notModified\": 1}"), std::string::npos) << ss.str();
+}
+
+} // anonymous namespace
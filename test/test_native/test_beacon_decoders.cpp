@@ -0,0 +1,273 @@
+#include <gtest/gtest.h>
+#include "BeaconDecoders.h"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace heating::beacon;
+using Payload = std::vector<uint8_t>;
+
+// advertisement payloads in the shape sensors send them (flags, names and service / manufacturer data)
+namespace corpus {
+const Payload atc1441{0x02, 0x01, 0x06, 0x10, 0x16, 0x1A, 0x18, 0xA4, 0xC1, 0x38, 0x12, 0x34, 0x56, 0x00, 0xD7, 0x37, 0x5A, 0x0B, 0xB8, 0x2A, 0x09, 0x09, 'A', 'T', 'C', '_', '1', '2', '3', '4'};
+const Payload pvvx{0x02, 0x01, 0x06, 0x12, 0x16, 0x1A, 0x18, 0x56, 0x34, 0x12, 0x38, 0xC1, 0xA4, 0x66, 0x08, 0xD2, 0x14, 0xB8, 0x0B, 0x5F, 0x07, 0x04};
+const Payload atc1441Negative{0x10, 0x16, 0x1A, 0x18, 0xA4, 0xC1, 0x38, 0x12, 0x34, 0x56, 0xFF, 0x9C, 0x50, 0x40, 0x0B, 0x54, 0x01};
+const Payload btHome{0x02, 0x01, 0x06, 0x0E, 0x16, 0xD2, 0xFC, 0x40, 0x00, 0x12, 0x01, 0x5D, 0x02, 0xC4, 0x09, 0x03, 0xBF, 0x13};
+const Payload btHomeUnknownObject{0x02, 0x01, 0x06, 0x0B, 0x16, 0xD2, 0xFC, 0x40, 0x02, 0xC4, 0x09, 0xF0, 0x03, 0xBF, 0x13};
+const Payload btHomeEncrypted{0x02, 0x01, 0x06, 0x0E, 0x16, 0xD2, 0xFC, 0x41, 0x00, 0x12, 0x01, 0x5D, 0x02, 0xC4, 0x09, 0x03, 0xBF, 0x13};
+const Payload miBeaconTempHum{0x02, 0x01, 0x06, 0x15, 0x16, 0x95, 0xFE, 0x50, 0x20, 0xAA, 0x01, 0x3C, 0x12, 0x34, 0x56, 0x38, 0xC1, 0xA4, 0x0D, 0x10, 0x04, 0xD7, 0x00, 0x2C, 0x02};
+const Payload miBeaconBattery{0x02, 0x01, 0x06, 0x12, 0x16, 0x95, 0xFE, 0x50, 0x20, 0xAA, 0x01, 0x3D, 0x12, 0x34, 0x56, 0x38, 0xC1, 0xA4, 0x0A, 0x10, 0x01, 0x5A, 0x09, 0x09, 'M', 'J', '_', 'H', 'T', '_', 'V', '1'};
+const Payload miBeaconEncrypted{0x02, 0x01, 0x06, 0x15, 0x16, 0x95, 0xFE, 0x58, 0x20, 0xAA, 0x01, 0x3C, 0x12, 0x34, 0x56, 0x38, 0xC1, 0xA4, 0x0D, 0x10, 0x04, 0xD7, 0x00, 0x2C, 0x02};
+const Payload govee5075{0x02, 0x01, 0x06, 0x09, 0xFF, 0x88, 0xEC, 0x00, 0x03, 0x4D, 0x87, 0x64, 0x00};
+const Payload govee5075Negative{0x09, 0xFF, 0x88, 0xEC, 0x00, 0x80, 0xCE, 0x41, 0x50, 0x00};
+const Payload govee5074{0x0A, 0xFF, 0x88, 0xEC, 0x00, 0x66, 0x08, 0xD2, 0x14, 0x5F, 0x02};
+const Payload iBeacon{0x02, 0x01, 0x06, 0x1A, 0xFF, 0x4C, 0x00, 0x02, 0x15, 0xE2, 0xC5, 0x6D, 0xB5, 0xDF, 0xFB, 0x48, 0xD2, 0xB0, 0x60, 0xD0, 0xF5, 0xA7, 0x10, 0x96, 0xE0, 0x00, 0x01, 0x00, 0x02, 0xC5};
+const Payload eddystone{0x02, 0x01, 0x06, 0x03, 0x03, 0xAA, 0xFE, 0x0E, 0x16, 0xAA, 0xFE, 0x10, 0xEB, 0x01, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x07};
+const Payload truncated{0x02, 0x01, 0x06, 0x15, 0x16, 0x95, 0xFE, 0x50, 0x20, 0xAA};
+
+// bthome.io encryption example: key 231d39c1d7cc1ab1aee224cd096db932, address 54:48:E6:8F:80:A5, counter 0x33221100
+const Payload btHomeBindKey{0x02, 0x01, 0x06, 0x12, 0x16, 0xD2, 0xFC, 0x41, 0xA4, 0x72, 0x66, 0xC9, 0x5F, 0x73, 0x00, 0x11, 0x22, 0x33, 0x78, 0x23, 0x72, 0x14};
+// MiBeacon v5 (LYWSD03MMC product id 0x055B), key e9efaa6873f9f9c87a5e75a5f814801c, address a4:c1:38:12:34:56, object 0x100D
+// 21.5 °C / 55.6 %, extended counter 1 - MIC cross-checked with OpenSSL AES-CCM
+const Payload miBeaconBindKey{0x02, 0x01, 0x06, 0x1C, 0x16, 0x95, 0xFE, 0x58, 0x58, 0x5B, 0x05, 0x3C, 0x56, 0x34, 0x12, 0x38, 0xC1, 0xA4, 0xD6, 0x28, 0xE7, 0x75, 0xDF, 0x2A, 0x8C, 0x01, 0x00, 0x00, 0x7B, 0x5A, 0xC7, 0x50};
+
+const std::vector<Payload const *> all{&atc1441, &pvvx, &atc1441Negative, &btHome, &btHomeUnknownObject, &btHomeEncrypted, &miBeaconTempHum, &miBeaconBattery, &miBeaconEncrypted, &govee5075, &govee5075Negative, &govee5074, &iBeacon, &eddystone, &truncated, &btHomeBindKey, &miBeaconBindKey};
+} // namespace corpus
+
+namespace keys {
+const heating::crypto::Aes128 btHome{{0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1, 0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d, 0xb9, 0x32}};
+const uint8_t btHomeAddress[6]{0x54, 0x48, 0xE6, 0x8F, 0x80, 0xA5};
+const heating::crypto::Aes128 miBeacon{{0xe9, 0xef, 0xaa, 0x68, 0x73, 0xf9, 0xf9, 0xc8, 0x7a, 0x5e, 0x75, 0xa5, 0xf8, 0x14, 0x80, 0x1c}};
+const uint8_t miBeaconAddress[6]{0xa4, 0xc1, 0x38, 0x12, 0x34, 0x56};
+} // namespace keys
+
+std::optional<Reading> decodePayload(Payload const &payload, std::string *format = nullptr, DecryptionContext const &context = {}) {
+	char const *name = nullptr;
+	auto reading = decode(payload.data(), payload.size(), &name, context);
+	if (format && name) {
+		*format = name;
+	}
+	return reading;
+}
+
+TEST(AdStructuresTest, IteratesInPlace) {
+	std::vector<uint8_t> types;
+	for (auto const &ad : AdStructures(corpus::atc1441.data(), corpus::atc1441.size())) {
+		types.push_back(ad.type);
+		EXPECT_GE(ad.data, corpus::atc1441.data());
+		EXPECT_LE(ad.data + ad.length, corpus::atc1441.data() + corpus::atc1441.size());
+	}
+	EXPECT_EQ(types, (std::vector<uint8_t>{0x01, 0x16, 0x09}));
+}
+
+TEST(AdStructuresTest, StopsAtMalformedStructure) {
+	size_t count = 0;
+	for (auto const &ad : AdStructures(corpus::truncated.data(), corpus::truncated.size())) {
+		(void)ad;
+		count++;
+	}
+	EXPECT_EQ(count, 1u);
+
+	Payload zeroLength{0x02, 0x01, 0x06, 0x00, 0x05, 0x16};
+	count = 0;
+	for (auto const &ad : AdStructures(zeroLength.data(), zeroLength.size())) {
+		(void)ad;
+		count++;
+	}
+	EXPECT_EQ(count, 1u);
+}
+
+TEST(BeaconDecodersTest, Atc1441) {
+	std::string format;
+	auto reading = decodePayload(corpus::atc1441, &format);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(format, "ATC");
+	EXPECT_EQ(reading->temperature, 2150);
+	EXPECT_EQ(reading->humidity, 5500);
+	EXPECT_EQ(reading->battery, 90);
+	EXPECT_EQ(reading->counter, 0x2A);
+
+	reading = decodePayload(corpus::atc1441Negative);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(reading->temperature, -1000);
+}
+
+TEST(BeaconDecodersTest, PvvxCustom) {
+	auto reading = decodePayload(corpus::pvvx);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(reading->temperature, 2150);
+	EXPECT_EQ(reading->humidity, 5330);
+	EXPECT_EQ(reading->battery, 95);
+	EXPECT_EQ(reading->counter, 7);
+}
+
+TEST(BeaconDecodersTest, BtHome) {
+	std::string format;
+	auto reading = decodePayload(corpus::btHome, &format);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(format, "BTHome");
+	EXPECT_EQ(reading->temperature, 2500);
+	EXPECT_EQ(reading->humidity, 5055);
+	EXPECT_EQ(reading->battery, 93);
+	EXPECT_EQ(reading->counter, 0x12);
+}
+
+TEST(BeaconDecodersTest, BtHomeStopsAtUnknownObject) {
+	auto reading = decodePayload(corpus::btHomeUnknownObject);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(reading->temperature, 2500);
+	EXPECT_FALSE(reading->humidity.has_value());
+}
+
+TEST(BeaconDecodersTest, MiBeacon) {
+	std::string format;
+	auto reading = decodePayload(corpus::miBeaconTempHum, &format);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(format, "MiBeacon");
+	EXPECT_EQ(reading->temperature, 2150);
+	EXPECT_EQ(reading->humidity, 5560);
+	EXPECT_FALSE(reading->battery.has_value());
+	EXPECT_EQ(reading->counter, 0x3C);
+
+	reading = decodePayload(corpus::miBeaconBattery);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(reading->battery, 90);
+	EXPECT_FALSE(reading->temperature.has_value());
+}
+
+TEST(BeaconDecodersTest, Govee) {
+	std::string format;
+	auto reading = decodePayload(corpus::govee5075, &format);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(format, "Govee");
+	EXPECT_EQ(reading->temperature, 2160);
+	EXPECT_EQ(reading->humidity, 4550);
+	EXPECT_EQ(reading->battery, 100);
+
+	reading = decodePayload(corpus::govee5075Negative);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(reading->temperature, -520);
+	EXPECT_EQ(reading->humidity, 8010);
+
+	reading = decodePayload(corpus::govee5074);
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(reading->temperature, 2150);
+	EXPECT_EQ(reading->humidity, 5330);
+	EXPECT_EQ(reading->battery, 95);
+}
+
+TEST(BeaconDecodersTest, RejectsUnknownAndEncrypted) {
+	EXPECT_FALSE(decodePayload(corpus::iBeacon).has_value());
+	EXPECT_FALSE(decodePayload(corpus::eddystone).has_value());
+	EXPECT_FALSE(decodePayload(corpus::truncated).has_value());
+	EXPECT_FALSE(decodePayload(corpus::btHomeEncrypted).has_value());
+	EXPECT_FALSE(decodePayload(corpus::miBeaconEncrypted).has_value());
+}
+
+TEST(BeaconDecodersTest, BtHomeEncrypted) {
+	std::string format;
+	auto reading = decodePayload(corpus::btHomeBindKey, &format, {keys::btHomeAddress, &keys::btHome});
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(format, "BTHome");
+	EXPECT_EQ(reading->temperature, 2506);
+	EXPECT_EQ(reading->humidity, 5055);
+	EXPECT_EQ(reading->replayCounter, 0x33221100u);
+}
+
+TEST(BeaconDecodersTest, MiBeaconEncrypted) {
+	auto reading = decodePayload(corpus::miBeaconBindKey, nullptr, {keys::miBeaconAddress, &keys::miBeacon});
+	ASSERT_TRUE(reading.has_value());
+	EXPECT_EQ(reading->temperature, 2150);
+	EXPECT_EQ(reading->humidity, 5560);
+	EXPECT_EQ(reading->counter, 0x3C);
+	EXPECT_EQ(reading->replayCounter, 0x13Cu);
+}
+
+TEST(BeaconDecodersTest, EncryptedNeedsMatchingKeyAndAddress) {
+	EXPECT_FALSE(decodePayload(corpus::btHomeBindKey).has_value());
+	EXPECT_FALSE(decodePayload(corpus::btHomeBindKey, nullptr, {keys::btHomeAddress, &keys::miBeacon}).has_value());
+	EXPECT_FALSE(decodePayload(corpus::btHomeBindKey, nullptr, {keys::miBeaconAddress, &keys::btHome}).has_value()); // address is part of nonce
+	EXPECT_FALSE(decodePayload(corpus::miBeaconBindKey, nullptr, {keys::btHomeAddress, &keys::miBeacon}).has_value());
+
+	for (size_t pos = 9; pos < corpus::miBeaconBindKey.size(); ++pos) { // product id, frame counter and everything after MAC is authenticated
+		if (pos >= 12 && pos < 18) {
+			continue; // MAC in frame - nonce uses the advertiser address
+		}
+		auto tampered = corpus::miBeaconBindKey;
+		tampered[pos] ^= 0x01;
+		EXPECT_FALSE(decodePayload(tampered, nullptr, {keys::miBeaconAddress, &keys::miBeacon}).has_value()) << pos;
+	}
+}
+
+// random mutations of the corpus - decoders must stay within the payload (run with -fsanitize=address to verify)
+TEST(BeaconDecodersTest, Fuzz) {
+	uint32_t state = 0x12345678;
+	auto random = [&state]() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	};
+
+	size_t decoded = 0;
+	for (int iteration = 0; iteration < 200000; ++iteration) {
+		auto const &source = *corpus::all[random() % corpus::all.size()];
+		size_t size = random() % 32;
+		// exact sized heap buffer so any overread is caught by sanitizers
+		std::unique_ptr<uint8_t[]> payload(new uint8_t[size ? size : 1]);
+		for (size_t i = 0; i < size; ++i) {
+			payload[i] = i < source.size() ? source[i] : static_cast<uint8_t>(random());
+		}
+		for (int mutation = random() % 4; mutation > 0 && size > 0; --mutation) {
+			payload[random() % size] = static_cast<uint8_t>(random());
+		}
+
+		DecryptionContext context{keys::miBeaconAddress, iteration % 2 ? &keys::miBeacon : nullptr};
+		auto reading = decode(payload.get(), size, nullptr, context);
+		if (reading) {
+			EXPECT_FALSE(reading->empty());
+			decoded++;
+		}
+	}
+	EXPECT_GT(decoded, 0u);
+}
+
+TEST(BeaconDecodersTest, Benchmark) {
+	static constexpr int rounds = 20000;
+	size_t decoded = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		for (auto const *payload : corpus::all) {
+			decoded += decode(payload->data(), payload->size()).has_value();
+		}
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+	auto perAdvertisement = elapsed / (rounds * static_cast<int64_t>(corpus::all.size()));
+	RecordProperty("nsPerAdvertisement", static_cast<int>(perAdvertisement));
+	EXPECT_EQ(decoded, rounds * 10u);
+}
+
+TEST(BeaconDecodersTest, BenchmarkEncrypted) {
+	static constexpr int rounds = 20000;
+	size_t decoded = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		decoded += decode(corpus::btHomeBindKey.data(), corpus::btHomeBindKey.size(), nullptr, {keys::btHomeAddress, &keys::btHome}).has_value();
+		decoded += decode(corpus::miBeaconBindKey.data(), corpus::miBeaconBindKey.size(), nullptr, {keys::miBeaconAddress, &keys::miBeacon}).has_value();
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+	auto perAdvertisement = elapsed / (rounds * 2);
+	RecordProperty("nsPerEncryptedAdvertisement", static_cast<int>(perAdvertisement));
+	EXPECT_EQ(decoded, rounds * 2u);
+}
+
+} // anonymous namespace
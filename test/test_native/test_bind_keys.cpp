@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include "BindKeys.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+using heating::BindKeys;
+
+heating::BleAddress_t const sensorA{0xa4, 0xc1, 0x38, 0x12, 0x34, 0x56};
+heating::BleAddress_t const sensorB{0x54, 0x48, 0xe6, 0x8f, 0x80, 0xa5};
+BindKeys::Key_t const keyA{0xe9, 0xef, 0xaa, 0x68, 0x73, 0xf9, 0xf9, 0xc8, 0x7a, 0x5e, 0x75, 0xa5, 0xf8, 0x14, 0x80, 0x1c};
+
+using verdict_t = BindKeys::verdict_t;
+
+class BindKeysTest : public ::testing::Test {
+protected:
+	BindKeys keys{{{sensorA, keyA}}};
+	BindKeys::clock_t::time_point now = BindKeys::clock_t::now();
+
+	// every frame a different one
+	bool accept(BindKeys &to, heating::BleAddress_t const &address, uint32_t counter, BindKeys::clock_t::time_point time) {
+		return to.accept(address, counter, ++frames, time) == verdict_t::fresh;
+	}
+	bool accept(heating::BleAddress_t const &address, uint32_t counter, BindKeys::clock_t::time_point time) { return accept(keys, address, counter, time); }
+
+	uint32_t frames = 0x1000;
+};
+
+TEST_F(BindKeysTest, FindsOnlyConfiguredSensors) {
+	EXPECT_EQ(keys.size(), 1u);
+	EXPECT_NE(keys.find(sensorA), nullptr);
+	EXPECT_EQ(keys.find(sensorB), nullptr);
+	EXPECT_FALSE(accept(sensorB, 1, now));
+}
+
+TEST_F(BindKeysTest, RejectsReplayedCounter) {
+	EXPECT_TRUE(accept(sensorA, 100, now));
+	EXPECT_FALSE(accept(sensorA, 100, now + 1s));
+	EXPECT_FALSE(accept(sensorA, 99, now + 2s));
+	EXPECT_TRUE(accept(sensorA, 101, now + 3s));
+	EXPECT_EQ(keys.getReplays(), 2u);
+}
+
+TEST_F(BindKeysTest, ResyncsAfterLongSilence) {
+	EXPECT_TRUE(accept(sensorA, 5000, now));
+	EXPECT_FALSE(accept(sensorA, 1, now + 30min));
+	EXPECT_TRUE(accept(sensorA, 1, now + BindKeys::resyncAfter + 1s)); // sensor restarted, counter from zero
+}
+
+TEST_F(BindKeysTest, CountersCarriedOverOnReload) {
+	EXPECT_TRUE(accept(sensorA, 100, now));
+
+	BindKeys reloaded({{sensorA, keyA}, {sensorB, keyA}}, &keys);
+	EXPECT_FALSE(accept(reloaded, sensorA, 100, now + 1s));
+	EXPECT_TRUE(accept(reloaded, sensorB, 1, now + 1s));
+}
+
+// the advertisement filter forwards an unchanged frame again every refresh to keep the sensor alive
+TEST_F(BindKeysTest, LastFrameRepeatedIsNotReplay) {
+	EXPECT_EQ(keys.accept(sensorA, 100, 0xabcd, now), verdict_t::fresh);
+	EXPECT_EQ(keys.accept(sensorA, 100, 0xabcd, now + 60s), verdict_t::repeated);
+	EXPECT_EQ(keys.accept(sensorA, 100, 0xabcd, now + 120s), verdict_t::repeated);
+	EXPECT_EQ(keys.accept(sensorA, 100, 0x1234, now + 121s), verdict_t::rejected); // same counter, other frame
+	EXPECT_EQ(keys.accept(sensorA, 101, 0x5678, now + 180s), verdict_t::fresh);
+	EXPECT_EQ(keys.accept(sensorA, 100, 0xabcd, now + 181s), verdict_t::rejected); // no longer the last one
+	EXPECT_EQ(keys.getReplays(), 2u);
+
+	BindKeys reloaded({{sensorA, keyA}}, &keys);
+	EXPECT_EQ(reloaded.accept(sensorA, 101, 0x5678, now + 240s), verdict_t::repeated);
+}
+
+} // anonymous namespace
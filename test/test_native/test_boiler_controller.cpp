@@ -172,6 +172,59 @@ TEST_F(ValvePreheatingTest, NoPreheating_WhenDelayZero) {
 	EXPECT_NE(ss.str().find("\"boiler\": true"), std::string::npos);
 }
 
+// ============================================================================
+// Thermal actuator opening compensation tests
+// ============================================================================
+
+class ValveOpeningTest : public BoilerOnOffTest {
+protected:
+	std::vector<heating::ThermalActuator::Config> actuators;
+
+	void SetUp() override {
+		BoilerOnOffTest::SetUp();
+		cfg.boiler.valveOpenCapacityToStart = 50;
+	}
+
+	heating::BoilerController makeController() {
+		auto bp = std::make_unique<MockGpioPort>(99);
+		boilerGpio = bp.get();
+		return heating::BoilerController(cfg, [this]() { return outdoorTemp; }, [](bool, uint8_t) {}, [](uint8_t) {}, std::move(bp), valveMocks.makePorts(2), {}, actuators);
+	}
+};
+
+TEST_F(ValveOpeningTest, WaitsForValvesToOpen) {
+	actuators = {{std::chrono::seconds(3600), std::chrono::seconds(0), 1}, {std::chrono::seconds(3600), std::chrono::seconds(0), 1}};
+	auto bc = makeController();
+
+	bc.startBoilerOrContinue(true, false, std::nullopt);
+	bc.handleValves({0, 1}); // both closed instantly (close time 0)
+	bc.startBoilerOrContinue(false, false, std::nullopt);
+	bc.handleValves({}); // boiler off - all opened, but opening takes an hour
+
+	bc.startBoilerOrContinue(true, false, std::nullopt);
+
+	std::stringstream ss;
+	bc.getStatus(ss);
+	EXPECT_NE(ss.str().find("\"boiler\": false"), std::string::npos);
+	EXPECT_NE(ss.str().find("\"valvesPosition\": [0, 0]"), std::string::npos);
+}
+
+TEST_F(ValveOpeningTest, StartsWhenValvesOpen) {
+	actuators = {{std::chrono::seconds(0), std::chrono::seconds(0), 1}, {std::chrono::seconds(3600), std::chrono::seconds(0), 1}};
+	auto bc = makeController();
+
+	bc.startBoilerOrContinue(true, false, std::nullopt);
+	bc.handleValves({0, 1});
+	bc.startBoilerOrContinue(false, false, std::nullopt);
+	bc.handleValves({}); // valve 0 opens instantly - 50% of capacity
+
+	bc.startBoilerOrContinue(true, false, std::nullopt);
+
+	std::stringstream ss;
+	bc.getStatus(ss);
+	EXPECT_NE(ss.str().find("\"boiler\": true"), std::string::npos);
+}
+
 // ============================================================================
 // Valve handling tests
 // ============================================================================
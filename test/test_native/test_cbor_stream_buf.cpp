@@ -0,0 +1,307 @@
+#include <gtest/gtest.h>
+#include "CborStreamBuf.h"
+#include "StatusCache.h"
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+using heating::CborStreamBuf;
+
+std::string shortest(double value) {
+	char text[32];
+	auto result = std::to_chars(text, text + sizeof(text), value);
+	return std::string(text, result.ptr);
+}
+
+std::string shortest(float value) {
+	char text[32];
+	auto result = std::to_chars(text, text + sizeof(text), value);
+	return std::string(text, result.ptr);
+}
+
+// CBOR back to compact JSON, enough of RFC 8949 for what CborStreamBuf writes
+class CborToJson {
+public:
+	explicit CborToJson(std::string_view cbor) : cbor_(cbor) {}
+
+	std::string decode() {
+		std::string json;
+		item(json);
+		EXPECT_EQ(at_, cbor_.size()) << "trailing bytes";
+		return json;
+	}
+
+private:
+	uint8_t byte() {
+		if (at_ >= cbor_.size()) {
+			ADD_FAILURE() << "truncated";
+			return 0xff;
+		}
+		return static_cast<uint8_t>(cbor_[at_++]);
+	}
+
+	uint64_t argument(uint8_t info) {
+		if (info < 24) {
+			return info;
+		}
+		uint64_t value = 0;
+		for (int bytes = 1 << (info - 24); bytes > 0; --bytes) {
+			value = value << 8 | byte();
+		}
+		return value;
+	}
+
+	bool isBreak() const { return at_ < cbor_.size() && static_cast<uint8_t>(cbor_[at_]) == 0xff; }
+
+	void item(std::string &json) {
+		auto initial = byte();
+		auto major = initial >> 5;
+		auto info = initial & 0x1f;
+		switch (major) {
+		case 0: json += std::to_string(argument(info)); break;
+		case 1: json += "-" + std::to_string(argument(info) + 1); break;
+		case 3: {
+			auto length = argument(info);
+			json += "\"" + escape(cbor_.substr(at_, length)) + "\"";
+			at_ += length;
+			break;
+		}
+		case 4:
+		case 5: {
+			EXPECT_EQ(info, 31) << "indefinite length expected";
+			json += major == 4 ? "[" : "{";
+			for (bool first = true; !isBreak() && at_ < cbor_.size(); first = false) {
+				json += first ? "" : ",";
+				item(json);
+				if (major == 5) {
+					json += ":";
+					item(json);
+				}
+			}
+			byte();
+			json += major == 4 ? "]" : "}";
+			break;
+		}
+		case 7:
+			if (info == 20 || info == 21 || info == 22) {
+				json += info == 20 ? "false" : info == 21 ? "true" : "null";
+			} else if (info == 26) {
+				auto bits = static_cast<uint32_t>(argument(info));
+				float value;
+				std::memcpy(&value, &bits, sizeof(value));
+				json += shortest(value);
+			} else if (info == 27) {
+				auto bits = argument(info);
+				double value;
+				std::memcpy(&value, &bits, sizeof(value));
+				json += shortest(value);
+			} else {
+				ADD_FAILURE() << "unexpected simple value " << info;
+			}
+			break;
+		default: ADD_FAILURE() << "unexpected major type " << major; break;
+		}
+	}
+
+	static std::string escape(std::string_view text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+			}
+			if (c == '\n') {
+				escaped += "\\n";
+				continue;
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	std::string_view cbor_;
+	size_t at_ = 0;
+};
+
+// whitespace dropped outside strings, fractional numbers in their shortest form
+std::string compact(std::string_view json) {
+	std::string result;
+	bool string = false;
+	for (size_t i = 0; i < json.size(); ++i) {
+		char c = json[i];
+		if (string) {
+			result += c;
+			if (c == '\\') {
+				result += json[++i];
+			} else if (c == '"') {
+				string = false;
+			}
+		} else if (c == '"') {
+			string = true;
+			result += c;
+		} else if (c == '-' || (c >= '0' && c <= '9')) {
+			auto end = json.find_first_not_of("0123456789.eE+-", i);
+			auto number = std::string(json.substr(i, end - i));
+			result += number.find_first_of(".eE") == std::string::npos ? number : shortest(std::strtod(number.c_str(), nullptr));
+			i = end - 1;
+		} else if (c != ' ' && c != '\n' && c != '\t') {
+			result += c;
+		}
+	}
+	return result;
+}
+
+std::string encode(std::string_view json) {
+	CborStreamBuf buf;
+	std::ostream ss(&buf);
+	ss << json;
+	EXPECT_TRUE(buf.finish()) << json;
+	return std::string(buf.view());
+}
+
+std::string hex(std::string_view bytes) {
+	std::string text;
+	char digits[3];
+	for (char c : bytes) {
+		std::snprintf(digits, sizeof(digits), "%02x", static_cast<uint8_t>(c));
+		text += digits;
+	}
+	return text;
+}
+
+// rooms the way Room::getStatus writes them, the bulk of /status
+void writeStatus(std::ostream &ss, size_t rooms) {
+	ss << "{\"rooms\": [";
+	for (size_t room = 0; room < rooms; ++room) {
+		ss << (room ? "," : "") << "{\"name\": \"Room " << room << "\", \"enabled\": true";
+		ss << ", \"currentTemp\": " << 2100 + room * 7 << ", \"currentHumidity\": " << 45 + room << ", \"currentTempAgeMs\": " << 12345 + room * 1000;
+		ss << ", \"batteryLevel\": 87, \"meanTemp\": " << 2098 + room << ", \"tempConfidence\": 92, \"tempRejected\": 0";
+		ss << ", \"sensors\": [{\"address\": \"a4:c1:38:12:34:5" << room << "\", \"weight\": 100, \"encrypted\": false, \"batteryLevel\": 87, \"temp\": " << 2100 + room * 7 << ", \"confidence\": 92}]";
+		ss << ", \"currentProgram\": " << (room % 2 ? "null" : "\"Morning\"") << ", \"tempSet\": 2150, \"tempMarginUp\": 20, \"tempMarginDown\": 10, \"temporaryProgramSecondsLeft\": 0";
+		ss << ", \"shouldContinueHeating\": false, \"shouldStartBoiler\": " << (room == 2 ? "true" : "false") << ", \"valves\": [\"" << room << "\"]}";
+	}
+	ss << "], \"activeProgram\": \"Winter\"";
+	ss << ", \"ems\": {\"heatingActive\": true, \"currentFlowTemperature\": 452, \"selectedFlowTemperature\": 46, \"burnerPower\": 37, \"outdoorTemperature\": -3.5}";
+	ss << ", \"warmWater\": {\"program\": {\"active\": false}, \"events\": [{\"liters\": 12.3457, \"energyKwh\": 0.5, \"durationS\": 240}]}";
+	ss << ", \"time\": \"07:15:00\", \"date\": \"2026-10-18\", \"weekDay\": 0, \"uptime\": 123456}";
+}
+
+std::string statusDocument(size_t rooms) {
+	std::stringstream ss;
+	writeStatus(ss, rooms);
+	return ss.str();
+}
+
+TEST(CborStreamBufTest, EncodesScalarsInShortestForm) {
+	EXPECT_EQ(hex(encode("0")), "00");
+	EXPECT_EQ(hex(encode("23")), "17");
+	EXPECT_EQ(hex(encode("24")), "1818");
+	EXPECT_EQ(hex(encode("1000")), "1903e8");
+	EXPECT_EQ(hex(encode("1000000")), "1a000f4240");
+	EXPECT_EQ(hex(encode("-1")), "20");
+	EXPECT_EQ(hex(encode("-500")), "3901f3");
+	EXPECT_EQ(hex(encode("-0")), "00");
+	EXPECT_EQ(hex(encode("1.5")), "fa3fc00000");        // a float holds it exactly
+	EXPECT_EQ(hex(encode("0.1")), "fb3fb999999999999a"); // a float doesn't
+	EXPECT_EQ(hex(encode("true")), "f5");
+	EXPECT_EQ(hex(encode("false")), "f4");
+	EXPECT_EQ(hex(encode("null")), "f6");
+	EXPECT_EQ(hex(encode("\"a\"")), "6161");
+	EXPECT_EQ(hex(encode("{\"a\": [1, 2]}")), "bf61619f0102ffff");
+}
+
+TEST(CborStreamBufTest, UnescapesStrings) {
+	EXPECT_EQ(encode(R"("q\"b\\s\/n\nt\t")"), std::string("\x6a") + "q\"b\\s/n\nt\t");
+	EXPECT_EQ(encode(R"("\u00e9\u20ac")"), "\x65\xc3\xa9\xe2\x82\xac");
+	EXPECT_EQ(encode(R"("\ud83d\ude00")"), "\x64\xf0\x9f\x98\x80"); // surrogate pair
+}
+
+TEST(CborStreamBufTest, RejectsMalformedJson) {
+	for (auto json : {"{\"a\": tru}", "]", "{\"a\": 1", "{\"a\": 1.2.3}", "{\"a\": -}", "{\"a\": @}", "\"\\u12g4\""}) {
+		CborStreamBuf buf;
+		std::ostream ss(&buf);
+		ss << json;
+		EXPECT_FALSE(buf.finish()) << json;
+	}
+	CborStreamBuf empty;
+	EXPECT_FALSE(empty.finish());
+}
+
+TEST(CborStreamBufTest, RoundTripsStatusAgainstJson) {
+	auto json = statusDocument(6);
+	auto cbor = encode(json);
+	EXPECT_EQ(CborToJson(cbor).decode(), compact(json));
+
+	// written piece by piece as status writers do, every split point lands in the middle of some token
+	CborStreamBuf buf;
+	std::ostream ss(&buf);
+	for (size_t at = 0; at < json.size(); at += 3) {
+		ss << json.substr(at, 3);
+	}
+	ASSERT_TRUE(buf.finish());
+	EXPECT_EQ(buf.view(), cbor);
+	EXPECT_EQ(buf.getConsumed(), json.size());
+}
+
+// the same writer rendering either representation, as REST does
+TEST(CborStreamBufBench, SizeAndRenderingTime) {
+	constexpr size_t rooms = 8;
+	constexpr int rounds = 200;
+	size_t jsonSize = 0;
+	size_t cborSize = 0;
+
+	auto started = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		std::stringstream ss;
+		writeStatus(ss, rooms);
+		jsonSize = ss.str().size();
+	}
+	auto jsonNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count() / rounds;
+
+	started = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		CborStreamBuf buf;
+		std::ostream ss(&buf);
+		writeStatus(ss, rooms);
+		ASSERT_TRUE(buf.finish());
+		cborSize = buf.view().size();
+	}
+	auto cborNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count() / rounds;
+
+	// served from the status cache, CBOR encoded at its refresh
+	heating::StatusCache cache;
+	cache.setSections({{"status", [&](std::ostream &ss) { writeStatus(ss, rooms); }}});
+	cache.refresh();
+	started = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		std::stringstream ss;
+		cache.write(ss, 0);
+	}
+	auto cachedJsonNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count() / rounds;
+	started = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		CborStreamBuf buf;
+		std::ostream ss(&buf);
+		cache.write(ss, 0, &buf);
+		ASSERT_TRUE(buf.finish());
+	}
+	auto cachedCborNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count() / rounds;
+
+	RecordProperty("rooms", static_cast<int>(rooms));
+	RecordProperty("jsonBytes", static_cast<int>(jsonSize));
+	RecordProperty("jsonNs", static_cast<int>(jsonNs));
+	RecordProperty("cborBytes", static_cast<int>(cborSize));
+	RecordProperty("cborNs", static_cast<int>(cborNs));
+	RecordProperty("cachedJsonNs", static_cast<int>(cachedJsonNs));
+	RecordProperty("cachedCborNs", static_cast<int>(cachedCborNs));
+	EXPECT_LT(cborSize * 100, jsonSize * 80); // syntax, whitespace and binary numbers save at least a fifth
+}
+
+} // anonymous namespace
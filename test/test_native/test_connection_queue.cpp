@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include "ConnectionQueue.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using heating::ConnectionQueue;
+using namespace std::chrono_literals;
+
+TEST(ConnectionQueueTest, AcceptsOnlyForWaitingWorker) {
+	ConnectionQueue<int> connections;
+	EXPECT_FALSE(connections.hasIdleWorker());
+
+	int served = 0;
+	std::thread worker([&] {
+		served = connections.pop();
+		connections.done();
+	});
+	while (!connections.hasIdleWorker()) {
+		std::this_thread::sleep_for(100us);
+	}
+	connections.push(7);
+	EXPECT_FALSE(connections.hasIdleWorker()); // the waiting worker is taken
+	worker.join();
+	EXPECT_EQ(served, 7);
+
+	std::stringstream ss;
+	connections.getStatus(ss);
+	EXPECT_EQ(ss.str(), R"({"accepted": 1, "served": 1, "busy": 0, "maxBusy": 1, "idle": 0})");
+}
+
+// HTTP server on loopback the way the REST task runs it - a server thread accepts while a worker waits, workers serve
+// one connection each with blocking writes. "d" is a 190 kB asset, anything else a short status.
+class Server {
+public:
+	explicit Server(size_t workers) {
+		listener_ = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(listener_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+		listen(listener_, 4);
+		socklen_t length = sizeof(address);
+		getsockname(listener_, reinterpret_cast<sockaddr *>(&address), &length);
+		port_ = ntohs(address.sin_port);
+
+		for (size_t i = 0; i < workers; ++i) {
+			workers_.emplace_back([this] {
+				for (;;) {
+					int fd = connections_.pop();
+					if (fd < 0) {
+						return;
+					}
+					serve(fd);
+					connections_.done();
+				}
+			});
+		}
+		server_ = std::thread([this] {
+			while (!stop_) {
+				pollfd pending{listener_, POLLIN, 0};
+				if (!connections_.hasIdleWorker() || poll(&pending, 1, 1) <= 0) {
+					std::this_thread::sleep_for(1ms);
+					continue;
+				}
+				int fd = accept(listener_, nullptr, nullptr);
+				int buffer = 4096;
+				setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+				connections_.push(fd);
+			}
+		});
+	}
+
+	~Server() {
+		stop_ = true;
+		server_.join();
+		for (size_t i = 0; i < workers_.size(); ++i) {
+			connections_.push(-1);
+		}
+		for (auto &worker : workers_) {
+			worker.join();
+		}
+		close(listener_);
+	}
+
+	uint16_t port() const { return port_; }
+	ConnectionQueue<int> const &connections() const { return connections_; }
+
+private:
+	static void serve(int fd) {
+		char request = 0;
+		if (read(fd, &request, 1) == 1) {
+			std::string body(request == 'd' ? 190 * 1024 : 1024, 'x');
+			for (size_t sent = 0; sent < body.size();) {
+				auto written = write(fd, body.data() + sent, body.size() - sent);
+				if (written <= 0) {
+					break;
+				}
+				sent += static_cast<size_t>(written);
+			}
+		}
+		close(fd);
+	}
+
+	int listener_;
+	uint16_t port_;
+	ConnectionQueue<int> connections_;
+	std::vector<std::thread> workers_;
+	std::thread server_;
+	std::atomic_bool stop_{false};
+};
+
+// client reading the response in chunks of one segment with a pause after each - ~1.4 MB/s when slow
+size_t get(uint16_t port, char request, bool slow) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (slow) {
+		int buffer = 4096;
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+	}
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	size_t received = 0;
+	if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 && write(fd, &request, 1) == 1) {
+		char chunk[1436];
+		ssize_t length;
+		while ((length = read(fd, chunk, sizeof(chunk))) > 0) {
+			received += static_cast<size_t>(length);
+			if (slow) {
+				std::this_thread::sleep_for(1ms);
+			}
+		}
+	}
+	close(fd);
+	return received;
+}
+
+// status requests of two clients per second while a third one downloads slowly
+double requestsPerSecond(size_t workers) {
+	constexpr int requests = 20;
+	Server server(workers);
+	std::thread download([&] { EXPECT_EQ(get(server.port(), 'd', true), 190u * 1024); });
+	std::this_thread::sleep_for(10ms); // download holds a worker
+
+	auto started = std::chrono::steady_clock::now();
+	std::vector<std::thread> clients;
+	for (int client = 0; client < 2; ++client) {
+		clients.emplace_back([&] {
+			for (int request = 0; request < requests; ++request) {
+				EXPECT_EQ(get(server.port(), 's', false), 1024u);
+			}
+		});
+	}
+	for (auto &client : clients) {
+		client.join();
+	}
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	download.join();
+	return 2 * requests / elapsed;
+}
+
+TEST(ConnectionQueueTest, SlowDownloadDoesntHoldOtherClients) {
+	auto before = requestsPerSecond(1); // single WebServer, one connection at a time
+	auto after = requestsPerSecond(3);
+
+	RecordProperty("beforeRequestsPerSecond", static_cast<int>(before));
+	RecordProperty("afterRequestsPerSecond", static_cast<int>(after));
+	EXPECT_GT(after, before * 3);
+}
+
+} // anonymous namespace
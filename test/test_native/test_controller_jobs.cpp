@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include "ControllerJobs.h"
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+using heating::ControllerJobs;
+using namespace std::chrono_literals;
+
+TEST(ControllerJobsTest, RunsCallOnControllerThread) {
+	ControllerJobs jobs;
+	std::atomic_bool stop{false};
+	std::thread controller([&] {
+		while (!stop) {
+			jobs.execute();
+			std::this_thread::sleep_for(1ms);
+		}
+	});
+
+	auto callerThread = std::this_thread::get_id();
+	std::thread::id ranOn;
+	int result = 0; // on caller's stack, written by the controller thread
+	EXPECT_TRUE(jobs.run([&] { ranOn = std::this_thread::get_id(); result = 42; }, 1000ms));
+	EXPECT_EQ(result, 42);
+	EXPECT_NE(ranOn, callerThread);
+
+	stop = true;
+	controller.join();
+}
+
+TEST(ControllerJobsTest, QueuedCallWithdrawnAtTimeout) {
+	ControllerJobs jobs;
+	bool ran = false;
+	EXPECT_FALSE(jobs.run([&] { ran = true; }, 10ms)); // controller never gets to it
+	EXPECT_EQ(jobs.execute(), 0u);
+	EXPECT_FALSE(ran);
+
+	std::stringstream ss;
+	jobs.getStatus(ss);
+	EXPECT_EQ(ss.str(), R"({"executed": 0, "timeouts": 1, "rejected": 0, "queued": 0, "maxWaitUs": 0, "maxRunUs": 0})");
+}
+
+TEST(ControllerJobsTest, StartedCallIsWaitedForPastTimeout) {
+	ControllerJobs jobs;
+	std::atomic_bool started{false};
+	std::thread controller([&] {
+		while (!started) {
+			if (jobs.execute()) {
+				break;
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+	});
+
+	bool finished = false;
+	EXPECT_TRUE(jobs.run([&] {
+		started = true;
+		std::this_thread::sleep_for(50ms); // longer than the timeout
+		finished = true;
+	}, 20ms));
+	EXPECT_TRUE(finished);
+	controller.join();
+}
+
+TEST(ControllerJobsTest, RejectsWhenFull) {
+	ControllerJobs jobs(1);
+	std::thread first([&] { jobs.run([&] {}, 200ms); });
+	while (true) {
+		std::stringstream ss;
+		jobs.getStatus(ss);
+		if (ss.str().find("\"queued\": 1") != std::string::npos) {
+			break;
+		}
+		std::this_thread::sleep_for(1ms);
+	}
+	EXPECT_FALSE(jobs.run([] {}, 200ms));
+	EXPECT_EQ(jobs.execute(), 1u);
+	first.join();
+
+	std::stringstream ss;
+	jobs.getStatus(ss);
+	EXPECT_NE(ss.str().find("\"executed\": 1, \"timeouts\": 0, \"rejected\": 1"), std::string::npos) << ss.str();
+}
+
+TEST(ControllerJobsTest, ManyCallersServedInOrder) {
+	ControllerJobs jobs(8);
+	std::atomic_bool stop{false};
+	std::thread controller([&] {
+		while (!stop) {
+			jobs.execute();
+			std::this_thread::sleep_for(100us);
+		}
+	});
+
+	std::atomic<int> total{0};
+	std::vector<std::thread> callers;
+	for (int c = 0; c < 4; ++c) {
+		callers.emplace_back([&] {
+			for (int i = 0; i < 50; ++i) {
+				int value = 0;
+				ASSERT_TRUE(jobs.run([&] { value = 1; }, 1000ms));
+				total += value;
+			}
+		});
+	}
+	for (auto &caller : callers) {
+		caller.join();
+	}
+	EXPECT_EQ(total, 200);
+
+	stop = true;
+	controller.join();
+}
+
+} // anonymous namespace
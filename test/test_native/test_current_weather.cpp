@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "CurrentWeather.h"
+#include "HeapCounter.h"
+
+#include <string>
+
+namespace {
+
+using heating::CurrentWeatherParser;
+using heating::FetchBackoff;
+using heating::Outdoor;
+
+// /data/2.5/weather response as sent by the API
+constexpr char response[] = R"({"coord":{"lon":17.0333,"lat":51.1},"weather":[{"id":803,"main":"Clouds","description":"broken clouds","icon":"04n"},{"id":701,"main":"Mist","description":"mist","icon":"50n"}],"base":"stations","main":{"temp":-3.47,"feels_like":-7.9,"temp_min":-4.06,"temp_max":-2.78,"pressure":1024,"humidity":93,"sea_level":1024,"grnd_level":1005},"visibility":10000,"wind":{"speed":3.09,"deg":250},"clouds":{"all":75},"dt":1736910421,"sys":{"type":2,"id":2073402,"country":"PL","sunrise":1736923620,"sunset":1736954226},"timezone":3600,"id":3081368,"name":"Wrocław \"centre\"","cod":200})";
+
+class CurrentWeatherTest : public ::testing::Test {
+protected:
+	Outdoor outdoor;
+	CurrentWeatherParser parser{outdoor};
+};
+
+TEST_F(CurrentWeatherTest, ExtractsUsedFields) {
+	parser.feed(response, sizeof(response) - 1);
+	ASSERT_TRUE(parser.finish());
+	EXPECT_TRUE(outdoor.valid);
+	EXPECT_EQ(outdoor.temp, -347);
+	EXPECT_EQ(outdoor.feelsLike, -790);
+	EXPECT_EQ(outdoor.humidity, 93);
+	EXPECT_EQ(outdoor.pressure, 1024);
+	EXPECT_EQ(outdoor.windSpeed, 309);
+	EXPECT_EQ(outdoor.windDeg, 250);
+	EXPECT_EQ(outdoor.date, 1736910421u);
+	EXPECT_STREQ(outdoor.description, "broken clouds"); // first weather only
+	EXPECT_STREQ(outdoor.icon, "04n");
+}
+
+TEST_F(CurrentWeatherTest, RendersCompactStatus) {
+	for (size_t pos = 0; pos < sizeof(response) - 1; pos += 7) {
+		parser.feed(response + pos, std::min<size_t>(7, sizeof(response) - 1 - pos));
+	}
+	ASSERT_TRUE(parser.finish());
+	EXPECT_EQ(outdoor.getJSON(), R"({"dt":1736910421,"name":"Wrocław \"centre\"","weather":[{"description":"broken clouds","icon":"04n"}],)"
+	                             R"("main":{"temp":-3.47,"feels_like":-7.90,"humidity":93,"pressure":1024},"wind":{"speed":3.09,"deg":250}})");
+	EXPECT_EQ(Outdoor{}.getJSON(), "{}");
+}
+
+TEST_F(CurrentWeatherTest, InvalidWithoutTemperatureOrComplete) {
+	std::string error = R"({"cod":401, "message": "Invalid API key."})";
+	parser.feed(error.data(), error.size());
+	EXPECT_FALSE(parser.finish());
+	EXPECT_FALSE(outdoor.valid);
+
+	parser.reset();
+	parser.feed(response, 200);
+	EXPECT_FALSE(parser.finish());
+}
+
+TEST_F(CurrentWeatherTest, StreamingParseDoesntAllocate) {
+	// previous path: whole body in a String, a cJSON tree over it and a copy of the body per status request
+	heap::start();
+	std::string body(response);
+	std::string statusCopy(body);
+	size_t bodyBytes = heap::counter.bytes;
+
+	heap::start();
+	parser.feed(response, sizeof(response) - 1);
+	bool parsed = parser.finish();
+	size_t parseAllocations = heap::counter.allocations;
+
+	heap::start();
+	auto status = outdoor.getJSON();
+	size_t statusAllocations = heap::counter.allocations;
+	size_t statusBytes = heap::counter.bytes;
+	heap::stop();
+
+	ASSERT_TRUE(parsed);
+	EXPECT_EQ(parseAllocations, 0u);
+	EXPECT_EQ(statusAllocations, 1u); // rendered once per fetch, shared by status requests
+	EXPECT_LT(statusBytes, bodyBytes / 2);
+	EXPECT_LT(sizeof(CurrentWeatherParser) + sizeof(Outdoor), 400u);
+}
+
+TEST(FetchBackoff, DoublesAfterFailuresUpToLimit) {
+	EXPECT_EQ(FetchBackoff::nextDelayMs(120000, 0), 120000u);
+	EXPECT_EQ(FetchBackoff::nextDelayMs(120000, 1), 15000u);
+	EXPECT_EQ(FetchBackoff::nextDelayMs(120000, 2), 30000u);
+	EXPECT_EQ(FetchBackoff::nextDelayMs(120000, 5), 240000u);
+	EXPECT_EQ(FetchBackoff::nextDelayMs(120000, 10), FetchBackoff::maxDelayMs);
+	EXPECT_EQ(FetchBackoff::nextDelayMs(120000, 255), FetchBackoff::maxDelayMs);
+	EXPECT_EQ(FetchBackoff::nextDelayMs(3600000, 20), 3600000u); // capped at the regular interval when that is longer
+}
+
+} // anonymous namespace
@@ -0,0 +1,323 @@
+#include <gtest/gtest.h>
+#include "HeatingCurveLearner.h"
+#include "FlowTemperatureOptimizer.h"
+#include "HeatingCurve.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using namespace std::chrono_literals;
+using heating::CurveLearnerState;
+using heating::HeatingCurveLearner;
+using clock_t_ = HeatingCurveLearner::clock_t;
+
+HeatingCurveLearner::Curve_t const steepCurve{30, 36, 44, 52, 60, 68, 76, 84, 90};
+
+// no room feedback unless set afterwards
+HeatingCurveLearner::Observation observation(int16_t outdoor, bool heating = false, std::optional<int16_t> flow = std::nullopt) {
+	return {outdoor, heating, flow, std::nullopt, std::nullopt, std::nullopt};
+}
+
+class CurveLearnerTest : public ::testing::Test {
+protected:
+	clock_t_::time_point now = clock_t_::time_point{} + 1h;
+
+	struct Rooms {
+		int16_t temperature;
+		int16_t set;
+	};
+
+	// one window at constant outdoor temperature, boiler running for given share of it
+	void runWindow(HeatingCurveLearner &learner, int16_t outdoor, int16_t flow, double duty, std::optional<int16_t> gainRate = std::nullopt, std::optional<Rooms> rooms = std::nullopt) {
+		auto const ticks = HeatingCurveLearner::window / 10s;
+		for (int tick = 0; tick <= ticks; ++tick) {
+			auto observation = ::observation(outdoor);
+			observation.heating = tick < ticks * duty;
+			if (observation.heating) {
+				observation.flowTemperature = flow;
+				observation.gainRate = gainRate;
+				if (rooms) {
+					observation.roomTemperature = rooms->temperature;
+					observation.roomSet = rooms->set;
+				}
+			}
+			learner.add(observation, now);
+			now += 10s;
+		}
+	}
+
+	static float flowAt(HeatingCurveLearner const &learner, size_t point, float priorSlope = 0) { return learner.getPointFlow(point, priorSlope).value_or(-100); }
+};
+
+TEST_F(CurveLearnerTest, NothingLearntKeepsCurrentCurve) {
+	HeatingCurveLearner learner;
+	auto suggestion = learner.suggest(steepCurve, 20, 90);
+	EXPECT_FALSE(suggestion.ready);
+	EXPECT_EQ(suggestion.curve, steepCurve);
+	EXPECT_EQ(suggestion.confidence[4], 0);
+}
+
+TEST_F(CurveLearnerTest, CyclingScalesFlowByDuty) {
+	HeatingCurveLearner learner;
+	runWindow(learner, 0, 6000, 0.5, std::nullopt, Rooms{2050, 2100}); // boiler half of the time at 60 °C holds the room
+	EXPECT_EQ(learner.getWindows(), 1u);
+	EXPECT_NEAR(flowAt(learner, 4), 21 + std::pow(0.5, 1 / HeatingCurveLearner::emitterExponent) * 39, 0.2);
+	EXPECT_FLOAT_EQ(learner.getState().points[4].weight, 1);
+	EXPECT_FALSE(learner.getPointFlow(3, 0).has_value());
+}
+
+TEST_F(CurveLearnerTest, ColdRoomsScaleByHeatLoss) {
+	HeatingCurveLearner learner;
+	runWindow(learner, -1000, 5000, 1.0, 0, Rooms{1800, 2100}); // never stops, rooms stay 3 °C below set point
+	// loss at set point is 31/28 of the current one
+	EXPECT_NEAR(flowAt(learner, 6), 21 + std::pow(31.0 / 28, 1 / HeatingCurveLearner::emitterExponent) * 32, 0.2);
+}
+
+TEST_F(CurveLearnerTest, WarmingUpIsNotSteadyState) {
+	HeatingCurveLearner learner;
+	runWindow(learner, -1000, 5000, 1.0, 150, Rooms{1800, 2100}); // recovering from night set back
+	EXPECT_EQ(learner.getWindows(), 0u);
+}
+
+TEST_F(CurveLearnerTest, WithoutRoomsGainShortfallRaises) {
+	HeatingCurveLearner learner;
+	runWindow(learner, -1000, 5000, 1.0, -50);
+	EXPECT_NEAR(flowAt(learner, 6), 50 + 2 * (HeatingCurveLearner::targetGainRate + 50) / 100.0, 0.1);
+}
+
+TEST_F(CurveLearnerTest, SpreadsBetweenNeighbouringPoints) {
+	HeatingCurveLearner learner;
+	runWindow(learner, -250, 4000, 1.0); // half way between 0 and -5 °C
+	EXPECT_FLOAT_EQ(learner.getState().points[4].weight, 0.5);
+	EXPECT_FLOAT_EQ(learner.getState().points[5].weight, 0.5);
+	EXPECT_FLOAT_EQ(flowAt(learner, 4), 40);
+	EXPECT_FLOAT_EQ(flowAt(learner, 5), 40);
+}
+
+TEST_F(CurveLearnerTest, LocalLineReachesPointOutsideWeatherSeen) {
+	HeatingCurveLearner learner;
+	for (int16_t outdoor = -600; outdoor >= -1200; outdoor -= 50) { // -6 .. -12 °C, flow needs 1.5 °C per °C
+		runWindow(learner, outdoor, static_cast<int16_t>(4500 - outdoor * 3 / 2), 1.0);
+	}
+	EXPECT_NEAR(flowAt(learner, 7, -1.6f), 45 + 15 * 1.5, 0.5); // -15 °C not seen, but not pulled to the middle either
+	EXPECT_NEAR(flowAt(learner, 6, -1.6f), 45 + 10 * 1.5, 0.3);
+	EXPECT_NEAR(flowAt(learner, 6, 0), 45 + 10 * 1.5, 0.3); // enough spread around -10 °C to not need the prior
+}
+
+TEST_F(CurveLearnerTest, CurveSlope) {
+	EXPECT_FLOAT_EQ(HeatingCurveLearner::getCurveSlope(steepCurve, 0), -6.0f / 5);
+	EXPECT_FLOAT_EQ(HeatingCurveLearner::getCurveSlope(steepCurve, 4), -16.0f / 10);
+	EXPECT_FLOAT_EQ(HeatingCurveLearner::getCurveSlope(steepCurve, 8), -6.0f / 5);
+}
+
+TEST_F(CurveLearnerTest, DiscardsUselessWindows) {
+	HeatingCurveLearner learner;
+	runWindow(learner, 500, 5000, 0.0); // no heating - nothing learnt about required flow
+
+	auto const ticks = HeatingCurveLearner::window / 10s;
+	for (int tick = 0; tick <= ticks; ++tick) { // weather front - outdoor temperature not representative
+		learner.add(observation(static_cast<int16_t>(tick * 2), true, 5000), now);
+		now += 10s;
+	}
+	EXPECT_EQ(learner.getWindows(), 0u);
+	for (auto const &point : learner.getState().points) {
+		EXPECT_EQ(point.weight, 0);
+	}
+}
+
+TEST_F(CurveLearnerTest, GapsAreNotCounted) {
+	HeatingCurveLearner learner;
+	learner.add(observation(0, true, 5000), now);
+	learner.add(observation(0), now + 50min); // device was offline, counts as one tick only
+	EXPECT_EQ(learner.getWindows(), 0u);
+}
+
+TEST_F(CurveLearnerTest, OldEvidenceFades) {
+	HeatingCurveLearner learner;
+	for (int i = 0; i < 48; ++i) {
+		runWindow(learner, 0, 5000, 1.0);
+	}
+	EXPECT_FLOAT_EQ(learner.getState().points[4].weight, HeatingCurveLearner::maxWeight);
+	for (int i = 0; i < 48; ++i) {
+		runWindow(learner, 0, 4000, 1.0);
+	}
+	EXPECT_NEAR(flowAt(learner, 4), 40, 1.5); // house changed (new windows) - learnt curve follows
+}
+
+TEST_F(CurveLearnerTest, SuggestionExtrapolatesMonotonicAndClamped) {
+	auto point = [](float flow, float weight) { return CurveLearnerState::Point{weight, 0, flow * weight, 0, 0}; };
+	CurveLearnerState state;
+	state.points[3] = point(40, HeatingCurveLearner::trustedWeight); // 5 °C
+	state.points[4] = point(45, HeatingCurveLearner::trustedWeight); // 0 °C
+	state.points[5] = point(50, HeatingCurveLearner::trustedWeight); // -5 °C
+	state.points[0] = point(35, 0.1);                                // 20 °C - noisy, little evidence
+	HeatingCurveLearner learner(state);
+
+	auto suggestion = learner.suggest(steepCurve, 25, 55);
+	EXPECT_TRUE(suggestion.ready);
+	EXPECT_EQ(suggestion.curve[3], 40);
+	EXPECT_EQ(suggestion.curve[4], 45);
+	EXPECT_EQ(suggestion.curve[5], 50);
+	EXPECT_EQ(suggestion.confidence[4], 100);
+	EXPECT_NEAR(suggestion.curve[6], 55, 1);
+	EXPECT_EQ(suggestion.curve[8], 55); // max
+	EXPECT_GE(suggestion.curve[0], 25); // min
+	for (size_t i = 1; i < suggestion.curve.size(); ++i) {
+		EXPECT_GE(suggestion.curve[i], suggestion.curve[i - 1]);
+	}
+}
+
+TEST_F(CurveLearnerTest, SingleRegionShiftsCurrentCurve) {
+	CurveLearnerState state;
+	state.points[4] = CurveLearnerState::Point{HeatingCurveLearner::trustedWeight, 0, 50 * HeatingCurveLearner::trustedWeight, 0, 0}; // current says 60 °C at 0 °C
+	HeatingCurveLearner learner(state);
+
+	auto suggestion = learner.suggest(steepCurve, 20, 90);
+	EXPECT_FALSE(suggestion.ready);
+	EXPECT_EQ(suggestion.curve[4], 50);
+	EXPECT_EQ(suggestion.curve[8], 80);
+	EXPECT_EQ(suggestion.curve[0], 20);
+}
+
+// Room with heat loss to outside, emitters with non-linear output and a thermostat with hysteresis; boiler flow
+// temperature from the heating curve. Outdoor temperature changes over the day.
+struct House {
+	double loss;     // W/K
+	double emitter;  // W/K^exponent
+	double exponent; // 1.0 underfloor, 1.3 radiators
+	double outdoorMean;
+	double outdoorAmplitude;
+
+	static constexpr double massFlow = 400; // W/K
+	static constexpr double capacity = 5e6; // J/K
+	static constexpr double setpoint = 21.0;
+	static constexpr double margin = 0.2;
+
+	double power(double flow, double room) const {
+		double mean = flow;
+		double output = 0;
+		for (int i = 0; i < 8; ++i) { // mean water temperature depends on output
+			output = mean > room ? emitter * std::pow(mean - room, exponent) : 0;
+			mean = flow - output / (2 * massFlow);
+		}
+		return output;
+	}
+
+	// flow temperature holding set point continuously
+	double requiredFlow(double outdoor) const {
+		double needed = loss * (setpoint - outdoor);
+		return setpoint + std::pow(needed / emitter, 1 / exponent) + needed / (2 * massFlow);
+	}
+
+	double outdoorAt(std::chrono::seconds time) const {
+		return outdoorMean + outdoorAmplitude * std::sin(2 * M_PI * time.count() / 86400.0);
+	}
+};
+
+class CurveLearnerSimulation : public ::testing::Test {
+protected:
+	// runs the house on given curve while learning, returns max room temperature deviation below set point
+	double simulate(House const &house, HeatingCurveLearner &learner, HeatingCurveLearner::Curve_t const &curve, std::chrono::hours duration) {
+		static constexpr auto step = 30s;
+		heating::GainRateEstimator gain;
+		double lowest = 0;
+		for (auto end = elapsed_ + duration; elapsed_ < end; elapsed_ += step) {
+			auto now = clock_t_::time_point{} + elapsed_;
+			double outdoor = house.outdoorAt(elapsed_);
+			auto measured = static_cast<int16_t>(room_ * 100);
+			if (room_ < House::setpoint - House::margin) {
+				heating_ = true;
+			} else if (room_ >= House::setpoint + House::margin) {
+				heating_ = false;
+			}
+
+			auto flow = heating::calcHeatingTemperature(static_cast<int16_t>(outdoor * 100), curve);
+			double power = 0;
+			if (heating_) {
+				gain.add(measured, now);
+				power = house.power(flow / 100.0, room_);
+			} else {
+				gain.reset();
+			}
+			auto observation = ::observation(static_cast<int16_t>(outdoor * 100), heating_);
+			if (heating_) {
+				observation.flowTemperature = flow;
+				observation.gainRate = gain.get();
+				observation.roomTemperature = measured;
+				observation.roomSet = static_cast<int16_t>(House::setpoint * 100);
+			}
+			learner.add(observation, now);
+
+			room_ += (power - house.loss * (room_ - outdoor)) * std::chrono::seconds(step).count() / House::capacity;
+			lowest = std::min(lowest, room_ - House::setpoint);
+		}
+		return lowest;
+	}
+
+	// learns for a few days, applies suggestion, repeats
+	HeatingCurveLearner::Curve_t tune(House const &house, HeatingCurveLearner::Curve_t curve, int rounds) {
+		HeatingCurveLearner learner;
+		for (int round = 0; round < rounds; ++round) {
+			simulate(house, learner, curve, 96h);
+			auto suggestion = learner.suggest(curve, 20, 90);
+			if (suggestion.ready) {
+				curve = suggestion.curve;
+			}
+		}
+		lastState_ = learner.getState();
+		return curve;
+	}
+
+	// max error at curve points the weather reached
+	double error(House const &house, HeatingCurveLearner::Curve_t const &curve) const {
+		double worst = 0;
+		for (size_t i = 0; i < curve.size(); ++i) {
+			if (lastState_.points[i].weight >= HeatingCurveLearner::trustedWeight) {
+				worst = std::max(worst, std::abs(curve[i] - house.requiredFlow(HeatingCurveLearner::outdoorAxis[i])));
+			}
+		}
+		return worst;
+	}
+
+	size_t trustedPoints() const {
+		return std::count_if(lastState_.points.begin(), lastState_.points.end(), [](auto const &point) { return point.weight >= HeatingCurveLearner::trustedWeight; });
+	}
+
+	std::chrono::seconds elapsed_{3600};
+	double room_ = House::setpoint;
+	bool heating_ = false;
+	CurveLearnerState lastState_;
+};
+
+TEST_F(CurveLearnerSimulation, UnderfloorHouseFromSteepCurve) {
+	House house{150, 450, 1.0, 2.0, 6.0};
+	auto curve = tune(house, steepCurve, 3);
+
+	EXPECT_GE(trustedPoints(), 2u);
+	EXPECT_LE(error(house, curve), 1.5);
+	EXPECT_LT(curve[4], steepCurve[4] - 20); // flow at 0 °C lowered a lot
+}
+
+TEST_F(CurveLearnerSimulation, RadiatorHouseFromSteepCurve) {
+	House house{280, 120, 1.3, -8.0, 5.0};
+	auto curve = tune(house, steepCurve, 3);
+
+	EXPECT_GE(trustedPoints(), 2u);
+	EXPECT_LE(error(house, curve), 1.5);
+}
+
+TEST_F(CurveLearnerSimulation, RadiatorHouseFromTooLowCurve) {
+	House house{280, 120, 1.3, -8.0, 5.0};
+	HeatingCurveLearner::Curve_t const lowCurve{25, 28, 31, 34, 37, 40, 43, 46, 49}; // rooms never reach set point
+	auto curve = tune(house, lowCurve, 5);
+
+	EXPECT_GE(trustedPoints(), 2u);
+	EXPECT_LE(error(house, curve), 2.0);
+
+	HeatingCurveLearner learner(lastState_);
+	EXPECT_GT(simulate(house, learner, curve, 48h), -0.4); // comfort with the learnt curve
+}
+
+} // anonymous namespace
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "DeviceTable.h"
+
+#include <set>
+
+namespace {
+
+using namespace std::chrono_literals;
+using Table = heating::DeviceTable<16>;
+
+heating::BleAddress_t address(uint32_t id) {
+	return {0xa4, 0xc1, static_cast<uint8_t>(id >> 24), static_cast<uint8_t>(id >> 16), static_cast<uint8_t>(id >> 8), static_cast<uint8_t>(id)};
+}
+
+class DeviceTableTest : public ::testing::Test {
+protected:
+	Table table;
+	Table::clock_t::time_point now = Table::clock_t::now();
+};
+
+TEST_F(DeviceTableTest, Empty) {
+	EXPECT_EQ(table.size(), 0u);
+	EXPECT_EQ(table.find(address(1)), nullptr);
+}
+
+TEST_F(DeviceTableTest, SeenUpdatesExistingDevice) {
+	table.seen(address(1), -70, now);
+	table.seen(address(1), -60, now + 1s);
+
+	ASSERT_EQ(table.size(), 1u);
+	auto device = table.find(address(1));
+	ASSERT_NE(device, nullptr);
+	EXPECT_EQ(device->rssi, -60);
+	EXPECT_EQ(device->advertisements, 2u);
+	EXPECT_EQ(device->lastSeen, now + 1s);
+}
+
+TEST_F(DeviceTableTest, EvictsLeastRecentlySeen) {
+	for (uint32_t id = 0; id < Table::maxDevices; ++id) {
+		table.seen(address(id), -50, now + std::chrono::seconds(id));
+	}
+	table.seen(address(0), -50, now + 100s); // refresh the oldest one
+
+	table.seen(address(1000), -50, now + 101s);
+
+	EXPECT_EQ(table.size(), Table::maxDevices);
+	EXPECT_EQ(table.getEvictions(), 1u);
+	EXPECT_NE(table.find(address(0)), nullptr);
+	EXPECT_EQ(table.find(address(1)), nullptr); // least recently seen
+	EXPECT_NE(table.find(address(1000)), nullptr);
+}
+
+TEST_F(DeviceTableTest, BoundedUnderManyForeignDevices) {
+	for (uint32_t id = 0; id < 5000; ++id) {
+		table.seen(address(id * 7919), static_cast<int8_t>(-(id % 90)), now + std::chrono::milliseconds(id));
+	}
+	EXPECT_EQ(table.size(), Table::maxDevices);
+
+	// most recent devices are all present and every stored device is reachable after many deletions
+	for (uint32_t id = 5000 - Table::maxDevices; id < 5000; ++id) {
+		EXPECT_NE(table.find(address(id * 7919)), nullptr) << id;
+	}
+
+	std::set<heating::BleAddress_t> stored;
+	table.forEach([&](auto const &device) {
+		EXPECT_EQ(table.find(device.address), &device);
+		stored.insert(device.address);
+	});
+	EXPECT_EQ(stored.size(), Table::maxDevices);
+}
+
+TEST_F(DeviceTableTest, SampleIntervalIsSmoothed) {
+	table.seen(address(1), -70, now);
+	table.seen(address(1), -70, now + 10s);
+	EXPECT_EQ(table.find(address(1))->intervalMs, 10000u);
+
+	table.seen(address(1), -70, now + 28s); // 18s interval
+	EXPECT_EQ(table.find(address(1))->intervalMs, 11000u);
+}
+
+TEST_F(DeviceTableTest, CounterGapsCountedAsLost) {
+	table.seen(address(1), -70, now, 250);
+	table.seen(address(1), -70, now + 1s, 251);
+	table.seen(address(1), -70, now + 2s, 251); // repeated frame
+	table.seen(address(1), -70, now + 3s, 2);   // wraps, 252..1 lost
+	EXPECT_EQ(table.find(address(1))->lost, 6u);
+
+	table.seen(address(1), -70, now + 4000s, 150); // restarted or out of range - not counted
+	EXPECT_EQ(table.find(address(1))->lost, 6u);
+}
+
+} // anonymous namespace
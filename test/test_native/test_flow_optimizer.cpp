@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include "FlowTemperatureOptimizer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+using namespace std::chrono_literals;
+using heating::FlowOptimizerConfig;
+using heating::FlowOptimizerState;
+using heating::FlowTemperatureOptimizer;
+using heating::GainRateEstimator;
+using clock_t_ = FlowTemperatureOptimizer::clock_t;
+
+TEST(GainRateEstimatorTest, LinearRamp) {
+	GainRateEstimator estimator(5min);
+	auto start = clock_t_::time_point{} + 1h;
+	EXPECT_FALSE(estimator.get().has_value());
+
+	for (int minute = 0; minute <= 60; ++minute) {
+		estimator.add(static_cast<int16_t>(2000 + minute * 100 / 60), start + std::chrono::minutes(minute)); // 1 °C per hour
+	}
+	ASSERT_TRUE(estimator.get().has_value());
+	EXPECT_NEAR(*estimator.get(), 100, 3);
+
+	estimator.reset();
+	EXPECT_FALSE(estimator.get().has_value());
+	estimator.add(2100, start);
+	estimator.add(2050, start + 5min);
+	EXPECT_EQ(estimator.get(), -600);
+}
+
+TEST(FlowOptimizerTest, DisabledKeepsCurve) {
+	FlowTemperatureOptimizer optimizer(FlowOptimizerConfig{}, FlowOptimizerState{500, 1200});
+	EXPECT_EQ(optimizer.apply(5000), 5000);
+	EXPECT_FALSE(optimizer.update({3, 3, -100, std::nullopt, std::nullopt}, 5000, clock_t_::now()));
+}
+
+class FlowOptimizerUnitTest : public ::testing::Test {
+protected:
+	FlowOptimizerConfig config = [] {
+		FlowOptimizerConfig c;
+		c.enabled = true;
+		return c;
+	}();
+	clock_t_::time_point now = clock_t_::time_point{} + 10h;
+};
+
+TEST_F(FlowOptimizerUnitTest, ApplyOffsetAndSlope) {
+	FlowTemperatureOptimizer optimizer(config, FlowOptimizerState{-200, 1100});
+	EXPECT_EQ(optimizer.apply(6000), 2000 + 4400 - 200);
+	EXPECT_EQ(optimizer.apply(2000), 1800);
+
+	auto learnt = optimizer.getLearntCurve(std::array<uint8_t, 9>{30, 30, 37, 46, 55, 63, 72, 75, 75});
+	EXPECT_EQ(learnt[0], 29); // 20 + 10 * 1.1 - 2
+	EXPECT_EQ(learnt[8], 79); // 20 + 55 * 1.1 - 2, rounded
+}
+
+TEST_F(FlowOptimizerUnitTest, StateIsClamped) {
+	FlowTemperatureOptimizer optimizer(config, FlowOptimizerState{5000, 3000});
+	EXPECT_EQ(optimizer.getState().offset, config.maxOffset);
+	EXPECT_EQ(optimizer.getState().slope, config.maxSlope);
+}
+
+TEST_F(FlowOptimizerUnitTest, RateLimitedByIntervalAndStep) {
+	FlowTemperatureOptimizer optimizer(config); // mild weather - all of the correction goes to the offset
+	EXPECT_TRUE(optimizer.update({1, 1, -500, std::nullopt, std::nullopt}, 2800, now));
+	EXPECT_EQ(optimizer.apply(2800), 2800 + config.maxStep); // large shortfall, one step only
+
+	EXPECT_FALSE(optimizer.update({1, 1, -500, std::nullopt, std::nullopt}, 2800, now + 1min));
+	EXPECT_TRUE(optimizer.update({1, 1, -500, std::nullopt, std::nullopt}, 2800, now + config.updateInterval));
+	EXPECT_EQ(optimizer.apply(2800), 2800 + 2 * config.maxStep);
+}
+
+TEST_F(FlowOptimizerUnitTest, SingleColdRoomRaisesLess) {
+	FlowTemperatureOptimizer all(config), single(config);
+	all.update({8, 8, 30, std::nullopt, std::nullopt}, 2800, now);
+	single.update({8, 1, 30, std::nullopt, std::nullopt}, 2800, now);
+	EXPECT_EQ(all.apply(2800), 2840);
+	EXPECT_EQ(single.apply(2800), 2810);
+}
+
+TEST_F(FlowOptimizerUnitTest, ReturnTemperatureLowersWhenRoomsSatisfied) {
+	FlowTemperatureOptimizer optimizer(config);
+	optimizer.update({2, 2, 50, 7000, 6000}, 7000, now); // gain on target, return too hot to condense
+	EXPECT_LT(optimizer.apply(7000), 7000);
+
+	FlowTemperatureOptimizer small(config);
+	small.update({2, 2, 50, 4500, 4200}, 4500, now); // emitters take little heat
+	EXPECT_LT(small.apply(4500), 4500);
+
+	FlowTemperatureOptimizer cold(config);
+	cold.update({2, 2, 0, 7000, 6000}, 7000, now); // rooms too slow - return doesn't matter
+	EXPECT_GT(cold.apply(7000), 7000);
+}
+
+TEST_F(FlowOptimizerUnitTest, ColdWeatherCorrectsSlope) {
+	FlowTemperatureOptimizer optimizer(config);
+	optimizer.update({1, 1, 500, std::nullopt, std::nullopt}, 6000, now); // gaining far too fast
+	EXPECT_EQ(optimizer.getState().offset, -50);
+	EXPECT_EQ(optimizer.getState().slope, 1000 - 12);
+	EXPECT_EQ(optimizer.apply(2000), 1950); // mild end of the curve moves by offset only
+	EXPECT_NEAR(optimizer.apply(6000), 6000 - config.maxStep, 2);
+}
+
+TEST_F(FlowOptimizerUnitTest, NoDemandNoLearning) {
+	FlowTemperatureOptimizer optimizer(config);
+	EXPECT_FALSE(optimizer.update({3, 0, 0, 7000, 6000}, 5000, now));
+	EXPECT_EQ(optimizer.apply(5000), 5000);
+}
+
+// Single zone house: heat loss to outside, radiators with flow dependent output, thermostat with hysteresis.
+// Optimizer runs as it does in the controller - fed with gain rate of the demanding room and flow/return temperatures.
+class HouseSimulation {
+public:
+	struct Result {
+		int16_t finalFlow;         // flow temperature applied at the end, 1/100 °C
+		double minTemperature;     // over the last day, °C
+		double maxTemperature;
+		int16_t maxFlowChange;     // largest change between optimizer updates, 1/100 °C
+	};
+
+	HouseSimulation(FlowOptimizerConfig const &config, double outdoor, int16_t curveTemperature) : optimizer_(config), outdoor_(outdoor), curve_(curveTemperature) {}
+
+	Result run(std::chrono::hours duration) {
+		auto start = clock_t_::time_point{} + 1h;
+		auto end = start + duration;
+		Result result{0, 100.0, -100.0, 0};
+		int16_t lastFlow = optimizer_.apply(curve_);
+
+		for (auto now = start; now < end; now += 1min) {
+			int16_t measured = static_cast<int16_t>(room_ * 100);
+			if (measured < setpoint - margin) {
+				heating_ = true;
+			} else if (measured >= setpoint + margin) {
+				heating_ = false;
+			}
+
+			double flow = optimizer_.apply(curve_) / 100.0;
+			double power = 0;
+			double returnTemperature = flow;
+			if (heating_) {
+				gain_.add(measured, now);
+				power = std::max(0.0, radiator * (flow - room_) / (1 + radiator / (2 * massFlow)));
+				returnTemperature = flow - power / massFlow;
+
+				FlowTemperatureOptimizer::Feedback feedback{1, 1, gain_.get(), static_cast<int16_t>(flow * 100), static_cast<int16_t>(returnTemperature * 100)};
+				if (optimizer_.update(feedback, curve_, now)) {
+					int16_t applied = optimizer_.apply(curve_);
+					result.maxFlowChange = std::max<int16_t>(result.maxFlowChange, static_cast<int16_t>(std::abs(applied - lastFlow)));
+					lastFlow = applied;
+				}
+			} else {
+				gain_.reset();
+			}
+
+			room_ += (power - loss * (room_ - outdoor_)) * 60 / capacity;
+			if (now >= end - 24h) {
+				result.minTemperature = std::min(result.minTemperature, room_);
+				result.maxTemperature = std::max(result.maxTemperature, room_);
+			}
+		}
+		result.finalFlow = optimizer_.apply(curve_);
+		return result;
+	}
+
+	static constexpr int16_t setpoint = 2100;
+	static constexpr int16_t margin = 20;
+
+private:
+	static constexpr double loss = 200;      // W/K
+	static constexpr double radiator = 210;  // W/K
+	static constexpr double massFlow = 400;  // W/K - water flow times heat capacity
+	static constexpr double capacity = 5e6;  // J/K
+
+	FlowTemperatureOptimizer optimizer_;
+	GainRateEstimator gain_;
+	double outdoor_;
+	int16_t curve_;
+	double room_ = 20.5;
+	bool heating_ = false;
+};
+
+TEST_F(FlowOptimizerUnitTest, SimulationLowersOverheatedCurve) {
+	HouseSimulation house(config, 0.0, 6500); // steady state needs about 46 °C flow at 0 °C outside
+	auto result = house.run(96h);
+
+	EXPECT_LT(result.finalFlow, 5600);
+	EXPECT_GT(result.finalFlow, 4600);
+	EXPECT_GE(result.minTemperature, (HouseSimulation::setpoint - HouseSimulation::margin) / 100.0 - 0.1); // comfort kept
+	EXPECT_LE(result.maxFlowChange, config.maxStep);
+}
+
+TEST_F(FlowOptimizerUnitTest, SimulationRaisesTooColdCurve) {
+	HouseSimulation house(config, 0.0, 4200); // room can't reach set point with this curve
+	auto result = house.run(96h);
+
+	EXPECT_GT(result.finalFlow, 4700);
+	EXPECT_GE(result.maxTemperature, (HouseSimulation::setpoint + HouseSimulation::margin) / 100.0 - 0.05); // reaches set point again
+	EXPECT_LE(result.maxFlowChange, config.maxStep);
+}
+
+TEST_F(FlowOptimizerUnitTest, SimulationColdWeatherLearnsSlope) {
+	HouseSimulation house(config, -15.0, 7500);
+	auto result = house.run(96h);
+
+	EXPECT_LT(result.finalFlow, 7500);
+	EXPECT_GE(result.minTemperature, (HouseSimulation::setpoint - HouseSimulation::margin) / 100.0 - 0.1);
+}
+
+} // anonymous namespace
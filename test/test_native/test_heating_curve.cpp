@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include "HeatingCurve.h"
 
+#include <chrono>
+#include <cstdlib>
+
 class HeatingCurveTest : public ::testing::Test {
 protected:
 	// Example curve: at 20°C→20, 15°C→25, 10°C→30, 5°C→35, 0°C→45, -5°C→55, -10°C→65, -15°C→75, -20°C→80
@@ -51,3 +54,123 @@ TEST_F(HeatingCurveTest, FlatCurve) {
 	EXPECT_EQ(heating::calcHeatingTemperature(0, flat), 4000);
 	EXPECT_EQ(heating::calcHeatingTemperature(-1500, flat), 4000);
 }
+
+namespace {
+
+// float interpolation for any axis - same arithmetic as calcHeatingTemperature
+template <size_t Points>
+int16_t referenceTemperature(int16_t outdoor, std::array<int8_t, Points> const &axis, std::array<uint8_t, Points> const &curve) {
+	for (size_t idx = 0; idx < Points; ++idx) {
+		if (axis[idx] * 100 <= outdoor) {
+			if (idx == 0) {
+				return curve[idx] * 100;
+			}
+			float slope = static_cast<float>(curve[idx] - curve[idx - 1]) / static_cast<float>(axis[idx] - axis[idx - 1]);
+			float intercept = curve[idx - 1] * 100 - (slope * axis[idx - 1] * 100);
+			return static_cast<int16_t>(slope * outdoor + intercept);
+		}
+	}
+	return curve[Points - 1] * 100;
+}
+
+// xorshift - deterministic curves for property tests
+struct Random {
+	uint32_t state = 2463534242u;
+	uint32_t operator()(uint32_t range) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state % range;
+	}
+};
+
+template <size_t Points>
+std::array<uint8_t, Points> randomCurve(Random &random) {
+	std::array<uint8_t, Points> curve;
+	for (auto &point : curve) {
+		point = static_cast<uint8_t>(random(91)); // any shape, not only monotonic
+	}
+	return curve;
+}
+
+} // anonymous namespace
+
+TEST_F(HeatingCurveTest, CompiledExactValues) {
+	auto compiled = heating::compileHeatingCurve(curve);
+	for (int16_t outdoor : {3500, 2500, 2000, 1750, 1500, 1000, 570, 500, 0, -250, -500, -1000, -1500, -2000, -2500, -3000}) {
+		EXPECT_EQ(compiled(outdoor), heating::calcHeatingTemperature(outdoor, curve)) << "outdoor " << outdoor;
+	}
+	EXPECT_EQ(compiled.getCurve(), curve);
+}
+
+TEST_F(HeatingCurveTest, CompiledExtremeInputs) {
+	std::array<uint8_t, 9> steep = {{0, 0, 0, 0, 0, 0, 0, 0, 255}};
+	auto compiled = heating::compileHeatingCurve(steep);
+	EXPECT_EQ(compiled(INT16_MAX), 0);
+	EXPECT_EQ(compiled(INT16_MIN), 25500);
+	EXPECT_EQ(compiled(-1750), 12750);
+}
+
+// every outdoor temperature in 0.01 °C steps, random curves - compiled curve matches float within 0.01 °C
+TEST_F(HeatingCurveTest, CompiledMatchesFloatProperty) {
+	Random random;
+	for (int round = 0; round < 200; ++round) {
+		auto randomPoints = randomCurve<9>(random);
+		auto compiled = heating::compileHeatingCurve(randomPoints);
+		for (int32_t outdoor = -3000; outdoor <= 3000; ++outdoor) {
+			auto expected = heating::calcHeatingTemperature(static_cast<int16_t>(outdoor), randomPoints);
+			auto actual = compiled(static_cast<int16_t>(outdoor));
+			ASSERT_LE(std::abs(actual - expected), 1) << "round " << round << " outdoor " << outdoor;
+		}
+	}
+}
+
+TEST_F(HeatingCurveTest, CompiledCustomAxes) {
+	Random random;
+	std::array<int8_t, 5> uneven{{18, 12, 0, -3, -25}};
+	std::array<int8_t, 3> wide{{100, 0, -100}};
+	std::array<int8_t, 17> dense{{16, 14, 12, 10, 8, 6, 4, 2, 0, -2, -4, -6, -8, -10, -12, -14, -16}};
+	for (int round = 0; round < 50; ++round) {
+		auto unevenCurve = randomCurve<5>(random);
+		auto wideCurve = randomCurve<3>(random);
+		auto denseCurve = randomCurve<17>(random);
+		heating::CompiledHeatingCurve<5> compiledUneven(unevenCurve, uneven);
+		heating::CompiledHeatingCurve<3> compiledWide(wideCurve, wide);
+		heating::CompiledHeatingCurve<17> compiledDense(denseCurve, dense);
+		for (int32_t outdoor = -12000; outdoor <= 12000; outdoor += 7) {
+			auto x = static_cast<int16_t>(outdoor);
+			ASSERT_LE(std::abs(compiledUneven(x) - referenceTemperature(x, uneven, unevenCurve)), 1) << "outdoor " << outdoor;
+			ASSERT_LE(std::abs(compiledWide(x) - referenceTemperature(x, wide, wideCurve)), 1) << "outdoor " << outdoor;
+			ASSERT_LE(std::abs(compiledDense(x) - referenceTemperature(x, dense, denseCurve)), 1) << "outdoor " << outdoor;
+		}
+	}
+}
+
+TEST_F(HeatingCurveTest, CompiledRejectsUnorderedAxis) {
+	std::array<uint8_t, 3> points{{30, 40, 50}};
+	EXPECT_THROW((heating::CompiledHeatingCurve<3>(points, {{10, 10, 0}})), std::invalid_argument);
+	EXPECT_THROW((heating::CompiledHeatingCurve<3>(points, {{-10, 0, 10}})), std::invalid_argument);
+}
+
+TEST_F(HeatingCurveTest, BenchmarkCompiledVsFloat) {
+	auto compiled = heating::compileHeatingCurve(curve);
+	int64_t sumFloat = 0, sumCompiled = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int repeat = 0; repeat < 20; ++repeat) {
+		for (int32_t outdoor = -3000; outdoor <= 3000; ++outdoor) {
+			sumFloat += heating::calcHeatingTemperature(static_cast<int16_t>(outdoor), curve);
+		}
+	}
+	auto middle = std::chrono::steady_clock::now();
+	for (int repeat = 0; repeat < 20; ++repeat) {
+		for (int32_t outdoor = -3000; outdoor <= 3000; ++outdoor) {
+			sumCompiled += compiled(static_cast<int16_t>(outdoor));
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	auto evaluations = 20 * 6001;
+	RecordProperty("evaluations", evaluations);
+	RecordProperty("floatNs", static_cast<int>(std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count()));
+	RecordProperty("compiledNs", static_cast<int>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count()));
+	EXPECT_NEAR(static_cast<double>(sumCompiled), static_cast<double>(sumFloat), evaluations);
+}
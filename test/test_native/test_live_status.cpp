@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "LiveStatus.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using heating::LiveStatus;
+using namespace std::chrono_literals;
+
+class LiveStatusTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		cache.setSections({
+			{"room/0", [this](std::ostream &ss) { renders++; ss << "{\"temperature\": " << room0 << "}"; }},
+			{"room/1", [this](std::ostream &ss) { renders++; ss << "{\"temperature\": " << room1 << "}"; }},
+			{"boiler", [this](std::ostream &ss) { renders++; ss << "{\"boiler\": " << (boiler ? "true" : "false") << "}"; }},
+			{"loop", [this](std::ostream &ss) { ss << loops; }}, // not sent to viewers
+		});
+	}
+
+	std::vector<LiveStatus::Event> eventsSince(uint32_t id) {
+		std::vector<LiveStatus::Event> events;
+		EXPECT_TRUE(live.getEventsSince(id, events));
+		return events;
+	}
+
+	heating::StatusCache cache;
+	LiveStatus live{cache, {"room/", "boiler"}, 7, {4, 200, 1000ms}};
+	LiveStatus::clock_t::time_point now = LiveStatus::clock_t::time_point{} + 1h;
+	int room0 = 2100;
+	int room1 = 1900;
+	bool boiler = false;
+	int loops = 0;
+	int renders = 0;
+};
+
+TEST_F(LiveStatusTest, NothingRenderedWithoutViewers) {
+	cache.markDirty("");
+	EXPECT_FALSE(live.publish(now));
+	EXPECT_EQ(renders, 0);
+}
+
+TEST_F(LiveStatusTest, SnapshotThenOnlyChangedSections) {
+	live.addViewer();
+	auto ticket = live.requestSnapshot();
+	EXPECT_FALSE(live.getSnapshot(ticket));
+
+	live.publish(now);
+	auto snapshot = live.getSnapshot(ticket);
+	ASSERT_TRUE(snapshot);
+	EXPECT_EQ(snapshot->data, R"({"room/0": {"temperature": 2100}, "room/1": {"temperature": 1900}, "boiler": {"boiler": false}})");
+	EXPECT_EQ(renders, 3);
+
+	// a sample for room 1 - both rooms re-rendered, only the changed one sent
+	room1 = 1950;
+	cache.markDirty("room/");
+	EXPECT_TRUE(live.publish(now += 1s));
+	auto events = eventsSince(snapshot->id);
+	ASSERT_EQ(events.size(), 1u);
+	EXPECT_EQ(events[0].data, R"({"room/1": {"temperature": 1950}})");
+	EXPECT_EQ(renders, 5);
+
+	// dirty but unchanged - no event
+	cache.markDirty("boiler");
+	EXPECT_FALSE(live.publish(now += 1s));
+	EXPECT_TRUE(eventsSince(events[0].id).empty());
+
+	// changed but not for viewers - no event
+	loops++;
+	cache.markDirty("loop");
+	EXPECT_FALSE(live.publish(now += 1s));
+	EXPECT_TRUE(eventsSince(events[0].id).empty());
+
+	// clean sections aren't rendered at all
+	EXPECT_FALSE(live.publish(now += 1s));
+	EXPECT_EQ(renders, 6);
+}
+
+TEST_F(LiveStatusTest, ChangesWithinIntervalCoalesced) {
+	live.addViewer();
+	auto ticket = live.requestSnapshot();
+	live.publish(now);
+	auto snapshot = live.getSnapshot(ticket)->id;
+
+	boiler = true;
+	cache.markDirty("boiler");
+	EXPECT_FALSE(live.publish(now += 200ms)); // within the interval since the snapshot
+	room0 = 2050;
+	cache.markDirty("room/0");
+	EXPECT_TRUE(live.publish(now += 800ms));
+
+	auto events = eventsSince(snapshot);
+	ASSERT_EQ(events.size(), 1u);
+	EXPECT_EQ(events[0].data, R"({"room/0": {"temperature": 2050}, "boiler": {"boiler": true}})");
+}
+
+TEST_F(LiveStatusTest, ViewerBehindRingNeedsSnapshot) {
+	live.addViewer();
+	auto ticket = live.requestSnapshot();
+	live.publish(now);
+	auto behind = live.getSnapshot(ticket)->id;
+
+	for (int i = 0; i < 10; ++i) {
+		room0 += 10;
+		cache.markDirty("room/0");
+		ASSERT_TRUE(live.publish(now += 1s));
+	}
+
+	std::vector<LiveStatus::Event> events;
+	EXPECT_FALSE(live.getEventsSince(behind, events)); // ring keeps 4 events
+	EXPECT_TRUE(live.getEventsSince(behind + 6, events));
+	EXPECT_EQ(events.size(), 4u);
+
+	std::stringstream ss;
+	live.getStatus(ss);
+	EXPECT_EQ(ss.str(), R"({"viewers": 1, "lastId": 11, "deltas": 10, "snapshots": 1, "events": 4, "bytes": 132})");
+}
+
+TEST_F(LiveStatusTest, RingBoundedByBytes) {
+	live.addViewer();
+	live.requestSnapshot();
+	live.publish(now);
+
+	for (int i = 0; i < 3; ++i) {
+		room0 += 10;
+		room1 += 10;
+		boiler = !boiler;
+		cache.markDirty("");
+		ASSERT_TRUE(live.publish(now += 1s));
+	}
+	std::vector<LiveStatus::Event> events;
+	EXPECT_FALSE(live.getEventsSince(live.getSnapshot(1)->id, events));
+	EXPECT_TRUE(live.getEventsSince(live.getSnapshot(1)->id + 1, events));
+	EXPECT_EQ(events.size(), 2u); // 3 events of about 95 bytes are over the 200 bytes limit
+}
+
+TEST_F(LiveStatusTest, UnknownIdOrNewSectionsRestartFromSnapshot) {
+	live.addViewer();
+	live.requestSnapshot();
+	live.publish(now);
+
+	std::vector<LiveStatus::Event> events;
+	EXPECT_FALSE(live.getEventsSince(1000, events)); // id from before a reboot
+
+	auto id = live.getSnapshot(1)->id;
+	EXPECT_TRUE(live.getEventsSince(id, events));
+	cache.setSections({{"boiler", [](std::ostream &ss) { ss << "{}"; }}});
+	live.publish(now += 1s);
+	EXPECT_FALSE(live.getEventsSince(id, events));
+
+	auto ticket = live.requestSnapshot();
+	live.publish(now += 1s);
+	EXPECT_EQ(live.getSnapshot(ticket)->data, R"({"boiler": {}})");
+	EXPECT_EQ(live.getEpoch(), 7u);
+}
+
+} // anonymous namespace
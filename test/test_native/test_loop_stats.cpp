@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "ControllerJobs.h"
+#include "LoopStats.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+using heating::ControllerJobs;
+using heating::LoopStats;
+using namespace std::chrono_literals;
+
+TEST(LoopStatsTest, MeasuresPeriodBetweenIterations) {
+	LoopStats stats;
+	auto now = LoopStats::clock_t::time_point{} + 1h;
+	stats.tick(now);
+	EXPECT_EQ(stats.getIterations(), 0u); // period starts with the second one
+
+	stats.tick(now += 500us);
+	stats.tick(now += 3ms);
+	stats.tick(now += 3ms);
+	stats.tick(now += 1500ms); // e.g. a slow client served on the loop
+	stats.tick(now += 5s);
+
+	EXPECT_EQ(stats.getIterations(), 5u);
+	EXPECT_EQ(stats.getMaxUs(), 5000000u);
+	EXPECT_EQ(stats.getMeanUs(), (500 + 3000 + 3000 + 1500000 + 5000000) / 5);
+	EXPECT_EQ(stats.getBucket(0), 1u);
+	EXPECT_EQ(stats.getBucket(1), 2u);
+	EXPECT_EQ(stats.getBucket(5), 1u);
+	EXPECT_EQ(stats.getBucket(6), 1u);
+
+	std::stringstream ss;
+	stats.getStatus(ss);
+	EXPECT_EQ(ss.str(), R"({"iterations": 5, "meanUs": 1301300, "maxUs": 5000000, "histogramMs": {"<1": 1, "<5": 2, "<20": 0, "<100": 0, "<500": 0, "<2000": 1, ">=2000": 1}})");
+}
+
+TEST(LoopStatsTest, BucketBoundsAreExclusive) {
+	LoopStats stats;
+	auto now = LoopStats::clock_t::time_point{} + 1h;
+	stats.tick(now);
+	stats.tick(now += 1ms);
+	EXPECT_EQ(stats.getBucket(1), 1u);
+}
+
+// A client downloading a 190 kB asset at ~1.4 MB/s, served by a blocking write like WebServer does. Served on the loop
+// (before) every iteration waits for it, served by its own thread (after) the loop keeps its period.
+class SlowDownload {
+public:
+	SlowDownload() {
+		socketpair(AF_UNIX, SOCK_STREAM, 0, sockets_);
+		int buffer = 4096;
+		setsockopt(sockets_[0], SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+		reader_ = std::thread([this] {
+			char chunk[1436];
+			while (read(sockets_[1], chunk, sizeof(chunk)) > 0) {
+				std::this_thread::sleep_for(1ms);
+			}
+		});
+	}
+
+	~SlowDownload() {
+		close(sockets_[0]);
+		reader_.join();
+		close(sockets_[1]);
+	}
+
+	void serve() {
+		std::string body(190 * 1024, 'x');
+		for (size_t sent = 0; sent < body.size();) {
+			auto written = write(sockets_[0], body.data() + sent, body.size() - sent);
+			if (written <= 0) {
+				break;
+			}
+			sent += static_cast<size_t>(written);
+		}
+	}
+
+private:
+	int sockets_[2];
+	std::thread reader_;
+};
+
+// one controller loop iteration - queued calls and ~1 ms of control work
+void iterate(LoopStats &stats, ControllerJobs &jobs) {
+	stats.tick(LoopStats::clock_t::now());
+	jobs.execute();
+	std::this_thread::sleep_for(1ms);
+}
+
+TEST(LoopStatsTest, DownloadServedOffTheLoopKeepsPeriod) {
+	constexpr auto duration = 400ms;
+
+	LoopStats before;
+	{
+		ControllerJobs jobs;
+		SlowDownload download;
+		auto end = LoopStats::clock_t::now() + duration;
+		bool served = false;
+		while (LoopStats::clock_t::now() < end) {
+			iterate(before, jobs);
+			if (!served) {
+				download.serve(); // handleClient() on the loop
+				served = true;
+			}
+		}
+	}
+
+	LoopStats after;
+	{
+		ControllerJobs jobs;
+		SlowDownload download;
+		std::thread server([&] {
+			download.serve();
+			int value = 0;
+			jobs.run([&] { value = 1; }, 3000ms); // status rendered on the controller task
+			EXPECT_EQ(value, 1);
+		});
+		auto end = LoopStats::clock_t::now() + duration;
+		while (LoopStats::clock_t::now() < end) {
+			iterate(after, jobs);
+		}
+		server.join();
+	}
+
+	RecordProperty("beforeIterations", before.getIterations());
+	RecordProperty("beforeMaxUs", before.getMaxUs());
+	RecordProperty("beforeMeanUs", before.getMeanUs());
+	RecordProperty("afterIterations", after.getIterations());
+	RecordProperty("afterMaxUs", after.getMaxUs());
+	RecordProperty("afterMeanUs", after.getMeanUs());
+	EXPECT_GT(before.getMaxUs(), 100000u);
+	EXPECT_LT(after.getMaxUs(), before.getMaxUs() / 4);
+	EXPECT_GT(after.getIterations(), before.getIterations());
+}
+
+} // anonymous namespace
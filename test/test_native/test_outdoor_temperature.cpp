@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include "OutdoorTemperature.h"
+
+#include <sstream>
+
+namespace {
+
+using heating::OutdoorPayloadParser;
+using heating::OutdoorTemperature;
+using heating::OutdoorTemperatureConfig;
+using source_t = OutdoorTemperature::source_t;
+using namespace std::chrono_literals;
+
+class OutdoorTemperatureTest : public ::testing::Test {
+protected:
+	static OutdoorTemperatureConfig makeConfig() {
+		OutdoorTemperatureConfig config;
+		config.source[static_cast<size_t>(source_t::ems)] = {true, 100, 600};
+		config.source[static_cast<size_t>(source_t::openweather)] = {true, 40, 3600};
+		config.source[static_cast<size_t>(source_t::mqtt)] = {true, 80, 1800};
+		config.smoothing = 0;
+		return config;
+	}
+
+	OutdoorTemperature::clock_t::time_point start = OutdoorTemperature::clock_t::time_point{} + 24h;
+};
+
+TEST_F(OutdoorTemperatureTest, NoSourceGivesFallback) {
+	OutdoorTemperature outdoor(makeConfig());
+	outdoor.evaluate(start);
+	EXPECT_FALSE(outdoor.get());
+	EXPECT_EQ(outdoor.getTemperature(), -2000);
+}
+
+TEST_F(OutdoorTemperatureTest, PreferredSourceUsedAlone) {
+	OutdoorTemperature outdoor(makeConfig());
+	outdoor.update(source_t::ems, {500, start});
+	outdoor.update(source_t::openweather, {100, start});
+	outdoor.evaluate(start);
+	EXPECT_EQ(outdoor.get(), 500); // openweather 40 is less than half of ems 100
+}
+
+TEST_F(OutdoorTemperatureTest, SimilarSourcesAveragedByScore) {
+	OutdoorTemperature outdoor(makeConfig());
+	outdoor.update(source_t::ems, {500, start});
+	outdoor.update(source_t::mqtt, {200, start});
+	outdoor.evaluate(start);
+	EXPECT_EQ(outdoor.get(), (500 * 100 + 200 * 80) / 180);
+}
+
+TEST_F(OutdoorTemperatureTest, AgingSourceLosesToFresherOne) {
+	OutdoorTemperature outdoor(makeConfig());
+	outdoor.update(source_t::ems, {500, start});
+	outdoor.update(source_t::openweather, {100, start + 500s});
+	outdoor.evaluate(start + 500s);
+	// ems score 100 * (1 - 500/600) = 16, openweather 40 * (1 - 0) = 40
+	EXPECT_EQ(outdoor.get(), 100);
+
+	outdoor.evaluate(start + 600s);
+	EXPECT_EQ(outdoor.get(), 100); // ems stale
+}
+
+TEST_F(OutdoorTemperatureTest, DisabledSourceIgnored) {
+	auto config = makeConfig();
+	config.source[static_cast<size_t>(source_t::ems)].enabled = false;
+	OutdoorTemperature outdoor(config);
+	outdoor.update(source_t::ems, {500, start});
+	outdoor.evaluate(start);
+	EXPECT_FALSE(outdoor.get());
+	EXPECT_FALSE(outdoor.isEnabled(source_t::ems));
+}
+
+TEST_F(OutdoorTemperatureTest, RepeatedReadingDoesntRefresh) {
+	OutdoorTemperature outdoor(makeConfig());
+	outdoor.update(source_t::ems, {500, start});
+	outdoor.update(source_t::ems, {500, start}); // polled again, same telegram
+	outdoor.evaluate(start + 601s);
+	std::stringstream ss;
+	outdoor.getStatus(ss, start + 601s);
+	EXPECT_NE(ss.str().find("\"ems\": {\"readings\": 1, \"temperature\": 500, \"ageS\": 601, \"score\": 0}"), std::string::npos) << ss.str();
+}
+
+TEST_F(OutdoorTemperatureTest, LastGoodValueHeldThenFallback) {
+	auto config = makeConfig();
+	config.hold = 3600;
+	OutdoorTemperature outdoor(config);
+	outdoor.update(source_t::ems, {-500, start});
+	outdoor.evaluate(start);
+	outdoor.evaluate(start + 599s); // last evaluation with a fresh reading
+
+	outdoor.evaluate(start + 599s + 3599s);
+	EXPECT_EQ(outdoor.get(), -500);
+	EXPECT_TRUE(outdoor.isHeld());
+
+	outdoor.evaluate(start + 599s + 3600s);
+	EXPECT_FALSE(outdoor.get());
+	EXPECT_FALSE(outdoor.isHeld());
+	EXPECT_EQ(outdoor.getTemperature(), -2000);
+}
+
+TEST_F(OutdoorTemperatureTest, SmoothsSourceSwitch) {
+	auto config = makeConfig();
+	config.smoothing = 900;
+	OutdoorTemperature outdoor(config);
+	outdoor.update(source_t::ems, {500, start});
+	outdoor.evaluate(start);
+	EXPECT_EQ(outdoor.get(), 500); // first value taken as is
+
+	// ems goes stale, openweather reports 3 °C less
+	outdoor.update(source_t::openweather, {200, start + 600s});
+	outdoor.evaluate(start + 600s);
+	EXPECT_EQ(outdoor.get(), 500 - 300 * 600 / 1500);
+	for (auto t = 660s; t <= 6000s; t += 60s) {
+		outdoor.update(source_t::openweather, {200, start + t});
+		outdoor.evaluate(start + t);
+	}
+	EXPECT_NEAR(outdoor.get().value(), 200, 1);
+}
+
+TEST(OutdoorPayloadParser, ParsesNumberOrJson) {
+	EXPECT_EQ(OutdoorPayloadParser::parse("-3.47"), -347);
+	EXPECT_EQ(OutdoorPayloadParser::parse(" 12\n"), 1200);
+	EXPECT_EQ(OutdoorPayloadParser::parse(R"({"battery":97,"humidity":81.5,"temperature":-3.5,"linkquality":120})"), -350);
+	EXPECT_EQ(OutdoorPayloadParser::parse(R"({"Time":"2025-01-15T07:00:00","DS18B20":{"Id":"0316A2","Temperature":4.2},"TempUnit":"C"})"), 420);
+	EXPECT_FALSE(OutdoorPayloadParser::parse(""));
+	EXPECT_FALSE(OutdoorPayloadParser::parse("offline"));
+	EXPECT_FALSE(OutdoorPayloadParser::parse("nan"));
+	EXPECT_FALSE(OutdoorPayloadParser::parse("850")); // out of outdoor range
+	EXPECT_FALSE(OutdoorPayloadParser::parse(R"({"humidity":81.5})"));
+	EXPECT_FALSE(OutdoorPayloadParser::parse(R"({"temperature":-3.5)"));
+}
+
+} // anonymous namespace
@@ -77,4 +77,26 @@ TEST(ParseTimeHHMM, Minute99) {
 	EXPECT_THROW(parseTimeHHMM("08:99"), std::out_of_range);
 }
 
+// ============================================================================
+// addMinutesHHMM
+// ============================================================================
+
+TEST(AddMinutesHHMM, SameDay) {
+	auto [time, day] = ib::timeutils::addMinutesHHMM(830, 2, 45);
+	EXPECT_EQ(time, 915);
+	EXPECT_EQ(day, 2);
+}
+
+TEST(AddMinutesHHMM, OverMidnight) {
+	auto [time, day] = ib::timeutils::addMinutesHHMM(2350, 3, 20);
+	EXPECT_EQ(time, 10);
+	EXPECT_EQ(day, 4);
+}
+
+TEST(AddMinutesHHMM, SaturdayToSunday) {
+	auto [time, day] = ib::timeutils::addMinutesHHMM(2330, 6, 60);
+	EXPECT_EQ(time, 30);
+	EXPECT_EQ(day, 0);
+}
+
 } // anonymous namespace
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "HeapCounter.h"
+#include "ProgramImage.h"
+#include "ProgramParser.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using heating::ProgramImage;
+using heating::ProgramParser;
+using heating::RoomConfig;
+
+constexpr char program[] = R"([
+	{"name": "Sypialnia", "sensor": "a4:c1:38:61:34:a3", "sensor_key": "00112233445566778899aabbccddeeff",
+	 "sensors": [{"address": "58:2d:34:3a:71:57", "weight": 40}], "valves": [1, "ext:pcf/3"],
+	 "base_temp": 2070, "temp_margin_up": 5, "temp_margin_down": 15, "enabled": true,
+	 "filter": {"method": "ewma", "ewma_alpha": 32, "staleness_weighting": false, "max_age": 600, "sample_interval": 300},
+	 "temperatures": [
+		{"name": "Dzień", "time_from": "08:00", "time_to": "15:00", "temp": -150, "boiler_temp": 45, "days": [1, 2, 5]},
+		{"name": "Noc", "time_from": "22:30", "time_to": "06:00", "temp": 2020, "enabled": false, "valves": ["1"]}
+	 ]},
+	{"name": "Przedpokoj", "sensor": "", "valves": [3], "base_temp": 1900, "enabled": false, "temperatures": []}
+])";
+
+std::vector<RoomConfig> parse(std::string_view json) {
+	std::vector<RoomConfig> rooms;
+	ProgramParser parser(rooms);
+	parser.feed(json.data(), json.size());
+	EXPECT_TRUE(parser.finish());
+	return rooms;
+}
+
+TEST(ProgramImageTest, LoadsWhatWasCompiled) {
+	auto source = ProgramImage::hash(program);
+	auto image = ProgramImage::build(parse(program), source);
+	auto rooms = ProgramImage::load(image, source);
+	ASSERT_TRUE(rooms);
+	ASSERT_EQ(rooms->size(), 2u);
+	EXPECT_EQ(ProgramImage::build(*rooms, source), image); // nothing lost on the way
+
+	auto const &room = (*rooms)[0];
+	EXPECT_EQ(room.name_, "Sypialnia");
+	EXPECT_TRUE(room.enabled_);
+	EXPECT_EQ(room.baseTemperature_, 2070);
+	EXPECT_EQ(room.temperatureMarginDown_, 15);
+	EXPECT_EQ(room.filter_.method, heating::TemperatureFilterConfig::method_t::ewma);
+	EXPECT_EQ(room.filter_.ewmaAlpha, 32);
+	EXPECT_FALSE(room.filter_.stalenessWeighting);
+	EXPECT_EQ(room.filter_.maxSampleAge, std::chrono::seconds(600));
+	EXPECT_EQ(room.filter_.sampleInterval, std::chrono::seconds(300));
+	ASSERT_EQ(room.sensors_.size(), 2u);
+	ASSERT_TRUE(room.sensors_[0].bindKey_);
+	EXPECT_EQ((*room.sensors_[0].bindKey_)[15], 0xff);
+	EXPECT_EQ(room.sensors_[1].weight_, 40);
+	EXPECT_FALSE(room.sensors_[1].bindKey_);
+	EXPECT_EQ(room.valves_, (std::vector<std::string>{"1", "ext:pcf/3"}));
+	ASSERT_EQ(room.temperatures_.size(), 2u);
+	EXPECT_EQ(room.temperatures_[0].name_, "Dzień");
+	EXPECT_EQ(room.temperatures_[0].temperature_, -150);
+	EXPECT_EQ(room.temperatures_[0].heatingTemperatureOverride_, 45);
+	EXPECT_EQ(room.temperatures_[0].days_, (std::array<bool, 7>{{false, true, true, false, false, true, false}}));
+	EXPECT_EQ(room.temperatures_[1].timeFrom_, 2230);
+	EXPECT_FALSE(room.temperatures_[1].enabled_);
+	EXPECT_FALSE(room.temperatures_[1].heatingTemperatureOverride_);
+	EXPECT_EQ(room.temperatures_[1].valves_, (std::vector<std::string>{"1"}));
+	EXPECT_TRUE((*rooms)[1].temperatures_.empty());
+}
+
+TEST(ProgramImageTest, StaleOrDamagedImageNotLoaded) {
+	auto source = ProgramImage::hash(program);
+	auto image = ProgramImage::build(parse(program), source);
+	ASSERT_TRUE(ProgramImage::load(image, source));
+
+	EXPECT_FALSE(ProgramImage::load(image, source ^ 1)); // JSON changed since
+	EXPECT_FALSE(ProgramImage::load(image.substr(0, image.size() - 1), source));
+	EXPECT_FALSE(ProgramImage::load(image + '\0', source));
+	EXPECT_FALSE(ProgramImage::load(image.substr(0, ProgramImage::headerSize - 1), source));
+	EXPECT_FALSE(ProgramImage::load({}, source));
+	for (size_t at = 0; at < image.size(); at += 7) {
+		auto damaged = image;
+		damaged[at] ^= 0x10;
+		EXPECT_FALSE(ProgramImage::load(damaged, source)) << at;
+	}
+}
+
+TEST(ProgramImageTest, NoRoomsIsAProgramToo) {
+	auto image = ProgramImage::build({}, 7);
+	auto rooms = ProgramImage::load(image, 7);
+	ASSERT_TRUE(rooms);
+	EXPECT_TRUE(rooms->empty());
+}
+
+std::string largeProgram(size_t roomCount, size_t settings) {
+	std::stringstream ss;
+	ss << "[\n";
+	for (size_t room = 0; room < roomCount; ++room) {
+		ss << (room ? ",\n" : "") << "\t{\n\t\t\"name\": \"Room " << room << "\",\n\t\t\"sensor\": \"a4:c1:38:61:34:a" << room << "\",\n";
+		ss << "\t\t\"valves\": [\n\t\t\t" << room << "\n\t\t],\n\t\t\"base_temp\": 2070,\n\t\t\"temp_margin_up\": 5,\n\t\t\"temp_margin_down\": 15,\n\t\t\"enabled\": true,\n";
+		ss << "\t\t\"temperatures\": [\n";
+		for (size_t setting = 0; setting < settings; ++setting) {
+			ss << (setting ? ",\n" : "") << "\t\t\t{\n\t\t\t\t\"name\": \"Setting " << setting << "\",\n";
+			ss << "\t\t\t\t\"time_from\": \"" << (setting < 10 ? "0" : "") << setting << ":00\",\n\t\t\t\t\"time_to\": \"" << (setting < 9 ? "0" : "") << setting + 1 << ":00\",\n";
+			ss << "\t\t\t\t\"temp\": " << 1900 + setting * 10 << ",\n\t\t\t\t\"enabled\": true,\n\t\t\t\t\"days\": [\n";
+			for (int day = 0; day < 7; ++day) {
+				ss << "\t\t\t\t\t" << day << (day < 6 ? ",\n" : "\n");
+			}
+			ss << "\t\t\t\t]\n\t\t\t}";
+		}
+		ss << "\n\t\t]\n\t}";
+	}
+	ss << "\n]\n";
+	return ss.str();
+}
+
+// reloadConfiguration() of an unchanged 8 rooms x 20 settings program: the JSON is only hashed to check the image
+TEST(ProgramImageBench, LoadVersusParse) {
+	constexpr int rounds = 200;
+	auto json = largeProgram(8, 20);
+	auto source = ProgramImage::hash(json);
+	auto image = ProgramImage::build(parse(json), source);
+
+	heap::start();
+	auto started = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		std::vector<RoomConfig> rooms;
+		ProgramParser parser(rooms);
+		for (size_t at = 0; at < json.size(); at += 256) {
+			auto chunk = std::string_view(json).substr(at, 256);
+			parser.feed(chunk.data(), chunk.size());
+		}
+		ASSERT_TRUE(parser.finish());
+	}
+	auto parseNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count() / rounds;
+	auto parseAllocations = heap::counter.allocations / rounds;
+
+	heap::start();
+	started = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		auto rooms = ProgramImage::load(image, ProgramImage::hash(json));
+		ASSERT_TRUE(rooms);
+	}
+	auto loadNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count() / rounds;
+	auto loadAllocations = heap::counter.allocations / rounds;
+	heap::stop();
+
+	RecordProperty("jsonBytes", static_cast<int>(json.size()));
+	RecordProperty("parseNs", static_cast<int>(parseNs));
+	RecordProperty("parseAllocations", static_cast<int>(parseAllocations));
+	RecordProperty("imageBytes", static_cast<int>(image.size()));
+	RecordProperty("loadNs", static_cast<int>(loadNs));
+	RecordProperty("loadAllocations", static_cast<int>(loadAllocations));
+	EXPECT_LT(image.size() * 4, json.size());
+	EXPECT_LT(loadNs, parseNs);
+}
+
+} // anonymous namespace
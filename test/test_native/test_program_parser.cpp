@@ -0,0 +1,284 @@
+#include <gtest/gtest.h>
+#include "HeapCounter.h"
+#include "ProgramParser.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using heating::ProgramParser;
+using heating::RoomConfig;
+
+// rooms the way the web UI stores them - tabs, one value per line
+constexpr char program[] = R"([
+	{
+		"name": "Sypialnia",
+		"sensor": "a4:c1:38:61:34:a3",
+		"valves": [
+			1,
+			"ext:pcf/3"
+		],
+		"base_temp": 2070,
+		"temp_margin_up": 5,
+		"temp_margin_down": 15,
+		"enabled": true,
+		"filter": {"method": "median", "outlier_tolerance": 80, "staleness_weighting": false, "max_age": 300, "sample_interval": 120},
+		"temperatures": [
+			{
+				"name": "Dzien \"roboczy\"",
+				"time_from": "08:00",
+				"time_to": "15:00",
+				"temp": 1850,
+				"boiler_temp": 45,
+				"enabled": true,
+				"days": [
+					1,
+					2,
+					5
+				]
+			},
+			{
+				"name": "Noc",
+				"time_from": "22:30",
+				"time_to": "06:00",
+				"temp": 2020,
+				"enabled": false,
+				"valves": ["1"]
+			}
+		]
+	},
+	{
+		"name": "Przedpokoj",
+		"sensor": "",
+		"valves": [
+			3
+		],
+		"base_temp": 1900,
+		"temp_margin_up": 5,
+		"temp_margin_down": 15,
+		"enabled": false,
+		"temperatures": []
+	}
+])";
+
+bool parse(std::string_view json, std::vector<RoomConfig> &rooms, size_t chunk = 256) {
+	ProgramParser parser(rooms);
+	for (size_t at = 0; at < json.size(); at += chunk) {
+		auto part = json.substr(at, chunk);
+		parser.feed(part.data(), part.size());
+	}
+	return parser.finish();
+}
+
+// everything RoomConfig holds, to compare parses
+std::string describe(std::vector<RoomConfig> const &rooms) {
+	std::stringstream ss;
+	for (auto const &room : rooms) {
+		ss << room.name_ << " " << room.enabled_ << " " << room.baseTemperature_ << " " << +room.temperatureMarginUp_ << " " << +room.temperatureMarginDown_;
+		ss << " filter " << static_cast<int>(room.filter_.method) << " " << room.filter_.outlierTolerance << " " << room.filter_.maxRatePerMinute << " " << +room.filter_.ewmaAlpha << " " << +room.filter_.minConfidence << " " << room.filter_.stalenessWeighting << " " << room.filter_.maxSampleAge.count() << " " << room.filter_.sampleInterval.count();
+		for (auto const &sensor : room.sensors_) {
+			ss << " sensor " << heating::BLEAddressToString(sensor.address_) << " " << +sensor.weight_ << " " << sensor.bindKey_.has_value();
+		}
+		for (auto const &valve : room.valves_) {
+			ss << " valve " << valve;
+		}
+		for (auto const &setting : room.temperatures_) {
+			ss << "\n  " << setting.name_ << " " << setting.timeFrom_ << "-" << setting.timeTo_ << " " << setting.temperature_ << " " << setting.enabled_ << " " << (setting.heatingTemperatureOverride_ ? *setting.heatingTemperatureOverride_ : -1) << " days ";
+			for (auto day : setting.days_) {
+				ss << day;
+			}
+			for (auto const &valve : setting.valves_) {
+				ss << " valve " << valve;
+			}
+		}
+		ss << "\n";
+	}
+	return ss.str();
+}
+
+TEST(ProgramParserTest, FillsRoomConfig) {
+	std::vector<RoomConfig> rooms;
+	ASSERT_TRUE(parse(program, rooms));
+	ASSERT_EQ(rooms.size(), 2u);
+
+	auto const &room = rooms[0];
+	EXPECT_EQ(room.name_, "Sypialnia");
+	EXPECT_TRUE(room.enabled_);
+	EXPECT_EQ(room.baseTemperature_, 2070);
+	EXPECT_EQ(room.temperatureMarginUp_, 5);
+	EXPECT_EQ(room.temperatureMarginDown_, 15);
+	ASSERT_EQ(room.sensors_.size(), 1u);
+	EXPECT_EQ(room.sensors_[0].address_, (heating::BleAddress_t{0xa4, 0xc1, 0x38, 0x61, 0x34, 0xa3}));
+	EXPECT_EQ(room.sensors_[0].weight_, 100);
+	EXPECT_EQ(room.valves_, (std::vector<std::string>{"1", "ext:pcf/3"}));
+	EXPECT_EQ(room.filter_.method, heating::TemperatureFilterConfig::method_t::median);
+	EXPECT_EQ(room.filter_.outlierTolerance, 80);
+	EXPECT_EQ(room.filter_.maxRatePerMinute, heating::TemperatureFilterConfig{}.maxRatePerMinute);
+	EXPECT_FALSE(room.filter_.stalenessWeighting);
+	EXPECT_EQ(room.filter_.maxSampleAge, std::chrono::seconds(300));
+	EXPECT_EQ(room.filter_.sampleInterval, std::chrono::seconds(120));
+
+	ASSERT_EQ(room.temperatures_.size(), 2u);
+	auto const &day = room.temperatures_[0];
+	EXPECT_EQ(day.name_, "Dzien \"roboczy\"");
+	EXPECT_EQ(day.timeFrom_, 800);
+	EXPECT_EQ(day.timeTo_, 1500);
+	EXPECT_EQ(day.temperature_, 1850);
+	EXPECT_EQ(day.heatingTemperatureOverride_, 45);
+	EXPECT_TRUE(day.enabled_);
+	EXPECT_EQ(day.days_, (std::array<bool, 7>{{false, true, true, false, false, true, false}}));
+	EXPECT_TRUE(day.valves_.empty());
+	auto const &night = room.temperatures_[1];
+	EXPECT_EQ(night.timeFrom_, 2230);
+	EXPECT_EQ(night.timeTo_, 600);
+	EXPECT_FALSE(night.enabled_);
+	EXPECT_FALSE(night.heatingTemperatureOverride_);
+	EXPECT_EQ(night.days_, (std::array<bool, 7>{{true, true, true, true, true, true, true}}));
+	EXPECT_EQ(night.valves_, (std::vector<std::string>{"1"}));
+
+	EXPECT_EQ(rooms[1].name_, "Przedpokoj");
+	EXPECT_FALSE(rooms[1].enabled_);
+	EXPECT_TRUE(rooms[1].sensors_.empty());
+	EXPECT_TRUE(rooms[1].temperatures_.empty());
+}
+
+TEST(ProgramParserTest, ChunkSizeDoesntMatter) {
+	std::vector<RoomConfig> whole;
+	ASSERT_TRUE(parse(program, whole, sizeof(program)));
+	for (size_t chunk : {1, 2, 3, 7, 64}) {
+		std::vector<RoomConfig> rooms;
+		ASSERT_TRUE(parse(program, rooms, chunk)) << chunk;
+		EXPECT_EQ(describe(rooms), describe(whole)) << chunk;
+	}
+}
+
+// what the cJSON parser did with missing or mistyped members
+TEST(ProgramParserTest, KeepsPreviousDefaults) {
+	std::vector<RoomConfig> rooms;
+	ASSERT_TRUE(parse(R"([{"temperatures": [{"temp": "2000", "time_from": "8:00", "days": []}, 5]}, 7, [], {"enabled": 1, "filter": [1]}])", rooms));
+	ASSERT_EQ(rooms.size(), 2u);
+	EXPECT_EQ(rooms[0].name_, "");
+	EXPECT_FALSE(rooms[0].enabled_);
+	EXPECT_EQ(rooms[0].baseTemperature_, 0);
+	EXPECT_EQ(rooms[0].temperatureMarginUp_, 0);
+	EXPECT_EQ(rooms[0].temperatureMarginDown_, 0);
+	ASSERT_EQ(rooms[0].temperatures_.size(), 1u);
+	auto const &setting = rooms[0].temperatures_[0];
+	EXPECT_EQ(setting.temperature_, 0);
+	EXPECT_EQ(setting.timeFrom_, 0); // invalid time logged, setting kept
+	EXPECT_TRUE(setting.enabled_);
+	EXPECT_EQ(setting.days_, (std::array<bool, 7>{{true, true, true, true, true, true, true}}));
+	EXPECT_FALSE(rooms[1].enabled_);
+	EXPECT_EQ(rooms[1].filter_.method, heating::TemperatureFilterConfig{}.method);
+}
+
+TEST(ProgramParserTest, PrimarySensorFirstWhereverItIs) {
+	std::vector<RoomConfig> rooms;
+	auto json = R"([{"sensors": ["58:2d:34:3a:71:57", {"address": "58:2d:34:3a:71:56", "weight": 50}, {"address": "58:2d:34:3a:71:58", "weight": 30, "key": "00112233445566778899aabbccddeeff"}, "58:2d:34:3a:71:57", {"weight": 10}],
+		"sensor": "58:2d:34:3a:71:56", "sensor_key": "00112233445566778899AABBCCDDEEFF"}])";
+	ASSERT_TRUE(parse(json, rooms));
+	ASSERT_EQ(rooms.size(), 1u);
+	auto const &sensors = rooms[0].sensors_;
+	ASSERT_EQ(sensors.size(), 3u);
+	EXPECT_EQ(heating::BLEAddressToString(sensors[0].address_), "58:2d:34:3a:71:56");
+	EXPECT_EQ(sensors[0].weight_, 100);
+	ASSERT_TRUE(sensors[0].bindKey_);
+	EXPECT_EQ((*sensors[0].bindKey_)[15], 0xff);
+	EXPECT_EQ(heating::BLEAddressToString(sensors[1].address_), "58:2d:34:3a:71:57");
+	EXPECT_EQ(heating::BLEAddressToString(sensors[2].address_), "58:2d:34:3a:71:58");
+	EXPECT_EQ(sensors[2].weight_, 30);
+	ASSERT_TRUE(sensors[2].bindKey_);
+	EXPECT_EQ((*sensors[2].bindKey_)[1], 0x11);
+}
+
+TEST(ProgramParserTest, SensorsOtherThanBluetoothLeftOut) {
+	std::vector<RoomConfig> rooms;
+	ASSERT_TRUE(parse(R"([{"sensor": "28-0316a2795aff", "sensors": ["58:2d:34:3a:71:57", "mqtt:salon/temp", {"address": "58-2d-34-3a-71-58"}, "58:2d:34:3a:71:5g"]}])", rooms));
+	ASSERT_EQ(rooms.size(), 1u);
+	ASSERT_EQ(rooms[0].sensors_.size(), 1u);
+	EXPECT_EQ(heating::BLEAddressToString(rooms[0].sensors_[0].address_), "58:2d:34:3a:71:57");
+}
+
+TEST(ProgramParserTest, UnescapesNames) {
+	std::vector<RoomConfig> rooms;
+	ASSERT_TRUE(parse(R"([{"name": "Pok\u00f3j \ud83d\udecf\tdzieci\b\f\r\/", "temperatures": [{"name": "\u0044zie\u0144"}]}])", rooms));
+	ASSERT_EQ(rooms.size(), 1u);
+	EXPECT_EQ(rooms[0].name_, "Pokój \U0001F6CF\tdzieci\b\f\r/");
+	ASSERT_EQ(rooms[0].temperatures_.size(), 1u);
+	EXPECT_EQ(rooms[0].temperatures_[0].name_, "Dzień");
+
+	EXPECT_FALSE(parse(R"([{"name": "\u00g3"}])", rooms));
+}
+
+TEST(ProgramParserTest, RejectsValuesOverMaxLength) {
+	std::vector<RoomConfig> rooms;
+	std::string name(ProgramParser::maxValue, 'x');
+	ASSERT_TRUE(parse("[{\"name\": \"" + name + "\"}]", rooms));
+	EXPECT_EQ(rooms[0].name_, name);
+	EXPECT_FALSE(parse("[{\"name\": \"" + name + "y\"}]", rooms));
+	EXPECT_FALSE(parse("[{\"name\": \"" + std::string(ProgramParser::maxValue - 1, 'x') + "\\u0144\"}]", rooms)); // 2 bytes once decoded
+}
+
+TEST(ProgramParserTest, RejectsMalformedDocuments) {
+	for (auto json : {"", "{\"name\": \"Salon\"}", "[{\"name\": \"Salon\"}", "[{\"name\": \"Salon\"}]]", "[{\"base_temp\": 12345678901234567890123456789012345678901234567890123456789012345}]"}) {
+		std::vector<RoomConfig> rooms;
+		EXPECT_FALSE(parse(json, rooms)) << json;
+	}
+	std::vector<RoomConfig> rooms;
+	EXPECT_TRUE(parse("[]", rooms));
+	EXPECT_TRUE(rooms.empty());
+}
+
+std::string largeProgram(size_t roomCount, size_t settings) {
+	std::stringstream ss;
+	ss << "[\n";
+	for (size_t room = 0; room < roomCount; ++room) {
+		ss << (room ? ",\n" : "") << "\t{\n\t\t\"name\": \"Room " << room << "\",\n\t\t\"sensor\": \"a4:c1:38:61:34:a" << room << "\",\n";
+		ss << "\t\t\"valves\": [\n\t\t\t" << room << "\n\t\t],\n\t\t\"base_temp\": 2070,\n\t\t\"temp_margin_up\": 5,\n\t\t\"temp_margin_down\": 15,\n\t\t\"enabled\": true,\n";
+		ss << "\t\t\"temperatures\": [\n";
+		for (size_t setting = 0; setting < settings; ++setting) {
+			ss << (setting ? ",\n" : "") << "\t\t\t{\n\t\t\t\t\"name\": \"Setting " << setting << "\",\n";
+			ss << "\t\t\t\t\"time_from\": \"" << (setting < 10 ? "0" : "") << setting << ":00\",\n\t\t\t\t\"time_to\": \"" << (setting < 9 ? "0" : "") << setting + 1 << ":00\",\n";
+			ss << "\t\t\t\t\"temp\": " << 1900 + setting * 10 << ",\n\t\t\t\t\"enabled\": true,\n\t\t\t\t\"days\": [\n";
+			for (int day = 0; day < 7; ++day) {
+				ss << "\t\t\t\t\t" << day << (day < 6 ? ",\n" : "\n");
+			}
+			ss << "\t\t\t\t]\n\t\t\t}";
+		}
+		ss << "\n\t\t]\n\t}";
+	}
+	ss << "\n]\n";
+	return ss.str();
+}
+
+// reloadConfiguration() with a large program: the parse is read from the file in chunks of getRoomsConfig(), the
+// previous path held the whole document in a String - and a cJSON tree of it, not measured here - besides the rooms
+TEST(ProgramParserBench, PeakHeapOfLargeProgram) {
+	constexpr size_t roomCount = 8;
+	constexpr size_t settings = 20;
+	auto json = largeProgram(roomCount, settings);
+
+	heap::start();
+	std::vector<RoomConfig> rooms;
+	bool parsed = parse(json, rooms);
+	auto peak = heap::counter.peak;
+	auto kept = heap::counter.live;
+	auto allocations = heap::counter.allocations;
+	heap::stop();
+
+	ASSERT_TRUE(parsed);
+	ASSERT_EQ(rooms.size(), roomCount);
+	EXPECT_EQ(rooms[7].temperatures_.size(), settings);
+	EXPECT_EQ(rooms[7].temperatures_[19].timeTo_, 2000);
+
+	RecordProperty("jsonBytes", static_cast<int>(json.size()));
+	RecordProperty("peakBytes", static_cast<int>(peak));
+	RecordProperty("roomsBytes", static_cast<int>(kept));
+	RecordProperty("allocations", static_cast<int>(allocations));
+	EXPECT_LT(static_cast<size_t>(peak), json.size()); // less than the String alone
+	EXPECT_LT(peak - kept, 4096);                       // parsing itself holds next to nothing
+}
+
+} // anonymous namespace
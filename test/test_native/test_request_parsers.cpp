@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "RequestParsers.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using heating::DebugOptionsParser;
+using heating::GpioTestParser;
+using heating::ProgramSelectionParser;
+using heating::TemporaryOverrideParser;
+
+// fed the way the raw handler hands the body over, in chunks
+template <typename Parser>
+bool parse(Parser &parser, std::string_view json, size_t chunk = 1436) {
+	parser.reset();
+	for (size_t at = 0; at < json.size(); at += chunk) {
+		auto part = json.substr(at, chunk);
+		parser.feed(part.data(), part.size());
+	}
+	return parser.finish();
+}
+
+TEST(RequestParsersTest, DebugOptionsMissingAreTurnedOff) {
+	auto previous = debug::debug;
+	DebugOptionsParser parser;
+	ASSERT_TRUE(parse(parser, R"({"debugREST": true, "debugMQTT": false, "debugFatal": "true"})", 3));
+	EXPECT_TRUE(debug::debug.debugREST);
+	EXPECT_FALSE(debug::debug.debugMQTT);
+	EXPECT_FALSE(debug::debug.debugFatal);
+	EXPECT_FALSE(debug::debug.debugHeatingController);
+
+	debug::debug.debugHeatingController = true;
+	EXPECT_FALSE(parse(parser, R"({"debugREST": false, "debugHeatingController": false)"));
+	EXPECT_TRUE(debug::debug.debugREST); // malformed, nothing changed
+	EXPECT_TRUE(debug::debug.debugHeatingController);
+	debug::debug = previous;
+}
+
+TEST(RequestParsersTest, ProgramSelection) {
+	ProgramSelectionParser parser;
+	for (size_t chunk : {1, 5, 1436}) {
+		ASSERT_TRUE(parse(parser, R"({"other": {"program": "x"}, "program": "zima łagodna"})", chunk)) << chunk;
+		EXPECT_EQ(parser.program(), "zima \xc5\x82" "agodna") << chunk;
+	}
+
+	EXPECT_FALSE(parse(parser, R"({"program": ""})"));
+	EXPECT_FALSE(parse(parser, R"({"program": 1})"));
+	EXPECT_FALSE(parse(parser, R"(["program", "zima"])"));
+	EXPECT_FALSE(parse(parser, R"({"program": "zima")"));
+	EXPECT_FALSE(parse(parser, R"({"program": ")" + std::string(64, 'a') + "\"}"));
+}
+
+TEST(RequestParsersTest, TemporaryOverride) {
+	TemporaryOverrideParser parser;
+	ASSERT_TRUE(parse(parser, R"({"roomName": "Salon", "temperature": 2150.7, "validSeconds": 3600})", 2));
+	EXPECT_EQ(parser.roomName(), "Salon");
+	EXPECT_EQ(parser.temperature(), 2150); // truncated as cJSON valueint
+	EXPECT_EQ(parser.validSeconds(), 3600);
+
+	ASSERT_TRUE(parse(parser, R"({"roomName": 7, "temperature": "2150", "validSeconds": null})"));
+	EXPECT_FALSE(parser.roomName());
+	EXPECT_FALSE(parser.temperature());
+	EXPECT_FALSE(parser.validSeconds());
+
+	EXPECT_FALSE(parse(parser, R"([{"roomName": "Salon"}])"));
+	EXPECT_FALSE(parse(parser, R"({"roomName": "Salon", "temperature": 2150)"));
+}
+
+TEST(RequestParsersTest, GpioTest) {
+	GpioTestParser parser;
+	ASSERT_TRUE(parse(parser, R"({"duration": 60, "boiler": true, "valves": [true, false, {"on": true}, 1, true], "x": {"duration": 5}})", 4));
+	EXPECT_EQ(parser.duration(), 60);
+	EXPECT_TRUE(parser.boiler());
+	EXPECT_EQ(parser.valves(), (std::vector<bool>{true, false, false, false, true})); // anything but true is off
+
+	ASSERT_TRUE(parse(parser, R"({"duration": "60", "boiler": "true", "valves": true})"));
+	EXPECT_FALSE(parser.duration());
+	EXPECT_FALSE(parser.boiler());
+	EXPECT_TRUE(parser.valves().empty());
+
+	EXPECT_FALSE(parse(parser, R"({"duration": 60, "valves": [true})"));
+}
+
+} // anonymous namespace
@@ -112,7 +112,7 @@ protected:
 		cfg.baseTemperature_ = baseTemp;
 		cfg.enabled_ = true;
 		cfg.name_ = "TestRoom";
-		cfg.sensorAddress_ = {};
+		cfg.sensors_ = {};
 		return cfg;
 	}
 
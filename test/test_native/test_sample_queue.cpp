@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "SampleQueue.h"
+
+#include <thread>
+
+namespace {
+
+using Queue = heating::SampleQueue<uint32_t, 8>;
+
+TEST(SampleQueueTest, Fifo) {
+	Queue queue;
+	EXPECT_FALSE(queue.pop().has_value());
+
+	for (uint32_t i = 0; i < 5; ++i) {
+		EXPECT_TRUE(queue.push(i));
+	}
+	EXPECT_EQ(queue.size(), 5u);
+	for (uint32_t i = 0; i < 5; ++i) {
+		EXPECT_EQ(queue.pop(), i);
+	}
+	EXPECT_FALSE(queue.pop().has_value());
+	EXPECT_EQ(queue.getHighWaterMark(), 5u);
+}
+
+TEST(SampleQueueTest, DropsWhenFull) {
+	Queue queue;
+	for (uint32_t i = 0; i < Queue::capacity + 3; ++i) {
+		queue.push(i);
+	}
+	EXPECT_EQ(queue.size(), Queue::capacity);
+	EXPECT_EQ(queue.getDrops(), 3u);
+	EXPECT_EQ(queue.getPushed(), Queue::capacity);
+	EXPECT_EQ(queue.getHighWaterMark(), Queue::capacity);
+
+	EXPECT_EQ(queue.pop(), 0u); // oldest kept, newest dropped
+	EXPECT_TRUE(queue.push(100));
+}
+
+TEST(SampleQueueTest, WrapsAround) {
+	Queue queue;
+	for (uint32_t i = 0; i < 1000; ++i) {
+		ASSERT_TRUE(queue.push(i));
+		ASSERT_TRUE(queue.push(i + 1));
+		ASSERT_EQ(queue.pop(), i);
+		ASSERT_EQ(queue.pop(), i + 1);
+	}
+	EXPECT_EQ(queue.getHighWaterMark(), 2u);
+	EXPECT_EQ(queue.getDrops(), 0u);
+}
+
+// producer and consumer on separate threads - items arrive in order, every item is either received or counted as drop
+TEST(SampleQueueTest, ProducerConsumerThreads) {
+	static constexpr uint32_t items = 200000;
+	heating::SampleQueue<uint32_t, 32> queue;
+
+	std::thread producer([&queue] {
+		for (uint32_t i = 1; i <= items; ++i) {
+			queue.push(i);
+		}
+	});
+
+	uint32_t received = 0;
+	uint32_t last = 0;
+	bool ordered = true;
+	while (received + queue.getDrops() < items || queue.size() > 0) {
+		if (auto item = queue.pop()) {
+			ordered = ordered && *item > last;
+			last = *item;
+			received++;
+		}
+	}
+	producer.join();
+
+	EXPECT_TRUE(ordered);
+	EXPECT_EQ(received + queue.getDrops(), items);
+	EXPECT_LE(queue.getHighWaterMark(), 32u);
+}
+
+} // anonymous namespace
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include "RoomConfig.h"
+#include "SensorIndex.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using heating::BleAddress_t;
+using heating::RoomConfig;
+
+// what the index needs of a room
+struct FakeRoom {
+	std::string name;
+	std::vector<RoomConfig::Sensor> sensors;
+
+	std::vector<RoomConfig::Sensor> const &getSensors() const { return sensors; }
+};
+
+using Index = heating::SensorIndex<FakeRoom>;
+
+constexpr BleAddress_t kitchen{0x58, 0x2d, 0x34, 0x3a, 0x71, 0x56};
+constexpr BleAddress_t hall{0x58, 0x2d, 0x34, 0x3a, 0x71, 0x57};
+constexpr BleAddress_t shared{0xa4, 0xc1, 0x38, 0x61, 0x34, 0xa3};
+
+std::shared_ptr<FakeRoom> room(std::string name, std::vector<BleAddress_t> const &addresses) {
+	auto created = std::make_shared<FakeRoom>(FakeRoom{std::move(name), {}});
+	for (auto const &address : addresses) {
+		created->sensors.push_back({address, 100, std::nullopt});
+	}
+	return created;
+}
+
+TEST(SensorIndexTest, RoutesToRoomAndSensorSlot) {
+	std::vector<std::shared_ptr<FakeRoom>> rooms{room("Kitchen", {kitchen, shared}), room("Hall", {hall})};
+	auto index = Index::build(rooms);
+	EXPECT_EQ(index->size(), 3u);
+
+	auto routes = index->find(shared);
+	ASSERT_NE(routes, nullptr);
+	ASSERT_EQ(routes->size(), 1u);
+	EXPECT_EQ((*routes)[0].room, rooms[0]);
+	EXPECT_EQ((*routes)[0].sensor, 1u);
+
+	routes = index->find(hall);
+	ASSERT_NE(routes, nullptr);
+	ASSERT_EQ(routes->size(), 1u);
+	EXPECT_EQ((*routes)[0].room, rooms[1]);
+	EXPECT_EQ((*routes)[0].sensor, 0u);
+}
+
+TEST(SensorIndexTest, SensorServingSeveralRooms) {
+	std::vector<std::shared_ptr<FakeRoom>> rooms{room("Kitchen", {kitchen, shared}), room("Hall", {hall}), room("Dining", {shared})};
+	auto index = Index::build(rooms);
+	auto routes = index->find(shared);
+	ASSERT_NE(routes, nullptr);
+	ASSERT_EQ(routes->size(), 2u);
+	EXPECT_EQ((*routes)[0].room->name, "Kitchen");
+	EXPECT_EQ((*routes)[0].sensor, 1u);
+	EXPECT_EQ((*routes)[1].room->name, "Dining");
+	EXPECT_EQ((*routes)[1].sensor, 0u);
+}
+
+TEST(SensorIndexTest, UnknownAddress) {
+	auto index = Index::build({room("Kitchen", {kitchen})});
+	EXPECT_EQ(index->find(hall), nullptr);
+	EXPECT_EQ(Index::build({})->find(kitchen), nullptr);
+}
+
+// samples routed through an index built before a reload keep reaching the rooms they were meant for
+TEST(SensorIndexTest, PreviousIndexKeepsItsRooms) {
+	auto before = Index::build({room("Kitchen", {kitchen})});
+	auto after = Index::build({room("Kitchen", {hall})});
+	ASSERT_NE(before->find(kitchen), nullptr);
+	EXPECT_EQ((*before->find(kitchen))[0].room->name, "Kitchen");
+	EXPECT_EQ(after->find(kitchen), nullptr);
+}
+
+} // anonymous namespace
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include "ControllerJobs.h"
+#include "StatusCache.h"
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using heating::ControllerJobs;
+using heating::StatusCache;
+using namespace std::chrono_literals;
+
+class StatusCacheTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		cache.setSections({
+			{"room/0", [this](std::ostream &ss) { renders++; ss << "{\"temperature\": " << room0 << "}"; }},
+			{"room/1", [this](std::ostream &ss) { renders++; ss << "{\"temperature\": " << room1 << "}"; }},
+			{"boiler", [this](std::ostream &ss) { renders++; ss << "{\"boiler\": " << (boiler ? "true" : "false") << "}"; }},
+		});
+	}
+
+	std::string since(uint32_t version) {
+		std::stringstream ss;
+		cache.write(ss, version);
+		return ss.str();
+	}
+
+	std::vector<std::string> keysSince(uint32_t version) {
+		std::vector<std::string> keys;
+		cache.forEach(version, [&](StatusCache::Fragment const &fragment) { keys.push_back(fragment.key); });
+		return keys;
+	}
+
+	StatusCache cache{100};
+	int room0 = 2100;
+	int room1 = 1900;
+	bool boiler = false;
+	int renders = 0;
+};
+
+TEST_F(StatusCacheTest, RendersOnlyDirtySections) {
+	EXPECT_TRUE(cache.isDirty());
+	EXPECT_EQ(cache.refresh(), 3u);
+	EXPECT_FALSE(cache.isDirty());
+	EXPECT_EQ(renders, 3);
+	EXPECT_EQ(cache.getVersion(), 102u); // 101 for the new sections, 102 for their first rendering
+
+	// nothing dirty - served as is, nothing rendered
+	EXPECT_EQ(cache.refresh(), 0u);
+	EXPECT_EQ(renders, 3);
+
+	room1 = 1950;
+	cache.markDirty("room/");
+	EXPECT_TRUE(cache.isDirty());
+	EXPECT_EQ(cache.refresh(), 1u);
+	EXPECT_EQ(renders, 5);
+	EXPECT_EQ(cache.getVersion(), 103u);
+
+	// rendered again, same JSON - version stays
+	cache.markDirty("boiler");
+	EXPECT_EQ(cache.refresh(), 0u);
+	EXPECT_EQ(renders, 6);
+	EXPECT_EQ(cache.getVersion(), 103u);
+
+	std::stringstream ss;
+	cache.getStatus(ss);
+	EXPECT_EQ(ss.str(), R"({"version": 103, "sections": 3, "bytes": 103, "renders": 6, "changes": 4})");
+}
+
+TEST_F(StatusCacheTest, ChangedSinceVersion) {
+	cache.refresh();
+	auto first = cache.getVersion();
+	EXPECT_EQ(since(first), R"({"sections": {}, "version": 102, "full": false})");
+
+	boiler = true;
+	cache.markDirty("boiler");
+	cache.refresh();
+	room0 = 2050;
+	cache.markDirty("");
+	cache.refresh();
+
+	EXPECT_EQ(since(first), R"({"sections": {"room/0": {"temperature": 2050}, "boiler": {"boiler": true}}, "version": 104, "full": false})");
+	EXPECT_EQ(keysSince(first + 1), std::vector<std::string>{"room/0"});
+	EXPECT_TRUE(keysSince(cache.getVersion()).empty());
+}
+
+TEST_F(StatusCacheTest, UnknownOrOldVersionGetsEverything) {
+	cache.refresh();
+	std::vector<std::string> all{"room/0", "room/1", "boiler"};
+	EXPECT_EQ(keysSince(0), all);    // before these sections
+	EXPECT_EQ(keysSince(5000), all); // from a previous boot
+	EXPECT_EQ(since(5000), R"({"sections": {"room/0": {"temperature": 2100}, "room/1": {"temperature": 1900}, "boiler": {"boiler": false}}, "version": 102, "full": true})");
+
+	auto version = cache.getVersion();
+	cache.setSections({{"boiler", [](std::ostream &ss) { ss << "{}"; }}});
+	EXPECT_EQ(since(version), R"({"sections": {"boiler": null}, "version": 103, "full": true})");
+	cache.refresh();
+	EXPECT_EQ(since(version), R"({"sections": {"boiler": {}}, "version": 104, "full": true})");
+	EXPECT_EQ(since(version + 1), R"({"sections": {"boiler": {}}, "version": 104, "full": false})");
+}
+
+TEST_F(StatusCacheTest, CborEncodedOnceAtRefresh) {
+	cache.refresh();
+	boiler = true;
+	cache.markDirty("boiler");
+	cache.refresh();
+
+	// copied from the fragments, same as encoding the JSON document
+	for (uint32_t version : {0u, cache.getVersion() - 1}) {
+		std::string json = since(version);
+		heating::CborStreamBuf cborBuf;
+		std::ostream cbor(&cborBuf);
+		cache.write(cbor, version, &cborBuf);
+		ASSERT_TRUE(cborBuf.finish());
+		EXPECT_EQ(cborBuf.view(), heating::CborStreamBuf::encode(json)) << json;
+		size_t fragments = 0;
+		cache.forEach(version, [&](StatusCache::Fragment const &fragment) { fragments += fragment.json.size(); });
+		EXPECT_EQ(cborBuf.getConsumed(), json.size() - fragments); // only the framing is lexed
+	}
+
+	// a fragment that can't be encoded fails the CBOR document, JSON is still served
+	cache.setSections({{"broken", [](std::ostream &ss) { ss << "{\"a\": nan}"; }}});
+	cache.refresh();
+	heating::CborStreamBuf cborBuf;
+	std::ostream cbor(&cborBuf);
+	cache.write(cbor, 0, &cborBuf);
+	EXPECT_FALSE(cborBuf.finish());
+	EXPECT_NE(since(0).find("nan"), std::string::npos);
+}
+
+TEST_F(StatusCacheTest, VersionsCarryOverWrap) {
+	StatusCache wrapping{0xfffffffe};
+	int value = 0;
+	wrapping.setSections({{"value", [&](std::ostream &ss) { ss << value; }}});
+	wrapping.refresh();
+	auto version = wrapping.getVersion();
+	EXPECT_EQ(version, 0u);
+
+	value = 1;
+	wrapping.markDirty("value");
+	wrapping.refresh();
+	std::stringstream ss;
+	wrapping.write(ss, version);
+	EXPECT_EQ(ss.str(), R"({"sections": {"value": 1}, "version": 1, "full": false})");
+}
+
+// GET /status?since= as the REST task serves it - refreshed on the controller task only when dirty. The refresh call
+// itself mustn't dirty anything, or the "loop" diagnostics counting it would give every poll a new version.
+TEST(StatusCacheReadTest, RepeatedPollsWithoutChangeAreNotModified) {
+	StatusCache cache{100};
+	ControllerJobs jobs;
+	int room = 2100;
+	cache.setSections({
+		{"room/0", [&](std::ostream &ss) { ss << room; }},
+		{"loop", [&](std::ostream &ss) { jobs.getStatus(ss); }},
+	});
+
+	std::atomic_bool stop{false};
+	std::thread controller([&] {
+		while (!stop) {
+			jobs.execute(); // HeatingController::loop()
+			std::this_thread::sleep_for(1ms);
+		}
+	});
+
+	struct Poll {
+		StatusCache::Read read;
+		std::string body;
+		bool notModified;
+	};
+	auto poll = [&](uint32_t since) {
+		if (cache.isDirty()) {
+			EXPECT_TRUE(jobs.run([&] { cache.refresh(); }, 1000ms));
+		}
+		std::stringstream ss;
+		auto read = cache.write(ss, since);
+		return Poll{read, ss.str(), !read.full && read.version == since};
+	};
+
+	auto first = poll(0);
+	EXPECT_TRUE(first.read.full);
+	auto second = poll(first.read.version);
+	auto third = poll(second.read.version);
+	EXPECT_EQ(second.read.version, first.read.version);
+	EXPECT_EQ(third.read.version, first.read.version);
+	EXPECT_TRUE(second.notModified);
+	EXPECT_TRUE(third.notModified);
+
+	// a call changing a room marks only that room
+	EXPECT_TRUE(jobs.run([&] { room = 2150; cache.markDirty("room/0"); }, 1000ms));
+	auto changed = poll(third.read.version);
+	EXPECT_FALSE(changed.notModified);
+	EXPECT_EQ(changed.body, R"({"sections": {"room/0": 2150}, "version": )" + std::to_string(changed.read.version) + R"(, "full": false})");
+	EXPECT_TRUE(poll(changed.read.version).notModified);
+
+	// operate() cadence - diagnostics catch up
+	EXPECT_TRUE(jobs.run([&] { cache.markDirty(""); }, 1000ms));
+	auto operated = poll(changed.read.version);
+	EXPECT_NE(operated.body.find("\"loop\": {\"executed\""), std::string::npos) << operated.body;
+	EXPECT_EQ(operated.body.find("room/0"), std::string::npos);
+
+	stop = true;
+	controller.join();
+}
+
+} // anonymous namespace
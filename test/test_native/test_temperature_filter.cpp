@@ -0,0 +1,329 @@
+#include <gtest/gtest.h>
+#include "TemperatureFilter.h"
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+using heating::TemperatureFilter;
+using heating::TemperatureFilterConfig;
+using method_t = TemperatureFilterConfig::method_t;
+
+// deterministic pseudo-random noise in range [-amplitude, amplitude]
+struct Noise {
+	uint32_t state = 12345;
+	int16_t next(int16_t amplitude) {
+		state = state * 1103515245u + 12345u;
+		return static_cast<int16_t>(static_cast<int32_t>((state >> 16) % (2 * amplitude + 1)) - amplitude);
+	}
+};
+
+class TemperatureFilterTest : public ::testing::Test {
+protected:
+	TemperatureFilter::clock_t::time_point now = TemperatureFilter::clock_t::now();
+	TemperatureFilterConfig config;
+	std::vector<TemperatureFilter::Sample> samples;
+
+	// samples every interval, newest taken at now
+	void trace(std::vector<int16_t> const &values, std::chrono::seconds interval = 15s) {
+		samples.clear();
+		auto time = now - interval * (values.size() - 1);
+		for (auto value : values) {
+			samples.push_back({time, value});
+			time += interval;
+		}
+	}
+
+	std::optional<TemperatureFilter::Result> apply() { return TemperatureFilter(config).apply(samples.data(), samples.size(), now); }
+};
+
+TEST_F(TemperatureFilterTest, NoSamples) {
+	EXPECT_FALSE(apply().has_value());
+}
+
+TEST_F(TemperatureFilterTest, AllSamplesTooOld) {
+	trace({2100, 2100}, 60s);
+	now += 5min;
+	EXPECT_FALSE(apply().has_value());
+}
+
+TEST_F(TemperatureFilterTest, StableTraceFullConfidence) {
+	trace({2100, 2100, 2100, 2100, 2100});
+	auto result = apply();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2100);
+	EXPECT_EQ(result->confidence, 100);
+	EXPECT_EQ(result->samples, 5);
+	EXPECT_EQ(result->rejected, 0);
+}
+
+TEST_F(TemperatureFilterTest, SpikeIsRejected) {
+	trace({2100, 2102, 2099, 8500, 2101, 2100});
+	for (auto method : {method_t::mean, method_t::median, method_t::trimmedMean, method_t::ewma}) {
+		config.method = method;
+		auto result = apply();
+		ASSERT_TRUE(result.has_value());
+		EXPECT_NEAR(result->temperature, 2100, 2);
+		EXPECT_EQ(result->rejected, 1);
+		EXPECT_LT(result->confidence, 100);
+	}
+}
+
+TEST_F(TemperatureFilterTest, RampWithinRateLimitIsAccepted) {
+	config.maxRatePerMinute = 100;
+	config.outlierTolerance = 10;
+	trace({2000, 2020, 2040, 2060, 2080, 2100, 2120}, 30s); // 0.4 deg / minute
+	auto result = apply();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->rejected, 0);
+}
+
+TEST_F(TemperatureFilterTest, NoisyTraceWithDropouts) {
+	Noise noise;
+	std::vector<int16_t> values;
+	for (int i = 0; i < 10; ++i) {
+		values.push_back(2150 + noise.next(15));
+	}
+	values[2] = -4000; // broken reading
+	values[7] = 3500;
+	trace(values, 18s);
+
+	config.method = method_t::mean;
+	config.outlierTolerance = 20000; // effectively no rejection
+	config.maxRatePerMinute = 0;
+	auto unfiltered = apply();
+
+	config = TemperatureFilterConfig{};
+	auto filtered = apply();
+
+	ASSERT_TRUE(unfiltered.has_value());
+	ASSERT_TRUE(filtered.has_value());
+	EXPECT_NEAR(filtered->temperature, 2150, 15);
+	EXPECT_GT(std::abs(unfiltered->temperature - 2150), 100);
+	EXPECT_EQ(filtered->rejected, 2);
+}
+
+TEST_F(TemperatureFilterTest, StalenessLowersConfidence) {
+	trace({2100, 2100, 2100}, 10s);
+	auto fresh = apply();
+	now += 100s;
+	auto stale = apply();
+	ASSERT_TRUE(fresh.has_value());
+	ASSERT_TRUE(stale.has_value());
+	EXPECT_GT(fresh->confidence, stale->confidence);
+	EXPECT_GE(stale->confidence, 50);
+}
+
+TEST_F(TemperatureFilterTest, SingleSampleLowerConfidence) {
+	trace({2100});
+	auto result = apply();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->confidence, 66);
+	now += config.maxSampleAge;
+	result = apply();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->confidence, 33);
+}
+
+// one sensor forwarded once a minute (duplicate refresh), evaluated every second in between, including one lost sample
+TEST_F(TemperatureFilterTest, SingleSensorAtItsIntervalStaysConfident) {
+	auto start = now;
+	for (auto interval : {60s, 120s}) {
+		for (size_t count = 1; count <= 5; ++count) {
+			now = start;
+			trace(std::vector<int16_t>(count, 2100), interval);
+			for (auto age = 0s; age < interval && age <= config.maxSampleAge; age += 1s, now += 1s) {
+				auto result = apply();
+				ASSERT_TRUE(result.has_value());
+				EXPECT_GE(result->confidence, config.minConfidence) << count << " samples, newest " << age.count() << "s old";
+			}
+		}
+	}
+	now = start;
+	trace({2100, 2100, 2100}, 60s);
+	EXPECT_EQ(apply()->confidence, 100);
+}
+
+TEST_F(TemperatureFilterTest, TwoDisagreeingSamplesFollowNewer) {
+	trace({2000, 2300}, 30s);
+	auto rising = apply();
+	trace({2300, 2000}, 30s);
+	auto falling = apply();
+	ASSERT_TRUE(rising.has_value());
+	ASSERT_TRUE(falling.has_value());
+	EXPECT_EQ(rising->temperature, 2300);
+	EXPECT_EQ(falling->temperature, 2000);
+	EXPECT_EQ(rising->rejected, 1);
+	EXPECT_EQ(falling->rejected, 1);
+}
+
+TEST_F(TemperatureFilterTest, StalenessWeightingFavoursNewSamples) {
+	config.method = method_t::mean;
+	config.outlierTolerance = 1000;
+	trace({2000, 2200}, 170s);
+	auto weighted = apply();
+	config.stalenessWeighting = false;
+	auto plain = apply();
+	ASSERT_TRUE(weighted.has_value());
+	ASSERT_TRUE(plain.has_value());
+	EXPECT_EQ(plain->temperature, 2100);
+	EXPECT_GT(weighted->temperature, 2100);
+}
+
+TEST_F(TemperatureFilterTest, EwmaFollowsNewestSamples) {
+	config.method = method_t::ewma;
+	config.ewmaAlpha = 128;
+	config.outlierTolerance = 100;
+	trace({2000, 2000, 2000, 2040, 2040, 2040});
+	auto result = apply();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2035);
+}
+
+TEST_F(TemperatureFilterTest, TrimmedMeanDropsExtremes) {
+	config.method = method_t::trimmedMean;
+	config.stalenessWeighting = false;
+	config.outlierTolerance = 100;
+	trace({2100, 2100, 2180, 2020, 2100, 2100, 2100, 2100});
+	auto result = apply();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2100);
+	EXPECT_EQ(result->rejected, 0);
+}
+
+// ============================================================================
+// Fusion of multiple sensors
+// ============================================================================
+
+using Estimate = TemperatureFilter::WeightedEstimate;
+
+TEST(TemperatureFusionTest, NoSensors) {
+	EXPECT_FALSE(TemperatureFilter::fuse(nullptr, 0, 20).has_value());
+}
+
+TEST(TemperatureFusionTest, WeightedBySensorWeight) {
+	std::vector<Estimate> estimates{{TemperatureFilter::Result{2000, 100, 5, 0}, 50}, {TemperatureFilter::Result{2200, 100, 5, 0}, 150}};
+	auto result = TemperatureFilter::fuse(estimates.data(), estimates.size(), 20);
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2150);
+	EXPECT_EQ(result->confidence, 100);
+	EXPECT_EQ(result->samples, 10);
+}
+
+TEST(TemperatureFusionTest, WeightedByConfidence) {
+	std::vector<Estimate> estimates{{TemperatureFilter::Result{2000, 100, 5, 0}, 100}, {TemperatureFilter::Result{2300, 50, 1, 0}, 100}};
+	auto result = TemperatureFilter::fuse(estimates.data(), estimates.size(), 20);
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2100);
+	EXPECT_EQ(result->confidence, 75);
+}
+
+TEST(TemperatureFusionTest, FailedSensorFallsBack) {
+	std::vector<Estimate> estimates{{std::nullopt, 100}, {TemperatureFilter::Result{2100, 90, 4, 0}, 100}, {TemperatureFilter::Result{3000, 10, 1, 2}, 100}};
+	auto result = TemperatureFilter::fuse(estimates.data(), estimates.size(), 20);
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2100);
+	EXPECT_EQ(result->confidence, 90);
+}
+
+TEST(TemperatureFusionTest, AllSensorsFailed) {
+	std::vector<Estimate> estimates{{std::nullopt, 100}, {TemperatureFilter::Result{2100, 10, 1, 0}, 100}};
+	EXPECT_FALSE(TemperatureFilter::fuse(estimates.data(), estimates.size(), 20).has_value());
+}
+
+// room estimate from the samples of its sensors, as Room gets it
+
+class SensorFusionTest : public TemperatureFilterTest {
+protected:
+	std::vector<std::vector<TemperatureFilter::Sample>> sensorSamples;
+	std::vector<uint8_t> weights;
+
+	// sensor with samples every interval, newest taken age before now
+	void sensor(std::vector<int16_t> const &values, uint8_t weight, std::chrono::seconds age = 0s, std::chrono::seconds interval = 60s) {
+		auto &added = sensorSamples.emplace_back();
+		auto time = now - age - interval * (values.size() - 1);
+		for (auto value : values) {
+			added.push_back({time, value});
+			time += interval;
+		}
+		weights.push_back(weight);
+	}
+
+	std::optional<TemperatureFilter::Result> fused() {
+		std::vector<TemperatureFilter::SensorSamples> sensors;
+		for (size_t i = 0; i < sensorSamples.size(); ++i) {
+			sensors.push_back({sensorSamples[i].data(), sensorSamples[i].size(), weights[i]});
+		}
+		return TemperatureFilter(config).apply(sensors.data(), sensors.size(), now);
+	}
+};
+
+TEST_F(SensorFusionTest, NoSensors) {
+	EXPECT_FALSE(fused().has_value());
+}
+
+TEST_F(SensorFusionTest, SingleSensorIsItsOwnEstimate) {
+	sensor({2100, 2104, 2098}, 100);
+	samples = sensorSamples[0];
+	auto alone = apply();
+	auto room = fused();
+	ASSERT_TRUE(alone.has_value());
+	ASSERT_TRUE(room.has_value());
+	EXPECT_EQ(room->temperature, alone->temperature);
+	EXPECT_EQ(room->confidence, alone->confidence);
+}
+
+TEST_F(SensorFusionTest, WeightsOfSensors) {
+	sensor({2000, 2000, 2000}, 100);
+	sensor({2300, 2300, 2300}, 50);
+	auto result = fused();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2100);
+	EXPECT_EQ(result->confidence, 100);
+	EXPECT_EQ(result->samples, 6);
+}
+
+TEST_F(SensorFusionTest, SensorWithFewerSamplesCountsLess) {
+	sensor({2000, 2000, 2000}, 100);
+	sensor({2300}, 100);
+	auto result = fused();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2119); // confidence 100% and 66%
+}
+
+TEST_F(SensorFusionTest, SilentSensorFallsBackToOthers) {
+	sensor({2000, 2000, 2000}, 100, 10min); // out of range or battery dead
+	sensor({2200, 2200}, 30, 30s);
+	sensor({}, 100);                      // never heard
+	auto result = fused();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2200);
+	EXPECT_EQ(result->samples, 2);
+}
+
+TEST_F(SensorFusionTest, OutlierOfOneSensorDoesntMoveRoom) {
+	sensor({2100, 2100, 8500, 2100}, 100, 0s, 15s);
+	sensor({2110, 2110, 2110}, 100);
+	auto result = fused();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_NEAR(result->temperature, 2105, 2);
+	EXPECT_EQ(result->rejected, 1);
+}
+
+TEST_F(SensorFusionTest, ZeroWeightSensorIgnored) {
+	sensor({2000, 2000, 2000}, 100);
+	sensor({2600, 2600, 2600}, 0);
+	auto result = fused();
+	ASSERT_TRUE(result.has_value());
+	EXPECT_EQ(result->temperature, 2000);
+}
+
+TEST_F(SensorFusionTest, AllSensorsSilent) {
+	sensor({2000, 2000}, 100, 5min);
+	sensor({2100}, 100, 4min);
+	EXPECT_FALSE(fused().has_value());
+}
+
+} // anonymous namespace
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include "ValveScheduler.h"
+#include "PcfGpioPort.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono_literals;
+using clock_t_ = heating::ValveScheduler::clock_t;
+
+struct CountingGpioPort : public gpio::GpioPort {
+	bool lastValue = false;
+	int writeCount = 0;
+	int stageCount = 0;
+	int commitCount = 0;
+
+	void initOutput() override {}
+	void write(bool high) override {
+		lastValue = high;
+		writeCount++;
+	}
+	void stage(bool high) override {
+		lastValue = high;
+		stageCount++;
+	}
+	void commit() override { commitCount++; }
+};
+
+class ValveSchedulerTest : public ::testing::Test {
+protected:
+	std::vector<CountingGpioPort *> raw;
+	clock_t_::time_point now = clock_t_::now();
+
+	heating::ValveScheduler make(size_t count, uint8_t batch) {
+		std::vector<std::unique_ptr<gpio::GpioPort>> ports;
+		for (size_t i = 0; i < count; i++) {
+			auto p = std::make_unique<CountingGpioPort>();
+			raw.push_back(p.get());
+			ports.push_back(std::move(p));
+		}
+		return heating::ValveScheduler(std::move(ports), 500ms, batch);
+	}
+};
+
+TEST_F(ValveSchedulerTest, UnchangedStateIsNotWritten) {
+	auto vs = make(4, 2);
+
+	EXPECT_EQ(vs.process(now), 0u);
+	vs.setClosed(1, false); // already open
+	EXPECT_EQ(vs.process(now), 0u);
+
+	for (auto *p : raw) {
+		EXPECT_EQ(p->stageCount, 0);
+		EXPECT_EQ(p->commitCount, 0);
+	}
+}
+
+TEST_F(ValveSchedulerTest, EnergizingIsStaggered) {
+	auto vs = make(6, 2);
+	for (uint8_t v = 0; v < 5; ++v) {
+		vs.setClosed(v, true);
+	}
+
+	EXPECT_EQ(vs.process(now), 2u);
+	EXPECT_TRUE(vs.isClosed(0));
+	EXPECT_TRUE(vs.isClosed(1));
+	EXPECT_FALSE(vs.isClosed(2));
+	EXPECT_TRUE(vs.isPending());
+
+	EXPECT_EQ(vs.process(now + 100ms), 0u); // step interval not passed yet
+	EXPECT_EQ(vs.process(now + 500ms), 2u);
+	EXPECT_EQ(vs.process(now + 1000ms), 1u);
+	EXPECT_FALSE(vs.isPending());
+	EXPECT_FALSE(vs.isClosed(5));
+}
+
+TEST_F(ValveSchedulerTest, DeenergizingIsImmediate) {
+	auto vs = make(4, 1);
+	for (uint8_t v = 0; v < 4; ++v) {
+		vs.setClosed(v, true);
+	}
+	vs.process(now);
+	vs.process(now + 500ms);
+	ASSERT_TRUE(vs.isClosed(0));
+	ASSERT_TRUE(vs.isClosed(1));
+
+	vs.setAllOpen();
+	EXPECT_EQ(vs.process(now + 600ms), 2u); // both opened without waiting for step
+	EXPECT_FALSE(vs.isPending());
+	EXPECT_FALSE(raw[0]->lastValue);
+	EXPECT_FALSE(raw[1]->lastValue);
+}
+
+TEST_F(ValveSchedulerTest, ChangesCommittedOncePerStep) {
+	auto vs = make(3, 3);
+	vs.setClosed(0, true);
+	vs.setClosed(2, true);
+	vs.process(now);
+
+	for (auto *p : raw) {
+		EXPECT_EQ(p->commitCount, 1);
+		EXPECT_EQ(p->writeCount, 0);
+	}
+	EXPECT_EQ(raw[0]->stageCount, 1);
+	EXPECT_EQ(raw[1]->stageCount, 0);
+	EXPECT_EQ(raw[2]->stageCount, 1);
+}
+
+TEST_F(ValveSchedulerTest, CountsActuations) {
+	auto vs = make(2, 2);
+	for (int cycle = 0; cycle < 3; ++cycle) {
+		vs.setClosed(0, true);
+		vs.process(now);
+		now += 1s;
+		vs.setClosed(0, false);
+		vs.process(now);
+		now += 1s;
+	}
+	EXPECT_EQ(vs.getActuations(0), 6u);
+	EXPECT_EQ(vs.getActuations(1), 0u);
+}
+
+TEST_F(ValveSchedulerTest, OpenCapacityOfValvesToBeOpened) {
+	std::vector<std::unique_ptr<gpio::GpioPort>> ports;
+	for (int i = 0; i < 3; i++) {
+		ports.push_back(std::make_unique<CountingGpioPort>());
+	}
+	std::vector<heating::ThermalActuator::Config> actuators{{100s, 100s, 1}, {100s, 100s, 3}, {100s, 100s, 1}};
+	heating::ValveScheduler vs(std::move(ports), 0ms, 3, {}, actuators);
+
+	vs.setClosed(0, true);
+	vs.setClosed(1, true);
+	vs.process(now);
+	now += 100s; // fully closed
+	EXPECT_EQ(vs.getPosition(0, now), 0);
+	EXPECT_EQ(vs.getOpenCapacity(now), 1000); // only valve 2 is supposed to be open and it is
+
+	vs.setAllOpen();
+	vs.process(now);
+	EXPECT_EQ(vs.getOpenCapacity(now), 200); // 1/5 of capacity open
+	now += 50s;
+	EXPECT_EQ(vs.getOpenCapacity(now), 600);
+	now += 50s;
+	EXPECT_EQ(vs.getOpenCapacity(now), 1000);
+}
+
+// ============================================================================
+// ThermalActuator
+// ============================================================================
+
+TEST(ThermalActuatorTest, StartsOpen) {
+	heating::ThermalActuator act;
+	EXPECT_EQ(act.getPosition(clock_t_::now()), heating::ThermalActuator::fullyOpen);
+}
+
+TEST(ThermalActuatorTest, TravelsLinearly) {
+	heating::ThermalActuator act({120s, 240s, 1});
+	auto t0 = clock_t_::now();
+
+	act.setEnergized(true, t0);
+	EXPECT_EQ(act.getPosition(t0), 1000);
+	EXPECT_EQ(act.getPosition(t0 + 60s), 750);
+	EXPECT_EQ(act.getPosition(t0 + 240s), 0);
+	EXPECT_EQ(act.getPosition(t0 + 1000s), 0);
+
+	act.setEnergized(false, t0 + 1000s);
+	EXPECT_EQ(act.getPosition(t0 + 1060s), 500);
+	EXPECT_EQ(act.getPosition(t0 + 1120s), 1000);
+}
+
+TEST(ThermalActuatorTest, ReversalMidTravel) {
+	heating::ThermalActuator act({100s, 100s, 1});
+	auto t0 = clock_t_::now();
+
+	act.setEnergized(true, t0);
+	act.setEnergized(false, t0 + 30s); // reached 700
+	EXPECT_EQ(act.getPosition(t0 + 30s), 700);
+	EXPECT_EQ(act.getPosition(t0 + 40s), 800);
+	EXPECT_EQ(act.getPosition(t0 + 60s), 1000);
+}
+
+TEST(PcfDeviceTest, SetPinMarksDirtyOnlyOnChange) {
+	gpio::PcfDevice dev(0x20, true);
+	EXPECT_FALSE(dev.dirty);
+
+	dev.setPin(3, true); // already HIGH
+	EXPECT_FALSE(dev.dirty);
+
+	dev.setPin(3, false);
+	dev.setPin(5, false);
+	EXPECT_TRUE(dev.dirty);
+	EXPECT_EQ(dev.shadow, static_cast<uint16_t>(0xFFFF & ~(1u << 3) & ~(1u << 5)));
+
+	dev.commit();
+	EXPECT_FALSE(dev.dirty);
+}
+
+} // anonymous namespace
@@ -0,0 +1,305 @@
+#include <gtest/gtest.h>
+#include "WarmWaterProgram.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+using namespace std::chrono_literals;
+using heating::WarmWaterConfig;
+using heating::WarmWaterEvents;
+using heating::WarmWaterProgram;
+using state_t = WarmWaterProgram::state_t;
+
+WarmWaterConfig makeConfig() {
+	WarmWaterConfig config;
+	config.enabled = true;
+	WarmWaterConfig::Window morning;
+	morning.timeFrom = 600;
+	morning.timeTo = 650; // ends with the last expected draw - tank isn't reheated to comfort afterwards
+	WarmWaterConfig::Window evening;
+	evening.timeFrom = 1830;
+	evening.timeTo = 2050;
+	WarmWaterConfig::Window weekend;
+	weekend.timeFrom = 1000;
+	weekend.timeTo = 1200;
+	weekend.days = {{true, false, false, false, false, false, true}};
+	weekend.mode = WarmWaterConfig::mode_t::eco;
+	config.windows = {morning, evening, weekend};
+	return config;
+}
+
+class WarmWaterProgramTest : public ::testing::Test {
+protected:
+	WarmWaterProgram::Inputs at(uint16_t time, uint8_t day, bool heatingDemand = false, std::optional<int16_t> tank = std::nullopt) {
+		WarmWaterProgram::Inputs inputs;
+		inputs.time = time;
+		inputs.dayOfTheWeek = day;
+		inputs.date = 20261018 + day; // Sunday 18th, one week
+		inputs.heatingDemand = heatingDemand;
+		inputs.tankTemperature = tank;
+		return inputs;
+	}
+
+	WarmWaterConfig config = makeConfig();
+	WarmWaterProgram::clock_t::time_point now = WarmWaterProgram::clock_t::time_point{} + 10h;
+};
+
+TEST_F(WarmWaterProgramTest, DisabledLeavesBoilerAlone) {
+	WarmWaterProgram program;
+	EXPECT_FALSE(program.evaluate(at(630, 1), now).has_value());
+}
+
+TEST_F(WarmWaterProgramTest, WindowsSelectTemperature) {
+	WarmWaterProgram program(config);
+	auto comfort = program.evaluate(at(630, 1), now);
+	ASSERT_TRUE(comfort.has_value());
+	EXPECT_EQ(comfort.value(), (WarmWaterProgram::Target{true, 55, state_t::comfort}));
+	EXPECT_EQ(program.evaluate(at(1100, 1), now).value(), (WarmWaterProgram::Target{true, 40, state_t::setback}));
+	EXPECT_EQ(program.evaluate(at(1100, 0), now).value(), (WarmWaterProgram::Target{true, 48, state_t::eco})); // Sunday only
+	EXPECT_EQ(program.evaluate(at(2050, 3), now).value().state, state_t::comfort); // end is inclusive like room schedules
+}
+
+TEST_F(WarmWaterProgramTest, OvernightWindowAndNoSetback) {
+	config.windows = {WarmWaterConfig::Window{2200, 200}};
+	config.setbackTemperature = 0;
+	WarmWaterProgram program(config);
+	EXPECT_EQ(program.evaluate(at(2330, 2), now).value().state, state_t::comfort);
+	EXPECT_EQ(program.evaluate(at(130, 3), now).value().state, state_t::comfort);
+	EXPECT_EQ(program.evaluate(at(300, 3), now).value(), (WarmWaterProgram::Target{false, 0, state_t::off}));
+}
+
+TEST_F(WarmWaterProgramTest, HeatingPriorityDefersLimitedTime) {
+	config.priority = WarmWaterConfig::priority_t::heating;
+	config.maxDeferralMinutes = 30;
+	WarmWaterProgram program(config);
+
+	EXPECT_EQ(program.evaluate(at(630, 1, true), now).value(), (WarmWaterProgram::Target{true, 40, state_t::deferred}));
+	EXPECT_EQ(program.evaluate(at(645, 1, true), now + 15min).value().state, state_t::deferred);
+	EXPECT_EQ(program.evaluate(at(645, 1, true), now + 30min).value().state, state_t::comfort); // limit passed, rooms wait now
+	EXPECT_EQ(program.evaluate(at(646, 1, true), now + 31min).value().state, state_t::comfort);
+
+	// demand ends - next demand defers again
+	EXPECT_EQ(program.evaluate(at(1900, 1, false), now + 12h).value().state, state_t::comfort);
+	EXPECT_EQ(program.evaluate(at(1901, 1, true), now + 12h + 1min).value().state, state_t::deferred);
+	// setback needs no deferral
+	EXPECT_EQ(program.evaluate(at(1500, 1, true), now + 20h).value().state, state_t::setback);
+}
+
+TEST_F(WarmWaterProgramTest, WarmWaterPriorityNeverDefers) {
+	WarmWaterProgram program(config);
+	EXPECT_EQ(program.evaluate(at(630, 1, true), now).value().state, state_t::comfort);
+}
+
+TEST_F(WarmWaterProgramTest, AntiLegionellaHoldsTemperatureOncePerWeek) {
+	config.antiLegionella.enabled = true;
+	config.antiLegionella.day = 3;
+	config.antiLegionella.time = 200;
+	config.antiLegionella.holdMinutes = 30;
+	config.priority = WarmWaterConfig::priority_t::heating;
+	WarmWaterProgram program(config);
+
+	EXPECT_EQ(program.evaluate(at(159, 3, false, 4000), now).value().state, state_t::setback);
+	EXPECT_EQ(program.evaluate(at(200, 3, true, 4000), now).value(), (WarmWaterProgram::Target{true, 60, state_t::antiLegionella})); // heating doesn't defer it
+	EXPECT_EQ(program.evaluate(at(220, 3, false, 5900), now + 20min).value().state, state_t::antiLegionella); // reached within margin
+	EXPECT_EQ(program.evaluate(at(249, 3, false, 6000), now + 49min).value().state, state_t::antiLegionella);
+	EXPECT_EQ(program.evaluate(at(250, 3, false, 6000), now + 50min).value().state, state_t::setback); // held 30 minutes
+	EXPECT_EQ(program.evaluate(at(300, 3, false, 5000), now + 60min).value().state, state_t::setback); // done for today
+
+	std::stringstream ss;
+	program.getStatus(ss);
+	EXPECT_NE(ss.str().find("\"cycles\": 1, \"failed\": 0"), std::string::npos);
+
+	EXPECT_EQ(program.evaluate(at(300, 4, false, 5000), now + 24h).value().state, state_t::setback);
+	auto nextWeek = at(200, 3, false, 4000);
+	nextWeek.date += 7;
+	EXPECT_EQ(program.evaluate(nextWeek, now + 7 * 24h).value().state, state_t::antiLegionella);
+}
+
+TEST_F(WarmWaterProgramTest, AntiLegionellaNotRepeatedAfterRestart) {
+	config.antiLegionella.enabled = true;
+	config.antiLegionella.day = 3;
+	WarmWaterProgram program(config);
+	EXPECT_EQ(program.evaluate(at(200, 3, false, 6000), now).value().state, state_t::antiLegionella);
+	EXPECT_EQ(program.evaluate(at(230, 3, false, 6000), now + 30min).value().state, state_t::setback);
+	ASSERT_TRUE(program.getLastCycleDate());
+	EXPECT_EQ(*program.getLastCycleDate(), 20261021u);
+
+	WarmWaterProgram restarted(config);
+	restarted.setLastCycleDate(*program.getLastCycleDate());
+	EXPECT_EQ(restarted.evaluate(at(240, 3, false, 5500), now + 40min).value().state, state_t::setback);
+	WarmWaterProgram forgetful(config);
+	EXPECT_EQ(forgetful.evaluate(at(240, 3, false, 5500), now + 40min).value().state, state_t::antiLegionella);
+}
+
+TEST_F(WarmWaterProgramTest, AntiLegionellaCutOffAtMidnightFails) {
+	config.antiLegionella.enabled = true;
+	config.antiLegionella.day = 3;
+	config.antiLegionella.time = 2330;
+	WarmWaterProgram program(config);
+	EXPECT_EQ(program.evaluate(at(2330, 3, false, 4500), now).value().state, state_t::antiLegionella);
+	EXPECT_EQ(program.evaluate(at(2359, 3, false, 5500), now + 29min).value().state, state_t::antiLegionella);
+	EXPECT_EQ(program.evaluate(at(0, 4, false, 5600), now + 30min).value().state, state_t::setback);
+
+	std::stringstream ss;
+	program.getStatus(ss);
+	EXPECT_NE(ss.str().find("\"cycles\": 1, \"failed\": 1"), std::string::npos);
+	EXPECT_EQ(program.getLastCycleDate(), 20261021u);
+}
+
+TEST_F(WarmWaterProgramTest, AntiLegionellaGivesUp) {
+	config.antiLegionella.enabled = true;
+	config.antiLegionella.day = 3;
+	config.antiLegionella.maxMinutes = 60;
+	WarmWaterProgram program(config);
+
+	EXPECT_EQ(program.evaluate(at(200, 3, false, 4500), now).value().state, state_t::antiLegionella);
+	EXPECT_EQ(program.evaluate(at(300, 3, false, 5200), now + 60min).value().state, state_t::setback);
+
+	std::stringstream ss;
+	program.getStatus(ss);
+	EXPECT_NE(ss.str().find("\"cycles\": 1, \"failed\": 1"), std::string::npos);
+}
+
+TEST(WarmWaterEventsTest, EnergyAndWaterPerEvent) {
+	WarmWaterEvents events;
+	events.addEnergy(1.0); // idle - not attributed
+	events.update(true, 1000);
+	events.addEnergy(0.25);
+	events.addWater(3.0);
+	events.addEnergy(0.25);
+	EXPECT_TRUE(events.isActive());
+	EXPECT_EQ(events.size(), 0u);
+	events.update(false, 61000);
+
+	ASSERT_EQ(events.size(), 1u);
+	EXPECT_EQ(events[0].startMs, 1000u);
+	EXPECT_EQ(events[0].durationMs, 60000u);
+	EXPECT_DOUBLE_EQ(events[0].energyKwh, 0.5);
+	EXPECT_DOUBLE_EQ(events[0].liters, 3.0);
+
+	std::stringstream ss;
+	events.getJSON(ss);
+	EXPECT_EQ(ss.str(), "[{\"durationS\": 60, \"energyKwh\": 0.5, \"liters\": 3}]");
+}
+
+TEST(WarmWaterEventsTest, KeepsLastEventsAndReportsNewOnes) {
+	WarmWaterEvents events;
+	for (uint64_t i = 0; i < 10; ++i) {
+		events.update(true, i * 100000);
+		events.addEnergy(static_cast<double>(i));
+		events.update(false, i * 100000 + 1000);
+	}
+	EXPECT_EQ(events.size(), WarmWaterEvents::capacity);
+	EXPECT_EQ(events.getTotal(), 10u);
+	EXPECT_DOUBLE_EQ(events[0].energyKwh, 2.0);
+
+	std::stringstream since;
+	events.getJSON(since, 8);
+	EXPECT_EQ(since.str(), "[{\"durationS\": 1, \"energyKwh\": 8, \"liters\": 0}, {\"durationS\": 1, \"energyKwh\": 9, \"liters\": 0}]");
+	std::stringstream none;
+	events.getJSON(none, 10);
+	EXPECT_EQ(none.str(), "[]");
+}
+
+// Storage tank with standby loss to the room it stands in. The boiler charges it with its own hysteresis to the set
+// point written by the program, water is drawn in the morning and evening.
+class TankSimulation {
+public:
+	struct Result {
+		double standbyLossKwh;
+		double chargedKwh;
+		double minDrawTemperature; // tank temperature when water is drawn in a comfort window, °C
+		uint32_t disinfections;
+	};
+
+	explicit TankSimulation(WarmWaterConfig const &config) : program_(config) {}
+
+	Result run(int days) {
+		Result result{0, 0, 100, 0};
+		auto start = WarmWaterProgram::clock_t::time_point{} + 1h;
+		for (int minute = 0; minute < days * 24 * 60; ++minute) {
+			uint8_t day = static_cast<uint8_t>((1 + minute / (24 * 60)) % 7); // starts on Monday
+			uint16_t time = static_cast<uint16_t>((minute / 60) % 24 * 100 + minute % 60);
+
+			WarmWaterProgram::Inputs inputs;
+			inputs.time = time;
+			inputs.dayOfTheWeek = day;
+			inputs.date = 1 + minute / (24 * 60); // day number stands in for the date
+			inputs.tankTemperature = static_cast<int16_t>(tank_ * 100);
+			auto target = program_.evaluate(inputs, start + std::chrono::minutes(minute)).value_or(WarmWaterProgram::Target{true, constantSetPoint, WarmWaterProgram::state_t::comfort});
+
+			if (!target.enabled) {
+				charging_ = false;
+			} else if (tank_ < target.temperature - hysteresis) {
+				charging_ = true;
+			} else if (tank_ >= target.temperature) {
+				charging_ = false;
+			}
+
+			for (auto const &draw : draws) {
+				if (draw.time == time) {
+					if (draw.comfort) {
+						result.minDrawTemperature = std::min(result.minDrawTemperature, tank_);
+					}
+					tank_ = (tank_ * (volume - draw.liters) + coldWater * draw.liters) / volume;
+				}
+			}
+
+			double loss = standbyLoss * (tank_ - ambient) * 60;
+			double charge = charging_ ? chargePower * 60 : 0;
+			tank_ += (charge - loss) / (volume * 4186);
+			result.standbyLossKwh += loss / 3.6e6;
+			result.chargedKwh += charge / 3.6e6;
+		}
+		std::stringstream status;
+		program_.getStatus(status);
+		result.disinfections = status.str().find("\"cycles\": 1") != std::string::npos ? 1 : 0;
+		return result;
+	}
+
+	static constexpr uint8_t constantSetPoint = 55;
+
+private:
+	struct Draw {
+		uint16_t time; // HHMM
+		double liters;
+		bool comfort;  // in a comfort window
+	};
+	static constexpr std::array<Draw, 6> draws{{{630, 40, true}, {650, 30, true}, {1300, 10, false}, {1900, 40, true}, {2000, 40, true}, {2050, 30, true}}};
+
+	static constexpr double volume = 150;       // l
+	static constexpr double standbyLoss = 2.0;  // W/K
+	static constexpr double chargePower = 20e3; // W
+	static constexpr double ambient = 20;
+	static constexpr double coldWater = 10;
+	static constexpr double hysteresis = 5;
+
+	WarmWaterProgram program_;
+	double tank_ = 55;
+	bool charging_ = false;
+};
+
+TEST(WarmWaterSimulation, ProgramReducesStandbyLoss) {
+	WarmWaterConfig constant; // program disabled - boiler keeps 55 °C all the time
+	auto always = TankSimulation(constant).run(7);
+
+	auto config = makeConfig();
+	config.antiLegionella.enabled = true;
+	config.antiLegionella.day = 0;
+	auto programmed = TankSimulation(config).run(7);
+
+	RecordProperty("constantStandbyLossWh", static_cast<int>(always.standbyLossKwh * 1000));
+	RecordProperty("programStandbyLossWh", static_cast<int>(programmed.standbyLossKwh * 1000));
+	RecordProperty("constantChargedWh", static_cast<int>(always.chargedKwh * 1000));
+	RecordProperty("programChargedWh", static_cast<int>(programmed.chargedKwh * 1000));
+
+	EXPECT_LT(programmed.standbyLossKwh, always.standbyLossKwh * 0.85);
+	EXPECT_LT(programmed.chargedKwh, always.chargedKwh);
+	EXPECT_GE(programmed.minDrawTemperature, 45.0); // comfort kept when water is used
+	EXPECT_GE(always.minDrawTemperature, 45.0);
+	EXPECT_EQ(programmed.disinfections, 1u);
+}
+
+} // anonymous namespace
@@ -0,0 +1,311 @@
+#include <gtest/gtest.h>
+#include "HeapCounter.h"
+#include "WeatherForecast.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+using heating::ForecastConfig;
+using heating::ForecastOutlook;
+using heating::ForecastParser;
+using heating::HourlyForecast;
+
+constexpr uint32_t base = 1736931600; // 2025-01-15 09:00 UTC
+
+// shortened /data/2.5/forecast response, 3 h steps
+std::string forecastResponse() {
+	std::stringstream ss;
+	ss << R"({"cod":"200","message":0,"cnt":4,"list":[)";
+	int16_t temps[] = {250, -120, -575, -810};
+	int clouds[] = {0, 40, 100, 75};
+	for (int i = 0; i < 4; ++i) {
+		ss << (i ? "," : "") << R"({"dt":)" << base + i * 10800 << R"(,"main":{"temp":)" << temps[i] / 100.0 << R"(,"feels_like":-1.5,"pressure":1021,"humidity":81},)"
+		   << R"("weather":[{"id":804,"main":"Clouds","description":"overcast \"clouds\" {x}","icon":"04d"}],"clouds":{"all":)" << clouds[i]
+		   << R"(},"wind":{"speed":2.1,"deg":240},"visibility":10000,"pop":0.2,"sys":{"pod":"d"},"dt_txt":"2025-01-15 09:00:00"})";
+	}
+	ss << R"(],"city":{"id":3081368,"name":"Wroclaw","coord":{"lat":51.1,"lon":17.0333},"country":"PL","population":0,"timezone":3600,"sunrise":1736923620,"sunset":1736954226}})";
+	return ss.str();
+}
+
+// shortened One Call response, hourly steps
+std::string hourlyResponse() {
+	std::stringstream ss;
+	ss << R"({"lat":51.1,"lon":17.03,"timezone":"Europe/Warsaw","timezone_offset":3600,"current":{"dt":1736931000,"temp":3.1,"clouds":20},)";
+	ss << R"("hourly": [ )";
+	for (int i = 0; i < 6; ++i) {
+		ss << (i ? ", " : "") << "{ \"dt\" : " << base + i * 3600 << ", \"temp\" : " << 3.0 - i << ", \"clouds\" : " << i * 10 << ", \"weather\" : [ { \"id\" : 800 } ] }";
+	}
+	ss << R"( ], "daily": [{"dt":1736935200,"temp":{"day":2.5,"min":-1}}]})";
+	return ss.str();
+}
+
+HourlyForecast parse(std::string const &payload, bool *complete = nullptr) {
+	HourlyForecast forecast;
+	ForecastParser parser(forecast);
+	parser.feed(payload.data(), payload.size());
+	bool done = parser.finish();
+	if (complete) {
+		*complete = done;
+	}
+	return forecast;
+}
+
+TEST(WeatherForecast, ParsesForecastList) {
+	bool complete = false;
+	auto forecast = parse(forecastResponse(), &complete);
+	ASSERT_TRUE(complete);
+	ASSERT_EQ(forecast.size(), 4u);
+	EXPECT_EQ(forecast[0].time, base);
+	EXPECT_EQ(forecast[0].temperature, 250);
+	EXPECT_EQ(forecast[1].temperature, -120);
+	EXPECT_EQ(forecast[2].temperature, -575);
+	EXPECT_EQ(forecast[2].clouds, 100);
+	EXPECT_EQ(forecast[3].time, base + 3 * 10800);
+	EXPECT_EQ(forecast[3].clouds, 75);
+	EXPECT_EQ(forecast.getTimezoneOffset(), 3600);
+}
+
+TEST(WeatherForecast, ParsesHourlyAndIgnoresOtherArrays) {
+	bool complete = false;
+	auto forecast = parse(hourlyResponse(), &complete);
+	ASSERT_TRUE(complete);
+	ASSERT_EQ(forecast.size(), 6u); // current and daily aren't forecast entries
+	EXPECT_EQ(forecast[0].temperature, 300);
+	EXPECT_EQ(forecast[5].temperature, -200);
+	EXPECT_EQ(forecast[5].clouds, 50);
+	EXPECT_EQ(forecast.getTimezoneOffset(), 3600);
+}
+
+TEST(WeatherForecast, ChunkBoundariesDontMatter) {
+	auto payload = forecastResponse();
+	auto whole = parse(payload);
+	std::mt19937 rng(7);
+	for (int round = 0; round < 50; ++round) {
+		HourlyForecast forecast;
+		ForecastParser parser(forecast);
+		for (size_t pos = 0; pos < payload.size();) {
+			size_t chunk = std::min<size_t>(payload.size() - pos, 1 + rng() % 17);
+			parser.feed(payload.data() + pos, chunk);
+			pos += chunk;
+		}
+		ASSERT_TRUE(parser.finish());
+		ASSERT_EQ(forecast.size(), whole.size());
+		for (size_t i = 0; i < whole.size(); ++i) {
+			EXPECT_EQ(forecast[i].time, whole[i].time);
+			EXPECT_EQ(forecast[i].temperature, whole[i].temperature);
+			EXPECT_EQ(forecast[i].clouds, whole[i].clouds);
+		}
+	}
+}
+
+TEST(WeatherForecast, StreamingParseDoesntAllocate) {
+	// a whole 40 entry /data/2.5/forecast response fed in client buffer sized chunks
+	std::stringstream ss;
+	ss << R"({"cod":"200","message":0,"cnt":40,"list":[)";
+	for (int i = 0; i < 40; ++i) {
+		ss << (i ? "," : "") << R"({"dt":)" << base + i * 10800 << R"(,"main":{"temp":-1.25,"feels_like":-5.5,"pressure":1021,"humidity":81},"weather":[{"id":804,"main":"Clouds","description":"overcast clouds","icon":"04d"}],"clouds":{"all":90},"wind":{"speed":2.1,"deg":240},"visibility":10000,"pop":0.2,"sys":{"pod":"d"},"dt_txt":"2025-01-15 09:00:00"})";
+	}
+	ss << R"(],"city":{"id":3081368,"name":"Wroclaw","timezone":3600}})";
+	auto payload = ss.str();
+
+	HourlyForecast forecast;
+	ForecastParser parser(forecast);
+	heap::start();
+	for (size_t pos = 0; pos < payload.size(); pos += 1436) {
+		parser.feed(payload.data() + pos, std::min<size_t>(1436, payload.size() - pos));
+	}
+	bool parsed = parser.finish();
+	heap::stop();
+
+	ASSERT_TRUE(parsed);
+	EXPECT_EQ(forecast.size(), 40u);
+	EXPECT_EQ(heap::counter.allocations, 0u);
+	EXPECT_GT(payload.size(), 12000u); // what a String payload of the response would have held
+}
+
+TEST(WeatherForecast, RejectsIncompleteAndErrorResponses) {
+	auto payload = forecastResponse();
+	bool complete = true;
+	parse(payload.substr(0, payload.size() / 2), &complete);
+	EXPECT_FALSE(complete);
+	parse(R"({"cod":401, "message": "Invalid API key. Please see https://openweathermap.org/faq#error401 for more info."})", &complete);
+	EXPECT_FALSE(complete);
+	parse("", &complete);
+	EXPECT_FALSE(complete);
+	parse(R"({"list":[{"dt":1,"main":{"temp":123456789012345678901234567890123456789012345678901234567890}}]})", &complete);
+	EXPECT_FALSE(complete);
+}
+
+TEST(WeatherForecast, KeepsFixedCapacity) {
+	std::stringstream ss;
+	ss << R"({"hourly":[)";
+	for (int i = 0; i < 96; ++i) {
+		ss << (i ? "," : "") << R"({"dt":)" << base + i * 3600 << R"(,"temp":)" << i << "}";
+	}
+	ss << "]}";
+	bool complete = false;
+	auto forecast = parse(ss.str(), &complete);
+	EXPECT_TRUE(complete);
+	EXPECT_EQ(forecast.size(), HourlyForecast::capacity);
+	EXPECT_EQ(forecast[HourlyForecast::capacity - 1].temperature, 4700);
+	EXPECT_LT(sizeof(ForecastParser), 256u);
+}
+
+TEST(WeatherForecast, InterpolatesBetweenSteps) {
+	auto forecast = parse(forecastResponse());
+	EXPECT_EQ(forecast.temperatureAt(base), 250);
+	EXPECT_EQ(forecast.temperatureAt(base + 3600), 127);
+	EXPECT_EQ(forecast.temperatureAt(base + 10800), -120);
+	EXPECT_EQ(forecast.temperatureAt(base - 3600), 250); // just before the first step
+	EXPECT_FALSE(forecast.temperatureAt(base - 4 * 3600).has_value());
+	EXPECT_FALSE(forecast.temperatureAt(base + 4 * 10800).has_value());
+	EXPECT_EQ(forecast.cloudsAt(base + 3600), 0);
+	EXPECT_EQ(forecast.cloudsAt(base + 10800 + 60), 40);
+}
+
+TEST(WeatherForecast, OutlookPreChargesBeforeColdSnap) {
+	ForecastConfig config;
+	config.solarGain = 0;
+	auto forecast = parse(forecastResponse());
+	// samples 10:00 - 13:00 UTC: 1.27, 0.04, -1.20, -2.71
+	auto outlook = ForecastOutlook::evaluate(forecast, base, 250, config);
+	ASSERT_TRUE(outlook.valid);
+	EXPECT_EQ(outlook.meanTemperature, -65);
+	EXPECT_EQ(outlook.adjustment, -157); // half of the coming 3.15 °C drop
+	config.gain = 100;
+	config.maxAdjustment = 200;
+	EXPECT_EQ(ForecastOutlook::evaluate(forecast, base, 250, config).adjustment, -200);
+}
+
+TEST(WeatherForecast, OutlookCoastsOnSun) {
+	std::stringstream ss;
+	ss << R"({"timezone_offset":3600,"hourly":[)";
+	for (int i = 0; i < 12; ++i) {
+		ss << (i ? "," : "") << R"({"dt":)" << base + i * 3600 << R"(,"temp":2,"clouds":)" << (i < 6 ? 0 : 100) << "}";
+	}
+	ss << "]}";
+	auto forecast = parse(ss.str());
+	ForecastConfig config;
+	// 11:00 - 14:00 local, clear sky
+	auto sunny = ForecastOutlook::evaluate(forecast, base + 3600, 200, config);
+	EXPECT_EQ(sunny.sun, 100);
+	EXPECT_EQ(sunny.adjustment, 200);
+	// 15:00 - 18:00 local, overcast and mostly after daylight
+	auto overcast = ForecastOutlook::evaluate(forecast, base + 5 * 3600, 200, config);
+	EXPECT_EQ(overcast.sun, 0);
+	EXPECT_EQ(overcast.adjustment, 0);
+	// warm spell lets the building coast too
+	auto warmer = ForecastOutlook::evaluate(forecast, base + 6 * 3600, -400, config);
+	EXPECT_EQ(warmer.adjustment, 300);
+}
+
+TEST(WeatherForecast, OutlookInvalidWithoutFreshForecast) {
+	auto forecast = parse(forecastResponse());
+	EXPECT_FALSE(ForecastOutlook::evaluate(forecast, base + 4 * 10800, 0, ForecastConfig{}).valid);
+	EXPECT_FALSE(ForecastOutlook::evaluate(HourlyForecast{}, base, 0, ForecastConfig{}).valid);
+	std::stringstream ss;
+	ForecastOutlook{}.getStatus(ss);
+	EXPECT_EQ(ss.str(), "{\"valid\": false}");
+}
+
+// Stand-in for api.openweathermap.org on loopback - serves a canned response in small TCP writes, like a slow link
+class HttpStandIn {
+public:
+	explicit HttpStandIn(std::string body) : body_(std::move(body)) {
+		server_ = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0;
+		bind(server_, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+		listen(server_, 1);
+		socklen_t length = sizeof(address);
+		getsockname(server_, reinterpret_cast<sockaddr *>(&address), &length);
+		port_ = ntohs(address.sin_port);
+		thread_ = std::thread([this] { serve(); });
+	}
+
+	~HttpStandIn() {
+		thread_.join();
+		close(server_);
+	}
+
+	uint16_t getPort() const { return port_; }
+	std::string const &getRequest() const { return request_; }
+
+private:
+	void serve() {
+		int client = accept(server_, nullptr, nullptr);
+		char buffer[512];
+		while (request_.find("\r\n\r\n") == std::string::npos) {
+			auto received = recv(client, buffer, sizeof(buffer), 0);
+			if (received <= 0) {
+				break;
+			}
+			request_.append(buffer, static_cast<size_t>(received));
+		}
+		std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body_.size()) + "\r\nConnection: close\r\n\r\n" + body_;
+		for (size_t pos = 0; pos < response.size(); pos += 97) {
+			send(client, response.data() + pos, std::min<size_t>(97, response.size() - pos), 0);
+		}
+		close(client);
+	}
+
+	std::string body_;
+	int server_ = -1;
+	uint16_t port_ = 0;
+	std::string request_;
+	std::thread thread_;
+};
+
+TEST(WeatherForecast, StreamsFromStandInServer) {
+	HttpStandIn server(forecastResponse());
+
+	int client = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(server.getPort());
+	ASSERT_EQ(connect(client, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+	std::string request = "GET /data/2.5/forecast?lat=51.1&lon=17.03&appid=x&units=metric&cnt=4 HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	send(client, request.data(), request.size(), 0);
+
+	// body goes to the parser as it arrives, only a chunk sized buffer is held
+	HourlyForecast forecast;
+	ForecastParser parser(forecast);
+	std::string headers;
+	bool inBody = false;
+	char chunk[64];
+	ssize_t received;
+	while ((received = recv(client, chunk, sizeof(chunk), 0)) > 0) {
+		size_t offset = 0;
+		if (!inBody) {
+			headers.append(chunk, static_cast<size_t>(received));
+			auto end = headers.find("\r\n\r\n");
+			if (end == std::string::npos) {
+				continue;
+			}
+			inBody = true;
+			offset = static_cast<size_t>(received) - (headers.size() - end - 4);
+		}
+		parser.feed(chunk + offset, static_cast<size_t>(received) - offset);
+	}
+	close(client);
+
+	EXPECT_NE(headers.find("200 OK"), std::string::npos);
+	ASSERT_TRUE(parser.finish());
+	EXPECT_EQ(forecast.size(), 4u);
+	EXPECT_EQ(forecast[2].temperature, -575);
+	EXPECT_NE(server.getRequest().find("cnt=4"), std::string::npos);
+}
+
+} // anonymous namespace
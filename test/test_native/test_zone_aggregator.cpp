@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include "ZoneAggregator.h"
+
+#include <sstream>
+
+namespace {
+
+using namespace std::chrono_literals;
+using heating::ZoneAggregator;
+using heating::ZoneConfig;
+using heating::ZonesConfig;
+
+constexpr std::array<uint8_t, 9> underfloorCurve{{25, 27, 29, 31, 33, 35, 37, 39, 40}};
+constexpr std::array<uint8_t, 9> radiatorCurve{{30, 35, 40, 45, 50, 55, 60, 65, 70}};
+
+ZonesConfig makeConfig(ZonesConfig::policy_t policy) {
+	ZonesConfig config;
+	config.policy = policy;
+	config.slice = 600s;
+	config.zones = {
+		ZoneConfig{"floor", {"Bath", "Kitchen", "Hall"}, underfloorCurve, 1},
+		ZoneConfig{"radiators", {"Bedroom", "Office"}, radiatorCurve, 1},
+	};
+	return config;
+}
+
+class ZoneAggregatorTest : public ::testing::Test {
+protected:
+	ZoneAggregator::clock_t::time_point now = ZoneAggregator::clock_t::time_point{} + 1h;
+	static constexpr int16_t outdoor = 0; // floor 33 °C, radiators 50 °C
+	static constexpr int16_t boilerCurve = 4500;
+};
+
+TEST_F(ZoneAggregatorTest, NoZonesDisabled) {
+	ZoneAggregator zones;
+	EXPECT_FALSE(zones.isEnabled());
+	EXPECT_EQ(zones.size(), 0u);
+	EXPECT_FALSE(zones.aggregate(outdoor, boilerCurve, now).flowTemperature.has_value());
+}
+
+TEST_F(ZoneAggregatorTest, RoomsMapToZonesAndDefault) {
+	ZoneAggregator zones(makeConfig(ZonesConfig::policy_t::max));
+	EXPECT_EQ(zones.size(), 3u);
+	EXPECT_EQ(zones.getZone("Kitchen"), 0u);
+	EXPECT_EQ(zones.getZone("Office"), 1u);
+	EXPECT_EQ(zones.getZone("Garage"), 2u); // default zone
+}
+
+TEST_F(ZoneAggregatorTest, MaxPolicyTakesHottestDemandingZone) {
+	ZoneAggregator zones(makeConfig(ZonesConfig::policy_t::max));
+	zones.addRoom(0, true, true, false, std::nullopt);
+	auto floorOnly = zones.aggregate(outdoor, boilerCurve, now);
+	EXPECT_TRUE(floorOnly.start);
+	EXPECT_EQ(floorOnly.flowTemperature, 3300); // underfloor doesn't get radiator temperature
+
+	zones.clearDemand();
+	zones.addRoom(0, true, false, true, std::nullopt);
+	zones.addRoom(1, true, true, false, std::nullopt);
+	zones.addRoom(1, true, false, false, std::nullopt); // satisfied room
+	auto both = zones.aggregate(outdoor, boilerCurve, now);
+	EXPECT_TRUE(both.start);
+	EXPECT_TRUE(both.keep);
+	EXPECT_EQ(both.flowTemperature, 5000);
+
+	zones.clearDemand();
+	zones.addRoom(2, true, true, false, std::nullopt);
+	EXPECT_EQ(zones.aggregate(outdoor, boilerCurve, now).flowTemperature, boilerCurve); // default zone follows boiler curve
+
+	zones.clearDemand();
+	zones.addRoom(0, true, false, false, std::nullopt);
+	auto none = zones.aggregate(outdoor, boilerCurve, now);
+	EXPECT_FALSE(none.start || none.keep);
+	EXPECT_FALSE(none.flowTemperature.has_value());
+}
+
+TEST_F(ZoneAggregatorTest, OverrideStaysInItsZone) {
+	ZoneAggregator zones(makeConfig(ZonesConfig::policy_t::weighted));
+	zones.addRoom(0, true, true, false, std::nullopt);
+	zones.addRoom(1, true, false, false, 70); // not demanding - its override doesn't count
+	EXPECT_EQ(zones.aggregate(outdoor, boilerCurve, now).flowTemperature, 3300);
+
+	zones.clearDemand();
+	zones.addRoom(0, true, true, false, 45);
+	EXPECT_EQ(zones.aggregate(outdoor, boilerCurve, now).flowTemperature, 4500);
+}
+
+TEST_F(ZoneAggregatorTest, WeightedPolicy) {
+	auto config = makeConfig(ZonesConfig::policy_t::weighted);
+	config.zones[1].weight = 2;
+	ZoneAggregator zones(config);
+	zones.addRoom(0, true, true, false, std::nullopt);
+	zones.addRoom(0, true, true, false, std::nullopt);
+	zones.addRoom(1, true, true, false, std::nullopt);
+	// (2 * 1 * 3300 + 1 * 2 * 5000) / 4
+	EXPECT_EQ(zones.aggregate(outdoor, boilerCurve, now).flowTemperature, 4150);
+
+	std::stringstream ss;
+	zones.getStatus(ss);
+	EXPECT_EQ(ss.str(), "{\"policy\": \"weighted\", \"flowTemperature\": 4150, \"zones\": ["
+	                    "{\"name\": \"floor\", \"rooms\": 2, \"demanding\": 2, \"demand\": true, \"flowTemperature\": 3300}, "
+	                    "{\"name\": \"radiators\", \"rooms\": 1, \"demanding\": 1, \"demand\": true, \"flowTemperature\": 5000}, "
+	                    "{\"name\": \"default\", \"rooms\": 0, \"demanding\": 0, \"demand\": false}]}");
+}
+
+TEST_F(ZoneAggregatorTest, TimeSlicedRotatesDemandingZones) {
+	ZoneAggregator zones(makeConfig(ZonesConfig::policy_t::timeSliced));
+	auto demandAll = [&zones] {
+		zones.clearDemand();
+		zones.addRoom(0, true, true, false, std::nullopt);
+		zones.addRoom(1, true, true, false, std::nullopt);
+	};
+
+	demandAll();
+	auto first = zones.aggregate(outdoor, boilerCurve, now);
+	EXPECT_EQ(first.activeZone, 0u);
+	EXPECT_EQ(first.flowTemperature, 3300);
+
+	demandAll();
+	EXPECT_EQ(zones.aggregate(outdoor, boilerCurve, now + 5min).activeZone, 0u);
+
+	demandAll();
+	auto second = zones.aggregate(outdoor, boilerCurve, now + 10min);
+	EXPECT_EQ(second.activeZone, 1u);
+	EXPECT_EQ(second.flowTemperature, 5000);
+
+	// radiators satisfied early - floor gets the boiler at once
+	zones.clearDemand();
+	zones.addRoom(0, true, false, true, std::nullopt);
+	zones.addRoom(1, true, false, false, std::nullopt);
+	EXPECT_EQ(zones.aggregate(outdoor, boilerCurve, now + 12min).activeZone, 0u);
+
+	// the only demanding zone keeps being served after its slice
+	zones.clearDemand();
+	zones.addRoom(0, true, false, true, std::nullopt);
+	EXPECT_EQ(zones.aggregate(outdoor, boilerCurve, now + 30min).activeZone, 0u);
+
+	std::stringstream ss;
+	zones.getStatus(ss);
+	EXPECT_NE(ss.str().find("{\"name\": \"floor\", \"rooms\": 1, \"demanding\": 1, \"demand\": true, \"flowTemperature\": 3300, \"active\": true}"), std::string::npos);
+}
+
+} // anonymous namespace